@@ -3,7 +3,7 @@ DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0
 unix {
     TIDY_DIR=/opt/tidy56
     CONFIG += link_pkgconfig
-    PKGCONFIG += poppler-qt5 libcurl
+    PKGCONFIG += poppler-qt5 libcurl zlib sqlite3
     QMAKE_RPATHDIR += $$TIDY_DIR/lib
     LIBS += -L$$TIDY_DIR/lib -ltidy
     INCLUDEPATH += $$TIDY_DIR/include
@@ -13,7 +13,7 @@ unix:!mac:LIBS += -lpthread -g -rdynamic
 
 win32:INCLUDEPATH += "$$PWD/winlib/includes/poppler/qt5"
 win32:INCLUDEPATH += "$$PWD/winlib/includes"
-win32:LIBS += -L"$$PWD/winlib" -lpoppler-qt5
+win32:LIBS += -L"$$PWD/winlib" -lpoppler-qt5 -lz -lsqlite3
 win32:RC_ICONS += "$$PWD/resources/images/windowIcon.ico"
 
 
@@ -122,8 +122,14 @@ SOURCES += \
     src/exits/exitpoint.cpp \
     src/filters/filtercriteria.cpp \
     src/filters/filterengine.cpp \
+    src/filters/filterindex.cpp \
+    src/filters/filterquerycompiler.cpp \
+    src/filters/lidbitmap.cpp \
+    src/filters/materializedsearches.cpp \
     src/filters/notesortfilterproxymodel.cpp \
     src/filters/remotequery.cpp \
+    src/filters/searchcache.cpp \
+    src/filters/searchhighlight.cpp \
     src/gui/browserWidgets/authoreditor.cpp \
     src/gui/browserWidgets/colormenu.cpp \
     src/gui/browserWidgets/dateeditor.cpp \
@@ -157,6 +163,7 @@ SOURCES += \
     src/gui/nnotebookviewdelegate.cpp \
     src/gui/nnotebookviewitem.cpp \
     src/gui/nsearchview.cpp \
+    src/gui/nsearchviewdelegate.cpp \
     src/gui/nsearchviewitem.cpp \
     src/gui/ntableview.cpp \
     src/gui/ntableviewheader.cpp \
@@ -205,16 +212,20 @@ SOURCES += \
     src/sql/databaseconnection.cpp \
     src/sql/databaseupgrade.cpp \
     src/sql/datastore.cpp \
+    src/sql/datastorebatch.cpp \
     src/sql/favoritesrecord.cpp \
     src/sql/favoritestable.cpp \
     src/sql/filewatchertable.cpp \
+    src/sql/identitymap.cpp \
     src/sql/linkednotebooktable.cpp \
     src/sql/notebooktable.cpp \
     src/sql/notemetadata.cpp \
     src/sql/notetable.cpp \
     src/sql/nsqlquery.cpp \
     src/sql/resourcetable.cpp \
+    src/sql/searchindextable.cpp \
     src/sql/searchtable.cpp \
+    src/sql/searchtokenizer.cpp \
     src/sql/sharednotebooktable.cpp \
     src/sql/tagtable.cpp \
     src/sql/usertable.cpp \
@@ -225,15 +236,23 @@ SOURCES += \
     src/html/thumbnailer.cpp \
     src/threads/browserrunner.cpp \
     src/threads/counterrunner.cpp \
+    src/threads/indexpipeline.cpp \
     src/threads/indexrunner.cpp \
+    src/threads/indexscheduler.cpp \
+    src/threads/searchrunner.cpp \
     src/threads/syncrunner.cpp \
     src/utilities/crossmemorymapper.cpp \
     src/utilities/debugtool.cpp \
     src/utilities/encrypt.cpp \
+    src/utilities/enmltext.cpp \
     src/utilities/mimereference.cpp \
     src/utilities/noteindexer.cpp \
     src/utilities/nuuid.cpp \
+    src/utilities/officetext.cpp \
+    src/utilities/pdftext.cpp \
     src/utilities/pixelconverter.cpp \
+    src/utilities/textcache.cpp \
+    src/utilities/zipreader.cpp \
     src/watcher/filewatcher.cpp \
     src/watcher/filewatchermanager.cpp \
     src/xml/batchimport.cpp \
@@ -312,8 +331,14 @@ HEADERS  += \
     src/exits/exitpoint.h \
     src/filters/filtercriteria.h \
     src/filters/filterengine.h \
+    src/filters/filterindex.h \
+    src/filters/filterquerycompiler.h \
+    src/filters/lidbitmap.h \
+    src/filters/materializedsearches.h \
     src/filters/notesortfilterproxymodel.h \
     src/filters/remotequery.h \
+    src/filters/searchcache.h \
+    src/filters/searchhighlight.h \
     src/gui/browserWidgets/authoreditor.h \
     src/gui/browserWidgets/colormenu.h \
     src/gui/browserWidgets/dateeditor.h \
@@ -347,6 +372,7 @@ HEADERS  += \
     src/gui/nnotebookviewdelegate.h \
     src/gui/nnotebookviewitem.h \
     src/gui/nsearchview.h \
+    src/gui/nsearchviewdelegate.h \
     src/gui/nsearchviewitem.h \
     src/gui/ntableview.h \
     src/gui/ntableviewheader.h \
@@ -407,16 +433,20 @@ HEADERS  += \
     src/sql/databaseconnection.h \
     src/sql/databaseupgrade.h \
     src/sql/datastore.h \
+    src/sql/datastorebatch.h \
     src/sql/favoritesrecord.h \
     src/sql/favoritestable.h \
     src/sql/filewatchertable.h \
+    src/sql/identitymap.h \
     src/sql/linkednotebooktable.h \
     src/sql/notebooktable.h \
     src/sql/notemetadata.h \
     src/sql/notetable.h \
     src/sql/nsqlquery.h \
     src/sql/resourcetable.h \
+    src/sql/searchindextable.h \
     src/sql/searchtable.h \
+    src/sql/searchtokenizer.h \
     src/sql/sharednotebooktable.h \
     src/sql/tagtable.h \
     src/sql/usertable.h \
@@ -427,15 +457,23 @@ HEADERS  += \
     src/html/thumbnailer.h \
     src/threads/browserrunner.h \
     src/threads/counterrunner.h \
+    src/threads/indexpipeline.h \
     src/threads/indexrunner.h \
+    src/threads/indexscheduler.h \
+    src/threads/searchrunner.h \
     src/threads/syncrunner.h \
     src/utilities/crossmemorymapper.h \
     src/utilities/debugtool.h \
     src/utilities/encrypt.h \
+    src/utilities/enmltext.h \
     src/utilities/mimereference.h \
     src/utilities/noteindexer.h \
     src/utilities/nuuid.h \
+    src/utilities/officetext.h \
+    src/utilities/pdftext.h \
     src/utilities/pixelconverter.h \
+    src/utilities/textcache.h \
+    src/utilities/zipreader.h \
     src/watcher/filewatcher.h \
     src/watcher/filewatchermanager.h \
     src/xml/batchimport.h \
@@ -446,6 +484,18 @@ HEADERS  += \
     src/quentier/utility/StringUtils.h \
     src/quentier/utility/StringUtils_p.h
 
+# "qmake CONFIG+=benchmark" builds the headless search benchmark instead of
+# NixNote.  Run qmake for it in a build directory of its own.
+benchmark {
+    TARGET = nixnote21-benchmark
+    SOURCES -= src/main.cpp
+    SOURCES += \
+        src/benchmark/benchmarkcorpus.cpp \
+        src/benchmark/searchbenchmark.cpp
+    HEADERS += \
+        src/benchmark/benchmarkcorpus.h
+}
+
 # http://doc.qt.io/qt-5/qmake-function-reference.html#str-member-arg-start-end
 # $$left(VAR, len)
 #left = $$str_member(VAR, 0, $$num_add($$len, -1))
@@ -0,0 +1,402 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "benchmarkcorpus.h"
+#include "src/global.h"
+#include "src/sql/configstore.h"
+#include "src/sql/notetable.h"
+#include "src/sql/notebooktable.h"
+#include "src/sql/resourcetable.h"
+#include "src/sql/searchindextable.h"
+#include "src/sql/tagtable.h"
+#include "src/sql/nsqlquery.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QTime>
+
+extern Global global;
+
+// Words are built from these, three to a word
+static const char *syllables[] = { "ba", "be", "bi", "bo", "bu", "da", "de", "di", "do", "du",
+                                   "ka", "ke", "ki", "ko", "ku", "la", "le", "li", "lo", "lu" };
+#define SYLLABLE_COUNT  20
+
+
+BenchmarkCorpus::BenchmarkCorpus(DatabaseConnection *db, quint32 seed)
+{
+    this->db = db;
+    state = seed == 0 ? 1 : seed;
+    notes = 10000;
+    notebooks = 20;
+    tags = 30;
+    imageEvery = 5;
+    pdfEvery = 25;
+    reminderEvery = 10;
+    buildVocabulary();
+}
+
+
+
+// xorshift.  Qt's generators differ between versions & platforms and the
+// corpus has to be the same everywhere.
+quint32 BenchmarkCorpus::random() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+
+qint32 BenchmarkCorpus::random(qint32 limit) {
+    return static_cast<qint32>(random() % static_cast<quint32>(limit));
+}
+
+
+
+// The rank is skewed towards zero so a few words are in most notes and
+// most words are in only a few, like real text.
+QString BenchmarkCorpus::randomWord() {
+    double u = (random() % 1000000) / 1000000.0;
+    return vocabulary[static_cast<qint32>(BENCHMARK_VOCABULARY * u * u * u)];
+}
+
+
+QString BenchmarkCorpus::randomText(qint32 words) {
+    QStringList text;
+    for (qint32 i=0; i<words; i++)
+        text.append(randomWord());
+    return text.join(" ");
+}
+
+
+
+// Each word is the rank written in base 20 with a syllable for each digit.
+// The offset makes every word three syllables long.
+void BenchmarkCorpus::buildVocabulary() {
+    vocabulary.clear();
+    for (qint32 i=0; i<BENCHMARK_VOCABULARY; i++) {
+        qint32 value = i + SYLLABLE_COUNT * SYLLABLE_COUNT;
+        QString word;
+        while (value > 0) {
+            word.prepend(syllables[value % SYLLABLE_COUNT]);
+            value = value / SYLLABLE_COUNT;
+        }
+        vocabulary.append(word);
+    }
+}
+
+
+QString BenchmarkCorpus::word(qint32 rank) {
+    return vocabulary[rank];
+}
+
+
+QString BenchmarkCorpus::notebookName(qint32 i) {
+    return "notebook" + QString::number(i);
+}
+
+
+QString BenchmarkCorpus::tagName(qint32 i) {
+    return "topic" + QString::number(i);
+}
+
+
+
+// Number of notes in the database.  A corpus is only built into an empty one.
+qint32 BenchmarkCorpus::existingNotes() {
+    qint32 count = 0;
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.exec("Select count(*) from NoteTable");
+    if (query.next())
+        count = query.value(0).toInt();
+    query.finish();
+    db->unlock();
+    return count;
+}
+
+
+
+// The others are counted by their guids, so a reused database reports
+// what it really has.
+qint32 BenchmarkCorpus::existingNotebooks() {
+    return countKey(NOTEBOOK_GUID);
+}
+
+
+qint32 BenchmarkCorpus::existingTags() {
+    return countKey(TAG_GUID);
+}
+
+
+qint32 BenchmarkCorpus::existingResources() {
+    return countKey(RESOURCE_GUID);
+}
+
+
+qint32 BenchmarkCorpus::countKey(qint32 key) {
+    qint32 count = 0;
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select count(*) from DataStore where key=:key");
+    query.bindValue(":key", key);
+    query.exec();
+    if (query.next())
+        count = query.value(0).toInt();
+    query.finish();
+    db->unlock();
+    return count;
+}
+
+
+
+// Create everything, then finish the trigram index so postfix searches
+// are measured against it rather than a scan.
+void BenchmarkCorpus::build() {
+    QTime timer;
+    timer.start();
+    addNotebooks(notebooks);
+    addTags(tags);
+    for (qint32 i=0; i<notes; i++) {
+        addNote(i);
+        if ((i+1) % 1000 == 0)
+            QLOG_INFO() << "Benchmark corpus: " << i+1 << " of " << notes << " notes";
+    }
+
+    SearchIndexTable searchIndex(db);
+    searchIndex.createTrigramTable();
+    while (!searchIndex.buildTrigrams())
+        ;
+    QLOG_INFO() << "Benchmark corpus built in " << timer.elapsed() << "ms";
+}
+
+
+
+void BenchmarkCorpus::addNotebooks(qint32 count) {
+    NotebookTable notebookTable(db);
+    for (qint32 i=0; i<count; i++) {
+        Notebook notebook;
+        notebook.guid = QString("benchmark-notebook-%1").arg(i);
+        notebook.name = notebookName(i);
+        notebook.defaultNotebook = (i == 0);
+        notebook.updateSequenceNum = 0;
+        notebookTable.add(0, notebook, false, true);
+        notebookGuids.append(notebook.guid);
+    }
+}
+
+
+
+// Each top level tag has two children, and each of those has two more
+void BenchmarkCorpus::addTags(qint32 count) {
+    TagTable tagTable(db);
+    for (qint32 i=0; i<count; i++) {
+        QStringList parents;
+        parents.append(tagName(i));
+        for (qint32 level=0; level<3; level++) {
+            QStringList children;
+            for (qint32 j=0; j<parents.size(); j++) {
+                Tag tag;
+                tag.guid = "benchmark-tag-" + parents[j];
+                tag.name = parents[j];
+                tag.updateSequenceNum = 0;
+                if (level > 0)
+                    tag.parentGuid = "benchmark-tag-" + parents[j].left(parents[j].lastIndexOf("."));
+                tagTable.add(0, tag, false, 0);
+                tagGuids.append(tag.guid);
+                if (level < 2) {
+                    children.append(parents[j] + ".1");
+                    children.append(parents[j] + ".2");
+                }
+            }
+            parents = children;
+        }
+    }
+}
+
+
+
+void BenchmarkCorpus::addNote(qint32 number) {
+    Note note;
+    note.guid = QString("benchmark-note-%1").arg(number);
+    note.title = randomText(2 + random(6));
+    note.active = true;
+    note.updateSequenceNum = 0;
+    note.notebookGuid = notebookGuids[random(notebookGuids.size())];
+
+    QString content = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\"><en-note>";
+    qint32 words = BENCHMARK_WORDS_MIN + random(BENCHMARK_WORDS_MAX - BENCHMARK_WORDS_MIN);
+    for (qint32 i=0; i<words; i+=40) {
+        content = content + "<div>";
+        if (random(8) == 0)
+            content = content + "<en-todo checked=\"" + (random(2) ? "true" : "false") + "\"/>";
+        content = content + randomText(qMin(40, words-i));
+        if (random(4) == 0)
+            content = content + " " + randomWord() + "-" + randomWord() + " " + randomWord() + "_" + randomWord();
+        content = content + "</div>";
+    }
+    note.content = content + "</en-note>";
+
+    // Spread over the last two years so the date searches select a fraction
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 day = 24 * 60 * 60 * 1000;
+    note.created = now - random(730) * day - random(24 * 60) * 60 * 1000;
+    note.updated = note.created + random(30) * day;
+
+    QList<QString> noteTags;
+    qint32 tagCount = random(4);
+    for (qint32 i=0; i<tagCount && !tagGuids.isEmpty(); i++) {
+        QString guid = tagGuids[random(tagGuids.size())];
+        if (!noteTags.contains(guid))
+            noteTags.append(guid);
+    }
+    if (!noteTags.isEmpty())
+        note.tagGuids = noteTags;
+
+    NoteAttributes attributes;
+    if (number % reminderEvery == 0) {
+        attributes.reminderOrder = now - number;
+        attributes.reminderTime = now + random(60) * day;
+    }
+    attributes.author = "benchmark";
+    note.attributes = attributes;
+
+    NoteTable noteTable(db);
+    qint32 lid = noteTable.add(0, note, false);
+    if (number % imageEvery == 0)
+        addImage(lid, note.guid);
+    if (number % pdfEvery == 0)
+        addPdf(lid, note.guid);
+}
+
+
+
+// An image whose recognition data has a few candidate words per item,
+// weighted like the Evernote service does it
+void BenchmarkCorpus::addImage(qint32 noteLid, QString noteGuid) {
+    QByteArray body;
+    for (qint32 i=0; i<256; i++)
+        body.append(static_cast<char>(random(256)));
+    QByteArray hash = QCryptographicHash::hash(body, QCryptographicHash::Md5);
+
+    QString xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "<recoIndex docType=\"unknown\" objType=\"image\" objID=\"" + hash.toHex() + "\" "
+            "engineVersion=\"7.0.24.1\" recoType=\"service\" lang=\"en\" objWidth=\"640\" objHeight=\"480\">";
+    qint32 items = 3 + random(12);
+    for (qint32 i=0; i<items; i++) {
+        xml = xml + QString("<item x=\"%1\" y=\"%2\" w=\"%3\" h=\"20\">")
+                .arg(random(600)).arg(random(460)).arg(40 + random(120));
+        qint32 candidates = 1 + random(3);
+        for (qint32 j=0; j<candidates; j++)
+            xml = xml + QString("<t w=\"%1\">").arg(90 - j*30) + randomWord() + "</t>";
+        xml = xml + "</item>";
+    }
+    xml = xml + "</recoIndex>";
+
+    Data data;
+    data.body = body;
+    data.bodyHash = hash;
+    data.size = body.size();
+    Data recognition;
+    recognition.body = xml.toUtf8();
+    recognition.bodyHash = QCryptographicHash::hash(recognition.body, QCryptographicHash::Md5);
+    recognition.size = xml.toUtf8().size();
+
+    ConfigStore cs(db);
+    qint32 lid = cs.incrementLidCounter();
+    Resource r;
+    r.guid = QString("benchmark-resource-%1").arg(lid);
+    r.noteGuid = noteGuid;
+    r.mime = "image/png";
+    r.active = true;
+    r.updateSequenceNum = 0;
+    r.width = 640;
+    r.height = 480;
+    r.data = data;
+    r.recognition = recognition;
+    ResourceAttributes attributes;
+    attributes.fileName = QString("scan%1.png").arg(lid);
+    r.attributes = attributes;
+
+    ResourceTable resourceTable(db);
+    resourceTable.add(lid, r, false, noteLid);
+}
+
+
+
+void BenchmarkCorpus::addPdf(qint32 noteLid, QString noteGuid) {
+    Data data;
+    data.body = pdf(randomText(60 + random(200)));
+    data.bodyHash = QCryptographicHash::hash(data.body, QCryptographicHash::Md5);
+    data.size = QByteArray(data.body).size();
+
+    ConfigStore cs(db);
+    qint32 lid = cs.incrementLidCounter();
+    Resource r;
+    r.guid = QString("benchmark-resource-%1").arg(lid);
+    r.noteGuid = noteGuid;
+    r.mime = "application/pdf";
+    r.active = true;
+    r.updateSequenceNum = 0;
+    r.data = data;
+    ResourceAttributes attributes;
+    attributes.fileName = QString("document%1.pdf").arg(lid);
+    attributes.attachment = true;
+    r.attributes = attributes;
+
+    ResourceTable resourceTable(db);
+    resourceTable.add(lid, r, false, noteLid);
+}
+
+
+
+// The smallest PDF poppler will read: one page, one font & a line of text
+// for every ten words.
+QByteArray BenchmarkCorpus::pdf(QString text) {
+    QStringList words = text.split(" ", QString::SkipEmptyParts);
+    QString stream = "BT /F1 11 Tf 14 TL 50 760 Td";
+    for (qint32 i=0; i<words.size(); i+=10)
+        stream = stream + " (" + QStringList(words.mid(i, 10)).join(" ") + ") Tj T*";
+    stream = stream + " ET";
+
+    QList<QByteArray> objects;
+    objects.append("<< /Type /Catalog /Pages 2 0 R >>");
+    objects.append("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+    objects.append("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Contents 4 0 R "
+                   "/Resources << /Font << /F1 5 0 R >> >> >>");
+    objects.append("<< /Length " + QByteArray::number(stream.toLatin1().size()) + " >>\nstream\n"
+                   + stream.toLatin1() + "\nendstream");
+    objects.append("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+
+    QByteArray pdf = "%PDF-1.4\n";
+    QList<qint32> offsets;
+    for (qint32 i=0; i<objects.size(); i++) {
+        offsets.append(pdf.size());
+        pdf.append(QByteArray::number(i+1) + " 0 obj\n" + objects[i] + "\nendobj\n");
+    }
+    qint32 xref = pdf.size();
+    pdf.append("xref\n0 " + QByteArray::number(objects.size()+1) + "\n0000000000 65535 f \n");
+    for (qint32 i=0; i<offsets.size(); i++)
+        pdf.append(QString("%1 00000 n \n").arg(offsets[i], 10, 10, QChar('0')).toLatin1());
+    pdf.append("trailer\n<< /Size " + QByteArray::number(objects.size()+1) + " /Root 1 0 R >>\n"
+               "startxref\n" + QByteArray::number(xref) + "\n%%EOF\n");
+    return pdf;
+}
@@ -0,0 +1,84 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef BENCHMARKCORPUS_H
+#define BENCHMARKCORPUS_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+
+#include "src/sql/databaseconnection.h"
+
+//****************************************************
+//* Builds a synthetic database for the search
+//* benchmark: notebooks, nested tags & notes made of
+//* generated words, some with image resources that
+//* carry recognition data, PDFs & reminders.  The
+//* same seed always gives the same corpus, so runs
+//* on different builds can be compared.
+//****************************************************
+
+#define BENCHMARK_VOCABULARY    4000    // Distinct words in the corpus
+#define BENCHMARK_WORDS_MIN     40      // Words in the shortest note
+#define BENCHMARK_WORDS_MAX     400     // Words in the longest note
+
+class BenchmarkCorpus
+{
+private:
+    DatabaseConnection *db;
+    quint32 state;
+    QStringList vocabulary;
+    QList<QString> notebookGuids;
+    QList<QString> tagGuids;
+
+    quint32 random();                       // Next value of the generator
+    qint32 random(qint32 limit);            // 0 <= value < limit
+    QString randomWord();                   // Frequent words are picked more often
+    QString randomText(qint32 words);
+    void buildVocabulary();
+    void addNotebooks(qint32 count);
+    void addTags(qint32 count);
+    void addNote(qint32 number);
+    void addImage(qint32 noteLid, QString noteGuid);
+    void addPdf(qint32 noteLid, QString noteGuid);
+    qint32 countKey(qint32 key);            // DataStore rows with this key
+
+public:
+    qint32 notes;                           // Notes to create
+    qint32 notebooks;
+    qint32 tags;                            // Top level tags.  Each has two levels of children.
+    qint32 imageEvery;                      // One note in this many gets an image
+    qint32 pdfEvery;                        // ... a PDF
+    qint32 reminderEvery;                   // ... a reminder
+
+    BenchmarkCorpus(DatabaseConnection *db, quint32 seed);
+    qint32 existingNotes();                 // Notes already in the database
+    qint32 existingNotebooks();
+    qint32 existingTags();
+    qint32 existingResources();
+    void build();                           // Create the corpus & its indexes
+    QString word(qint32 rank);              // The word of a frequency rank.  0 is the most common.
+    QString notebookName(qint32 i);
+    QString tagName(qint32 i);
+    static QByteArray pdf(QString text);    // A one page PDF with the text on it
+};
+
+#endif // BENCHMARKCORPUS_H
@@ -0,0 +1,263 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+//*********************************************************************
+//* Search benchmark.  This replaces main.cpp when the project is
+//* built with "qmake CONFIG+=benchmark".  It builds a synthetic
+//* database (or reuses one from an earlier run), times
+//* FilterEngine::filter over a fixed set of query shapes & writes
+//* the timings as JSON.  It needs no display.
+//*
+//*   nixnote21-benchmark [--notes=10000] [--seed=1] [--iterations=20]
+//*                       [--output=file.json] [--legacy] [--cached]
+//*                       [--userDataDir=<dir>] [--logLevel=<level>]
+//*
+//* Without --userDataDir the database is built in a temporary
+//* directory that is removed on exit.
+//*********************************************************************
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtAlgorithms>
+#include <iostream>
+
+#include "src/global.h"
+#include "src/settings/startupconfig.h"
+#include "src/filters/filtercriteria.h"
+#include "src/filters/filterengine.h"
+#include "src/sql/databaseconnection.h"
+#include "src/logger/qslog.h"
+#include "benchmarkcorpus.h"
+
+extern Global global;
+
+class BenchmarkQuery
+{
+public:
+    QString name;
+    QString query;
+    BenchmarkQuery(QString name, QString query) { this->name = name; this->query = query; }
+};
+
+
+
+// The query shapes that are timed.  The words are picked by frequency rank
+// so every run searches for the same thing.
+static QList<BenchmarkQuery> catalog(BenchmarkCorpus &corpus) {
+    QList<BenchmarkQuery> queries;
+    queries.append(BenchmarkQuery("fts_common", corpus.word(0)));
+    queries.append(BenchmarkQuery("fts_medium", corpus.word(40)));
+    queries.append(BenchmarkQuery("fts_rare", corpus.word(1500)));
+    queries.append(BenchmarkQuery("fts_two_terms", corpus.word(3) + " " + corpus.word(25)));
+    queries.append(BenchmarkQuery("prefix", corpus.word(10).left(4) + "*"));
+    queries.append(BenchmarkQuery("postfix", "*" + corpus.word(12).right(4)));
+    queries.append(BenchmarkQuery("tag", "tag:" + corpus.tagName(3)));
+    queries.append(BenchmarkQuery("tag_wildcard", "tag:" + corpus.tagName(1) + "*"));
+    queries.append(BenchmarkQuery("notebook", "notebook:" + corpus.notebookName(2)));
+    queries.append(BenchmarkQuery("created", "created:day-30"));
+    queries.append(BenchmarkQuery("reminder", "reminderOrder:*"));
+    queries.append(BenchmarkQuery("resource", "resource:application/pdf"));
+    queries.append(BenchmarkQuery("any", "any: " + corpus.word(200) + " " + corpus.word(300) + " " + corpus.word(400)));
+    queries.append(BenchmarkQuery("negate_term", corpus.word(0) + " -" + corpus.word(5)));
+    queries.append(BenchmarkQuery("negate_tag", corpus.word(2) + " -tag:" + corpus.tagName(0)));
+    queries.append(BenchmarkQuery("negate_notebook", "-notebook:" + corpus.notebookName(1)));
+    queries.append(BenchmarkQuery("combined", "notebook:" + corpus.notebookName(3) + " tag:" + corpus.tagName(4)
+                                  + "* created:day-365 " + corpus.word(8)));
+    return queries;
+}
+
+
+
+// Nearest rank percentile of sorted samples
+static double percentile(const QList<double> &sorted, double p) {
+    if (sorted.isEmpty())
+        return 0;
+    qint32 rank = static_cast<qint32>(p / 100.0 * sorted.size() + 0.999999) - 1;
+    return sorted[qBound(0, rank, sorted.size() - 1)];
+}
+
+
+
+// Run one query the requested number of times
+static QJsonObject measure(BenchmarkQuery &query, qint32 iterations, bool cached) {
+    FilterEngine engine;
+    QList<double> samples;
+    qint32 results = 0;
+    for (qint32 i=-1; i<iterations; i++) {       // The first run warms up SQLite's page cache
+        if (!cached)
+            global.searchCache.clear();
+        FilterCriteria *criteria = new FilterCriteria();
+        criteria->setSearchString(query.query);
+        QList<qint32> lids;
+        QElapsedTimer timer;
+        timer.start();
+        engine.filter(criteria, &lids);
+        double elapsed = timer.nsecsElapsed() / 1000000.0;
+        delete criteria;
+        results = lids.size();
+        if (i >= 0)
+            samples.append(elapsed);
+    }
+
+    qSort(samples);
+    double total = 0;
+    for (int i=0; i<samples.size(); i++)
+        total += samples[i];
+
+    QJsonObject retval;
+    retval["name"] = query.name;
+    retval["query"] = query.query;
+    retval["results"] = results;
+    retval["min_ms"] = samples.isEmpty() ? 0 : samples.first();
+    retval["mean_ms"] = samples.isEmpty() ? 0 : total / samples.size();
+    retval["p50_ms"] = percentile(samples, 50);
+    retval["p90_ms"] = percentile(samples, 90);
+    retval["p95_ms"] = percentile(samples, 95);
+    retval["p99_ms"] = percentile(samples, 99);
+    retval["max_ms"] = samples.isEmpty() ? 0 : samples.last();
+    QLOG_INFO() << "Benchmark " << query.name << ": " << results << " notes, p50 "
+                << retval["p50_ms"].toDouble() << "ms";
+    return retval;
+}
+
+
+
+int main(int argc, char *argv[]) {
+    QsLogging::Logger &logger = QsLogging::Logger::instance();
+    logger.setLoggingLevel(QsLogging::InfoLevel);
+    QsLogging::DestinationPtr debugDestination(
+        QsLogging::DestinationFactory::MakeDebugOutputDestination());
+    logger.addDestination(debugDestination.get());
+
+    qint32 notes = 10000;
+    quint32 seed = 1;
+    qint32 iterations = 20;
+    QString output = "";
+    bool legacy = false;
+    bool cached = false;
+    for (int i=1; i<argc; i++) {
+        QString parm(argv[i]);
+        if (parm.startsWith("--notes="))
+            notes = parm.mid(8).toInt();
+        if (parm.startsWith("--seed="))
+            seed = parm.mid(7).toUInt();
+        if (parm.startsWith("--iterations="))
+            iterations = qMax(1, parm.mid(13).toInt());
+        if (parm.startsWith("--output="))
+            output = parm.mid(9);
+        if (parm == "--legacy")
+            legacy = true;
+        if (parm == "--cached")
+            cached = true;
+    }
+
+    // Nothing is shown, so there is no need for a display
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+    QCoreApplication::setApplicationName(NN_APP_NAME);
+    global.application = &a;
+    global.argc = argc;
+    global.argv = argv;
+
+    StartupConfig startupConfig;
+    bool guiAvailable;
+    if (startupConfig.init(argc, argv, guiAvailable) != 0)
+        return 1;
+
+    // Never touch the user's own database unless told to
+    QTemporaryDir scratch;
+    QString userDataDir = startupConfig.getUserDataDir();
+    if (userDataDir == "")
+        userDataDir = scratch.path();
+    QString configDir = startupConfig.getConfigDir();
+    if (configDir == "")
+        configDir = userDataDir;
+    global.fileManager.setup(configDir, userDataDir, startupConfig.getProgramDataDir());
+    global.initializeGlobalSettings();
+    global.initializeUserSettings(startupConfig.getAccountId());
+    global.fileManager.setupUserDirectories(global.getAccountId());
+    global.initializeSharedMemoryMapper(global.getAccountId());
+    global.setup(startupConfig, true);
+
+    // Index as the notes are added rather than in the background
+    global.enableIndexing = false;
+    global.indexPDFLocally = true;
+    global.setLegacyFilterEngine(legacy);
+
+    global.db = new DatabaseConnection(NN_DB_CONNECTION_NAME);
+    global.filterCriteria.append(new FilterCriteria());
+    global.filterPosition = 0;
+
+    BenchmarkCorpus corpus(global.db, seed);
+    corpus.notes = notes;
+    qint32 existing = corpus.existingNotes();
+    QElapsedTimer buildTimer;
+    buildTimer.start();
+    if (existing == 0)
+        corpus.build();
+    else
+        QLOG_INFO() << "Reusing the " << existing << " notes already in " << userDataDir;
+    qint64 buildTime = buildTimer.elapsed();
+
+    QJsonObject corpusInfo;
+    corpusInfo["notes"] = corpus.existingNotes();
+    corpusInfo["notebooks"] = corpus.existingNotebooks();
+    corpusInfo["tags"] = corpus.existingTags();
+    corpusInfo["resources"] = corpus.existingResources();
+    corpusInfo["seed"] = static_cast<qint64>(seed);
+    corpusInfo["reused"] = existing != 0;
+    corpusInfo["build_ms"] = buildTime;
+
+    QJsonArray results;
+    QList<BenchmarkQuery> queries = catalog(corpus);
+    for (int i=0; i<queries.size(); i++)
+        results.append(measure(queries[i], iterations, cached));
+
+    QJsonObject report;
+    report["benchmark"] = QString("search");
+    report["version"] = global.fileManager.getProgramVersionPrintable();
+    report["qt"] = QString(qVersion());
+    report["engine"] = legacy ? QString("legacy") : QString("compiled");
+    report["cached"] = cached;
+    report["iterations"] = iterations;
+    report["corpus"] = corpusInfo;
+    report["queries"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (output == "") {
+        std::cout << json.constData();
+    } else {
+        QFile file(output);
+        if (!file.open(QIODevice::WriteOnly)) {
+            QLOG_ERROR() << "Unable to write " << output;
+            return 1;
+        }
+        file.write(json);
+        file.close();
+    }
+    if (global.sharedMemory->isAttached())
+        global.sharedMemory->detach();
+    return 0;
+}
@@ -0,0 +1,283 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+//*********************************************************************
+//* Text benchmark.  Times the ENML to text conversion the indexer
+//* uses against the way it used to be done (strip the tags one at a
+//* time & hand the rest to a QTextDocument), on a generated note.
+//* Then times StringUtils::removeDiacritics against the loop it
+//* replaced, on the note's text & on text full of accents.  The old
+//* loop is quadratic, so that text is smaller.
+//*
+//*   nixnote21-textbenchmark [--size=1048576] [--iterations=5]
+//*                           [--diacriticSize=65536] [--seed=1]
+//*                           [--output=file.json]
+//*********************************************************************
+
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextDocument>
+#include <QtAlgorithms>
+#include <iostream>
+
+#include "src/quentier/utility/StringUtils.h"
+#include "src/utilities/enmltext.h"
+
+typedef QString (*TextFunction)(const QString &text);
+
+static quint32 state;
+static quentier::StringUtils stringUtils;
+
+static quint32 nextRandom() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+
+
+// A note of about the given size made of the things real notes have:
+// paragraphs, formatting, lists, tables, entities, media & encrypted text.
+static QString generateNote(qint32 size) {
+    static const char *words[] = {
+        "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+        "india", "juliett", "kilo", "lima", "mike", "november", "oscar", "papa"
+    };
+    QString note = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                   "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\"><en-note>";
+    while (note.length() < size) {
+        switch (nextRandom() % 8) {
+        case 0:
+            note.append("<ul><li>" + QString(words[nextRandom() % 16]) + "</li><li>"
+                        + QString(words[nextRandom() % 16]) + " &amp; caf&eacute;</li></ul>");
+            break;
+        case 1:
+            note.append("<table><tr><td>" + QString(words[nextRandom() % 16]) + "</td><td>"
+                        + QString::number(nextRandom() % 1000) + "</td></tr></table>");
+            break;
+        case 2:
+            note.append("<div><en-media hash=\"0123456789abcdef0123456789abcdef\" type=\"image/png\"/></div>");
+            break;
+        case 3:
+            note.append("<en-crypt cipher=\"AES\" length=\"128\">U2FsdGVkX1+0123456789abcdefABCDEF==</en-crypt>");
+            break;
+        default:
+            note.append("<div>");
+            for (int i=0; i<12; i++) {
+                QString word = words[nextRandom() % 16];
+                if (i % 5 == 4)
+                    word = "<b>" + word + "</b>";
+                note.append(word + (i % 7 == 6 ? "&nbsp;" : " "));
+            }
+            note.append("</div>");
+        }
+    }
+    note.append("</en-note>");
+    return note;
+}
+
+
+
+// How IndexRunner, NoteIndexer & ExtractNoteText used to do it
+static QString legacyText(QString content) {
+    qint32 startPos = content.indexOf(QChar('<'));
+    qint32 endPos = content.indexOf(QChar('>'),startPos)+1;
+    content.remove(startPos,endPos-startPos);
+
+    while (content.contains("<en-crypt")) {
+        startPos = content.indexOf("<en-crypt");
+        endPos = content.indexOf("</en-crypt>") + 11;
+        content = content.mid(0,startPos)+content.mid(endPos);
+    }
+
+    while (content.contains(QChar('<'))) {
+        startPos = content.indexOf(QChar('<'));
+        endPos = content.indexOf(QChar('>'),startPos)+1;
+        content.remove(startPos,endPos-startPos);
+    }
+
+    QTextDocument textDocument;
+    textDocument.setHtml(content);
+    return textDocument.toPlainText();
+}
+
+
+
+// Text with accents, ligatures & a few scripts besides Latin
+static QString generateAccentedText(qint32 size) {
+    static const char *words[] = {
+        "café", "naïve", "Straße", "Ærøskøbing", "résumé", "Œuvre", "señor", "crème",
+        "Ελληνικά", "東京", "Ångström", "ﬁnancial", "Ｆｕｌｌ", "piñata", "alpha", "bravo"
+    };
+    QString text = "";
+    while (text.length() < size) {
+        text.append(QString::fromUtf8(words[nextRandom() % 16]));
+        text.append(nextRandom() % 9 == 0 ? "\n" : " ");
+    }
+    return text;
+}
+
+
+
+static QString streamingText(const QString &note) {
+    return EnmlText::toPlainText(note);
+}
+
+
+static QString legacyEnmlText(const QString &note) {
+    return legacyText(note);
+}
+
+
+static QString tableDiacritics(const QString &text) {
+    QString result = text;
+    stringUtils.removeDiacritics(result);
+    return result;
+}
+
+
+
+// How StringUtils used to remove diacritics
+static QString legacyDiacritics(const QString &text) {
+    static const QString letters = QString::fromUtf8("ŠŒŽšœžŸ¥µÀÁÂÃÄÅÆÇÈÉÊËÌÍÎÏÐÑÒÓÔÕÖØÙÚÛÜÝßàáâãäåæçèéêëìíîïðñòóôõöøùúûüýÿ");
+    static const char *plain[] = {
+        "S", "OE", "Z", "s", "oe", "z", "Y", "Y", "u", "A", "A", "A",
+        "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I",
+        "I", "D", "N", "O", "O", "O", "O", "O", "O", "U", "U", "U",
+        "U", "Y", "s", "a", "a", "a", "a", "a", "a", "ae", "c", "e",
+        "e", "e", "e", "i", "i", "i", "i", "o", "n", "o", "o", "o",
+        "o", "o", "o", "u", "u", "u", "u", "y", "y",
+    };
+    QString str = text.normalized(QString::NormalizationForm_KD);
+    for (int i=0; i<str.length(); ++i) {
+        QChar::Category category = str[i].category();
+        if (category == QChar::Mark_NonSpacing || category == QChar::Mark_SpacingCombining ||
+            category == QChar::Mark_Enclosing) {
+            str.remove(i, 1);
+            continue;
+        }
+        int index = letters.indexOf(str[i]);
+        if (index >= 0)
+            str.replace(i, 1, QString(plain[index]));
+    }
+    return str;
+}
+
+
+
+static QJsonObject measure(QString name, const QString &input, qint32 iterations, TextFunction function) {
+    QList<double> samples;
+    qint32 length = 0;
+    for (qint32 i=0; i<iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        QString text = function(input);
+        samples.append(timer.nsecsElapsed() / 1000000.0);
+        length = text.length();
+    }
+
+    qSort(samples);
+    double total = 0;
+    for (int i=0; i<samples.size(); i++)
+        total += samples[i];
+    double mean = total / samples.size();
+
+    QJsonObject retval;
+    retval["name"] = name;
+    retval["input_chars"] = input.length();
+    retval["text_chars"] = length;
+    retval["min_ms"] = samples.first();
+    retval["mean_ms"] = mean;
+    retval["p50_ms"] = samples[(samples.size()-1) / 2];
+    retval["max_ms"] = samples.last();
+    retval["mb_per_s"] = input.length() * 2 / 1048576.0 / (samples.first() / 1000.0);
+    std::cerr << qPrintable(name) << ": " << samples.first() << "ms" << std::endl;
+    return retval;
+}
+
+
+
+int main(int argc, char *argv[]) {
+    qint32 size = 1048576;
+    qint32 iterations = 5;
+    qint32 diacriticSize = 65536;
+    QString output = "";
+    state = 1;
+    for (int i=1; i<argc; i++) {
+        QString parm(argv[i]);
+        if (parm.startsWith("--size="))
+            size = parm.mid(7).toInt();
+        if (parm.startsWith("--iterations="))
+            iterations = qMax(1, parm.mid(13).toInt());
+        if (parm.startsWith("--diacriticSize="))
+            diacriticSize = parm.mid(16).toInt();
+        if (parm.startsWith("--seed="))
+            state = qMax(1u, parm.mid(7).toUInt());
+        if (parm.startsWith("--output="))
+            output = parm.mid(9);
+    }
+
+    // QTextDocument needs a QGuiApplication, but nothing is shown
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication a(argc, argv);
+
+    QString note = generateNote(size);
+    QJsonArray results;
+    results.append(measure("enml_streaming", note, iterations, streamingText));
+    results.append(measure("enml_legacy", note, iterations, legacyEnmlText));
+
+    // The old loop skips a mark that follows another, so only text without
+    // stacked marks is expected to come out the same
+    QString noteText = EnmlText::toPlainText(note).left(diacriticSize);
+    QString accented = generateAccentedText(diacriticSize);
+    bool same = tableDiacritics(noteText) == legacyDiacritics(noteText) &&
+                tableDiacritics(accented) == legacyDiacritics(accented);
+    results.append(measure("diacritics_table_note", noteText, iterations, tableDiacritics));
+    results.append(measure("diacritics_legacy_note", noteText, iterations, legacyDiacritics));
+    results.append(measure("diacritics_table_accented", accented, iterations, tableDiacritics));
+    results.append(measure("diacritics_legacy_accented", accented, iterations, legacyDiacritics));
+
+    QJsonObject report;
+    report["benchmark"] = QString("text");
+    report["qt"] = QString(qVersion());
+    report["iterations"] = iterations;
+    report["note_chars"] = note.length();
+    report["diacritics_match"] = same;
+    report["results"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (output == "") {
+        std::cout << json.constData();
+    } else {
+        QFile file(output);
+        if (!file.open(QIODevice::WriteOnly)) {
+            std::cerr << "Unable to write " << qPrintable(output) << std::endl;
+            return 1;
+        }
+        file.write(json);
+        file.close();
+    }
+    return 0;
+}
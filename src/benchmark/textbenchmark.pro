@@ -0,0 +1,22 @@
+# Microbenchmarks of the text handling behind the search index.  They
+# only need Qt, so they are a project of their own:
+#
+#   qmake src/benchmark/textbenchmark.pro && make
+QT += core gui
+TARGET = nixnote21-textbenchmark
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += \
+    textbenchmark.cpp \
+    ../quentier/utility/StringUtils.cpp \
+    ../quentier/utility/StringUtils_p.cpp \
+    ../utilities/enmltext.cpp
+
+HEADERS += \
+    ../quentier/utility/StringUtils.h \
+    ../quentier/utility/StringUtils_p.h \
+    ../utilities/enmltext.h
@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/global.h"
 #include <QXmlStreamReader>
 #include "extractnotetext.h"
+#include "src/utilities/enmltext.h"
 
 extern Global global;
 
@@ -86,23 +87,7 @@ void ExtractNoteText::unwrap(QString data) {
 
 
 QString ExtractNoteText::stripTags(QString content) {
-
-    // Start looking through the note
-    qint32 startPos =content.indexOf(QChar('<'));
-    qint32 endPos = content.indexOf(QChar('>'),startPos)+1;
-    content.remove(startPos,endPos-startPos);
-
-    // Remove encrypted text
-    while (content.contains("<en-crypt")) {
-        startPos = content.indexOf("<en-crypt");
-        endPos = content.indexOf("</en-crypt>") + 11;
-        content = content.mid(0,startPos)+content.mid(endPos);
-    }
-
-    // Get the content as an HTML doc.  This will strip any
-    // remaining tags out, but will also return it as a formatted
-    // string that preserves things like a newline.
-    QTextDocument textDocument;
-    textDocument.setHtml(content);
-    return textDocument.toPlainText();
+    // Block elements come back as line breaks, so the text keeps the
+    // note's paragraphs.
+    return EnmlText::toPlainText(content);
 }
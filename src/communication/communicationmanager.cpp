@@ -953,7 +953,8 @@ void CommunicationManager::processSyncChunk(SyncChunk &chunk, QString token) {
         QLOG_TRACE() << "Fetching chunk item: " << i << ": " << notes[i].title;
         Note n = notes[i];
         noteList.insert(n.guid, "");
-        n = noteStore->getNote(notes[i].guid, true, true, true, true, token);
+        n = noteStore->getNote(notes[i].guid, true, false, true, true, token);
+        fetchChangedResourceData(n, token);
         QLOG_TRACE() << "Note Retrieved";
 
         // Load up the tag names because Evernote doesn't give them.
@@ -1005,6 +1006,32 @@ void CommunicationManager::processSyncChunk(SyncChunk &chunk, QString token) {
 
 
 
+// Download the data for a note's resources, skipping any whose hash
+// matches what we already have.  NoteTable::sync keeps the existing
+// file for those, so an edit to a note's text doesn't pull down its
+// attachments again.
+void CommunicationManager::fetchChangedResourceData(Note &note, QString token) {
+    if (!note.resources.isSet())
+        return;
+    ResourceTable resTable(db);
+    QList<Resource> resources = note.resources;
+    for (int i = 0; i < resources.size(); i++) {
+        if (!resources[i].data.isSet())
+            continue;
+        Data data = resources[i].data;
+        qint32 lid = resTable.getLid(note.guid, resources[i].guid);
+        if (lid > 0 && data.bodyHash.isSet() && resTable.getDataHash(lid) == data.bodyHash.ref())
+            continue;
+        QLOG_TRACE() << "Fetching resource data: " << resources[i].guid;
+        data.body = noteStore->getResourceData(resources[i].guid, token);
+        resources[i].data = data;
+    }
+    note.resources = resources;
+}
+
+
+
+
 //***********************************************************************
 //***********************************************************************
 //*** Exception Handling. Print trace information & return            ***
@@ -100,6 +100,7 @@ private:
     NoteStore *linkedNoteStore;                               // Linked notestore class
     NoteStore *myNoteStore;                                   // local account notestore class
     void processSyncChunk(SyncChunk &chunk, QString token);   // Deal with a sync chunk.
+    void fetchChangedResourceData(Note &note, QString token);   // Download resource data we don't already have
     void dumpNote(const Note &note) const;
     void reportError(const CommunicationError::CommunicationErrorType errorType,
                      int code,
@@ -36,11 +36,13 @@ DebugPreferences::DebugPreferences(QWidget *parent) :
     showLidColumn = new QCheckBox(tr("Show LID column (requires restart)."));
     nonAsciiSortBug = new QCheckBox(tr("Disable Tag Sorting (useful for non-ASCII sort bug)."));
     forceUTF8 = new QCheckBox(tr("Force UTF8 Encoding."));
+    auditQueryPlans = new QCheckBox(tr("Log SQL full table scans (requires restart)."));
     nonAsciiSortBug->setChecked(global.nonAsciiSortBug);
     forceUTF8->setChecked(global.getForceUTF8());
     global.settings->beginGroup(INI_GROUP_DEBUGGING);
     disableUploads->setChecked(global.disableUploads);
     showLidColumn->setChecked(global.settings->value("showLids", false).toBool());
+    auditQueryPlans->setChecked(global.settings->value("auditQueryPlans", false).toBool());
     global.settings->endGroup();
     disableImageHighlight->setChecked(global.disableImageHighlight());
 
@@ -50,6 +52,7 @@ DebugPreferences::DebugPreferences(QWidget *parent) :
     mainLayout->addWidget(nonAsciiSortBug, row++, 1);
     mainLayout->addWidget(disableImageHighlight, row++, 1);
     mainLayout->addWidget(forceUTF8, row++, 1);
+    mainLayout->addWidget(auditQueryPlans, row++, 1);
 
 #ifndef _WIN32
     interceptSigHup = new QCheckBox(tr("Intercept Unix SIGHUP (requires restart)."));
@@ -86,6 +89,7 @@ void DebugPreferences::saveValues() {
     global.settings->setValue("showLids", showLidColumn->isChecked());
     global.settings->setValue("nonAsciiSortBug", nonAsciiSortBug->isChecked());
     global.settings->setValue("disableImageHighlight", disableImageHighlight->isChecked());
+    global.settings->setValue("auditQueryPlans", auditQueryPlans->isChecked());
     global.nonAsciiSortBug = nonAsciiSortBug->isChecked();
 
     // If the disable uploads is different than the defaults or if it has changed, we save it.
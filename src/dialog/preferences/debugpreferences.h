@@ -38,6 +38,7 @@ private:
     QCheckBox *nonAsciiSortBug;
     QCheckBox *disableImageHighlight;
     QCheckBox *forceUTF8;
+    QCheckBox *auditQueryPlans;
     QCheckBox *interceptSigHup;
     QCheckBox *multiThreadSave;
     QSpinBox *autoSaveInterval;
@@ -57,10 +57,18 @@ SearchPreferences::SearchPreferences(QWidget *parent) :
     mainLayout->addWidget(tagSelectionOr,row++,0);
     tagSelectionOr->setChecked(global.indexPDFLocally);
 
+    includeChildTags = new QCheckBox(tr("Include Child Tags When Selecting or Searching a Tag"));
+    mainLayout->addWidget(includeChildTags,row++,0);
+    includeChildTags->setChecked(global.getIncludeChildTags());
+
     indexPDF = new QCheckBox(tr("Index PDFs locally"));
     mainLayout->addWidget(indexPDF,row++,0);
     indexPDF->setChecked(global.indexPDFLocally);
 
+    legacyFilterEngine = new QCheckBox(tr("Use the legacy search engine"));
+    mainLayout->addWidget(legacyFilterEngine,row++,0);
+    legacyFilterEngine->setChecked(global.getLegacyFilterEngine());
+
     enableBackgroundIndexing = new QCheckBox(tr("Background Indexing (requires restart & may cause issues on some systems)"));
     mainLayout->addWidget(enableBackgroundIndexing,row++,0);
     enableBackgroundIndexing->setChecked(global.getBackgroundIndexing());
@@ -72,6 +80,14 @@ SearchPreferences::SearchPreferences(QWidget *parent) :
     weight->setMaximum(100);
     weight->setValue(global.getMinimumRecognitionWeight());
 
+    mainLayout->addWidget(new QLabel(tr("Indexing Threads")), row,0);
+    indexThreads = new QSpinBox(this);
+    mainLayout->addWidget(indexThreads,row++,1);
+    indexThreads->setMinimum(0);
+    indexThreads->setMaximum(32);
+    indexThreads->setSpecialValueText(tr("One per CPU"));
+    indexThreads->setValue(global.getIndexThreads());
+
 
     mainLayout->addWidget(new QLabel(tr("Experimental: Search/index preprocessing. On change reindexing of all notes is needed.")), row++, 0);
     mainLayout->addWidget(new QLabel(tr("=> currently can be only enabled manually")), row++, 0);
@@ -102,10 +118,13 @@ void SearchPreferences::saveValues() {
     global.setClearTagsOnSearch(clearNotebookOnSearch->isChecked());
     global.setClearSearchOnNotebook(clearSearchOnNotebook->isChecked());
     global.setTagSelectionOr(tagSelectionOr->isChecked());
+    global.setIncludeChildTags(includeChildTags->isChecked());
     global.setIndexPDFLocally(indexPDF->isChecked());
+    global.setLegacyFilterEngine(legacyFilterEngine->isChecked());
 
     //global.saveSettingForceSearchLowerCase(forceSearchLowerCase->isChecked());
     //global.forceSearchLowerCase=forceSearchLowerCase->isChecked();
 
     global.setBackgroundIndexing(enableBackgroundIndexing->isChecked());
+    global.setIndexThreads(indexThreads->value());
 }
@@ -31,12 +31,15 @@ class SearchPreferences : public QWidget
     Q_OBJECT
 private:
     QSpinBox *weight;
+    QSpinBox *indexThreads;      // Background indexing threads.  0 is one per CPU.
     QCheckBox *syncAttachments;  // Disabled for performance reasons
     QCheckBox *indexPDF;         // Index PDFs locally?
     QCheckBox *clearSearchOnNotebook;   // Clear search text when notebook changes?
     QCheckBox *clearNotebookOnSearch;   // Clear notebook on search text changes
     QCheckBox *clearTagsOnSearch;      // Clear tag selection on search text changes
     QCheckBox *tagSelectionOr;          // "OR" tag selections.
+    QCheckBox *includeChildTags;        // A tag also finds the notes of its children
+    QCheckBox *legacyFilterEngine;      // Use the old multi-pass search
 
     QCheckBox *forceSearchLowerCase;
     QCheckBox *forceSearchWithoutDiacritics;
@@ -45,6 +45,10 @@ SavedSearchProperties::SavedSearchProperties(QWidget *parent) :
     queryGrid.addWidget(&name, 1, 2);
     queryGrid.addWidget(&queryLabel, 2,1);
     queryGrid.addWidget(&query, 2, 2);
+    materialized.setText(tr("Keep the matching notes up to date"));
+    materialized.setToolTip(tr("Selecting the search shows the kept notes instead of searching again, "
+                               "and the number of notes is shown next to it."));
+    queryGrid.addWidget(&materialized, 3, 2);
     queryGrid.setContentsMargins(10, 10,  -10, -10);
     grid.addLayout(&queryGrid,1,1);
 
@@ -70,6 +74,8 @@ void SavedSearchProperties::okButtonPressed() {
         s.name = this->name.text().trimmed();
         s.query = this->query.text().trimmed();
         table.update(lid, s, true);
+        if (table.isMaterialized(lid) != materialized.isChecked())
+            table.setMaterialized(lid, materialized.isChecked());
         close();
         return;
     }
@@ -83,6 +89,10 @@ void SavedSearchProperties::okButtonPressed() {
     s.guid = g;
     SearchTable t(global.db);
     t.add(0,s,true);
+    if (materialized.isChecked()) {
+        QString newName = s.name;
+        t.setMaterialized(t.findByName(newName), true);
+    }
     close();
 }
 
@@ -100,6 +110,7 @@ void SavedSearchProperties::setLid(qint32 lid) {
         originalName = s.name;
         name.setText(originalName.trimmed());
         query.setText(s.query);
+        materialized.setChecked(table.isMaterialized(lid));
         return;
     }
     this->lid = 0;
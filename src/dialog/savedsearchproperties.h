@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <QDialog>
 #include <QLineEdit>
+#include <QCheckBox>
 #include <QPushButton>
 #include <QLabel>
 #include <QGridLayout>
@@ -46,6 +47,7 @@ public:
     explicit SavedSearchProperties(QWidget *parent = 0);
     QLineEdit	name;
     QLineEdit	query;
+    QCheckBox   materialized;
     bool okPressed;
     void setLid(qint32 lid);
 
@@ -18,6 +18,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 ***********************************************************************************/
 
 #include "filtercriteria.h"
+#include "src/global.h"
+
+#include <QStringList>
+#include <algorithm>
+
+extern Global global;
 
 FilterCriteria::FilterCriteria(QObject *parent) :
     QObject(parent)
@@ -316,3 +322,41 @@ void FilterCriteria::duplicate(FilterCriteria &newFilter) {
     newFilter.resetLid = resetLid;
     newFilter.resetSearchString = resetSearchString;
 }
+
+
+
+// A canonical string for the parts of the criteria that decide which notes
+// match.  Two criteria with the same key find the same notes, whatever
+// order the tags were picked in or how the search text was typed.  The
+// selected notes aren't part of it.
+QString FilterCriteria::cacheKey() {
+    if (!valueSet)
+        return "";
+
+    QStringList parts;
+    if (notebookIsSet && notebook != nullptr) {
+        QString id = notebook->data(0,Qt::UserRole).toString();
+        if (id == "STACK")
+            id = "stack:" + notebook->text(0);
+        parts.append("notebook=" + id);
+    }
+    if (tagsIsSet) {
+        QList<qint32> tagLids;
+        for (int i=0; i<tags.size(); i++)
+            tagLids.append(tags[i]->data(0,Qt::UserRole).toInt());
+        std::sort(tagLids.begin(), tagLids.end());
+        QStringList tagList;
+        for (int i=0; i<tagLids.size(); i++)
+            tagList.append(QString::number(tagLids[i]));
+        parts.append("tags=" + tagList.join(","));
+    }
+    if (attributeIsSet && attribute != nullptr)
+        parts.append("attribute=" + QString::number(attribute->data(0,Qt::UserRole).toInt()));
+    if (searchStringIsSet && searchString.trimmed() != "")
+        parts.append("search=" + global.normalizeTermForSearchAndIndex(searchString).simplified());
+    if (favoriteIsSet)
+        parts.append("favorite=" + QString::number(favoriteLid));
+    if (deletedOnlyIsSet && deletedOnly)
+        parts.append("deleted");
+    return parts.join("\n");
+}
@@ -120,6 +120,7 @@ public:
     bool resetFavorite;
 
     void duplicate(FilterCriteria &criteria);
+    QString cacheKey();             // Canonical form of what decides the matching notes
 
 
 signals:
@@ -19,6 +19,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "filterengine.h"
 #include "filtercriteria.h"
+#include "filterquerycompiler.h"
 #include "src/global.h"
 #include "src/sql/notetable.h"
 #include "src/sql/notebooktable.h"
@@ -29,6 +30,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/nsqlquery.h"
 #include "src/sql/favoritesrecord.h"
 #include "src/sql/favoritestable.h"
+#include "src/sql/searchindextable.h"
 
 #include <QtSql>
 
@@ -38,6 +40,31 @@ extern Global global;
 FilterEngine::FilterEngine(QObject *parent) :
     QObject(parent)
 {
+    firstBatch = 0;
+    generation = nullptr;
+    searchId = 0;
+}
+
+
+
+// Send partialResults() while a compiled search runs.  The first batch
+// has "rows" notes & every batch after that is twice the size of the last.
+void FilterEngine::setBatchSize(qint32 rows) {
+    firstBatch = rows;
+}
+
+
+
+// Stop a compiled search as soon as the counter no longer matches id.
+// This lets a newer search cancel an older one from another thread.
+void FilterEngine::setCancelCheck(QAtomicInt *counter, qint32 id) {
+    generation = counter;
+    searchId = id;
+}
+
+
+bool FilterEngine::isCancelled() {
+    return generation != nullptr && generation->loadAcquire() != searchId;
 }
 
 
@@ -108,15 +135,11 @@ void setupTagSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance, bo
 
 // prepare SQL query for selection by note title
 // searched string is in "searchStr"
-// relevance==0 means we a doing primary search
-// relevance>0 means we are doing relevance update search
-// "negativeSearch" may only be passed for relevance==0 and means negative search
+// "negativeSearch" means negative search
+// Ranking by title is done by FilterEngine::rankSearchTerm()
 //
-void setupTitleSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance, bool negativeSearch) {
+void setupTitleSelectionQuery(NSqlQuery &sql, QString searchStr, bool negativeSearch) {
     searchStr = searchStr.replace("*", "%");
-    // 0:  search (may then be positive or negative)
-    // >0: relevance update
-    bool isRelevanceUpdate = relevance > 0;
 
     // this may happen only if someone posts "intitle:" without term, which doesn't give much sense either
     if (searchStr == "") {
@@ -132,31 +155,20 @@ void setupTitleSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance,
     if (!searchStr.startsWith("%"))
         searchStr = QString("%") + searchStr;
 
-    QString cmdStr;
     QString selectionPart("(select lid from datastore where key=:key and data like :title)");
 
-    if (!isRelevanceUpdate) {
-        // positive search: filter out records (delete) where search term is not found in title => "not"
-        // negative search: filter out record where search term IS found in title => ""
-        QString negateStr = negativeSearch ? QString("") : QString("not");
-        cmdStr = QString("delete from filter where lid ") + negateStr + QString(" in ") + selectionPart;
-    } else {
-        // update record where search term IS found in title
-        cmdStr = QString("update filter set relevance=relevance+:relevance where lid in ") + selectionPart;
-    }
+    // positive search: filter out records (delete) where search term is not found in title => "not"
+    // negative search: filter out record where search term IS found in title => ""
+    QString negateStr = negativeSearch ? QString("") : QString("not");
+    QString cmdStr = QString("delete from filter where lid ") + negateStr + QString(" in ") + selectionPart;
     sql.prepare(cmdStr);
     QLOG_DEBUG() << "Title search query(" << searchStr
-                 << ", relevance=" << relevance
                  << ", negative:" << negativeSearch
                  << "): " + cmdStr;
 
 
     sql.bindValue(":key", NOTE_TITLE);
     sql.bindValue(":title", searchStr);
-
-    if (isRelevanceUpdate) {
-        sql.bindValue(":relevance", relevance);
-    }
 }
 
 
@@ -164,6 +176,225 @@ void FilterEngine::filter(FilterCriteria *newCriteria, QList<qint32> *results) {
     QLOG_TRACE_IN();
     bool internalSearch = true;
 
+    FilterCriteria *criteria = newCriteria;
+    if (criteria == nullptr) {
+        criteria = global.getCurrentCriteria();
+    }
+    else {
+        internalSearch = false;
+    }
+
+    // The old engine is still available so the results of the two can be
+    // compared.  It is also used if the compiled statement fails.
+    QList <qint32> goodLids;
+    if (global.getLegacyFilterEngine() || !compiledFilter(criteria, internalSearch, goodLids))
+        legacyFilter(criteria, goodLids);
+
+    if (internalSearch) {
+        trimSelection(goodLids);
+    } else {
+        results->clear();
+        for (int i = 0; i < goodLids.size(); i++) {
+            if (!results->contains(goodLids[i])) {
+                results->append(goodLids[i]);
+            }
+        }
+    }
+}
+
+
+
+// Remove any selected notes that are not in the filter.
+void FilterEngine::trimSelection(QList<qint32> &goodLids) {
+    if (global.filterCriteria.size() <= 0)
+        return;
+    FilterCriteria *criteria = global.getCurrentCriteria();
+    QList <qint32> selectedLids;
+    criteria->getSelectedNotes(selectedLids);
+    for (int i = selectedLids.size() - 1; i >= 0; i--) {
+        if (!goodLids.contains(selectedLids[i]))
+            selectedLids.removeAll(selectedLids[i]);
+    }
+    criteria->setSelectedNotes(selectedLids);
+    //global.setMessage(QString("Count: ") + QString::number(goodLids.size()), 0);
+}
+
+
+
+// The key search results are cached under.  Besides the criteria it has
+// the settings that change what a search finds, and today's date since
+// relative dates (created:day-1, "since yesterday") are worked out from it.
+QString FilterEngine::cacheKey(FilterCriteria *criteria) {
+    return criteria->cacheKey()
+            + "\nor=" + QString::number(global.getTagSelectionOr())
+            + "\nchildren=" + QString::number(global.getIncludeChildTags())
+            + "\nweight=" + QString::number(global.getMinimumRecognitionWeight())
+            + "\ntoday=" + QDate::currentDate().toString(Qt::ISODate);
+}
+
+
+
+// Run the criteria through the query compiler, unless the results are
+// still cached.  When updateFilter is set the results replace the contents
+// of the filter table the note list is built from, otherwise they are
+// only returned.
+bool FilterEngine::compiledFilter(FilterCriteria *criteria, bool updateFilter, QList<qint32> &lids) {
+    QString key = cacheKey(criteria);
+    QList<double> relevance;
+    if (!global.searchCache.get(key, lids, relevance)) {
+        qint32 generation = global.searchCache.currentGeneration();
+        QString statement;
+        QList<QVariant> values;
+        LidBitmap indexed;
+        if (!compileSearch(criteria, statement, values, indexed))
+            return false;
+        if (!materializedSearch(criteria, statement, values, indexed, lids, relevance)
+                && !runSearch(global.db, statement, values, indexed, lids, relevance))
+            return false;
+        global.searchCache.put(key, generation, lids, relevance);
+    }
+    if (updateFilter)
+        writeFilter(lids, relevance);
+    return true;
+}
+
+
+
+// Compile the criteria.  Notebook, tag, trash & flag criteria are answered
+// from the in memory FilterIndex, anything else becomes a single statement
+// whose results are ANDed with that.  The statement is empty if nothing
+// needs the database.  This reads the criteria's tree items, so it has to
+// be called on the GUI thread.
+bool FilterEngine::compileSearch(FilterCriteria *criteria, QString &statement,
+                                 QList<QVariant> &values, LidBitmap &indexed) {
+    FilterQueryCompiler compiler;
+    if (!compiler.compile(criteria))
+        return false;
+    compiler.evaluateIndexed(indexed);
+    statement = "";
+    values.clear();
+    if (compiler.hasSql())
+        statement = compiler.getSql(values, false);
+    return true;
+}
+
+
+
+// Run a compiled search.  Nothing is written, so this can run on any thread
+// with that thread's connection.  Returns false if the statement fails or
+// the search was cancelled.
+bool FilterEngine::runSearch(DatabaseConnection *db, QString statement, QList<QVariant> values,
+                             LidBitmap indexed, QList<qint32> &lids, QList<double> &relevance) {
+    QLOG_TRACE_IN();
+    QTime timer;
+    timer.start();
+
+    relevance.clear();
+    lids.clear();
+    if (isCancelled())
+        return false;
+
+    qint32 sent = 0;
+    qint32 nextBatch = firstBatch;
+    NSqlQuery sql(db);
+    if (statement != "") {
+        QLOG_DEBUG() << "Compiled filter: " << statement;
+        sql.prepare(statement);
+        for (int i=0; i<values.size(); i++)
+            sql.addBindValue(values[i]);
+        if (!sql.exec()) {
+            QLOG_ERROR() << "Compiled filter failed: " << sql.lastError() << " - using the legacy filter";
+            sql.finish();
+            return false;
+        }
+        while (sql.next()) {
+            qint32 lid = sql.value(0).toInt();
+            if (indexed.contains(lid)) {
+                lids.append(lid);
+                relevance.append(sql.value(1).toDouble());
+            }
+            if (firstBatch > 0 && lids.size() - sent >= nextBatch) {
+                if (isCancelled()) {
+                    sql.finish();
+                    return false;
+                }
+                emit partialResults(lids.mid(sent), relevance.mid(sent));
+                sent = lids.size();
+                nextBatch = nextBatch * 2;
+            }
+        }
+        sql.finish();
+        if (isCancelled())
+            return false;
+    } else {
+        lids = indexed.toList();
+        for (int i=0; i<lids.size(); i++)
+            relevance.append(0);
+    }
+
+    addPinned(lids, relevance);
+    QLOG_DEBUG() << "Compiled filter complete: " << lids.size() << " notes in " << timer.elapsed() << "ms";
+    return true;
+}
+
+
+
+// Pinned notes are always shown
+void FilterEngine::addPinned(QList<qint32> &lids, QList<double> &relevance) {
+    LidBitmap pinned = global.filterIndex.getPresent(NOTE_ISPINNED);
+    for (int i=0; i<lids.size(); i++)
+        pinned.remove(lids[i]);
+    QList<qint32> pinnedLids = pinned.toList();
+    lids.append(pinnedLids);
+    for (int i=0; i<pinnedLids.size(); i++)
+        relevance.append(1);
+}
+
+
+
+// If the criteria are a materialized saved search, take the results from
+// its kept matches instead of running the statement.
+bool FilterEngine::materializedSearch(FilterCriteria *criteria, QString statement, QList<QVariant> values,
+                                      LidBitmap indexed, QList<qint32> &lids, QList<double> &relevance) {
+    if (!criteria->isSavedSearchSet() || criteria->getSavedSearch() == nullptr)
+        return false;
+    qint32 searchLid = criteria->getSavedSearch()->data(0, Qt::UserRole).toInt();
+    if (!global.materializedSearches.get(global.db, searchLid, statement, values, indexed, lids, relevance))
+        return false;
+    QLOG_DEBUG() << "Materialized search " << searchLid << ": " << lids.size() << " notes";
+    addPinned(lids, relevance);
+    return true;
+}
+
+
+
+// Replace (or add to) the contents of the filter table.  Rows are inserted
+// FILTER_BATCH_ROWS at a time to keep the number of statements down.
+void FilterEngine::writeFilter(QList<qint32> &lids, QList<double> &relevance, bool append) {
+    NSqlQuery sql(global.db);
+    if (!append)
+        sql.exec("delete from filter");
+    for (int start=0; start<lids.size(); start+=FILTER_BATCH_ROWS) {
+        int count = qMin(FILTER_BATCH_ROWS, lids.size()-start);
+        QStringList rows;
+        for (int i=0; i<count; i++)
+            rows.append("(?,?)");
+        sql.prepare("insert into filter (lid,relevance) values " + rows.join(","));
+        for (int i=start; i<start+count; i++) {
+            sql.addBindValue(lids[i]);
+            sql.addBindValue(relevance[i]);
+        }
+        sql.exec();
+    }
+    sql.finish();
+}
+
+
+
+// The original filter.  The filter table starts with every note and each
+// criteria deletes the notes that don't match it.
+void FilterEngine::legacyFilter(FilterCriteria *criteria, QList<qint32> &goodLids) {
+    QLOG_TRACE_IN();
     NSqlQuery sql(global.db);
     QLOG_DEBUG() << "Purging filters";
     sql.exec("delete from filter");
@@ -176,15 +407,6 @@ void FilterEngine::filter(FilterCriteria *newCriteria, QList<qint32> *results) {
     sql.finish();
     QLOG_DEBUG() << "Reset complete";
 
-
-    FilterCriteria *criteria = newCriteria;
-    if (criteria == nullptr) {
-        criteria = global.getCurrentCriteria();
-    }
-    else {
-        internalSearch = false;
-    }
-
     QLOG_DEBUG() << "Filtering favorite";
     filterFavorite(criteria);
     QLOG_DEBUG() << "Filtering notebooks";
@@ -205,36 +427,13 @@ void FilterEngine::filter(FilterCriteria *newCriteria, QList<qint32> *results) {
     sql.bindValue(":key", NOTE_ISPINNED);
     sql.exec();
 
-    // Remove any selected notes that are not in the filter.
     NSqlQuery query(global.db);
-    QList <qint32> goodLids;
+    goodLids.clear();
     query.exec("select lid from filter;");
     while (query.next()) {
         goodLids.append(query.value(0).toInt());
     }
     query.finish();
-
-    if (internalSearch) {
-        // Remove any selected notes that are not in the filter.
-        if (global.filterCriteria.size() > 0) {
-            FilterCriteria *criteria = global.getCurrentCriteria();
-            QList <qint32> selectedLids;
-            criteria->getSelectedNotes(selectedLids);
-            for (int i = selectedLids.size() - 1; i >= 0; i--) {
-                if (!goodLids.contains(selectedLids[i]))
-                    selectedLids.removeAll(selectedLids[i]);
-            }
-            criteria->setSelectedNotes(selectedLids);
-            //global.setMessage(QString("Count: ") + QString::number(goodLids.size()), 0);
-        }
-    } else {
-        results->clear();
-        for (int i = 0; i < goodLids.size(); i++) {
-            if (!results->contains(goodLids[i])) {
-                results->append(goodLids[i]);
-            }
-        }
-    }
 }
 
 
@@ -699,7 +898,11 @@ void FilterEngine::filterTags(FilterCriteria *criteria) {
     if (!global.getTagSelectionOr()) {
         NSqlQuery query(global.db);
         for (qint32 i=0; i<tags.size(); i++) {
-            query.prepare("Delete from filter where lid not in (select lid from datastore where key=:notetagkey and data=:data)");
+            if (global.getIncludeChildTags())
+                query.prepare("Delete from filter where lid not in (select lid from datastore where key=:notetagkey and data in "
+                              "(select descendant from TagClosure where ancestor=:data))");
+            else
+                query.prepare("Delete from filter where lid not in (select lid from datastore where key=:notetagkey and data=:data)");
             query.bindValue(":notetagkey", NOTE_TAG_LID);
             query.bindValue(":data", tags[i]->data(0,Qt::UserRole).toInt())  ;
             query.exec();
@@ -708,11 +911,19 @@ void FilterEngine::filterTags(FilterCriteria *criteria) {
     } else {
         NoteTable noteTable(global.db);
         TagTable tagTable(global.db);
-        QList<qint32> goodNotes;
+        QList<qint32> tagLids;
         for (qint32 i=0; i<tags.size(); i++) {
+            qint32 lid = tags[i]->data(0,Qt::UserRole).toInt();
+            if (global.getIncludeChildTags())
+                tagTable.getDescendants(tagLids, lid);
+            else
+                tagLids.append(lid);
+        }
+        QList<qint32> goodNotes;
+        for (qint32 i=0; i<tagLids.size(); i++) {
             QList<qint32> notes;
             QString tagGuid;
-            tagTable.getGuid(tagGuid, tags[i]->data(0,Qt::UserRole).toInt());
+            tagTable.getGuid(tagGuid, tagLids[i]);
             noteTable.getNotesWithTag(notes, tagGuid);
             for (qint32 j=0; j<notes.size(); j++) {
                 if (!goodNotes.contains(notes[j]))
@@ -940,53 +1151,58 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
                    string.startsWith("subjectdate:", Qt::CaseInsensitive) ||
                    string.startsWith("-subjectdate:", Qt::CaseInsensitive)) {
             filterSearchStringDateAll(string);
-        } else if (string.startsWith("-*")) {   // Negative postfix search.  FTS doesn't do this.
+        } else if (string.startsWith("-*")) {   // Negative postfix search.  Uses the trigram index once it is built.
             string = string.mid(1);
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
+            QString table = SearchIndexTable::likeTable();
             NSqlQuery prefix(global.db);
             prefix.prepare(
-                "Delete from filter where lid in (select lid from SearchIndex where weight>=:weight "
+                "Delete from filter where lid in (select lid from " + table + " where weight>=:weight "
                     "and content like :word) or lid in (select data from DataStore where lid in "
-                    "(select lid from SearchIndex where weight>:weight2 and content like :word2))");
+                    "(select lid from " + table + " where weight>:weight2 and content like :word2))");
 
             prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
             prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
             prefix.bindValue(":word", string);
             prefix.bindValue(":word2", string);
             prefix.exec();
-        } else if (string.indexOf("_") >= 0) {    // underscore search.  FTS doesn't do this.
-            string = string.replace("_", "/_");
+        } else if (string.indexOf("_") >= 0) {    // underscore search.  Uses the trigram index once it is built.
+            QString glob = SearchIndexTable::toGlob(string);   // LIKE reads the '_' as a wildcard
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
             if (!string.startsWith("%"))
                 string = QString("%") + string;
+            QString table = SearchIndexTable::likeTable();
             NSqlQuery prefix(global.db);
             prefix.prepare(
-                "Delete from filter where lid not in (select lid from SearchIndex where weight>=:weight "
-                    "and content like :word escape '/') and "
-                    "lid not in (select data from DataStore where key=:key and lid in (select lid from SearchIndex "
-                    "where weight>:weight2 and content like :word2 escape '/'))");
+                "Delete from filter where lid not in (select lid from " + table + " where weight>=:weight "
+                    "and content like :word and lower(content) glob lower(:glob)) and "
+                    "lid not in (select data from DataStore where key=:key and lid in (select lid from " + table + " "
+                    "where weight>:weight2 and content like :word2 and lower(content) glob lower(:glob2)))");
 
             prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
             prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
             prefix.bindValue(":word", string);
             prefix.bindValue(":word2", string);
+            prefix.bindValue(":glob", glob);
+            prefix.bindValue(":glob2", glob);
             prefix.bindValue(":key", RESOURCE_NOTE_LID);
             prefix.exec();
-        } else if (string.indexOf("-") >= 0) {    // Hyphen search.  FTS doesn't do this.
+        } else if (string.indexOf("-") >= 0) {    // Hyphen search.  Uses the trigram index once it is built.
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
             if (!string.startsWith("%"))
                 string = QString("%") + string;
+            QString table = SearchIndexTable::likeTable();
             NSqlQuery prefix(global.db);
             prefix.prepare(
-                "Delete from filter where lid not in (select lid from SearchIndex where weight>=:weight and content "
+                "Delete from filter where lid not in (select lid from " + table + " where weight>=:weight and content "
                     "like :word) and lid not in (select data from DataStore where key=:key and lid in (select lid "
-                    "from SearchIndex where weight>:weight2 and content like :word2))");
+                    "from " + table + " where weight>:weight2 and content like :word2))");
 
             prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
             prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
@@ -994,15 +1210,16 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
             prefix.bindValue(":word2", string);
             prefix.bindValue(":key", RESOURCE_NOTE_LID);
             prefix.exec();
-        } else if (string.startsWith("*")) {    // Postfix search.  FTS doesn't do this.
+        } else if (string.startsWith("*")) {    // Postfix search.  Uses the trigram index once it is built.
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
+            QString table = SearchIndexTable::likeTable();
             NSqlQuery prefix(global.db);
             prefix.prepare(
-                "Delete from filter where lid not in (select lid from SearchIndex where weight>=:weight and content "
+                "Delete from filter where lid not in (select lid from " + table + " where weight>=:weight and content "
                     "like :word) and lid not in (select data from DataStore where key=:key and lid in (select lid "
-                    "from SearchIndex where weight>:weight2 and content like :word2))");
+                    "from " + table + " where weight>:weight2 and content like :word2))");
 
             prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
             prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
@@ -1015,20 +1232,13 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
 
             QLOG_TRACE() << "Using FTS search";
             if (string.startsWith("-")) {
-                string = string.remove(0, 1).trimmed();
-                if (!string.endsWith("*"))
-                    string = string + QString("*");
-                if (string.contains(" "))
-                    string = "\"" + string + "\"";
+                string = SearchIndexTable::toMatch(string.remove(0, 1));
                 sqlnegative.bindValue(":key", RESOURCE_NOTE_LID);
                 sqlnegative.bindValue(":word", string);
                 sqlnegative.bindValue(":word2", string);
                 sqlnegative.exec();
             } else {
-                if (!string.endsWith("*"))
-                    string = string + QString("*");
-                if (string.contains(" "))
-                    string = "\"" + string + "\"";
+                string = SearchIndexTable::toMatch(string);
                 sql.bindValue(":key", RESOURCE_NOTE_LID);
                 sql.bindValue(":word", string);
                 sql.bindValue(":word2", string);
@@ -1036,16 +1246,9 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
             }
 
 
-            // update relevance by +1 where search term is found in title
-            NSqlQuery relUpdtSql(global.db);
-            setupTitleSelectionQuery(relUpdtSql, origString, 1, true);
-            relUpdtSql.exec();
-
-            // update relevance by +1 where search term is found as tag value
-            setupTagSelectionQuery(relUpdtSql, origString, 1, true);
-            relUpdtSql.exec();
-
-            relUpdtSql.finish();
+            // rank the notes by how well the word matches their title, tags & text
+            if (!origString.startsWith("-"))
+                rankSearchTerm(origString);
         }
     }
 
@@ -1060,6 +1263,27 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
 }
 
 
+// Add the bm25 score of a search word to the relevance of the notes still in
+// the filter.  Title & tag matches are weighted more than the note text.
+void FilterEngine::rankSearchTerm(QString word) {
+    NSqlQuery sql(global.db);
+    sql.exec("create temporary table if not exists filterrank (lid integer primary key, score real)");
+    sql.exec("delete from filterrank");
+
+    // The "limit -1" keeps SQLite from flattening the subquery, which
+    // doesn't allow bm25() to be used.
+    sql.prepare(QString("insert into filterrank (lid, score) select lid, max(score) from "
+                "(select lid, ") + SEARCHINDEX_RANK + QString(" as score from SearchIndex "
+                "where SearchIndex match :word and source='text' limit -1) "
+                "where lid in (select lid from filter) group by lid"));
+    sql.bindValue(":word", SearchIndexTable::toMatch(word));
+    sql.exec();
+    sql.exec("update filter set relevance=relevance+(select score from filterrank r where r.lid=filter.lid) "
+             "where lid in (select lid from filterrank)");
+    sql.finish();
+}
+
+
 // filter based upon the title string the user specified.  This is for the "all"
 // filter and not the "any".
 void FilterEngine::filterSearchStringIntitleAll(QString searchStr) {
@@ -1069,11 +1293,11 @@ void FilterEngine::filterSearchStringIntitleAll(QString searchStr) {
     if (!searchStr.startsWith("-")) {
         // in" title
         searchStr.remove(0, 8);    // remove 8 chars of "intitle:"
-        setupTitleSelectionQuery(sql, searchStr, 0, false);
+        setupTitleSelectionQuery(sql, searchStr, false);
     } else {
         // NOT "in" title
         searchStr.remove(0, 9); // remove 9 chars of "!intitle:"
-        setupTitleSelectionQuery(sql, searchStr, 0, true);
+        setupTitleSelectionQuery(sql, searchStr, true);
     }
     sql.exec();
     sql.finish();
@@ -1821,14 +2045,14 @@ void FilterEngine::filterSearchStringAny(QStringList list) {
         else { // Filter not found
             if (string.startsWith("-")) {
                 string = string.remove(0,1);
-                sqlnegative.bindValue(":word", string.trimmed()+"*");
+                sqlnegative.bindValue(":word", SearchIndexTable::toMatch(string));
                 sqlnegative.exec();
-                resSqlNegative.bindValue(":word", string.trimmed()+"*");
+                resSqlNegative.bindValue(":word", SearchIndexTable::toMatch(string));
                 resSqlNegative.exec();
             } else {
-                sql.bindValue(":word", string.trimmed()+"*");
+                sql.bindValue(":word", SearchIndexTable::toMatch(string));
                 sql.exec();
-                resSql.bindValue(":word", string.trimmed()+"*");
+                resSql.bindValue(":word", SearchIndexTable::toMatch(string));
                 resSql.exec();
             }
         }
@@ -2421,8 +2645,8 @@ bool FilterEngine::resourceContains(qint32 resourceLid, QString searchString, QS
         returnHits->empty();
     NSqlQuery query(global.db);
     NSqlQuery query2(global.db);
-    query.prepare("select lid from SearchIndex where lid=:resourceLid and weight>=:weight and content match :word");
-    query2.prepare("select lid from SearchIndex where lid=:resourceLid and weight>=:weight and content like :word");
+    query.prepare("select lid from SearchIndex where rowid between :first and :last and weight>=:weight and content match :word");
+    query2.prepare("select lid from SearchContent where rowid between :first and :last and weight>=:weight and content like :word");
     QStringList terms;
     splitSearchTerms(terms, searchString);
     for (int i=0; i<terms.size(); i++) {
@@ -2469,7 +2693,8 @@ bool FilterEngine::resourceContains(qint32 resourceLid, QString searchString, QS
                 term.chop(1);
             if (term.startsWith("*")) {
                 term = term.mid(1);
-                query2.bindValue(":resourceLid", resourceLid);
+                query2.bindValue(":first", SearchIndexTable::firstRowid(resourceLid));
+                query2.bindValue(":last", SearchIndexTable::lastRowid(resourceLid));
                 query2.bindValue(":weight", global.getMinimumRecognitionWeight());
                 query2.bindValue(":word", "%"+term+"%");
                 query2.exec();
@@ -2481,9 +2706,10 @@ bool FilterEngine::resourceContains(qint32 resourceLid, QString searchString, QS
                         return true;
                 }
             } else {
-                query.bindValue(":resourceLid", resourceLid);
+                query.bindValue(":first", SearchIndexTable::firstRowid(resourceLid));
+                query.bindValue(":last", SearchIndexTable::lastRowid(resourceLid));
                 query.bindValue(":weight", global.getMinimumRecognitionWeight());
-                query.bindValue(":word", term);
+                query.bindValue(":word", SearchIndexTable::toMatch(term));
                 query.exec();
                 if (query.next()) {
                     returnValue = true;
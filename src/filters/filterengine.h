@@ -21,7 +21,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define FILTERENGINE_H
 
 #include <QObject>
+#include <QAtomicInt>
 #include "filtercriteria.h"
+#include "lidbitmap.h"
+
+#define FILTER_BATCH_ROWS 400        // Rows per insert when the filter table is rewritten
+
+class DatabaseConnection;
 
 class FilterEngine : public QObject
 {
@@ -36,7 +42,7 @@ private:
     void filterAttributes(FilterCriteria *criteria);
     void filterSearchString(FilterCriteria *criteria);
     void filterSearchStringAll(QStringList list);
-    void splitSearchTerms(QStringList &list, QString search);
+    void rankSearchTerm(QString word);
     void filterSearchStringNotebookAll(QString string);
     //    void filterSearchTodoAll(QStringList list);
     void filterSearchStringTodoAll(QString string);
@@ -55,7 +61,6 @@ private:
     void filterSearchStringContentClassAll(QString string);
     void filterSearchStringPlaceNameAll(QString string);
     void filterSearchStringResourceRecognitionTypeAll(QString string);
-    QDateTime calculateDateTime(QString string);
     void filterSearchStringDateAll(QString string);
 
     void filterSearchStringAny(QStringList list);
@@ -73,14 +78,36 @@ private:
     void filterSearchStringContentClassAny(QString string);
     void filterSearchStringResourceRecognitionTypeAny(QString string);
     bool anyFlagSet;
+    qint32 firstBatch;                  // Rows in the first partialResults(), 0 for none
+    QAtomicInt *generation;             // Cancel check, see setCancelCheck()
+    qint32 searchId;
+
+    bool compiledFilter(FilterCriteria *criteria, bool updateFilter, QList<qint32> &lids);
 
 public:
     explicit FilterEngine(QObject *parent = 0);
     void filter(FilterCriteria *newCriteria = nullptr, QList<qint32> *results = nullptr);
+    void legacyFilter(FilterCriteria *criteria, QList<qint32> &lids);     // Rebuilds the filter table
+    bool compileSearch(FilterCriteria *criteria, QString &statement,
+                       QList<QVariant> &values, LidBitmap &indexed);        // GUI thread only
+    bool runSearch(DatabaseConnection *db, QString statement, QList<QVariant> values,
+                   LidBitmap indexed, QList<qint32> &lids, QList<double> &relevance);  // Any thread
+    void setBatchSize(qint32 rows);
+    void setCancelCheck(QAtomicInt *counter, qint32 id);
+    bool isCancelled();
+    void writeFilter(QList<qint32> &lids, QList<double> &relevance, bool append=false);
+    void trimSelection(QList<qint32> &goodLids);   // Unselect notes that are no longer in the list
+    bool materializedSearch(FilterCriteria *criteria, QString statement, QList<QVariant> values,
+                            LidBitmap indexed, QList<qint32> &lids, QList<double> &relevance);  // GUI thread only
+    static void addPinned(QList<qint32> &lids, QList<double> &relevance);
+    static QString cacheKey(FilterCriteria *criteria);      // Key for global.searchCache
+    static void splitSearchTerms(QStringList &list, QString search);
+    static QDateTime calculateDateTime(QString string);
     bool resourceContains(qint32 resourceLid, QString searchString, QStringList *returnHits);
     
 signals:
-    
+    void partialResults(QList<qint32> lids, QList<double> relevance);   // Hits found so far by runSearch()
+
 public slots:
     
 };
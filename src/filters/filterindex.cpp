@@ -0,0 +1,239 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "filterindex.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/notetable.h"
+
+#include <QTime>
+
+extern Global global;
+
+// The keys that are indexed.  Keys in the first list also keep a bitmap
+// per value.  The others have too many distinct values (dates) to be worth
+// it, so only "does the note have it" is indexed.
+static const qint32 valueKeys[] = { NOTE_ACTIVE, NOTE_NOTEBOOK_LID, NOTE_TAG_LID,
+                                    NOTE_HAS_TODO_COMPLETED, NOTE_HAS_TODO_UNCOMPLETED };
+static const qint32 presenceKeys[] = { NOTE_HAS_ENCRYPT, NOTE_HAS_ATTACHMENT, NOTE_ISPINNED,
+                                       NOTE_ATTRIBUTE_REMINDER_ORDER, NOTE_ATTRIBUTE_REMINDER_TIME };
+#define NOTETABLE_ROW   0      // Marks a note that has a NoteTable row when re-reading it
+
+
+// Constructor
+FilterIndex::FilterIndex()
+{
+    loaded = false;
+}
+
+
+
+bool FilterIndex::hasValues(qint32 key) {
+    for (unsigned int i=0; i<sizeof(valueKeys)/sizeof(valueKeys[0]); i++) {
+        if (valueKeys[i] == key)
+            return true;
+    }
+    return false;
+}
+
+
+bool FilterIndex::isIndexed(qint32 key) {
+    if (hasValues(key))
+        return true;
+    for (unsigned int i=0; i<sizeof(presenceKeys)/sizeof(presenceKeys[0]); i++) {
+        if (presenceKeys[i] == key)
+            return true;
+    }
+    return false;
+}
+
+
+// The indexed keys for an "in (...)" clause
+static QString keyList() {
+    QStringList keys;
+    for (unsigned int i=0; i<sizeof(valueKeys)/sizeof(valueKeys[0]); i++)
+        keys.append(QString::number(valueKeys[i]));
+    for (unsigned int i=0; i<sizeof(presenceKeys)/sizeof(presenceKeys[0]); i++)
+        keys.append(QString::number(presenceKeys[i]));
+    return keys.join(",");
+}
+
+
+bool FilterIndex::isIndexed(qint32 key, qint64 value) {
+    Q_UNUSED(value);
+    return key == FILTERINDEX_NOTE_LID || key == FILTERINDEX_ALL_NOTES || hasValues(key);
+}
+
+
+
+// Build the index from the database.  This is only done once.  After that
+// NoteTable keeps it current.
+void FilterIndex::load(DatabaseConnection *db) {
+    lock.lockForRead();
+    bool done = loaded;
+    lock.unlock();
+    if (done)
+        return;
+
+    QWriteLocker locker(&lock);
+    if (loaded)
+        return;
+
+    QTime timer;
+    timer.start();
+    allNotes.clear();
+    present.clear();
+    postings.clear();
+    entries.clear();
+
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.exec("Select lid from NoteTable");
+    while (query.next()) {
+        allNotes.add(query.value(0).toInt());
+    }
+    query.exec("Select lid, key, data from DataStore where key in (" + keyList() + ")");
+    while (query.next()) {
+        addLocked(query.value(0).toInt(), query.value(1).toInt(), query.value(2).toLongLong());
+    }
+    query.finish();
+    db->unlock();
+    loaded = true;
+    QLOG_DEBUG() << "Filter index loaded: " << allNotes.size() << " notes in " << timer.elapsed() << "ms";
+}
+
+
+
+// Throw away the index.  It will be reloaded the next time it is needed.
+void FilterIndex::clear() {
+    QWriteLocker locker(&lock);
+    loaded = false;
+    allNotes.clear();
+    present.clear();
+    postings.clear();
+    entries.clear();
+}
+
+
+
+// Has the index been loaded?
+bool FilterIndex::isLoaded() {
+    QReadLocker locker(&lock);
+    return loaded;
+}
+
+
+
+// Re-read the indexed values of one note.  This is called by NoteTable after
+// anything it indexes has been changed.
+void FilterIndex::updateNote(DatabaseConnection *db, qint32 lid) {
+    if (!isLoaded() || lid <= 0)
+        return;
+
+    QList< QPair<qint32,qint64> > values;
+    bool inNoteTable = false;
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select key, data from DataStore where lid=:lid and key in (" + keyList() + ") union all "
+                  "select :noteTableRow, lid from NoteTable where lid=:lid2");
+    query.bindValue(":lid", lid);
+    query.bindValue(":noteTableRow", NOTETABLE_ROW);
+    query.bindValue(":lid2", lid);
+    query.exec();
+    while (query.next()) {
+        qint32 key = query.value(0).toInt();
+        if (key == NOTETABLE_ROW)
+            inNoteTable = true;
+        else
+            values.append(QPair<qint32,qint64>(key, query.value(1).toLongLong()));
+    }
+    query.finish();
+    db->unlock();
+
+    QWriteLocker locker(&lock);
+    removeLocked(lid);
+    if (!inNoteTable)
+        return;
+    allNotes.add(lid);
+    for (int i=0; i<values.size(); i++)
+        addLocked(lid, values[i].first, values[i].second);
+}
+
+
+
+// Forget a note that has been expunged
+void FilterIndex::removeNote(qint32 lid) {
+    QWriteLocker locker(&lock);
+    if (!loaded)
+        return;
+    removeLocked(lid);
+}
+
+
+
+void FilterIndex::addLocked(qint32 lid, qint32 key, qint64 value) {
+    present[key].add(lid);
+    if (hasValues(key))
+        postings[key][value].add(lid);
+    entries[lid].append(QPair<qint32,qint64>(key, value));
+}
+
+
+
+void FilterIndex::removeLocked(qint32 lid) {
+    allNotes.remove(lid);
+    QList< QPair<qint32,qint64> > old = entries.take(lid);
+    for (int i=0; i<old.size(); i++) {
+        qint32 key = old[i].first;
+        present[key].remove(lid);
+        if (hasValues(key)) {
+            QHash<qint64, LidBitmap> &values = postings[key];
+            values[old[i].second].remove(lid);
+            if (values[old[i].second].isEmpty())
+                values.remove(old[i].second);
+        }
+    }
+}
+
+
+
+LidBitmap FilterIndex::getAll() {
+    QReadLocker locker(&lock);
+    return allNotes;
+}
+
+
+LidBitmap FilterIndex::getPresent(qint32 key) {
+    QReadLocker locker(&lock);
+    return present.value(key);
+}
+
+
+LidBitmap FilterIndex::get(qint32 key, qint64 value) {
+    QReadLocker locker(&lock);
+    if (key == FILTERINDEX_ALL_NOTES)
+        return allNotes;
+    if (key == FILTERINDEX_NOTE_LID) {
+        LidBitmap retval;
+        if (allNotes.contains(value))
+            retval.add(value);
+        return retval;
+    }
+    return postings.value(key).value(value);
+}
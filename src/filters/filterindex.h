@@ -0,0 +1,76 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef FILTERINDEX_H
+#define FILTERINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QReadWriteLock>
+
+#include "lidbitmap.h"
+
+//****************************************************
+//* In memory index of the note attributes the
+//* filters only test for equality: notebook, tags,
+//* trash, to-do flags, reminders, attachments &
+//* pinned notes.  Each (key, value) pair has a
+//* bitmap of the notes it belongs to, so notebook &
+//* tag selections never go to the database.  It is
+//* loaded on first use and then kept current by
+//* NoteTable.  Safe to use from any thread.
+//****************************************************
+
+class DatabaseConnection;
+
+#define FILTERINDEX_NOTE_LID   -1      // Pseudo key for "the note with this lid"
+#define FILTERINDEX_ALL_NOTES  -2      // Pseudo key for every note
+
+class FilterIndex
+{
+private:
+    QReadWriteLock lock;
+    bool loaded;
+    LidBitmap allNotes;                                     // Every note in NoteTable
+    QHash<qint32, LidBitmap> present;                       // Key -> notes that have it
+    QHash<qint32, QHash<qint64, LidBitmap> > postings;      // Key -> value -> notes
+    QHash<qint32, QList< QPair<qint32,qint64> > > entries;  // Note -> what it is filed under
+
+    static bool hasValues(qint32 key);
+    void addLocked(qint32 lid, qint32 key, qint64 value);
+    void removeLocked(qint32 lid);
+
+public:
+    FilterIndex();
+    static bool isIndexed(qint32 key);                      // Can filters on this key use the index?
+    static bool isIndexed(qint32 key, qint64 value);        // Can this exact value be looked up?
+    void load(DatabaseConnection *db);                      // Load the index if it hasn't been yet
+    void clear();                                           // Force a reload on next use
+    bool isLoaded();
+
+    void updateNote(DatabaseConnection *db, qint32 lid);    // Re-read one note after it changed
+    void removeNote(qint32 lid);                            // Note expunged
+
+    LidBitmap getAll();                                     // Every note
+    LidBitmap getPresent(qint32 key);                       // Notes that have the key
+    LidBitmap get(qint32 key, qint64 value);                // Notes with key=value
+};
+
+#endif // FILTERINDEX_H
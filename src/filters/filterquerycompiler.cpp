@@ -0,0 +1,835 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2015 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "filterquerycompiler.h"
+#include "filterengine.h"
+#include "filterindex.h"
+#include "src/global.h"
+#include "src/gui/nattributetree.h"
+#include "src/sql/notetable.h"
+#include "src/sql/notebooktable.h"
+#include "src/sql/tagtable.h"
+#include "src/sql/resourcetable.h"
+#include "src/sql/favoritesrecord.h"
+#include "src/sql/favoritestable.h"
+#include "src/sql/searchindextable.h"
+
+extern Global global;
+
+
+FilterQueryNode::FilterQueryNode(Type type) {
+    this->type = type;
+    negate = false;
+    indexKey = 0;
+    indexValue = 0;
+    indexAny = false;
+}
+
+
+FilterQueryNode::FilterQueryNode(QString sql, QList<QVariant> values) {
+    type = Select;
+    negate = false;
+    this->sql = sql;
+    this->values = values;
+    indexKey = 0;
+    indexValue = 0;
+    indexAny = false;
+}
+
+
+FilterQueryNode::~FilterQueryNode() {
+    qDeleteAll(children);
+}
+
+
+// Add an operand.  A null child (a criteria that doesn't apply) is skipped
+// so callers can add the result of a builder without checking it.
+FilterQueryNode* FilterQueryNode::add(FilterQueryNode *child) {
+    if (child != nullptr)
+        children.append(child);
+    return child;
+}
+
+
+// Note that the FilterIndex can answer this select
+void FilterQueryNode::setIndex(qint32 key, qint64 value, bool any) {
+    indexKey = key;
+    indexValue = value;
+    indexAny = any;
+}
+
+
+
+
+FilterQueryCompiler::FilterQueryCompiler() {
+    root = nullptr;
+    minimumWeight = 0;
+}
+
+
+FilterQueryCompiler::~FilterQueryCompiler() {
+    delete root;
+}
+
+
+
+// Build the query tree.  Every criteria that is set becomes one operand of the
+// root AND node.  The base set is every note that isn't in a closed notebook,
+// the same starting point the filter table used to be filled with.
+bool FilterQueryCompiler::compile(FilterCriteria *criteria) {
+    delete root;
+    root = new FilterQueryNode(FilterQueryNode::And);
+    relevanceTerms.clear();
+    relevanceValues.clear();
+    rankTerms.clear();
+    minimumWeight = global.getMinimumRecognitionWeight();
+
+    root->add(new FilterQueryNode("select lid from NoteTable", QList<QVariant>()))->setIndex(FILTERINDEX_ALL_NOTES, 0);
+    QList<qint32> closedNotebooks;
+    NotebookTable notebookTable(global.db);
+    notebookTable.getClosedNotebooks(closedNotebooks);
+    if (closedNotebooks.size() > 0)
+        root->add(notebookListNode(closedNotebooks))->negate = true;
+    root->add(trashNode(criteria));
+    if (!criteria->isSet())
+        return true;
+
+    root->add(favoriteNode(criteria));
+    root->add(notebookNode(criteria));
+    root->add(tagsNode(criteria));
+    root->add(searchNode(criteria));
+    root->add(attributeNode(criteria));
+    return true;
+}
+
+
+
+// Evaluate the operands of the root node that only use indexed values.  They
+// are removed from the tree, so the statement from getSql() only has to deal
+// with the rest and its results need to be ANDed with this.
+void FilterQueryCompiler::evaluateIndexed(LidBitmap &result) {
+    global.filterIndex.load(global.db);
+    result = global.filterIndex.getAll();
+    if (root == nullptr)
+        return;
+
+    for (int i=root->children.size()-1; i>=0; i--) {
+        FilterQueryNode *child = root->children[i];
+        if (!isIndexed(child))
+            continue;
+        if (child->negate)
+            result -= evaluate(child);
+        else
+            result &= evaluate(child);
+        root->children.removeAt(i);
+        delete child;
+    }
+}
+
+
+
+// Is there anything left to ask the database?
+bool FilterQueryCompiler::hasSql() {
+    return root != nullptr && (root->children.size() > 0 || relevanceTerms.size() > 0 ||
+                               rankTerms.size() > 0);
+}
+
+
+
+// Can a node be evaluated entirely from the index?
+bool FilterQueryCompiler::isIndexed(FilterQueryNode *node) {
+    if (node->type == FilterQueryNode::Select)
+        return node->indexKey != 0;
+    for (int i=0; i<node->children.size(); i++) {
+        if (!isIndexed(node->children[i]))
+            return false;
+    }
+    return true;
+}
+
+
+
+LidBitmap FilterQueryCompiler::evaluate(FilterQueryNode *node) {
+    if (node->type == FilterQueryNode::Select) {
+        if (node->indexAny)
+            return global.filterIndex.getPresent(node->indexKey);
+        return global.filterIndex.get(node->indexKey, node->indexValue);
+    }
+
+    LidBitmap result;
+    if (node->type == FilterQueryNode::And) {
+        bool first = true;
+        for (int i=0; i<node->children.size(); i++) {
+            if (node->children[i]->negate)
+                continue;
+            if (first)
+                result = evaluate(node->children[i]);
+            else
+                result &= evaluate(node->children[i]);
+            first = false;
+        }
+        if (first)
+            result = global.filterIndex.getAll();
+        for (int i=0; i<node->children.size(); i++) {
+            if (node->children[i]->negate)
+                result -= evaluate(node->children[i]);
+        }
+        return result;
+    }
+
+    for (int i=0; i<node->children.size(); i++) {
+        if (node->children[i]->negate) {
+            LidBitmap others = global.filterIndex.getAll();
+            others -= evaluate(node->children[i]);
+            result |= others;
+        } else {
+            result |= evaluate(node->children[i]);
+        }
+    }
+    return result;
+}
+
+
+
+// Emit the statement.  The relevance is the bm25() rank of the note text
+// for the search words plus any fixed boosts.  Pinned notes are always
+// added back with a relevance of 1, just like the old engine did after it
+// finished filtering.  Callers that combine the results with the index add
+// them back themselves.
+QString FilterQueryCompiler::getSql(QList<QVariant> &values, bool includePinned) {
+    values.clear();
+    if (root == nullptr)
+        return "";
+
+    QString sql = "with hits(lid) as (";
+    emitNode(root, sql, values);
+    sql.append(")");
+    if (rankTerms.size() > 0) {
+        // The limit keeps SQLite from flattening the FTS query into the
+        // group by, which bm25() doesn't allow.
+        sql.append(", ranked(lid, score) as (select lid, max(score) from "
+                   "(select lid, " SEARCHINDEX_RANK " as score from SearchIndex "
+                   "where SearchIndex match ? and source='text' limit -1) group by lid)");
+        values.append(rankTerms.join(" OR "));
+    }
+    sql.append(" select hits.lid, ");
+    QStringList relevance = relevanceTerms;
+    if (rankTerms.size() > 0)
+        relevance.prepend("coalesce(ranked.score,0)");
+    if (relevance.size() > 0) {
+        sql.append(relevance.join("+"));
+        values.append(relevanceValues);
+    } else {
+        sql.append("0");
+    }
+    sql.append(" from hits");
+    if (rankTerms.size() > 0)
+        sql.append(" left join ranked on ranked.lid=hits.lid");
+    if (includePinned) {
+        sql.append(" union all select lid, 1 from DataStore where key=? "
+                   "and lid not in (select lid from hits)");
+        values.append(NOTE_ISPINNED);
+    }
+    return sql;
+}
+
+
+
+// Write out a node.  Positive AND operands are intersected first and the
+// negative ones are subtracted afterwards.  SQLite evaluates compound
+// selects left to right, so the order is all that is needed.
+void FilterQueryCompiler::emitNode(FilterQueryNode *node, QString &sql, QList<QVariant> &values) {
+    if (node->type == FilterQueryNode::Select) {
+        sql.append(node->sql);
+        values.append(node->values);
+        return;
+    }
+
+    if (node->type == FilterQueryNode::And) {
+        QList<FilterQueryNode*> positive;
+        QList<FilterQueryNode*> negative;
+        for (int i=0; i<node->children.size(); i++) {
+            if (node->children[i]->negate)
+                negative.append(node->children[i]);
+            else
+                positive.append(node->children[i]);
+        }
+        if (positive.size() == 0)
+            sql.append("select lid from NoteTable");
+        for (int i=0; i<positive.size(); i++) {
+            if (i>0)
+                sql.append(" intersect ");
+            emitOperand(positive[i], sql, values);
+        }
+        for (int i=0; i<negative.size(); i++) {
+            sql.append(" except ");
+            emitOperand(negative[i], sql, values);
+        }
+        return;
+    }
+
+    // An OR of nothing matches nothing
+    if (node->children.size() == 0) {
+        sql.append("select lid from NoteTable where 0");
+        return;
+    }
+    for (int i=0; i<node->children.size(); i++) {
+        if (i>0)
+            sql.append(" union ");
+        if (node->children[i]->negate) {
+            sql.append("select lid from (select lid from NoteTable except ");
+            emitOperand(node->children[i], sql, values);
+            sql.append(")");
+        } else {
+            emitOperand(node->children[i], sql, values);
+        }
+    }
+}
+
+
+
+// Compound operands have to be wrapped in a sub-select because SQLite
+// doesn't allow parentheses around part of a compound statement.
+void FilterQueryCompiler::emitOperand(FilterQueryNode *node, QString &sql, QList<QVariant> &values) {
+    if (node->type == FilterQueryNode::Select) {
+        emitNode(node, sql, values);
+        return;
+    }
+    sql.append("select lid from (");
+    emitNode(node, sql, values);
+    sql.append(")");
+}
+
+
+
+// Convert a user wildcard to a like pattern
+QString FilterQueryCompiler::toLike(QString value) {
+    return value.replace("*", "%");
+}
+
+
+
+void FilterQueryCompiler::addRelevance(QString sql, QList<QVariant> values, qint32 weight) {
+    relevanceTerms.append("(hits.lid in (" + sql + "))*" + QString::number(weight));
+    relevanceValues.append(values);
+}
+
+
+
+
+//*****************************************
+//* Criteria from the GUI selections
+//*****************************************
+
+FilterQueryNode* FilterQueryCompiler::trashNode(FilterCriteria *criteria) {
+    if (criteria->isSet() && criteria->isDeletedOnlySet() && criteria->getDeletedOnly())
+        return keyValueNode(NOTE_ACTIVE, 0);
+    return keyValueNode(NOTE_ACTIVE, 1);
+}
+
+
+FilterQueryNode* FilterQueryCompiler::favoriteNode(FilterCriteria *criteria) {
+    if (!criteria->isFavoriteSet())
+        return nullptr;
+
+    FavoritesTable ftable(global.db);
+    FavoritesRecord rec;
+    if (!ftable.get(rec, criteria->getFavorite()))
+        return nullptr;
+
+    switch (rec.type) {
+    case FavoritesRecord::ConflictNotebook:
+    case FavoritesRecord::LocalNotebook:
+    case FavoritesRecord::LinkedNotebook:
+    case FavoritesRecord::SharedNotebook:
+    case FavoritesRecord::SynchronizedNotebook:
+        return keyValueNode(NOTE_NOTEBOOK_LID, rec.target.toInt());
+    case FavoritesRecord::NotebookStack:
+    case FavoritesRecord::LinkedStack:
+        return stackNode(rec.target.toString());
+    case FavoritesRecord::Tag:
+        return keyValueNode(NOTE_TAG_LID, rec.target.toInt());
+    case FavoritesRecord::Note: {
+        FilterQueryNode *node = new FilterQueryNode("select lid from NoteTable where lid=?",
+                                                    QList<QVariant>() << rec.target.toInt());
+        node->setIndex(FILTERINDEX_NOTE_LID, rec.target.toInt());
+        return node;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+
+FilterQueryNode* FilterQueryCompiler::notebookNode(FilterCriteria *criteria) {
+    if (!criteria->isNotebookSet())
+        return nullptr;
+
+    QTreeWidgetItem *item = criteria->getNotebook();
+    if (item->data(0,Qt::UserRole).toString() == "STACK")
+        return stackNode(item->text(0));
+    return keyValueNode(NOTE_NOTEBOOK_LID, item->data(0,Qt::UserRole).toInt());
+}
+
+
+FilterQueryNode* FilterQueryCompiler::tagsNode(FilterCriteria *criteria) {
+    if (!criteria->isTagsSet())
+        return nullptr;
+
+    QList<QTreeWidgetItem*> tags = criteria->getTags();
+    FilterQueryNode *node = new FilterQueryNode(global.getTagSelectionOr() ?
+                                                    FilterQueryNode::Or : FilterQueryNode::And);
+    bool children = global.getIncludeChildTags();
+    TagTable tagTable(global.db);
+    for (int i=0; i<tags.size(); i++) {
+        qint32 lid = tags[i]->data(0,Qt::UserRole).toInt();
+        if (!children) {
+            node->add(keyValueNode(NOTE_TAG_LID, lid));
+            continue;
+        }
+
+        // The tag or any tag below it
+        QList<qint32> descendants;
+        tagTable.getDescendants(descendants, lid);
+        FilterQueryNode *tagNode = new FilterQueryNode(FilterQueryNode::Or);
+        for (int j=0; j<descendants.size(); j++)
+            tagNode->add(keyValueNode(NOTE_TAG_LID, descendants[j]));
+        node->add(tagNode);
+    }
+    return node;
+}
+
+
+FilterQueryNode* FilterQueryCompiler::attributeNode(FilterCriteria *criteria) {
+    if (!criteria->isAttributeSet())
+        return nullptr;
+
+    int attribute = criteria->getAttribute()->data(0,Qt::UserRole).toInt();
+
+    // The date attributes are laid out as four groups of eight periods
+    // (created since/before, modified since/before).
+    if (attribute < CONTAINS_IMAGES) {
+        QDateTime dt;
+        dt.setDate(QDate().currentDate());
+        dt.setTime(QTime(0,0,0,1));
+        int dow = QDate().currentDate().dayOfWeek();
+        int moy = QDate().currentDate().month();
+        int dom = QDate().currentDate().day();
+
+        switch (attribute % 100) {
+        case 2:     // yesterday
+            dt = dt.addDays(-1);
+            break;
+        case 3:     // this week
+            dt = dt.addDays(-1*dow);
+            break;
+        case 4:     // last week
+            dt = dt.addDays(-1*dow-7);
+            break;
+        case 5:     // this month
+            dt = dt.addDays(-1*dom+1);
+            break;
+        case 6:     // last month
+            dt = dt.addDays(-1*dom+1);
+            dt = dt.addMonths(-1);
+            break;
+        case 7:     // this year
+            dt = dt.addDays(-1*dom+1);
+            dt = dt.addMonths(-1*moy+1);
+            break;
+        case 8:     // last year
+            dt = dt.addDays(-1*dom+1);
+            dt = dt.addMonths(-1*moy+1);
+            dt = dt.addYears(-1);
+            break;
+        }
+
+        int group = attribute / 100;
+        qint32 key = (group < 2) ? NOTE_CREATED_DATE : NOTE_UPDATED_DATE;
+        return keyDateNode(key, (group % 2 == 0) ? ">" : "<", dt);
+    }
+
+    FilterQueryNode *node;
+    switch (attribute) {
+    case CONTAINS_IMAGES:
+        return resourceMatchNode(RESOURCE_MIME, "image/*");
+    case CONTAINS_AUDIO:
+        return resourceMatchNode(RESOURCE_MIME, "audio/*");
+    case CONTAINS_INK:
+        return resourceMatchNode(RESOURCE_MIME, "application/vnd.evernote.ink");
+    case CONTAINS_PDF_DOCUMENT:
+        return resourceMatchNode(RESOURCE_MIME, "application/pdf");
+    case CONTAINS_ENCRYPTED_TEXT:
+        return keyNode(NOTE_HAS_ENCRYPT);
+    case CONTAINS_TODO_ITEMS:
+        node = new FilterQueryNode(FilterQueryNode::Or);
+        node->add(keyValueNode(NOTE_HAS_TODO_COMPLETED, 1));
+        node->add(keyValueNode(NOTE_HAS_TODO_UNCOMPLETED, 1));
+        return node;
+    case CONTAINS_FINISHED_TODO_ITEMS:
+        return keyValueNode(NOTE_HAS_TODO_COMPLETED, 1);
+    case CONTAINS_UNFINISHED_TODO_ITEMS:
+        return keyValueNode(NOTE_HAS_TODO_UNCOMPLETED, 1);
+    case CONTAINS_ATTACHMENT:
+        return keyNode(NOTE_HAS_ATTACHMENT);
+    case CONTAINS_REMINDER:
+        return keyNode(NOTE_ATTRIBUTE_REMINDER_TIME);
+    case CONTAINS_UNCOMPLETED_REMINDER:
+        node = new FilterQueryNode(FilterQueryNode::And);
+        node->add(keyNode(NOTE_ATTRIBUTE_REMINDER_TIME));
+        node->add(new FilterQueryNode("select lid from DataStore where key=? and data>0",
+                                      QList<QVariant>() << NOTE_ATTRIBUTE_REMINDER_DONE_TIME))->negate = true;
+        return node;
+    case CONTAINS_FUTURE_REMINDER:
+        return new FilterQueryNode("select lid from DataStore where key=? and data>?",
+                                   QList<QVariant>() << NOTE_ATTRIBUTE_REMINDER_TIME
+                                                     << QDateTime::currentMSecsSinceEpoch());
+    case SOURCE_EMAIL:
+        return keyValueNode(NOTE_ATTRIBUTE_SOURCE, "mail.clip");
+    case SOURCE_EMAILED_TO_EVERNOTE:
+        return keyValueNode(NOTE_ATTRIBUTE_SOURCE, "mail.smtp");
+    case SOURCE_MOBILE:
+        return keyMatchNode(NOTE_ATTRIBUTE_SOURCE, "mobile.*");
+    case SOURCE_WEB_PAGE:
+        return keyValueNode(NOTE_ATTRIBUTE_SOURCE, "web.clip");
+    case SOURCE_ANOTHER_APPLICATION:
+        return new FilterQueryNode("select lid from DataStore where key=? and data != 'web.clip' and "
+                                   "data not like 'mobile.%' and data != 'mail.smtp' and data != 'mail.clip'",
+                                   QList<QVariant>() << NOTE_ATTRIBUTE_SOURCE);
+    }
+    return nullptr;
+}
+
+
+
+
+//*****************************************
+//* The search string
+//*****************************************
+
+// Parse the search string.  The default is that every term has to match
+// (an AND node).  "any:" makes it an OR node, where a negative term means
+// every note that doesn't match it.
+FilterQueryNode* FilterQueryCompiler::searchNode(FilterCriteria *criteria) {
+    if (!criteria->isSearchStringSet() || criteria->getSearchString().trimmed() == "")
+        return nullptr;
+
+    // Normalized for the LIKE searches.  MATCH words are folded by the tokenizer.
+    QString searchString = global.normalizeTermForSearchAndIndex(criteria->getSearchString()).trimmed();
+    bool any = false;
+    if (searchString.startsWith("any:", Qt::CaseInsensitive)) {
+        any = true;
+        searchString = searchString.mid(4);
+    }
+
+    QStringList list;
+    FilterEngine::splitSearchTerms(list, searchString);
+
+    FilterQueryNode *node = new FilterQueryNode(any ? FilterQueryNode::Or : FilterQueryNode::And);
+    for (int i=0; i<list.size(); i++)
+        node->add(termNode(list[i]));
+
+    // Notes tagged "important" float to the top, as they always have.
+    if (!any) {
+        addRelevance("select lid from DataStore where key=? and data in "
+                     "(select lid from DataStore where key=? and data like ?)",
+                     QList<QVariant>() << NOTE_TAG_LID << TAG_NAME << "important%", 3);
+    }
+    return node;
+}
+
+
+
+// The words of a search string that termNode() sends to the full text index,
+// quoted for MATCH.  Negated words & field terms are left out.  These are the
+// words a note was found by, so they are the ones to highlight in it.  The
+// tokenizer folds them, so unlike searchNode() they aren't normalized.
+QStringList FilterQueryCompiler::matchTerms(QString searchString) {
+    QStringList terms;
+    searchString = searchString.trimmed();
+    if (searchString.startsWith("any:", Qt::CaseInsensitive))
+        searchString = searchString.mid(4);
+
+    QStringList list;
+    FilterEngine::splitSearchTerms(list, searchString);
+    for (int i=0; i<list.size(); i++) {
+        QString term = list[i];
+        term.remove(QChar('"'));
+        if (term == "" || term.startsWith("-") || term.indexOf(":") > 0)
+            continue;
+        if (term.startsWith("*") || term.contains("_") || term.contains("-"))
+            continue;
+        QString match = SearchIndexTable::toMatch(term);
+        if (!terms.contains(match))
+            terms.append(match);
+    }
+    return terms;
+}
+
+
+
+// Compile one search term.  Date, reminder time and coordinate terms are
+// ranges, so "-created:" means "created before" rather than "everything
+// except".  Anything without a known prefix is a word to look for.
+FilterQueryNode* FilterQueryCompiler::termNode(QString term) {
+    term.remove(QChar('"'));
+    if (term == "" || term == "-")
+        return nullptr;
+
+    bool negative = false;
+    QString string = term;
+    if (string.startsWith("-")) {
+        negative = true;
+        string = string.mid(1);
+    }
+
+    QString field;
+    QString value;
+    int separator = string.indexOf(":");
+    if (separator > 0) {
+        field = string.left(separator).toLower();
+        value = string.mid(separator+1);
+        if (value == "")
+            value = "*";
+    }
+
+    FilterQueryNode *node = nullptr;
+    if (field == "notebook") {
+        node = notebookNameNode(value);
+    } else if (field == "stack") {
+        node = stackNode(value);
+    } else if (field == "tag") {
+        node = tagNameNode(value);
+    } else if (field == "intitle") {
+        node = titleNode(value);
+    } else if (field == "todo") {
+        if (value.startsWith("true", Qt::CaseInsensitive))
+            node = keyNode(NOTE_HAS_TODO_COMPLETED);
+        else if (value.startsWith("false", Qt::CaseInsensitive))
+            node = keyNode(NOTE_HAS_TODO_UNCOMPLETED);
+        else {
+            node = new FilterQueryNode(FilterQueryNode::Or);
+            node->add(keyNode(NOTE_HAS_TODO_COMPLETED));
+            node->add(keyNode(NOTE_HAS_TODO_UNCOMPLETED));
+        }
+    } else if (field == "reminderorder") {
+        if (value.startsWith("*"))
+            node = keyNode(NOTE_ATTRIBUTE_REMINDER_ORDER);
+        else
+            node = keyValueNode(NOTE_ATTRIBUTE_REMINDER_ORDER, value.toInt());
+    } else if (field == "resource") {
+        node = resourceMatchNode(RESOURCE_MIME, value);
+    } else if (field == "recotype") {
+        node = resourceMatchNode(RESOURCE_RECO_TYPE, value);
+    } else if (field == "author") {
+        node = keyMatchNode(NOTE_ATTRIBUTE_AUTHOR, value);
+    } else if (field == "source") {
+        node = keyMatchNode(NOTE_ATTRIBUTE_SOURCE, value);
+    } else if (field == "sourceapplication") {
+        node = keyMatchNode(NOTE_ATTRIBUTE_SOURCE_APPLICATION, value);
+    } else if (field == "contentclass") {
+        node = keyMatchNode(NOTE_ATTRIBUTE_CONTENT_CLASS, value);
+    } else if (field == "placename") {
+        node = keyMatchNode(NOTE_ATTRIBUTE_PLACE_NAME, value);
+    } else if (field == "created" || field == "updated" || field == "subjectdate" ||
+               field == "remindertime" || field == "reminderdonetime") {
+        qint32 key = NOTE_CREATED_DATE;
+        if (field == "updated")
+            key = NOTE_UPDATED_DATE;
+        if (field == "subjectdate")
+            key = NOTE_ATTRIBUTE_SUBJECT_DATE;
+        if (field == "remindertime")
+            key = NOTE_ATTRIBUTE_REMINDER_TIME;
+        if (field == "reminderdonetime")
+            key = NOTE_ATTRIBUTE_REMINDER_DONE_TIME;
+        return keyDateNode(key, negative ? "<" : ">=", FilterEngine::calculateDateTime(value));
+    } else if (field == "latitude" || field == "longitude" || field == "altitude") {
+        qint32 key = NOTE_ATTRIBUTE_LATITUDE;
+        if (field == "longitude")
+            key = NOTE_ATTRIBUTE_LONGITUDE;
+        if (field == "altitude")
+            key = NOTE_ATTRIBUTE_ALTITUDE;
+        return new FilterQueryNode(QString("select lid from DataStore where key=? and data") +
+                                       (negative ? "<" : ">=") + "?",
+                                   QList<QVariant>() << key << value.toDouble());
+    } else if (string.startsWith("*")) {
+        node = contentLikeNode(string, false);      // Postfix search.  The word index doesn't do this.
+    } else if (string.contains("_")) {
+        node = contentLikeNode(string, true);       // Underscore search.  The word index doesn't do this.
+    } else if (string.contains("-")) {
+        node = contentLikeNode(string, false);      // Hyphen search.  The word index doesn't do this.
+    } else {
+        node = contentMatchNode(string);
+        if (!negative)
+            rankTerms.append(SearchIndexTable::toMatch(string));
+    }
+
+    if (node != nullptr)
+        node->negate = negative;
+    return node;
+}
+
+
+
+
+//*****************************************
+//* Leaf selects
+//*****************************************
+
+FilterQueryNode* FilterQueryCompiler::keyNode(qint32 key) {
+    FilterQueryNode *node = new FilterQueryNode("select lid from DataStore where key=?", QList<QVariant>() << key);
+    if (FilterIndex::isIndexed(key))
+        node->setIndex(key, 0, true);
+    return node;
+}
+
+
+// Only numeric values are indexed.  Text attributes still go to the database.
+FilterQueryNode* FilterQueryCompiler::keyValueNode(qint32 key, QVariant value) {
+    FilterQueryNode *node = new FilterQueryNode("select lid from DataStore where key=? and data=?",
+                                                QList<QVariant>() << key << value);
+    if (value.type() != QVariant::String && FilterIndex::isIndexed(key, value.toLongLong()))
+        node->setIndex(key, value.toLongLong());
+    return node;
+}
+
+
+// An attribute value, with * as a wildcard
+FilterQueryNode* FilterQueryCompiler::keyMatchNode(qint32 key, QString value) {
+    if (value.contains("*"))
+        return new FilterQueryNode("select lid from DataStore where key=? and data like ?",
+                                   QList<QVariant>() << key << toLike(value));
+    return keyValueNode(key, value);
+}
+
+
+FilterQueryNode* FilterQueryCompiler::keyDateNode(qint32 key, QString op, QDateTime value) {
+    return new FilterQueryNode("select lid from DataStore where key=? and datetime(data/1000)" + op +
+                                   "datetime(?/1000)",
+                               QList<QVariant>() << key << value.toMSecsSinceEpoch());
+}
+
+
+// Notes owning a resource with a matching value.  The note lid is stored as
+// the data of the resource, so it is cast back to an integer or the compound
+// operators would treat "5" and 5 as different lids.
+FilterQueryNode* FilterQueryCompiler::resourceMatchNode(qint32 key, QString value) {
+    QString op = value.contains("*") ? "like" : "=";
+    return new FilterQueryNode("select cast(data as integer) as lid from DataStore where key=? and lid in "
+                               "(select lid from DataStore where key=? and data " + op + " ?)",
+                               QList<QVariant>() << RESOURCE_NOTE_LID << key << toLike(value));
+}
+
+
+FilterQueryNode* FilterQueryCompiler::notebookNameNode(QString value) {
+    if (value.contains("*"))
+        return new FilterQueryNode("select lid from NoteTable where notebook like ?",
+                                   QList<QVariant>() << toLike(value));
+    return new FilterQueryNode("select lid from NoteTable where notebook=?",
+                               QList<QVariant>() << value);
+}
+
+
+FilterQueryNode* FilterQueryCompiler::stackNode(QString stack) {
+    QList<qint32> notebooks;
+    NotebookTable notebookTable(global.db);
+    notebookTable.getStack(notebooks, stack);
+    return notebookListNode(notebooks);
+}
+
+
+// Notes in any of the notebooks
+FilterQueryNode* FilterQueryCompiler::notebookListNode(QList<qint32> notebooks) {
+    FilterQueryNode *node = new FilterQueryNode(FilterQueryNode::Or);
+    for (int i=0; i<notebooks.size(); i++)
+        node->add(keyValueNode(NOTE_NOTEBOOK_LID, notebooks[i]));
+    return node;
+}
+
+
+FilterQueryNode* FilterQueryCompiler::tagNameNode(QString value) {
+    QString op = value.contains("*") ? "like" : "=";
+    if (global.getIncludeChildTags())
+        return new FilterQueryNode("select lid from DataStore where key=? and data in "
+                                   "(select c.descendant from TagClosure c join DataStore t on t.lid=c.ancestor "
+                                   "where t.key=? and t.data " + op + " ?)",
+                                   QList<QVariant>() << NOTE_TAG_LID << TAG_NAME << toLike(value));
+    return new FilterQueryNode("select lid from DataStore where key=? and data in "
+                               "(select lid from DataStore where key=? and data " + op + " ?)",
+                               QList<QVariant>() << NOTE_TAG_LID << TAG_NAME << toLike(value));
+}
+
+
+// Title searches are always truncated on both sides
+FilterQueryNode* FilterQueryCompiler::titleNode(QString value) {
+    value = toLike(value);
+    if (!value.startsWith("%"))
+        value = "%" + value;
+    if (!value.endsWith("%"))
+        value = value + "%";
+    return new FilterQueryNode("select lid from DataStore where key=? and data like ?",
+                               QList<QVariant>() << NOTE_TITLE << value);
+}
+
+
+// A full text search.  Words found in a resource count for the note that
+// owns the resource.
+FilterQueryNode* FilterQueryCompiler::contentMatchNode(QString word) {
+    word = SearchIndexTable::toMatch(word);
+
+    FilterQueryNode *node = new FilterQueryNode(FilterQueryNode::Or);
+    node->add(new FilterQueryNode("select lid from SearchIndex where weight>=? and content match ?",
+                                  QList<QVariant>() << minimumWeight << word));
+    node->add(new FilterQueryNode("select cast(data as integer) as lid from DataStore where key=? and lid in "
+                                  "(select lid from SearchIndex where weight>=? and content match ?)",
+                                  QList<QVariant>() << RESOURCE_NOTE_LID << minimumWeight << word));
+    return node;
+}
+
+
+// A substring search for the terms the FTS tokenizer can't handle.  These
+// go to the trigram index when it is built, otherwise they scan the text.
+// The two argument LIKE is what the trigram index serves, but it reads
+// '_' as a wildcard, so an exact (underscore) search also checks the rows
+// it finds with a GLOB.  GLOB is case sensitive, so both sides are lowered the way
+// LIKE folds case.
+FilterQueryNode* FilterQueryCompiler::contentLikeNode(QString word, bool exact) {
+    QString table = SearchIndexTable::likeTable();
+    QString condition = "weight>=? and content like ?";
+    QList<QVariant> values;
+    values << minimumWeight;
+    QString glob = SearchIndexTable::toGlob(word);
+    word = toLike(word);
+    if (!word.startsWith("%"))
+        word = "%" + word;
+    if (!word.endsWith("%"))
+        word = word + "%";
+    values << word;
+    if (exact) {
+        condition += " and lower(content) glob lower(?)";
+        values << glob;
+    }
+
+    FilterQueryNode *node = new FilterQueryNode(FilterQueryNode::Or);
+    node->add(new FilterQueryNode("select lid from " + table + " where " + condition, values));
+    node->add(new FilterQueryNode("select cast(data as integer) as lid from DataStore where key=? and lid in "
+                                  "(select lid from " + table + " where " + condition + ")",
+                                  QList<QVariant>() << RESOURCE_NOTE_LID << values));
+    return node;
+}
@@ -0,0 +1,117 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2015 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef FILTERQUERYCOMPILER_H
+#define FILTERQUERYCOMPILER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVariant>
+#include <QDateTime>
+
+#include "filtercriteria.h"
+#include "lidbitmap.h"
+
+//*************************************************
+//* The query compiler turns a FilterCriteria and
+//* its search string into a tree of note lid sets
+//* and then into a single SQL statement.  AND
+//* nodes become INTERSECT/EXCEPT, OR nodes become
+//* UNION, and terms that only affect the sort
+//* order are summed into a relevance column.
+//* Selects that only test a notebook, tag, flag
+//* or trash state can instead be answered from
+//* the in memory FilterIndex.
+//*************************************************
+
+class FilterQueryNode
+{
+public:
+    enum Type {
+        Select = 0,     // A single select returning note lids
+        And = 1,        // Notes in every child
+        Or = 2          // Notes in any child
+    };
+
+    Type type;
+    bool negate;                        // Remove this set from the parent instead of adding it
+    QString sql;                        // Select statement for Select nodes
+    QList<QVariant> values;             // Values for the ? markers in sql
+    QList<FilterQueryNode*> children;   // Operands for And & Or nodes
+    qint32 indexKey;                    // FilterIndex key that can answer this select, 0 if none
+    qint64 indexValue;                  // Value to look up in the index
+    bool indexAny;                      // Any value of indexKey matches
+
+    explicit FilterQueryNode(Type type = Select);
+    FilterQueryNode(QString sql, QList<QVariant> values);
+    ~FilterQueryNode();
+    FilterQueryNode* add(FilterQueryNode *child);      // Take ownership of a child.  Null children are ignored.
+    void setIndex(qint32 key, qint64 value, bool any=false);
+};
+
+
+class FilterQueryCompiler
+{
+private:
+    FilterQueryNode *root;
+    QStringList relevanceTerms;         // "(lid in (...))*weight" expressions
+    QStringList rankTerms;              // Words ranked with bm25()
+    QList<QVariant> relevanceValues;    // Values for the relevance expressions
+    qint32 minimumWeight;               // Minimum recognition weight for search hits
+
+    FilterQueryNode* favoriteNode(FilterCriteria *criteria);
+    FilterQueryNode* notebookNode(FilterCriteria *criteria);
+    FilterQueryNode* tagsNode(FilterCriteria *criteria);
+    FilterQueryNode* trashNode(FilterCriteria *criteria);
+    FilterQueryNode* attributeNode(FilterCriteria *criteria);
+    FilterQueryNode* searchNode(FilterCriteria *criteria);
+    FilterQueryNode* termNode(QString term);
+
+    FilterQueryNode* keyNode(qint32 key);
+    FilterQueryNode* keyValueNode(qint32 key, QVariant value);
+    FilterQueryNode* keyMatchNode(qint32 key, QString value);
+    FilterQueryNode* keyDateNode(qint32 key, QString op, QDateTime value);
+    FilterQueryNode* resourceMatchNode(qint32 key, QString value);
+    FilterQueryNode* notebookNameNode(QString value);
+    FilterQueryNode* stackNode(QString stack);
+    FilterQueryNode* notebookListNode(QList<qint32> notebooks);
+    FilterQueryNode* tagNameNode(QString value);
+    FilterQueryNode* titleNode(QString value);
+    FilterQueryNode* contentMatchNode(QString word);
+    FilterQueryNode* contentLikeNode(QString word, bool exact);
+    void addRelevance(QString sql, QList<QVariant> values, qint32 weight);
+
+    static QString toLike(QString value);
+    void emitNode(FilterQueryNode *node, QString &sql, QList<QVariant> &values);
+    void emitOperand(FilterQueryNode *node, QString &sql, QList<QVariant> &values);
+    bool isIndexed(FilterQueryNode *node);
+    LidBitmap evaluate(FilterQueryNode *node);
+
+public:
+    FilterQueryCompiler();
+    ~FilterQueryCompiler();
+    bool compile(FilterCriteria *criteria);                    // Build the query tree for the criteria
+    void evaluateIndexed(LidBitmap &result);                   // Answer what we can from the FilterIndex & drop it from the tree
+    bool hasSql();                                             // Is anything left that needs the database?
+    QString getSql(QList<QVariant> &values, bool includePinned=true);  // One statement returning (lid, relevance)
+    static QStringList matchTerms(QString searchString);        // Words of a search that go to the full text index
+};
+
+#endif // FILTERQUERYCOMPILER_H
@@ -0,0 +1,328 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "lidbitmap.h"
+
+#include <QtAlgorithms>
+#include <algorithm>
+#include <iterator>
+
+
+LidBitmap::LidBitmap()
+{
+}
+
+
+
+// Add a lid to the set
+void LidBitmap::add(qint32 lid) {
+    quint32 value = static_cast<quint32>(lid);
+    Block &block = blocks[value >> 16];
+    quint16 low = value & 0xFFFF;
+
+    if (block.isBitset()) {
+        quint64 mask = Q_UINT64_C(1) << (low & 63);
+        if (!(block.bits[low >> 6] & mask)) {
+            block.bits[low >> 6] |= mask;
+            block.count++;
+        }
+        return;
+    }
+
+    QVector<quint16>::iterator i = std::lower_bound(block.array.begin(), block.array.end(), low);
+    if (i != block.array.end() && *i == low)
+        return;
+    block.array.insert(i, low);
+    block.count++;
+
+    // Switch to a bitset once the array is bigger than one
+    if (block.count > LIDBITMAP_ARRAY_MAX) {
+        QVector<quint64> bits;
+        toBits(block, bits);
+        block.array.clear();
+        block.bits = bits;
+    }
+}
+
+
+
+// Remove a lid from the set
+void LidBitmap::remove(qint32 lid) {
+    quint32 value = static_cast<quint32>(lid);
+    QMap<quint16, Block>::iterator b = blocks.find(value >> 16);
+    if (b == blocks.end())
+        return;
+    Block &block = b.value();
+    quint16 low = value & 0xFFFF;
+
+    if (block.isBitset()) {
+        quint64 mask = Q_UINT64_C(1) << (low & 63);
+        if (block.bits[low >> 6] & mask) {
+            block.bits[low >> 6] &= ~mask;
+            block.count--;
+        }
+        if (block.count <= LIDBITMAP_ARRAY_MAX) {
+            QVector<quint64> bits = block.bits;
+            fromBits(block, bits);
+        }
+    } else {
+        QVector<quint16>::iterator i = std::lower_bound(block.array.begin(), block.array.end(), low);
+        if (i == block.array.end() || *i != low)
+            return;
+        block.array.erase(i);
+        block.count--;
+    }
+    if (block.count == 0)
+        blocks.erase(b);
+}
+
+
+
+// Is the lid in the set?
+bool LidBitmap::contains(qint32 lid) const {
+    quint32 value = static_cast<quint32>(lid);
+    QMap<quint16, Block>::const_iterator b = blocks.constFind(value >> 16);
+    if (b == blocks.constEnd())
+        return false;
+    quint16 low = value & 0xFFFF;
+    if (b.value().isBitset())
+        return (b.value().bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(b.value().array.constBegin(), b.value().array.constEnd(), low);
+}
+
+
+
+// Number of lids in the set
+qint32 LidBitmap::size() const {
+    qint32 total = 0;
+    for (QMap<quint16, Block>::const_iterator b = blocks.constBegin(); b != blocks.constEnd(); ++b)
+        total += b.value().count;
+    return total;
+}
+
+
+bool LidBitmap::isEmpty() const {
+    return blocks.isEmpty();
+}
+
+
+void LidBitmap::clear() {
+    blocks.clear();
+}
+
+
+
+// Return the lids in ascending order
+QList<qint32> LidBitmap::toList() const {
+    QList<qint32> retval;
+    retval.reserve(size());
+    for (QMap<quint16, Block>::const_iterator b = blocks.constBegin(); b != blocks.constEnd(); ++b) {
+        qint32 high = static_cast<qint32>(b.key()) << 16;
+        const Block &block = b.value();
+        if (!block.isBitset()) {
+            for (int i=0; i<block.array.size(); i++)
+                retval.append(high | block.array[i]);
+            continue;
+        }
+        for (int w=0; w<LIDBITMAP_WORDS; w++) {
+            quint64 word = block.bits[w];
+            while (word != 0) {
+                int bit = qCountTrailingZeroBits(word);
+                retval.append(high | (w << 6) | bit);
+                word &= word - 1;
+            }
+        }
+    }
+    return retval;
+}
+
+
+
+LidBitmap &LidBitmap::operator&=(const LidBitmap &other) {
+    QMap<quint16, Block>::iterator b = blocks.begin();
+    while (b != blocks.end()) {
+        QMap<quint16, Block>::const_iterator o = other.blocks.constFind(b.key());
+        if (o == other.blocks.constEnd()) {
+            b = blocks.erase(b);
+            continue;
+        }
+        b.value() = intersect(b.value(), o.value());
+        if (b.value().count == 0)
+            b = blocks.erase(b);
+        else
+            ++b;
+    }
+    return *this;
+}
+
+
+
+LidBitmap &LidBitmap::operator|=(const LidBitmap &other) {
+    for (QMap<quint16, Block>::const_iterator o = other.blocks.constBegin(); o != other.blocks.constEnd(); ++o) {
+        QMap<quint16, Block>::iterator b = blocks.find(o.key());
+        if (b == blocks.end())
+            blocks.insert(o.key(), o.value());
+        else
+            b.value() = unite(b.value(), o.value());
+    }
+    return *this;
+}
+
+
+
+LidBitmap &LidBitmap::operator-=(const LidBitmap &other) {
+    for (QMap<quint16, Block>::const_iterator o = other.blocks.constBegin(); o != other.blocks.constEnd(); ++o) {
+        QMap<quint16, Block>::iterator b = blocks.find(o.key());
+        if (b == blocks.end())
+            continue;
+        b.value() = subtract(b.value(), o.value());
+        if (b.value().count == 0)
+            blocks.erase(b);
+    }
+    return *this;
+}
+
+
+
+// Expand a block to a bitset
+void LidBitmap::toBits(const Block &block, QVector<quint64> &bits) {
+    if (block.isBitset()) {
+        bits = block.bits;
+        return;
+    }
+    bits.fill(0, LIDBITMAP_WORDS);
+    quint64 *words = bits.data();
+    for (int i=0; i<block.array.size(); i++) {
+        quint16 low = block.array[i];
+        words[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    }
+}
+
+
+
+// Store a bitset in a block, shrinking it to an array if it is small enough
+void LidBitmap::fromBits(Block &block, QVector<quint64> &bits) {
+    const quint64 *words = bits.constData();
+    qint32 count = 0;
+    for (int w=0; w<LIDBITMAP_WORDS; w++)
+        count += qPopulationCount(words[w]);
+    block.count = count;
+
+    if (count > LIDBITMAP_ARRAY_MAX) {
+        block.array.clear();
+        block.bits = bits;
+        return;
+    }
+    block.bits.clear();
+    block.array.clear();
+    block.array.reserve(count);
+    for (int w=0; w<LIDBITMAP_WORDS; w++) {
+        quint64 word = words[w];
+        while (word != 0) {
+            block.array.append((w << 6) | qCountTrailingZeroBits(word));
+            word &= word - 1;
+        }
+    }
+}
+
+
+
+// The word loops below are kept branch free so the compiler can
+// vectorize them.
+LidBitmap::Block LidBitmap::intersect(const Block &a, const Block &b) {
+    Block result;
+    if (!a.isBitset() && !b.isBitset()) {
+        std::set_intersection(a.array.constBegin(), a.array.constEnd(),
+                              b.array.constBegin(), b.array.constEnd(),
+                              std::back_inserter(result.array));
+        result.count = result.array.size();
+        return result;
+    }
+    if (!a.isBitset() || !b.isBitset()) {
+        const Block &array = a.isBitset() ? b : a;
+        const Block &bitset = a.isBitset() ? a : b;
+        for (int i=0; i<array.array.size(); i++) {
+            quint16 low = array.array[i];
+            if ((bitset.bits[low >> 6] >> (low & 63)) & 1)
+                result.array.append(low);
+        }
+        result.count = result.array.size();
+        return result;
+    }
+
+    QVector<quint64> bits(LIDBITMAP_WORDS);
+    quint64 *out = bits.data();
+    const quint64 *x = a.bits.constData();
+    const quint64 *y = b.bits.constData();
+    for (int w=0; w<LIDBITMAP_WORDS; w++)
+        out[w] = x[w] & y[w];
+    fromBits(result, bits);
+    return result;
+}
+
+
+
+LidBitmap::Block LidBitmap::unite(const Block &a, const Block &b) {
+    Block result;
+    if (!a.isBitset() && !b.isBitset() && a.count + b.count <= LIDBITMAP_ARRAY_MAX) {
+        std::set_union(a.array.constBegin(), a.array.constEnd(),
+                       b.array.constBegin(), b.array.constEnd(),
+                       std::back_inserter(result.array));
+        result.count = result.array.size();
+        return result;
+    }
+
+    QVector<quint64> x;
+    QVector<quint64> y;
+    toBits(a, x);
+    toBits(b, y);
+    quint64 *out = x.data();
+    const quint64 *in = y.constData();
+    for (int w=0; w<LIDBITMAP_WORDS; w++)
+        out[w] |= in[w];
+    fromBits(result, x);
+    return result;
+}
+
+
+
+LidBitmap::Block LidBitmap::subtract(const Block &a, const Block &b) {
+    Block result;
+    if (!a.isBitset()) {
+        for (int i=0; i<a.array.size(); i++) {
+            quint16 low = a.array[i];
+            bool found = b.isBitset() ? ((b.bits[low >> 6] >> (low & 63)) & 1)
+                                      : std::binary_search(b.array.constBegin(), b.array.constEnd(), low);
+            if (!found)
+                result.array.append(low);
+        }
+        result.count = result.array.size();
+        return result;
+    }
+
+    QVector<quint64> x = a.bits;
+    QVector<quint64> y;
+    toBits(b, y);
+    quint64 *out = x.data();
+    const quint64 *in = y.constData();
+    for (int w=0; w<LIDBITMAP_WORDS; w++)
+        out[w] &= ~in[w];
+    fromBits(result, x);
+    return result;
+}
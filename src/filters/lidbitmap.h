@@ -0,0 +1,71 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef LIDBITMAP_H
+#define LIDBITMAP_H
+
+#include <QMap>
+#include <QVector>
+#include <QList>
+
+//****************************************************
+//* A compressed set of lids.  Lids are split into
+//* blocks of 65536 by their high 16 bits.  A block
+//* with few members is a sorted array of the low
+//* bits, a full one is a plain bitset that is
+//* combined a 64 bit word at a time.
+//****************************************************
+
+#define LIDBITMAP_ARRAY_MAX     4096        // Largest block kept as an array
+#define LIDBITMAP_WORDS         1024        // 65536 bits per bitset block
+
+class LidBitmap
+{
+private:
+    struct Block {
+        QVector<quint16> array;             // Sorted members when this is an array block
+        QVector<quint64> bits;              // Bitset when this is a bitset block
+        qint32 count;
+        Block() { count = 0; }
+        bool isBitset() const { return !bits.isEmpty(); }
+    };
+    QMap<quint16, Block> blocks;
+
+    static void toBits(const Block &block, QVector<quint64> &bits);
+    static void fromBits(Block &block, QVector<quint64> &bits);
+    static Block intersect(const Block &a, const Block &b);
+    static Block unite(const Block &a, const Block &b);
+    static Block subtract(const Block &a, const Block &b);
+
+public:
+    LidBitmap();
+    void add(qint32 lid);
+    void remove(qint32 lid);
+    bool contains(qint32 lid) const;
+    qint32 size() const;
+    bool isEmpty() const;
+    void clear();
+    QList<qint32> toList() const;           // Members in ascending order
+
+    LidBitmap &operator&=(const LidBitmap &other);  // AND
+    LidBitmap &operator|=(const LidBitmap &other);  // OR
+    LidBitmap &operator-=(const LidBitmap &other);  // AND NOT
+};
+
+#endif // LIDBITMAP_H
@@ -0,0 +1,340 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "materializedsearches.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/resourcetable.h"
+#include "src/sql/searchtable.h"
+
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTime>
+
+extern Global global;
+
+
+// Constructor
+MaterializedSearches::MaterializedSearches()
+{
+    loaded = false;
+}
+
+
+
+// The statement & its values as one string.  Matches are only used with
+// the statement they were found with.  It is never empty, even for a search
+// that is all notebooks & tags.
+QString MaterializedSearches::signature(QString statement, QList<QVariant> values) {
+    QStringList parts;
+    parts.append(QString::number(values.size()));
+    parts.append(statement);
+    for (int i=0; i<values.size(); i++)
+        parts.append(values[i].toString());
+    return parts.join(QChar(0x1F));
+}
+
+
+
+// Read the kept matches.  They were saved by an earlier session, so they
+// are checked once more in the background, but can be used until then.
+// Nothing is locked while the database is read.
+void MaterializedSearches::load(DatabaseConnection *db) {
+    mutex.lock();
+    bool done = loaded;
+    mutex.unlock();
+    if (done)
+        return;
+
+    QTime timer;
+    timer.start();
+    SearchTable table(db);
+    QList<qint32> lids;
+    table.getMaterialized(lids);
+    QHash<qint32, Entry> found;
+    for (int i=0; i<lids.size(); i++) {
+        Entry &entry = found[lids[i]];
+        entry.signature = table.getMatchSignature(lids[i]);
+        table.getMatches(lids[i], entry.relevance);
+        for (QHash<qint32, double>::const_iterator j = entry.relevance.constBegin(); j != entry.relevance.constEnd(); ++j)
+            entry.matches.add(j.key());
+        entry.rebuild = entry.signature == "";
+        entry.verify = true;
+    }
+
+    QMutexLocker locker(&mutex);
+    if (loaded)
+        return;
+    entries = found;
+    loaded = true;
+    QLOG_DEBUG() << "Materialized searches loaded: " << entries.size() << " searches in " << timer.elapsed() << "ms";
+}
+
+
+
+// Every materialized search
+QList<qint32> MaterializedSearches::searches(DatabaseConnection *db) {
+    load(db);
+    QMutexLocker locker(&mutex);
+    return entries.keys();
+}
+
+
+
+// Are there changes that haven't been checked yet?
+bool MaterializedSearches::hasPending() {
+    QMutexLocker locker(&mutex);
+    for (QHash<qint32, Entry>::const_iterator i = entries.constBegin(); i != entries.constEnd(); ++i) {
+        const Entry &entry = i.value();
+        if ((entry.rebuild && entry.failed == "") || entry.verify || !entry.pending.isEmpty())
+            return true;
+    }
+    return false;
+}
+
+
+
+// A search was marked as materialized (or not) by SearchTable
+void MaterializedSearches::setMaterialized(DatabaseConnection *db, qint32 searchLid, bool value) {
+    load(db);
+    QMutexLocker locker(&mutex);
+    if (value)
+        entries.insert(searchLid, Entry());
+    else
+        entries.remove(searchLid);
+}
+
+
+
+void MaterializedSearches::remove(qint32 searchLid) {
+    QMutexLocker locker(&mutex);
+    entries.remove(searchLid);
+}
+
+
+
+// A note or resource was written.  It is checked against every search
+// the next time they are refreshed.
+void MaterializedSearches::noteChanged(qint32 lid) {
+    if (lid <= 0)
+        return;
+    QMutexLocker locker(&mutex);
+    for (QHash<qint32, Entry>::iterator i = entries.begin(); i != entries.end(); ++i)
+        i.value().pending.add(lid);
+}
+
+
+
+// Tag or notebook names changed.  Searches by name can match different
+// notes without any note being written, so they all have to run again.
+void MaterializedSearches::invalidate() {
+    QMutexLocker locker(&mutex);
+    for (QHash<qint32, Entry>::iterator i = entries.begin(); i != entries.end(); ++i)
+        i.value().rebuild = true;
+}
+
+
+
+// Bring the matches of a search up to date.  Only the notes changed since
+// the last time are checked unless the statement is new or too many of
+// them changed.  Changed resources are checked through their note.  This
+// is run by the CounterRunner with its own connection.
+bool MaterializedSearches::refresh(DatabaseConnection *db, qint32 searchLid, QString statement, QList<QVariant> values) {
+    load(db);
+    QString newSignature = signature(statement, values);
+
+    LidBitmap changed;
+    bool full;
+    mutex.lock();
+    if (!entries.contains(searchLid) || entries[searchLid].checking || entries[searchLid].failed == newSignature) {
+        mutex.unlock();
+        return false;
+    }
+    Entry &entry = entries[searchLid];
+    full = entry.rebuild || entry.verify || entry.signature != newSignature
+            || entry.pending.size() > MATERIALIZEDSEARCH_MAX_CHECK;
+    if (!full && entry.pending.isEmpty()) {
+        mutex.unlock();
+        return true;
+    }
+    changed = entry.pending;
+    entry.pending.clear();
+    entry.rebuild = false;
+    entry.verify = false;
+    entry.checking = true;
+    entry.total = -1;
+    mutex.unlock();
+
+    QTime timer;
+    timer.start();
+    NSqlQuery sql(db);
+    QList<qint32> checked;
+    if (!full) {
+        checked = changed.toList();
+        QStringList marks;
+        for (int i=0; i<checked.size(); i++)
+            marks.append("?");
+        db->lockForRead();
+        sql.prepare("Select distinct data from DataStore where key=? and lid in (" + marks.join(",") + ")");
+        sql.addBindValue(RESOURCE_NOTE_LID);
+        for (int i=0; i<checked.size(); i++)
+            sql.addBindValue(checked[i]);
+        sql.exec();
+        while (sql.next())
+            changed.add(sql.value(0).toInt());
+        sql.finish();
+        db->unlock();
+        checked = changed.toList();
+    }
+
+    QHash<qint32, double> found;
+    bool ok = true;
+    if (statement != "") {
+        QString text = statement;
+        if (!full) {
+            QStringList marks;
+            for (int i=0; i<checked.size(); i++)
+                marks.append("?");
+            text = "select * from (" + statement + ") where lid in (" + marks.join(",") + ")";
+        }
+        db->lockForRead();
+        sql.prepare(text);
+        for (int i=0; i<values.size(); i++)
+            sql.addBindValue(values[i]);
+        for (int i=0; i<checked.size() && !full; i++)
+            sql.addBindValue(checked[i]);
+        ok = sql.exec();
+        if (!ok)
+            QLOG_ERROR() << "Materialized search " << searchLid << " failed: " << sql.lastError();
+        while (ok && sql.next())
+            found.insert(sql.value(0).toInt(), sql.value(1).toDouble());
+        sql.finish();
+        db->unlock();
+    }
+
+    SearchTable table(db);
+    if (ok && full)
+        ok = table.setMatches(searchLid, newSignature, found);
+    else if (ok)
+        ok = table.updateMatches(searchLid, checked, found);
+
+    QMutexLocker locker(&mutex);
+    if (!entries.contains(searchLid))
+        return ok;
+    Entry &current = entries[searchLid];
+    current.checking = false;
+    if (!ok) {
+        current.failed = newSignature;
+        current.rebuild = true;
+        return false;
+    }
+    if (full) {
+        current.matches.clear();
+        current.relevance.clear();
+        current.signature = newSignature;
+    } else {
+        for (int i=0; i<checked.size(); i++) {
+            current.matches.remove(checked[i]);
+            current.relevance.remove(checked[i]);
+        }
+    }
+    for (QHash<qint32, double>::const_iterator i = found.constBegin(); i != found.constEnd(); ++i) {
+        current.matches.add(i.key());
+        current.relevance.insert(i.key(), i.value());
+    }
+    QLOG_DEBUG() << "Materialized search " << searchLid << (full ? " rebuilt: " : " updated: ")
+                 << found.size() << " matches in " << timer.elapsed() << "ms";
+    return true;
+}
+
+
+
+// The number of notes the search finds.  The indexed bitmap is from
+// compiling the search now, so the notebook, tag & trash parts are
+// always current.
+qint32 MaterializedSearches::count(qint32 searchLid, const LidBitmap &indexed) {
+    QMutexLocker locker(&mutex);
+    QHash<qint32, Entry>::const_iterator i = entries.constFind(searchLid);
+    if (i == entries.constEnd())
+        return -1;
+    if (i.value().rebuild)
+        return -1;
+    LidBitmap retval = i.value().matches;
+    retval &= indexed;
+    return retval.size();
+}
+
+
+
+// Keep the count the CounterRunner worked out, so it can be shown again
+// without compiling the search.
+void MaterializedSearches::setTotal(qint32 searchLid, qint32 total) {
+    QMutexLocker locker(&mutex);
+    QHash<qint32, Entry>::iterator i = entries.find(searchLid);
+    if (i == entries.end() || i.value().checking)
+        return;
+    i.value().total = total;
+    i.value().totalDate = QDate::currentDate();
+}
+
+
+
+// The kept count.  It is only good if nothing changed since it was made
+// and it is still the same day.
+qint32 MaterializedSearches::total(qint32 searchLid) {
+    QMutexLocker locker(&mutex);
+    QHash<qint32, Entry>::const_iterator i = entries.constFind(searchLid);
+    if (i == entries.constEnd())
+        return -1;
+    const Entry &entry = i.value();
+    if (entry.checking || entry.rebuild || entry.verify || !entry.pending.isEmpty()
+            || entry.totalDate != QDate::currentDate())
+        return -1;
+    return entry.total;
+}
+
+
+
+// Answer a compiled search from the kept matches.  This is only done if
+// the search is the one they were found with & every change has been
+// checked.  Pinned notes aren't added.
+bool MaterializedSearches::get(DatabaseConnection *db, qint32 searchLid, QString statement, QList<QVariant> values,
+                               const LidBitmap &indexed, QList<qint32> &lids, QList<double> &relevance) {
+    if (statement == "")
+        return false;
+    load(db);
+    QString wanted = signature(statement, values);
+
+    QMutexLocker locker(&mutex);
+    QHash<qint32, Entry>::const_iterator i = entries.constFind(searchLid);
+    if (i == entries.constEnd())
+        return false;
+    const Entry &entry = i.value();
+    if (entry.checking || entry.rebuild || !entry.pending.isEmpty() || entry.signature != wanted)
+        return false;
+
+    LidBitmap hits = entry.matches;
+    hits &= indexed;
+    lids = hits.toList();
+    relevance.clear();
+    relevance.reserve(lids.size());
+    for (int j=0; j<lids.size(); j++)
+        relevance.append(entry.relevance.value(lids[j]));
+    return true;
+}
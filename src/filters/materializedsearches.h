@@ -0,0 +1,93 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef MATERIALIZEDSEARCHES_H
+#define MATERIALIZEDSEARCHES_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVariant>
+
+#include "lidbitmap.h"
+
+//****************************************************
+//* Saved searches whose matching notes are kept so
+//* selecting them doesn't search again.  Only the
+//* SQL part of the compiled search is kept.  The
+//* notebook, tag & trash parts come from the
+//* FilterIndex bitmaps, which are always current,
+//* & are ANDed with it whenever it is used.
+//*
+//* NoteTable & SearchIndexTable report every note
+//* they change.  The CounterRunner then checks just
+//* those notes against the statement again & keeps
+//* the count shown next to the search, which is
+//* reused until a note changes.  Renaming a tag or
+//* notebook (or a new statement, as with relative
+//* dates) runs the whole search again.
+//****************************************************
+
+class DatabaseConnection;
+
+#define MATERIALIZEDSEARCH_MAX_CHECK   300      // More changed notes than this & the whole search is run
+
+class MaterializedSearches
+{
+private:
+    struct Entry {
+        QString signature;                  // Statement & values the matches were found with
+        QString failed;                     // Signature of a statement that didn't run
+        LidBitmap matches;                  // Notes the statement matched
+        QHash<qint32, double> relevance;
+        LidBitmap pending;                  // Notes & resources changed since the last check
+        bool rebuild;                       // The matches can't be used until the search is run again
+        bool verify;                        // Run the search again, but the matches can be used
+        bool checking;                      // refresh() is running
+        qint32 total;                       // Last count, -1 if not counted since the last refresh
+        QDate totalDate;                    // Day the count was made.  Relative dates move.
+        Entry() { rebuild = true; verify = false; checking = false; total = -1; }
+    };
+    QMutex mutex;
+    bool loaded;
+    QHash<qint32, Entry> entries;
+
+    void load(DatabaseConnection *db);
+
+public:
+    MaterializedSearches();
+    static QString signature(QString statement, QList<QVariant> values);
+    QList<qint32> searches(DatabaseConnection *db);              // Every materialized search
+    bool hasPending();                                          // Are there changes not checked yet?
+    void setMaterialized(DatabaseConnection *db, qint32 searchLid, bool value);
+    void remove(qint32 searchLid);                              // Search expunged
+    void noteChanged(qint32 lid);                               // A note or resource was written
+    void invalidate();                                          // Tag or notebook names changed
+
+    bool refresh(DatabaseConnection *db, qint32 searchLid, QString statement, QList<QVariant> values);
+    qint32 count(qint32 searchLid, const LidBitmap &indexed);   // -1 if the matches aren't known
+    void setTotal(qint32 searchLid, qint32 total);              // Keep the count shown for the search
+    qint32 total(qint32 searchLid);                             // -1 if it has to be counted again
+    bool get(DatabaseConnection *db, qint32 searchLid, QString statement, QList<QVariant> values,
+             const LidBitmap &indexed, QList<qint32> &lids, QList<double> &relevance);
+};
+
+#endif // MATERIALIZEDSEARCHES_H
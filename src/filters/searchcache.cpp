@@ -0,0 +1,84 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "searchcache.h"
+
+#include <QMutexLocker>
+
+
+// Constructor
+SearchCache::SearchCache()
+{
+    entries.setMaxCost(SEARCHCACHE_MAX_ROWS);
+}
+
+
+
+qint32 SearchCache::currentGeneration() {
+    return generation.loadAcquire();
+}
+
+
+// Something searches look at was written.  Every entry found before now
+// is stale.
+void SearchCache::dataChanged() {
+    generation.ref();
+}
+
+
+
+// Look up the results for a key.  Entries found before the last write
+// are dropped.
+bool SearchCache::get(QString key, QList<qint32> &lids, QList<double> &relevance) {
+    QMutexLocker locker(&mutex);
+    Entry *entry = entries.object(key);
+    if (entry == nullptr)
+        return false;
+    if (entry->generation != generation.loadAcquire()) {
+        entries.remove(key);
+        return false;
+    }
+    lids = entry->lids;
+    relevance = entry->relevance;
+    return true;
+}
+
+
+
+// Save the results of a search.  foundAt is the generation when the search
+// started, so anything written while it ran makes the entry stale.  The
+// cost is the number of notes, so a few huge result sets can't push the
+// cache over SEARCHCACHE_MAX_ROWS.
+void SearchCache::put(QString key, qint32 foundAt, const QList<qint32> &lids, const QList<double> &relevance) {
+    if (foundAt != generation.loadAcquire())
+        return;
+    Entry *entry = new Entry();
+    entry->generation = foundAt;
+    entry->lids = lids;
+    entry->relevance = relevance;
+    QMutexLocker locker(&mutex);
+    entries.insert(key, entry, lids.size()+1);
+}
+
+
+
+void SearchCache::clear() {
+    QMutexLocker locker(&mutex);
+    entries.clear();
+}
@@ -0,0 +1,64 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include <QCache>
+#include <QList>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QString>
+
+//****************************************************
+//* Results of recent searches, so going back to a
+//* notebook, tag or saved search (or back & forward
+//* through the history) doesn't search again.
+//* Entries are keyed by FilterEngine::cacheKey() &
+//* remember the data generation they were found at.
+//* Writes to notes, tags, notebooks & the search
+//* index bump the generation (see NoteTable, TagTable,
+//* NotebookTable & SearchIndexTable), so an entry is
+//* only used if nothing it depends on changed since.
+//****************************************************
+
+#define SEARCHCACHE_MAX_ROWS    500000      // Total lids kept over every entry
+
+class SearchCache
+{
+private:
+    struct Entry {
+        qint32 generation;
+        QList<qint32> lids;
+        QList<double> relevance;
+    };
+    QMutex mutex;
+    QCache<QString, Entry> entries;
+    QAtomicInt generation;
+
+public:
+    SearchCache();
+    qint32 currentGeneration();
+    void dataChanged();                                 // Called after a write searches depend on
+    bool get(QString key, QList<qint32> &lids, QList<double> &relevance);
+    void put(QString key, qint32 foundAt, const QList<qint32> &lids, const QList<double> &relevance);
+    void clear();
+};
+
+#endif // SEARCHCACHE_H
@@ -0,0 +1,119 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "searchhighlight.h"
+#include "filterengine.h"
+#include "filterquerycompiler.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/searchindextable.h"
+
+#include <QRegExp>
+
+extern Global global;
+
+#define SEARCHHIGHLIGHT_START   QChar(0x01)     // Markers highlight() puts around a match
+#define SEARCHHIGHLIGHT_END     QChar(0x02)
+
+
+// The search string is the one the note list was found with
+SearchHighlight::SearchHighlight(QString searchString)
+{
+    match = FilterQueryCompiler::matchTerms(searchString).join(" OR ");
+    minimumWeight = global.getMinimumRecognitionWeight();
+
+    searchString = searchString.trimmed();
+    if (searchString.startsWith("any:", Qt::CaseInsensitive))
+        searchString = searchString.mid(4);
+    QStringList list;
+    FilterEngine::splitSearchTerms(list, searchString);
+    for (int i=0; i<list.size(); i++) {
+        QString word = list[i];
+        word.remove(QChar('"'));
+        word.remove(QChar('*'));
+        if (word == "" || word.startsWith("-") || word.indexOf(":") > 0)
+            continue;
+        if (!words.contains(word, Qt::CaseInsensitive))
+            words.append(word);
+    }
+}
+
+
+
+bool SearchHighlight::isEmpty() {
+    return match == "" && words.isEmpty();
+}
+
+
+
+// The words SearchIndex matched in every row of a note's text or of a
+// resource.  The rows of a lid are one rowid range, so this only reads
+// that lid's rows.
+QStringList SearchHighlight::hits(qint32 lid) {
+    QStringList hits;
+    if (match == "")
+        return hits;
+
+    NSqlQuery query(global.db);
+    global.db->lockForRead();
+    query.prepare("select highlight(SearchIndex, 2, char(1), char(2)) from SearchIndex "
+                  "where rowid between :first and :last and weight>=:weight and content match :match");
+    query.bindValue(":first", SearchIndexTable::firstRowid(lid));
+    query.bindValue(":last", SearchIndexTable::lastRowid(lid));
+    query.bindValue(":weight", minimumWeight);
+    query.bindValue(":match", match);
+    if (!query.exec())
+        QLOG_ERROR() << "Search highlight failed: " << query.lastError();
+    while (query.next())
+        addMarked(query.value(0).toString(), hits);
+    query.finish();
+    global.db->unlock();
+    return hits;
+}
+
+
+
+// The note text hits plus the words that were typed
+QStringList SearchHighlight::textHits(qint32 noteLid) {
+    QStringList hits = this->hits(noteLid);
+    for (int i=0; i<words.size(); i++) {
+        if (!hits.contains(words[i], Qt::CaseInsensitive))
+            hits.append(words[i]);
+    }
+    return hits;
+}
+
+
+
+// Pull the marked words out of a highlight() result.  Neighbouring matches
+// are marked as one span, so spans are split into words.
+void SearchHighlight::addMarked(QString text, QStringList &hits) {
+    qint32 start = text.indexOf(SEARCHHIGHLIGHT_START);
+    while (start != -1) {
+        qint32 end = text.indexOf(SEARCHHIGHLIGHT_END, start+1);
+        if (end == -1)
+            return;
+        QStringList marked = text.mid(start+1, end-start-1).split(QRegExp("\\s+"), QString::SkipEmptyParts);
+        for (int i=0; i<marked.size(); i++) {
+            if (!hits.contains(marked[i], Qt::CaseInsensitive))
+                hits.append(marked[i]);
+        }
+        start = text.indexOf(SEARCHHIGHLIGHT_START, end+1);
+    }
+}
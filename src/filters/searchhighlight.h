@@ -0,0 +1,54 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef SEARCHHIGHLIGHT_H
+#define SEARCHHIGHLIGHT_H
+
+#include <QString>
+#include <QStringList>
+
+//****************************************************
+//* The words to highlight in a note for the current
+//* search.  The search words go to SearchIndex with
+//* highlight(), so the words marked are the ones the
+//* index matched (a prefix search marks the whole
+//* word) & the browser never has to search the text
+//* or the recognition data itself.  The words typed
+//* in the search are added for the note text, so
+//* anything the index can't match (postfix searches,
+//* hyphens) is still found by the browser's find.
+//****************************************************
+
+class SearchHighlight
+{
+private:
+    QString match;              // FTS5 query for the search words, "" if there are none
+    QStringList words;          // Words as they were typed
+    qint32 minimumWeight;       // Minimum recognition weight for a hit
+
+    static void addMarked(QString text, QStringList &hits);
+
+public:
+    SearchHighlight(QString searchString);
+    bool isEmpty();                                 // Nothing to highlight
+    QStringList hits(qint32 lid);                   // Indexed words matched in a note or resource
+    QStringList textHits(qint32 noteLid);           // Words to find in the note text
+};
+
+#endif // SEARCHHIGHLIGHT_H
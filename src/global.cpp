@@ -94,6 +94,7 @@ Global::Global() {
     this->forceStartMinimized = false;
     this->globalSettings = nullptr;
     this->disableUploads = false;
+    this->auditQueryPlans = false;
     this->enableIndexing = false;
     this->disableThumbnails = false;
     this->defaultGuiFont = "";
@@ -158,6 +159,7 @@ void Global::setup(StartupConfig startupConfig, bool guiAvailable) {
 
     settings->beginGroup(INI_GROUP_DEBUGGING);
     disableUploads = settings->value("disableUploads", false).toBool();
+    auditQueryPlans = settings->value("auditQueryPlans", false).toBool();
     nonAsciiSortBug = settings->value("nonAsciiSortBug", false).toBool();
     settings->endGroup();
 
@@ -201,7 +203,7 @@ void Global::setup(StartupConfig startupConfig, bool guiAvailable) {
 
     minIndexInterval = 5000;
     maxIndexInterval = 120000;
-    indexResourceCountPause = 2;
+    indexResourceCountPause = 10;
     indexNoteCountPause = 100;
     isFullscreen = false;
     indexPDFLocally = getIndexPDFLocally();
@@ -517,6 +519,22 @@ bool Global::getBackgroundIndexing() {
 }
 
 
+// Threads the background indexer extracts text with.  0 picks one per CPU.
+int Global::getIndexThreads() {
+    settings->beginGroup(INI_GROUP_SEARCH);
+    int value = settings->value("indexThreads", 0).toInt();
+    settings->endGroup();
+    return qMax(0, value);
+}
+
+
+void Global::setIndexThreads(int value) {
+    settings->beginGroup(INI_GROUP_SEARCH);
+    settings->setValue("indexThreads", value);
+    settings->endGroup();
+}
+
+
 void Global::setBackgroundIndexing(bool value) {
     settings->beginGroup(INI_GROUP_SEARCH);
     settings->setValue("backgroundIndexing", value);
@@ -532,6 +550,34 @@ bool Global::getTagSelectionOr() {
 }
 
 
+void Global::setIncludeChildTags(bool value) {
+    settings->beginGroup(INI_GROUP_SEARCH);
+    settings->setValue("includeChildTags", value);
+    settings->endGroup();
+}
+
+bool Global::getIncludeChildTags() {
+    settings->beginGroup(INI_GROUP_SEARCH);
+    bool value = settings->value("includeChildTags", false).toBool();
+    settings->endGroup();
+    return value;
+}
+
+
+void Global::setLegacyFilterEngine(bool value) {
+    settings->beginGroup(INI_GROUP_SEARCH);
+    settings->setValue("legacyFilterEngine", value);
+    settings->endGroup();
+}
+
+bool Global::getLegacyFilterEngine() {
+    settings->beginGroup(INI_GROUP_SEARCH);
+    bool value = settings->value("legacyFilterEngine", false).toBool();
+    settings->endGroup();
+    return value;
+}
+
+
 void Global::setIndexPDFLocally(bool value) {
     settings->beginGroup(INI_GROUP_SEARCH);
     settings->setValue("indexPDFLocally", value);
@@ -1474,6 +1520,10 @@ bool Global::isForceSearchWithoutDiacritics() const
 
 /**
  * Normalize term before search or index process,
+ * The search index's tokenizer folds case & diacritics itself, so
+ * this is only needed for the content column: substring searches run
+ * it through LIKE & the trigram index, which fold neither diacritics
+ * nor (before the trigrams are built) non-ASCII case.
  * @param s String to process.
  * @return Normalized representation.
  */
@@ -46,6 +46,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/settings/accountsmanager.h"
 #include "src/reminders/remindermanager.h"
 #include "src/sql/databaseconnection.h"
+#include "src/sql/identitymap.h"
+#include "src/filters/filterindex.h"
+#include "src/filters/searchcache.h"
+#include "src/filters/materializedsearches.h"
 #include "src/threads/indexrunner.h"
 #include "src/utilities/crossmemorymapper.h"
 #include "src/exits/exitpoint.h"
@@ -213,6 +217,7 @@ public:
     CountBehavior countBehavior;   // How does the user want tags/notebooks to be counted.
 
     bool disableUploads;           // Should we disable all uploads to Evernote?  Useful for testing.
+    bool auditQueryPlans;          // Log SQL statements that do a full table scan.  Useful for testing.
 
     // Valid values for the note list appearance.  Should it be a narrow or wide list
     enum ListViewSetup {
@@ -276,6 +281,8 @@ public:
     void setPopupOnSyncError(bool value);    // Set if we should do a popup on sync errors.
     void setBackgroundIndexing(bool value);                         // Should we do indexing in a separate thread?
     bool getBackgroundIndexing();                         // Should we do indexing in a separate thread?
+    void setIndexThreads(int value);                      // Threads extracting text for the index.  0 is one per CPU.
+    int getIndexThreads();
     DatabaseConnection *db;                               // "default" DB connection for the main thread.
     bool javaFound;                                       // Have we found Java?
     bool forceUTF8;                                       // force UTF8 encoding
@@ -301,6 +308,10 @@ public:
     qint32 filterPosition;
 
     QReadWriteLock  *dbLock;                               // Database read/write lock mutex
+    IdentityMap identityMap;                               // GUID <-> LID lookups without a database round trip
+    FilterIndex filterIndex;                               // Notebook, tag & flag bitmaps for the filters
+    SearchCache searchCache;                               // Recent search results
+    MaterializedSearches materializedSearches;             // Kept matches of saved searches
 
     QHash<qint32, NoteCache*> cache;                         // Note cache  used to keep from needing to re-format the same note for a display
 
@@ -346,6 +357,10 @@ public:
     bool getClearSearchOnNotebook();
     bool getClearTagsOnSearch();
     bool getTagSelectionOr();
+    void setIncludeChildTags(bool value);                   // Selecting a tag also selects its children
+    bool getIncludeChildTags();
+    void setLegacyFilterEngine(bool value);                 // Filter with the old multi-pass engine
+    bool getLegacyFilterEngine();
     bool disableImageHighlight();
 
 
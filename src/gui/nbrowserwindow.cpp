@@ -50,6 +50,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/utilities/pixelconverter.h"
 #include "src/gui/browserWidgets/table/tablepropertiesdialog.h"
 #include "src/exits/exitmanager.h"
+#include "src/filters/searchhighlight.h"
 #include "browserWidgets/editorbuttonbar.h"
 
 #include <QPlainTextEdit>
@@ -469,12 +470,9 @@ void NBrowserWindow::setContent(qint32 lid) {
     bool inkNote = false;
     bool readOnly = false;
 
-    // If we are searching, we never pull from the cache since the search string may
-    // have changed since the last time.
+    // The cache never has search highlights in it.  They are added to the
+    // page afterwards, so a note opened while searching still uses it.
     FilterCriteria *criteria = global.getCurrentCriteria();
-    if (criteria->isSearchStringSet() && criteria->getSearchString().trimmed() != "") {
-        global.cache.remove(lid);
-    }
 
     QLOG_DEBUG() << "Checking if note is in cache, lid=" << this->lid;
     if (global.cache.contains(lid)) {
@@ -494,27 +492,33 @@ void NBrowserWindow::setContent(qint32 lid) {
     if (!global.cache.contains(lid)) {
         QLOG_DEBUG() << "Note not in cache, lid=" << this->lid;
         NoteFormatter formatter;
-        if (criteria->isSearchStringSet())
-            formatter.setHighlightText(criteria->getSearchString());
-
         formatter.setNote(n, global.pdfPreview);
         //formatter.setHighlight();
 
         QLOG_DEBUG() << "Rebuilding note HTML, lid=" << this->lid;
         content = formatter.rebuildNoteHTML();
-        if (!criteria->isSearchStringSet()) {
-            QLOG_DEBUG() << "Criteria search string set";
-            NoteCache *newCache = new NoteCache();
-            newCache->isReadOnly = formatter.readOnly;
-            newCache->isInkNote = formatter.inkNote;
-            newCache->noteContent = content;
-            QLOG_DEBUG() << "Adding to cache";
-            global.cache.insert(lid, newCache);
-        }
+        NoteCache *newCache = new NoteCache();
+        newCache->isReadOnly = formatter.readOnly;
+        newCache->isInkNote = formatter.inkNote;
+        newCache->noteContent = content;
+        newCache->images = formatter.images;
+        newCache->attachments = formatter.attachments;
+        QLOG_DEBUG() << "Adding to cache";
+        global.cache.insert(lid, newCache);
         readOnly = formatter.readOnly;
         inkNote = formatter.inkNote;
     }
 
+    // Highlight what the search found.  The words come from the search index,
+    // so prefix searches mark the whole word.
+    QStringList highlightWords;
+    if (criteria->isSearchStringSet() && criteria->getSearchString().trimmed() != "") {
+        SearchHighlight highlight(criteria->getSearchString());
+        highlightWords = highlight.textHits(lid);
+        NoteFormatter formatter;
+        content = formatter.addHighlight(content, global.cache.value(lid), highlight);
+    }
+
     setReadOnly(readOnly);
 
     QLOG_DEBUG() << "Setting note title";
@@ -611,11 +615,8 @@ void NBrowserWindow::setContent(qint32 lid) {
     QLOG_DEBUG() << "Calling set source, lid=" << this->lid;
     setSource();
 
-    if (criteria->isSearchStringSet()) {
-        QStringList list = criteria->getSearchString().split(" ");
-        for (int i = 0; i < list.size(); i++) {
-            editor->page()->findText(list[i], QWebPage::HighlightAllOccurrences);
-        }
+    for (int i = 0; i < highlightWords.size(); i++) {
+        editor->page()->findText(highlightWords[i], QWebPage::HighlightAllOccurrences);
     }
 
     QLOG_DEBUG() << "Checking thumbnail, lid=" << this->lid;
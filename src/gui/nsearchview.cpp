@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "nsearchview.h"
 #include "src/global.h"
 #include "nsearchviewitem.h"
+#include "nsearchviewdelegate.h"
 #include "src/dialog/savedsearchproperties.h"
 #include "src/sql/searchtable.h"
 #include "src/gui/treewidgeteditor.h"
@@ -55,6 +56,7 @@ NSearchView::NSearchView(QWidget *parent) :
     this->setRootIsDecorated(true);
     this->setSortingEnabled(false);
     this->header()->setVisible(false);
+    setItemDelegate(new NSearchViewDelegate());
 
     // Build the root item
     QIcon icon = global.getIconResource(":searchIcon");
@@ -374,6 +376,8 @@ void NSearchView::addRequested() {
     this->sortByColumn(NAME_POSITION);
 
     dataStore.insert(lid, newWidget);
+    if (dialog.materialized.isChecked())
+        emit updateCounts();
 }
 
 
@@ -392,6 +396,22 @@ void NSearchView::propertiesRequested() {
     if (!dialog.okPressed)
         return;
     items[0]->setData(NAME_POSITION, Qt::DisplayRole, dialog.name.text().trimmed());
+    ((NSearchViewItem*)items[0])->total = -1;
+    if (dialog.materialized.isChecked())
+        emit updateCounts();
+}
+
+
+
+//*************************************************************
+// The number of notes a materialized search finds has been
+// counted.
+//*************************************************************
+void NSearchView::updateTotals(qint32 lid, qint32 total) {
+    if (dataStore.contains(lid) && dataStore[lid] != nullptr) {
+        dataStore[lid]->total = total;
+        viewport()->update();
+    }
 }
 
 
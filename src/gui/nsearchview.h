@@ -75,10 +75,12 @@ public:
 signals:
     void updateSelectionRequested();
     void searchDeleted(qint32);
+    void updateCounts();
 
 public slots:
     void searchUpdated(qint32 lid, QString name);
     void searchExpunged(qint32 lid);
+    void updateTotals(qint32 lid, qint32 total);
     void buildSelection();
     void updateSelection();
     void addRequested();
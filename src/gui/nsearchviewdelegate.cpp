@@ -0,0 +1,67 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "nsearchviewdelegate.h"
+#include "nsearchview.h"
+#include "nsearchviewitem.h"
+#include "src/global.h"
+
+#include <QPainter>
+
+extern Global global;
+
+NSearchViewDelegate::NSearchViewDelegate(QObject *parent) :
+    QStyledItemDelegate(parent)
+{
+}
+
+
+
+void NSearchViewDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
+    QStyleOptionViewItem options = option;
+    initStyleOption(&options, index);
+
+    options.widget->style()->drawControl(QStyle::CE_ItemViewItem, &options, painter);
+
+    if (global.countBehavior == Global::CountNone) {
+        return;
+    }
+
+    // Only materialized searches have a count
+    qint32 lid = index.data(Qt::UserRole).toInt();
+    NSearchView *tree = (NSearchView *) options.widget;
+    if (lid <= 0 || !tree->dataStore.contains(lid) || tree->dataStore[lid]->total < 0)
+        return;
+
+    painter->save();
+    QString countString = QString("(") + QString::number(tree->dataStore[lid]->total) + QString(")");
+
+    QSize iconSize = options.icon.actualSize(options.rect.size());
+    painter->translate(options.rect.left() + iconSize.width(), options.rect.top());
+    QRect clip(0, 0, options.rect.width() + iconSize.width(), options.rect.height());
+
+    painter->setClipRect(clip);
+    QFontMetrics fm = options.fontMetrics;
+    QFont f = options.font;
+    f.setBold(false);
+    painter->setFont(f);
+    painter->setPen(Qt::darkGray);
+    painter->drawText(10 + fm.width(index.data().toString() + QString(" ")), fm.ascent(), countString);
+    painter->restore();
+}
@@ -19,9 +19,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "nsearchviewitem.h"
 
-NSearchViewItem::NSearchViewItem(QTreeWidget* parent):QTreeWidgetItem(parent){}
+NSearchViewItem::NSearchViewItem(QTreeWidget* parent):QTreeWidgetItem(parent){
+    total = -1;
+}
 
-NSearchViewItem::NSearchViewItem():QTreeWidgetItem(){}
+NSearchViewItem::NSearchViewItem():QTreeWidgetItem(){
+    total = -1;
+}
 
 
 bool NSearchViewItem::operator<(const QTreeWidgetItem &other)const {
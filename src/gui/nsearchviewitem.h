@@ -28,6 +28,7 @@ public:
     explicit NSearchViewItem(QTreeWidget* parent);
     explicit NSearchViewItem();
     void setRootColor(bool value);
+    qint32 total;                       // Notes a materialized search finds, -1 if not known
 
     bool operator<(const QTreeWidgetItem &other)const;
 
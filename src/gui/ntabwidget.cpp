@@ -543,10 +543,13 @@ void NTabWidget::noteContentEdited(QString uuid, qint32 lid, QString content) {
         }
     }
 
-    // Invalidate the cache (if needed)
+    // Invalidate the cache (if needed).  While searching, the edited page has
+    // the search highlights in it, so it can't replace the cached one.
     if (global.cache.contains(lid)) {
         NoteCache *cache = global.cache[lid];
-        if (cache != nullptr)
+        FilterCriteria *criteria = global.getCurrentCriteria();
+        bool searching = criteria->isSearchStringSet() && criteria->getSearchString().trimmed() != "";
+        if (cache != nullptr && !searching)
             cache->noteContent = content.toUtf8();
         else
             global.cache.remove(lid);
@@ -254,13 +254,24 @@ void NTagView::loadData() {
     }
 
     NSqlQuery query(global.db);
-    TagTable tagTable(global.db);
-    query.exec("Select lid, name, parent_gid, account from TagModel order by name");
+    // The parent comes from the tag hierarchy, so this is one pass of indexed joins
+    query.prepare("Select t.lid, n.data, c.ancestor, g.data, a.data from DataStore t "
+                  "left join DataStore n on n.lid=t.lid and n.key=:nameKey "
+                  "left join TagClosure c on c.descendant=t.lid and c.depth=1 "
+                  "left join DataStore g on g.lid=c.ancestor and g.key=:guidKey "
+                  "left join DataStore a on a.lid=t.lid and a.key=:accountKey "
+                  "where t.key=:guidKey2 order by n.data");
+    query.bindValue(":nameKey", TAG_NAME);
+    query.bindValue(":guidKey", TAG_GUID);
+    query.bindValue(":accountKey", TAG_OWNING_ACCOUNT);
+    query.bindValue(":guidKey2", TAG_GUID);
+    query.exec();
     while (query.next()) {
         qint32 lid = query.value(0).toInt();
         QString name = query.value(1).toString();
-        QString parentGid = query.value(2).toString();
-        qint32 account = query.value(3).toInt();
+        qint32 parentLid = query.value(2).toInt();
+        QString parentGid = query.value(3).toString();
+        qint32 account = query.value(4).toInt();
 
         NTagViewItem *newWidget = new NTagViewItem();
         newWidget->setData(NAME_POSITION, Qt::DisplayRole, name);
@@ -272,7 +283,7 @@ void NTagView::loadData() {
             newWidget->setHidden(false);
         this->dataStore.insert(lid, newWidget);
         newWidget->parentGuid = parentGid;
-        newWidget->parentLid = tagTable.getLid(parentGid);
+        newWidget->parentLid = parentLid;
         root->addChild(newWidget);
     }
     query.finish();
@@ -25,7 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/linkednotebooktable.h"
 #include "src/global.h"
 #include "src/filters/filtercriteria.h"
-#include "src/filters/filterengine.h"
+#include "src/filters/searchhighlight.h"
+#include "src/sql/searchtokenizer.h"
 #include "src/utilities/mimereference.h"
 #include "enmlformatter.h"
 
@@ -44,6 +45,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <QIcon>
 #include <QList>
+#include <QXmlStreamReader>
 
 
 #include <iostream>
@@ -63,7 +65,6 @@ NoteFormatter::NoteFormatter(QObject *parent) :
     this->formatError = false;
     this->inkNote = false;
     this->resourceError = false;
-    this->resourceHighlight = false;
 }
 
 
@@ -133,6 +134,8 @@ QByteArray NoteFormatter::rebuildNoteHTML() {
 
     formatError = false;
     readOnly = false;
+    images.clear();
+    attachments.clear();
 
     ResourceTable resTable(global.db);
     if (!haveGuid) {
@@ -338,31 +341,15 @@ void NoteFormatter::modifyTags(QWebPage &doc) {
 }
 
 
-/* This function works the same as the addHighlight, but instead of highlighting
-  text in a note, it highlights the text in an image. */
-QString NoteFormatter::addImageHighlight(qint32 resLid, QString imgfile) {
+/* Highlight the words the search found in an image.  The boxes are the
+  image's recognition data, read once & kept with the cached note. */
+QString NoteFormatter::addImageHighlight(qint32 resLid, QString imgfile, const QList<RecognitionBox> &boxes,
+                                         const QStringList &hits) {
     QLOG_TRACE_IN();
-    if (highlightWords.size() == 0)
+    if (hits.size() == 0 || boxes.size() == 0)
         return "";
 
-    // Get the image resource recognition data.  This tells where to highlight the image
-    ResourceTable resTable(global.db);
-    Resource recoResource;
-    resTable.getResourceRecognition(recoResource, resLid);
-    Data recognition;
-    if (recoResource.recognition.isSet())
-        recognition = recoResource.recognition;
-    if (!recognition.size.isSet() || !recognition.body.isSet() ||
-        recognition.size == 0) {
-        return "";
-    }
-
     QString filename = global.fileManager.getTmpDirPath() + QString::number(resLid) + ".png";
-    // Now we have the recognition data.  We need to go through it
-    QByteArray recoData;
-    if (recognition.body.isSet())
-        recoData = recognition.body;
-    QString xml(recoData);
 
     // Create a transparent pixmap.  The only non transparent piece is the
     // highlight that will be overlaid on the old image
@@ -377,50 +364,24 @@ QString NoteFormatter::addImageHighlight(qint32 resLid, QString imgfile) {
     QColor yellow(Qt::yellow);
     p2.setBrush(yellow);
 
-    // Now, we have the image.  We need to go through all the recognition data to highlight
-    // what we've found.
-    QDomDocument doc;
-    doc.setContent(xml);
-
-    // Go through the "item" nodes
+    // Highlight every box with a candidate word containing one of the hits
     bool found = false;
-    QDomNodeList anchors = doc.elementsByTagName("item");
-#if QT_VERSION < 0x050000
-    for (unsigned int i = 0; i < anchors.length(); i++) {
-#else
-    for (int i = 0; i < anchors.length(); i++) {
-#endif
-        QDomElement element = anchors.at(i).toElement();
-        int x = element.attribute("x").toInt();
-        int y = element.attribute("y").toInt();
-        int w = element.attribute("w").toInt();
-        int h = element.attribute("h").toInt();
-
-        // Get all children ("t" nodes)
-        QDomNodeList children = element.childNodes();
-#if QT_VERSION < 0x050000
-        for (unsigned int j = 0; j < children.length(); j++) {
-#else
-        for (int j = 0; j < children.length(); j++) {
-#endif
-            QDomElement child = children.at(j).toElement();
-            if (child.nodeName().toLower() == "t") {
-                QString text = child.text();
-                int weight = child.attribute("w").toInt(); // Image weight
-                if (weight >= global.getMinimumRecognitionWeight()) {
-
-                    // Check to see if this word matches something we're looking for
-                    for (int k = 0; k < highlightWords.size(); k++) {
-                        QString searchWord = highlightWords[k].toLower();
-                        if (searchWord.endsWith("*"))
-                            searchWord.chop(1);
-                        if (text.toLower().contains(searchWord)) {
-                            found = true;
-                            p2.drawRect(x, y, w, h);
-                        }
-                    }
-                }
-            }
+    qint32 minimumWeight = global.getMinimumRecognitionWeight();
+    QStringList searchWords;
+    for (int k = 0; k < hits.size(); k++)
+        searchWords.append(SearchTokenizer::fold(hits[k]));
+    for (int i = 0; i < boxes.size(); i++) {
+        const RecognitionBox &box = boxes[i];
+        bool match = false;
+        for (int j = 0; j < box.words.size() && !match; j++) {
+            if (box.weights[j] < minimumWeight)
+                continue;
+            for (int k = 0; k < searchWords.size() && !match; k++)
+                match = box.words[j].contains(searchWords[k]);
+        }
+        if (match) {
+            found = true;
+            p2.drawRect(box.rect);
         }
     }
 
@@ -483,7 +444,6 @@ void NoteFormatter::modifyImageTags(QWebElement &enMedia, QString &hash) {
     QString mimetype = enMedia.attribute("type");
     qint32 resLid = 0;
     resLid = hashMap[hash];
-    QString highlightString = "";
 
     if (resLid > 0) {
         QLOG_DEBUG() << "htmlfmt: image tag - getting resource hash=" << hash << ", lid=" << resLid;
@@ -509,6 +469,7 @@ void NoteFormatter::modifyImageTags(QWebElement &enMedia, QString &hash) {
                 global.fileManager.getDbDirPath(QString(NN_DB_DIR_PREFIX "a/") + QString::number(resLid) + type);
 
             enMedia.setAttribute("src", imgfile);
+            images.insert(resLid, imgfile);
             // Check if this is a LaTeX image
             ResourceAttributes attributes;
             if (r.attributes.isSet())
@@ -528,16 +489,6 @@ void NoteFormatter::modifyImageTags(QWebElement &enMedia, QString &hash) {
             enMedia.setAttribute("onContextMenu", "window.browserWindow.imageContextMenu('"
                                                   + QString::number(resLid) + "', '"
                                                   + QString::number(resLid) + type + "');");
-
-            if (!global.disableImageHighlight()) {
-                highlightString = addImageHighlight(resLid, imgfile);
-
-                if (highlightString != "")
-                    enMedia.setAttribute("src", highlightString);
-
-                //if (highlightString != "")
-                //    enMedia.setAttribute("onload", highlightString);
-            }
         }
     } else {
         resourceError = true;
@@ -656,6 +607,7 @@ void NoteFormatter::modifyApplicationTags(QWebElement &enmedia, QString &hash, Q
         fileExt = ref.getExtensionFromMime(mime, fn);
         QString icon = findIcon(resLid, r, fileExt);
         newText.setAttribute("src", "file:///" + icon);
+        attachments.insert(resLid, "file:///" + icon);
         if (attributes.fileName.isSet())
             newText.setAttribute("title", attributes.fileName);
         newText.setAttribute("en-tag", "temporary");
@@ -667,18 +619,12 @@ void NoteFormatter::modifyApplicationTags(QWebElement &enmedia, QString &hash, Q
 }
 
 
-// Build an icon for any attachments
-QString NoteFormatter::findIcon(qint32 lid, Resource r, QString appl) {
+// Build an icon for any attachments.  A highlighted icon, for an attachment
+// the search found, is written to its own file so the plain one stays cached.
+QString NoteFormatter::findIcon(qint32 lid, Resource r, QString appl, bool highlight) {
     QLOG_TRACE_IN();
 
-    FilterCriteria *criteria = global.getCurrentCriteria();
     // First get the icon for this type of file
-    resourceHighlight = false;
-    if (criteria->isSearchStringSet() && criteria->getSearchString() != "") {
-        FilterEngine engine;
-        resourceHighlight = engine.resourceContains(lid, criteria->getSearchString(), nullptr);
-    }
-
     QString fileName = global.fileManager.getDbaDirPath(QString::number(lid) + appl);
     QIcon icon;
     QFileInfo info(fileName);
@@ -714,7 +660,7 @@ QString NoteFormatter::findIcon(qint32 lid, Resource r, QString appl) {
     QPoint textPoint(40, 15);
     QPoint sizePoint(40, 29);
     QPixmap pixmap(width, 37);
-    if (resourceHighlight) {
+    if (highlight) {
         pixmap.fill(Qt::yellow);
     } else
         pixmap.fill(QColor(global.getEditorBackgroundColor()));
@@ -743,7 +689,8 @@ QString NoteFormatter::findIcon(qint32 lid, Resource r, QString appl) {
     p.end();
 
     // Now that it is drawn, we write it out to a temporary file
-    QString tmpFile = global.fileManager.getTmpDirPath(QString::number(lid) + QString("_icon.png"));
+    QString tmpFile = global.fileManager.getTmpDirPath(QString::number(lid) +
+                                                       QString(highlight ? "_icon_highlight.png" : "_icon.png"));
     pixmap.save(tmpFile, "png");
     return tmpFile;
     QLOG_TRACE_OUT();
@@ -809,12 +756,85 @@ void NoteFormatter::modifyPdfTags(qint32 resLid, QWebElement &enmedia) {
 }
 
 
-void NoteFormatter::setHighlightText(QString text) {
+// Read the word boxes of an image's recognition data.  The words are
+// folded the way the index folds them so they compare with the search hits.
+void NoteFormatter::readRecognition(qint32 resLid, QList<RecognitionBox> &boxes) {
+    boxes.clear();
+    ResourceTable resTable(global.db);
+    Resource recoResource;
+    resTable.getResourceRecognition(recoResource, resLid);
+    Data recognition;
+    if (recoResource.recognition.isSet())
+        recognition = recoResource.recognition;
+    if (!recognition.size.isSet() || !recognition.body.isSet() ||
+        recognition.size == 0) {
+        return;
+    }
+
+    QByteArray recoData;
+    recoData = recognition.body;
+    QXmlStreamReader reader(recoData);
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (!reader.isStartElement())
+            continue;
+        if (reader.name() == "item") {
+            RecognitionBox box;
+            QXmlStreamAttributes attributes = reader.attributes();
+            box.rect = QRect(attributes.value("x").toString().toInt(), attributes.value("y").toString().toInt(),
+                             attributes.value("w").toString().toInt(), attributes.value("h").toString().toInt());
+            boxes.append(box);
+        } else if (reader.name() == "t" && boxes.size() > 0) {
+            qint32 weight = reader.attributes().value("w").toString().toInt();
+            QString text = SearchTokenizer::fold(reader.readElementText());
+            boxes.last().words.append(text);
+            boxes.last().weights.append(weight);
+        }
+    }
+}
+
+
+/* Highlight what the search found in a page built by rebuildNoteHTML.  The
+  page itself is never formatted again: images & attachment icons the search
+  found in are pointed at highlighted copies.  The note text is left alone,
+  the browser finds those words itself. */
+QByteArray NoteFormatter::addHighlight(QByteArray page, NoteCache *cache, SearchHighlight &highlight) {
     QLOG_TRACE_IN();
-    QStringList temp = text.split(" ");
-    for (int i = 0; i < temp.size(); i++) {
-        if (temp[i].trimmed() != "")
-            highlightWords.append(temp[i]);
+    if (cache == nullptr || highlight.isEmpty())
+        return page;
+
+    if (!global.disableImageHighlight()) {
+        QHash<qint32, QString>::iterator i;
+        for (i = cache->images.begin(); i != cache->images.end(); ++i) {
+            QStringList hits = highlight.hits(i.key());
+            if (hits.size() == 0)
+                continue;
+            if (!cache->recognition.contains(i.key()))
+                readRecognition(i.key(), cache->recognition[i.key()]);
+            QString highlighted = addImageHighlight(i.key(), i.value(), cache->recognition[i.key()], hits);
+            if (highlighted != "")
+                page.replace("\"" + i.value().toUtf8() + "\"", "\"" + highlighted.toUtf8() + "\"");
+        }
+    }
+
+    QHash<qint32, QString>::iterator i;
+    for (i = cache->attachments.begin(); i != cache->attachments.end(); ++i) {
+        if (highlight.hits(i.key()).size() == 0)
+            continue;
+        Resource r;
+        ResourceTable resTable(global.db);
+        if (!resTable.get(r, i.key(), false))
+            continue;
+        MimeReference ref;
+        QString fn;
+        QString mime;
+        if (r.attributes.isSet() && r.attributes->fileName.isSet())
+            fn = r.attributes->fileName;
+        if (r.mime.isSet())
+            mime = r.mime;
+        QString icon = findIcon(i.key(), r, ref.getExtensionFromMime(mime, fn), true);
+        page.replace("\"" + i.value().toUtf8() + "\"", "\"file:///" + icon.toUtf8() + "\"");
     }
     QLOG_TRACE_OUT();
+    return page;
 }
@@ -32,12 +32,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QVector>
 #include <QtXml>
 #include "src/qevercloud/include/QEverCloud.h"
+#include "src/models/notecache.h"
 #include "enmlformatter.h"
 
 using namespace qevercloud;
 
 using namespace std;
 
+class SearchHighlight;
 
 class NoteFormatter : public QObject
 {
@@ -47,20 +49,20 @@ private:
     QByteArray content;
     bool pdfPreview;
     QList< QTemporaryFile* > tempFiles;
-    QStringList highlightWords;
     bool noteHistory;
     bool formatError;
-    QString addImageHighlight(qint32 resLid, QString imgfile);
+    QString addImageHighlight(qint32 resLid, QString imgfile, const QList<RecognitionBox> &boxes,
+                              const QStringList &hits);
+    static void readRecognition(qint32 resLid, QList<RecognitionBox> &boxes);
     void modifyImageTags(QWebElement &enMedia, QString &hash);
     void modifyApplicationTags(QWebElement &enmedia, QString &hash, QString appl);
     void modifyPdfTags(qint32 resLid, QWebElement &enmedia);
     void modifyTodoTags(QWebElement &todo);
     void modifyTags(QWebPage &doc);
-    QString findIcon(qint32 lid, Resource r, QString appl);
+    QString findIcon(qint32 lid, Resource r, QString appl, bool highlight=false);
     QString preHtmlFormat(QString content);
     QHash<QString, qint32> hashMap;
     QHash<qint32, Resource> resourceMap;
-    bool resourceHighlight;
     const char* findImageFormat(QString file);
 
 public:
@@ -68,6 +70,8 @@ public:
     bool readOnly;
     bool inkNote;
     bool thumbnail;
+    QHash<qint32, QString> images;          // Image src of each resource shown as an image
+    QHash<qint32, QString> attachments;     // Icon src of each resource shown as an attachment
     //bool enableHighlight;
 
     explicit NoteFormatter(QObject *parent = 0);
@@ -78,7 +82,7 @@ public:
     void setNoteHistory(bool value);
     QByteArray rebuildNoteHTML();
     bool  buildInkNote(QWebElement &docElem, QString &hash);
-    void setHighlightText(QString text);
+    QByteArray addHighlight(QByteArray page, NoteCache *cache, SearchHighlight &highlight);
 
 
 signals:
@@ -23,11 +23,25 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "src/qevercloud/include/QEverCloud.h"
 #include <QObject>
+#include <QHash>
+#include <QList>
+#include <QRect>
+#include <QStringList>
 
 
 using namespace qevercloud  ;
 
 
+// A word box from an image's recognition data, with its candidate words
+class RecognitionBox
+{
+public:
+    QRect rect;
+    QStringList words;          // Folded with SearchTokenizer::fold()
+    QList<qint32> weights;      // Weight of each word
+};
+
+
 class NoteCache : public QObject
 {
     Q_OBJECT
@@ -37,6 +51,9 @@ public:
     bool isReadOnly;
     bool isContentReadOnly;
     bool isInkNote;
+    QHash<qint32, QString> images;          // Resource lid to the image src in noteContent
+    QHash<qint32, QString> attachments;     // Resource lid to the attachment icon src in noteContent
+    QHash<qint32, QList<RecognitionBox> > recognition;    // Read the first time an image is highlighted
 
 signals:
 
@@ -51,7 +51,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/notetable.h"
 #include "src/gui/ntabwidget.h"
 #include "src/sql/notebooktable.h"
+#include "src/sql/searchtable.h"
 #include "src/sql/usertable.h"
+#include "src/sql/databaseupgrade.h"
 #include "src/settings/startupconfig.h"
 #include "src/dialog/logindialog.h"
 #include "src/dialog/closenotebookdialog.h"
@@ -138,9 +140,11 @@ NixNote::NixNote(QWidget *parent) : QMainWindow(parent) {
     connect(&syncThread, SIGNAL(started()), this, SLOT(syncThreadStarted()));
     connect(&counterThread, SIGNAL(started()), this, SLOT(counterThreadStarted()));
     connect(&indexThread, SIGNAL(started()), this, SLOT(indexThreadStarted()));
+    connect(&searchThread, SIGNAL(started()), this, SLOT(searchThreadStarted()));
     counterThread.start(QThread::LowestPriority);
     syncThread.start(QThread::LowPriority);
     indexThread.start(QThread::LowestPriority);
+    searchThread.start(QThread::NormalPriority);
     this->thread()->setPriority(QThread::HighestPriority);
 
     heartbeatTimer.setInterval(1000);
@@ -155,9 +159,30 @@ NixNote::NixNote(QWidget *parent) : QMainWindow(parent) {
 
     db = new DatabaseConnection(NN_DB_CONNECTION_NAME);  // Startup the database
 
+    // Copy any data not yet in the typed tables.  This runs in small
+    // chunks off a timer so it doesn't hold up the GUI.
+    DatabaseUpgrade *typedMigration = new DatabaseUpgrade(this);
+    connect(typedMigration, SIGNAL(typedMigrationFinished()), typedMigration, SLOT(deleteLater()));
+    typedMigration->startTypedMigration();
+
     // Setup the sync thread
     QLOG_TRACE() << "Setting up counter thread";
     connect(this, SIGNAL(updateCounts()), &counterRunner, SLOT(countAll()));
+    connect(this, SIGNAL(updateCounts()), this, SLOT(countSavedSearches()));
+    connect(this, SIGNAL(savedSearchCountRequested(qint32, QString, QList<QVariant>, LidBitmap)),
+            &counterRunner, SLOT(countSearch(qint32, QString, QList<QVariant>, LidBitmap)));
+
+    // Setup the search thread
+    QLOG_TRACE() << "Setting up search thread";
+    searchId = 0;
+    searchAfterSync = false;
+    searchFirstBatch = true;
+    searchGeneration = 0;
+    connect(this, SIGNAL(searchRequested(qint32, QString, QList<QVariant>, LidBitmap)),
+            &searchRunner, SLOT(search(qint32, QString, QList<QVariant>, LidBitmap)));
+    connect(&searchRunner, SIGNAL(searchResults(qint32, QList<qint32>, QList<double>, bool)),
+            this, SLOT(searchResultsReady(qint32, QList<qint32>, QList<double>, bool)));
+    connect(&searchRunner, SIGNAL(searchFailed(qint32)), this, SLOT(searchFailed(qint32)));
 
     // Setup the counter thread
     QLOG_TRACE() << "Setting up sync thread";
@@ -234,9 +259,11 @@ NixNote::~NixNote() {
     syncThread.quit();
     indexThread.quit();
     counterThread.quit();
+    searchThread.quit();
     while (!syncThread.isFinished());
     while (!indexThread.isFinished());
     while (!counterThread.isFinished());
+    while (!searchThread.isFinished());
 
     // Cleanup any temporary files
     if (global.purgeTemporaryFilesOnShutdown) {
@@ -832,12 +859,18 @@ void NixNote::setupGui() {
     global.setupShortcut(upNoteShortcut, "Up_Note");
     connect(upNoteShortcut, SIGNAL(activated()), noteTableView, SLOT(upNote()));
 
-    // startup the index timer (if needed)
+    // startup the index scheduler (if needed)
+    indexScheduler = nullptr;
+    indexStatus = nullptr;
     if (global.enableIndexing) {
-        indexTimer.setInterval(global.minimumThumbnailInterval);
-        connect(&indexTimer, SIGNAL(timeout()), &indexRunner, SLOT(index()));
+        indexStatus = new QLabel(this);
+        statusBar()->addPermanentWidget(indexStatus);
+        indexScheduler = new IndexScheduler(tabWindow, this);
+        connect(indexScheduler, SIGNAL(indexRequested(qint32,qint32)), &indexRunner, SLOT(index(qint32,qint32)));
+        connect(&indexRunner, SIGNAL(indexDone(bool)), indexScheduler, SLOT(indexFinished(bool)));
         connect(&indexRunner, SIGNAL(indexDone(bool)), this, SLOT(indexFinished(bool)));
-        indexTimer.start();
+        connect(&indexRunner, SIGNAL(indexProgress(qint32,qint32,double)), this, SLOT(indexProgress(qint32,qint32,double)));
+        indexScheduler->start();
     }
 }
 
@@ -873,12 +906,60 @@ TrayMenu *NixNote::createTrayContexMenu() {
 
 
 void NixNote::indexFinished(bool finished) {
-    indexTimer.stop();
-    if (!finished)
-        indexTimer.setInterval(global.minIndexInterval);
-    else
-        indexTimer.setInterval(global.maxIndexInterval);
-    indexTimer.start();
+    Q_UNUSED(finished);
+
+    // Newly indexed text can change what the materialized searches match
+    if (global.materializedSearches.hasPending())
+        countSavedSearches();
+}
+
+
+
+// Show how much is left to index & how fast it is going
+void NixNote::indexProgress(qint32 notes, qint32 resources, double rate) {
+    if (notes == 0 && resources == 0) {
+        indexStatus->clear();
+        return;
+    }
+    QString text = tr("Indexing: %1 notes, %2 attachments left").arg(notes).arg(resources);
+    if (rate > 0)
+        text = text + tr(" (%1/s)").arg(rate, 0, 'f', 1);
+    indexStatus->setText(text);
+}
+
+
+
+//*****************************************************
+//* Show the counts of the materialized saved searches.
+//* A search nothing changed for since it was last
+//* counted keeps its count.  The rest are compiled &
+//* the counter thread brings their matches up to
+//* date & counts them.
+//*****************************************************
+void NixNote::countSavedSearches() {
+    if (global.getLegacyFilterEngine())
+        return;
+    QList<qint32> lids = global.materializedSearches.searches(global.db);
+    SearchTable searchTable(global.db);
+    FilterEngine filterEngine;
+    for (int i=0; i<lids.size(); i++) {
+        qint32 total = global.materializedSearches.total(lids[i]);
+        if (total >= 0) {
+            if (global.countBehavior != Global::CountNone)
+                searchTreeView->updateTotals(lids[i], total);
+            continue;
+        }
+        SavedSearch search;
+        if (!searchTable.get(search, lids[i]) || !search.query.isSet())
+            continue;
+        FilterCriteria criteria;
+        criteria.setSearchString(search.query);
+        QString statement;
+        QList<QVariant> values;
+        LidBitmap indexed;
+        if (filterEngine.compileSearch(&criteria, statement, values, indexed))
+            emit savedSearchCountRequested(lids[i], statement, values, indexed);
+    }
 }
 
 
@@ -891,6 +972,11 @@ void NixNote::counterThreadStarted() {
 }
 
 
+void NixNote::searchThreadStarted() {
+    searchRunner.moveToThread(&searchThread);
+}
+
+
 //***************************************************************
 //* Signal received when the syncRunner thread has started
 //***************************************************************
@@ -964,6 +1050,8 @@ void NixNote::setupSearchTree() {
     leftPanel->addSearchView(searchTreeView);
     connect(&syncRunner, SIGNAL(searchUpdated(qint32, QString)), searchTreeView, SLOT(searchUpdated(qint32, QString)));
     connect(&syncRunner, SIGNAL(searchExpunged(qint32)), searchTreeView, SLOT(searchExpunged(qint32)));
+    connect(&counterRunner, SIGNAL(searchTotals(qint32, qint32)), searchTreeView, SLOT(updateTotals(qint32, qint32)));
+    connect(searchTreeView, SIGNAL(updateCounts()), this, SLOT(countSavedSearches()));
     //connect(&syncRunner, SIGNAL(syncComplete()),searchTreeView, SLOT(re);
     QLOG_TRACE() << "Exiting NixNote.setupSearchTree()";
 }
@@ -1151,6 +1239,8 @@ void NixNote::saveOnExit() {
     QLOG_DEBUG() << "Shutting down threads";
     indexRunner.keepRunning = false;
     counterRunner.keepRunning = false;
+    searchRunner.keepRunning = false;
+    searchRunner.nextSearch();      // Stop any search that is running
     QCoreApplication::processEvents();
 
     QLOG_DEBUG() << "Saving window states";
@@ -1266,6 +1356,7 @@ void NixNote::saveOnExit() {
     QLOG_DEBUG() << "Closing threads";
     indexThread.quit();
     counterThread.quit();
+    searchThread.quit();
 
     QLOG_DEBUG() << "Exiting saveOnExit()";
 }
@@ -1637,9 +1728,101 @@ void NixNote::updateSelectionCriteria(bool afterSync) {
         global.cache.remove(keys[i]);
     }
 
+    // The legacy engine works on the filter table itself, so it has
+    // to run here.  Otherwise the results are taken from the cache if
+    // nothing changed since the last time, or the criteria are compiled
+    // here & the statement is run on the search thread (unless it is a
+    // materialized saved search).  The note list is updated as the
+    // results come in.
     FilterEngine filterEngine;
+    if (!global.getLegacyFilterEngine()) {
+        QString key = FilterEngine::cacheKey(global.getCurrentCriteria());
+        QList<qint32> lids;
+        QList<double> relevance;
+        if (global.searchCache.get(key, lids, relevance)) {
+            searchId = searchRunner.nextSearch();     // Drop any search still running
+            filterEngine.writeFilter(lids, relevance);
+            filterEngine.trimSelection(lids);
+            showSearchResults(afterSync);
+            return;
+        }
+
+        QString statement;
+        QList<QVariant> values;
+        LidBitmap indexed;
+        qint32 generation = global.searchCache.currentGeneration();
+        if (filterEngine.compileSearch(global.getCurrentCriteria(), statement, values, indexed)) {
+            if (filterEngine.materializedSearch(global.getCurrentCriteria(), statement, values, indexed, lids, relevance)) {
+                searchId = searchRunner.nextSearch();
+                global.searchCache.put(key, generation, lids, relevance);
+                filterEngine.writeFilter(lids, relevance);
+                filterEngine.trimSelection(lids);
+                showSearchResults(afterSync);
+                return;
+            }
+            searchId = searchRunner.nextSearch();
+            searchAfterSync = afterSync;
+            searchFirstBatch = true;
+            searchKey = key;
+            searchGeneration = generation;
+            emit searchRequested(searchId, statement, values, indexed);
+            return;
+        }
+    }
+
     filterEngine.filter();
+    showSearchResults(afterSync);
+}
+
+
+
+//*****************************************************
+//* A batch of search results is back from the search
+//* thread.  The first batch replaces the note list,
+//* the rest are added to it.  The last one has every
+//* hit & finishes updating the selection.
+//*****************************************************
+void NixNote::searchResultsReady(qint32 id, QList<qint32> lids, QList<double> relevance, bool finished) {
+    if (id != searchId || !searchRunner.isCurrent(id))
+        return;
+
+    FilterEngine filterEngine;
+    if (!finished) {
+        filterEngine.writeFilter(lids, relevance, !searchFirstBatch);
+        if (searchFirstBatch)
+            noteTableView->scrollToTop();
+        searchFirstBatch = false;
+        noteTableView->refreshData();
+        return;
+    }
+
+    global.searchCache.put(searchKey, searchGeneration, lids, relevance);
+    filterEngine.writeFilter(lids, relevance);
+    filterEngine.trimSelection(lids);
+    showSearchResults(searchAfterSync);
+}
+
+
+
+// The search thread couldn't run the compiled statement.  Fall back to
+// the old filter here rather than trying the compiled one again.
+void NixNote::searchFailed(qint32 id) {
+    if (id != searchId || !searchRunner.isCurrent(id))
+        return;
+    FilterEngine filterEngine;
+    QList<qint32> lids;
+    filterEngine.legacyFilter(global.getCurrentCriteria(), lids);
+    filterEngine.trimSelection(lids);
+    showSearchResults(searchAfterSync);
+}
+
 
+
+//*****************************************************
+//* The filter table has the new results.  Show them
+//* & update everything that depends on the selection.
+//*****************************************************
+void NixNote::showSearchResults(bool afterSync) {
     QLOG_DEBUG() << "Refreshing data";
 
     noteTableView->refreshData();
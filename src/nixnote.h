@@ -40,6 +40,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/gui/nsearchview.h"
 #include "src/threads/syncrunner.h"
 #include "src/threads/indexrunner.h"
+#include "src/threads/indexscheduler.h"
 #include "src/gui/widgetpanel.h"
 #include "src/gui/nnotebookview.h"
 #include "src/gui/favoritesview.h"
@@ -49,6 +50,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/gui/ntrashtree.h"
 #include "src/dialog/accountdialog.h"
 #include "src/threads/counterrunner.h"
+#include "src/threads/searchrunner.h"
 //#include "src/oauth/oauthwindow.h"
 #include "src/html/thumbnailer.h"
 #include "src/reminders/remindermanager.h"
@@ -107,7 +109,8 @@ private:
     QString saveLastPath;   // Last path viewed in the restore dialog
     FileWatcherManager *importManager;
     Thumbnailer *hammer;
-    QTimer indexTimer;
+    IndexScheduler *indexScheduler;
+    QLabel *indexStatus;                // Index backlog & rate, in the status bar
 
     // Tool & menu bar
     NMainMenuBar *menuBar;
@@ -184,6 +187,12 @@ private:
     void trayActivatedAction(int value);
     TrayMenu *createTrayContexMenu();
     void restoreAndShowMainWindow();
+    void showSearchResults(bool afterSync);
+    qint32 searchId;                // Search we are waiting on from the searchRunner
+    bool searchAfterSync;           // The afterSync of the updateSelectionCriteria() that started it
+    bool searchFirstBatch;          // Next batch replaces the filter table
+    QString searchKey;              // Cache key & data generation of the running search
+    qint32 searchGeneration;
 
 public:
     NixNote(QWidget *parent = 0);  // Constructor
@@ -192,8 +201,10 @@ public:
     QThread syncThread;
     QThread indexThread;
     QThread counterThread;
+    QThread searchThread;
     IndexRunner indexRunner;
     CounterRunner counterRunner;
+    SearchRunner searchRunner;
     void closeEvent(QCloseEvent *event);
     //bool notify(QObject* receiver, QEvent* event);
     bool event(QEvent *event);
@@ -275,6 +286,9 @@ public slots:
     void indexThreadStarted();
     void syncThreadStarted();
     void counterThreadStarted();
+    void searchThreadStarted();
+    void searchResultsReady(qint32 id, QList<qint32> lids, QList<double> relevance, bool finished);
+    void searchFailed(qint32 id);
     void openCloseNotebooks();
     void deleteCurrentNote();
     void duplicateCurrentNote();
@@ -292,6 +306,8 @@ public slots:
     void presentationModeOn();
     void presentationModeOff();
     void indexFinished(bool finished);
+    void indexProgress(qint32 notes, qint32 resources, double rate);
+    void countSavedSearches();
     void onExportAsPdf();
     void saveOnExit();
     void onTrayActivated(QSystemTrayIcon::ActivationReason reason);
@@ -299,6 +315,8 @@ public slots:
 signals:
     void syncRequested();
     void updateCounts();
+    void searchRequested(qint32 id, QString statement, QList<QVariant> values, LidBitmap indexed);
+    void savedSearchCountRequested(qint32 searchLid, QString statement, QList<QVariant> values, LidBitmap indexed);
 
 };
 
@@ -19,9 +19,63 @@
 #include "StringUtils_p.h"
 //#include <quentier/logging/QuentierLogger.h>
 #include <QRegExp>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUENTIER_STRING_UTILS_SSE2
+#endif
 
 namespace quentier {
 
+namespace {
+
+// Returns the index of the first code unit at or after pos which is not ASCII,
+// or size if there is none. With SSE2 it checks 16 code units (32 bytes) at a time
+int findNonAscii(const ushort * data, int pos, const int size)
+{
+#ifdef QUENTIER_STRING_UTILS_SSE2
+    const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; pos + 16 <= size; pos += 16)
+    {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + 8));
+        __m128i high = _mm_or_si128(_mm_and_si128(first, mask), _mm_and_si128(second, mask));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF) {
+            break;
+        }
+    }
+
+    for(; pos + 8 <= size; pos += 8)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chunk, mask), zero)) != 0xFFFF) {
+            break;
+        }
+    }
+#endif
+
+    for(; pos < size; ++pos)
+    {
+        if (data[pos] >= 0x80) {
+            return pos;
+        }
+    }
+
+    return size;
+}
+
+bool isMark(const QChar::Category category)
+{
+    return (category == QChar::Mark_NonSpacing) ||
+           (category == QChar::Mark_SpacingCombining) ||
+           (category == QChar::Mark_Enclosing);
+}
+
+} // namespace
+
 StringUtilsPrivate::StringUtilsPrivate() :
     m_diacriticLetters(),
     m_noDiacriticLetters()
@@ -45,34 +99,96 @@ void StringUtilsPrivate::removePunctuation(QString & str, const QVector<QChar> &
     str.remove(punctuationFilter);
 }
 
+// Each character is replaced with what is left of its NFKD decomposition once
+// the combining marks are gone and the letters in m_diacriticLetters are swapped
+// for their plain forms. This is looked up per code unit in a table built once,
+// and runs of ASCII, which never change, are found a vector at a time and
+// copied as they are. The output goes into a buffer allocated up front.
 void StringUtilsPrivate::removeDiacritics(QString & str) const
 {
-    //QNTRACE(QStringLiteral("str before normalizing by D form: ") << str);
-    str = str.normalized(QString::NormalizationForm_KD);
-    //QNTRACE(QStringLiteral("str after normalizing by KD form: ") << str);
+    const int size = str.size();
+    const ushort * source = str.utf16();
+    int pos = findNonAscii(source, 0, size);
+    if (pos == size) {
+        return;
+    }
 
-    for(int i = 0; i < str.length(); ++i)
+    QString result;
+    result.resize(size + size / 8 + 16);
+    ushort * out = reinterpret_cast<ushort*>(result.data());
+    int length = 0;
+    auto reserve = [&](const int needed)
     {
-        QChar currentCharacter = str[i];
-        QChar::Category category = currentCharacter.category();
-        if ( (category == QChar::Mark_NonSpacing) ||
-             (category == QChar::Mark_SpacingCombining) ||
-             (category == QChar::Mark_Enclosing) )
+        if (length + needed > result.size()) {
+            result.resize(qMax(result.size() * 2, length + needed));
+            out = reinterpret_cast<ushort*>(result.data());
+        }
+    };
+    auto append = [&](const QString & replacement)
+    {
+        reserve(replacement.size());
+        memcpy(out + length, replacement.utf16(), static_cast<size_t>(replacement.size()) * sizeof(ushort));
+        length += replacement.size();
+    };
+
+    memcpy(out, source, static_cast<size_t>(pos) * sizeof(ushort));
+    length = pos;
+
+    const ushort * map = m_diacriticMap.constData();
+    while(pos < size)
+    {
+        const ushort c = source[pos];
+        if (c < 0x80)
         {
-            str.remove(i, 1);
+            const int end = findNonAscii(source, pos, size);
+            reserve(end - pos);
+            memcpy(out + length, source + pos, static_cast<size_t>(end - pos) * sizeof(ushort));
+            length += end - pos;
+            pos = end;
             continue;
         }
 
-        int diacriticIndex = m_diacriticLetters.indexOf(currentCharacter);
-        if (diacriticIndex < 0) {
+        if (QChar::isHighSurrogate(c) && (pos + 1 < size) && QChar::isLowSurrogate(source[pos + 1]))
+        {
+            // Outside the BMP there's no table, the character is decomposed here
+            const uint ucs4 = QChar::surrogateToUcs4(c, source[pos + 1]);
+            pos += 2;
+            if (isMark(QChar::category(ucs4))) {
+                continue;
+            }
+
+            const QString decomposed = QString::fromUcs4(&ucs4, 1).normalized(QString::NormalizationForm_KD);
+            for(int i = 0, count = decomposed.size(); i < count; ++i)
+            {
+                const ushort part = decomposed[i].unicode();
+                if (decomposed[i].isSurrogate()) {
+                    reserve(1);
+                    out[length++] = part;
+                }
+                else if (map[part] != 0) {
+                    reserve(1);
+                    out[length++] = map[part];
+                }
+                else {
+                    append(m_diacriticExpansions.value(part));
+                }
+            }
             continue;
         }
 
-        const QString & replacement = m_noDiacriticLetters[diacriticIndex];
-        str.replace(i, 1, replacement);
+        const ushort mapped = map[c];
+        if (mapped != 0) {
+            reserve(1);
+            out[length++] = mapped;
+        }
+        else {
+            append(m_diacriticExpansions.value(c));
+        }
+        ++pos;
     }
 
-    //QNTRACE(QStringLiteral("str after removing diacritics: ") << str);
+    result.resize(length);
+    str = result;
 }
 
 void StringUtilsPrivate::removeNewlines(QString & str) const
@@ -102,6 +218,57 @@ void StringUtilsPrivate::initialize()
                          << QStringLiteral("o") << QStringLiteral("o") << QStringLiteral("o") << QStringLiteral("u")
                          << QStringLiteral("u") << QStringLiteral("u") << QStringLiteral("u") << QStringLiteral("y")
                          << QStringLiteral("y");
+
+    initializeDiacriticMap();
+}
+
+void StringUtilsPrivate::initializeDiacriticMap()
+{
+    m_diacriticMap.resize(0x10000);
+    for(uint c = 0; c < 0x10000; ++c)
+    {
+        const QChar character(static_cast<ushort>(c));
+        m_diacriticMap[c] = static_cast<ushort>(c);
+        if ((c < 0x80) || character.isSurrogate()) {
+            continue;
+        }
+
+        const bool mark = isMark(character.category());
+        if (!mark && (character.decompositionTag() == QChar::NoDecomposition) &&
+            !m_diacriticLetters.contains(character))
+        {
+            continue;
+        }
+
+        QString replacement;
+        if (!mark)
+        {
+            const QString decomposed = QString(character).normalized(QString::NormalizationForm_KD);
+            for(int i = 0, size = decomposed.size(); i < size; ++i)
+            {
+                const QChar part = decomposed[i];
+                if (isMark(part.category())) {
+                    continue;
+                }
+
+                const int diacriticIndex = m_diacriticLetters.indexOf(part);
+                if (diacriticIndex < 0) {
+                    replacement.append(part);
+                }
+                else {
+                    replacement.append(m_noDiacriticLetters[diacriticIndex]);
+                }
+            }
+        }
+
+        if ((replacement.size() == 1) && !replacement[0].isNull()) {
+            m_diacriticMap[c] = replacement[0].unicode();
+        }
+        else {
+            m_diacriticMap[c] = 0;
+            m_diacriticExpansions.insert(static_cast<ushort>(c), replacement);
+        }
+    }
 }
 
 } // namespace quentier
@@ -22,6 +22,7 @@
 #include "src/quentier/utility/StringUtils.h"
 #include <QHash>
 #include <QStringList>
+#include <QVector>
 
 namespace quentier {
 
@@ -36,10 +37,16 @@ public:
 
 private:
     void initialize();
+    void initializeDiacriticMap();
 
 private:
     QString     m_diacriticLetters;
     QStringList m_noDiacriticLetters;
+
+    // What each BMP code unit becomes without its diacritics. Zero means
+    // the replacement isn't a single code unit and is in m_diacriticExpansions
+    QVector<ushort>         m_diacriticMap;
+    QHash<ushort, QString>  m_diacriticExpansions;
 };
 
 } // namespace quentier
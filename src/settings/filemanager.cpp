@@ -176,6 +176,10 @@ void FileManager::setupUserDirectories(int accountId) {
     thumbnailDir.setPath(dbDirPath + "t" + NN_DB_DIR_PREFIX + "a");
     createDirOrCheckWriteable(thumbnailDir);
     thumbnailDirPath = slashTerminatePath(thumbnailDir.path());
+
+    textCacheDir.setPath(dbDirPath + "textcache");
+    createDirOrCheckWriteable(textCacheDir);
+    textCacheDirPath = slashTerminatePath(textCacheDir.path());
 }
 
 
@@ -376,6 +380,10 @@ QString FileManager::getThumbnailDirPathSpecialChar(QString relativePath) {
     return thumbnailDirPath + toPlatformPathSeparator(relativePath).replace("#", "%23");
 }
 
+QString FileManager::getTextCacheDirPath(QString relativePath) {
+    return textCacheDirPath + toPlatformPathSeparator(relativePath);
+}
+
 QString FileManager::getTranslateFilePath(QString relativePath) {
     return translateDirPath + toPlatformPathSeparator(relativePath);
 }
@@ -68,6 +68,8 @@ private:
 
     QString thumbnailDirPath;
     QDir thumbnailDir;
+    QString textCacheDirPath;
+    QDir textCacheDir;
 
     QString translateDirPath;
     QDir translateDir;
@@ -108,6 +110,8 @@ public:
     QString getThumbnailDirPath();
     QString getThumbnailDirPath(QString relativePath);
     QString getThumbnailDirPathSpecialChar(QString relativePath);
+    // text extracted from attachments for the search index, keyed by the attachment's hash
+    QString getTextCacheDirPath(QString relativePath);
     QDir getImageDirFile(QString relativePath);
     QString getImageDirPath(QString relativePath);
     QDir getJavaDirFile(QString relativePath);
@@ -22,7 +22,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "notetable.h"
 #include "src/sql/nsqlquery.h"
 #include "resourcetable.h"
+#include "searchtable.h"
+#include "tagtable.h"
 #include "src/sql/databaseupgrade.h"
+#include "src/sql/searchtokenizer.h"
 
 
 extern Global global;
@@ -33,18 +36,31 @@ extern Global global;
 DatabaseConnection::DatabaseConnection(QString connection)
 {
     dbLocked = Unlocked;
+    transaction = false;
+    transactionGeneration = 0;
     this->connection = connection;
+    statementCache.setMaxCost(NN_STATEMENT_CACHE_SIZE);
+    statementHits = 0;
+    searchTokenizer = false;
+    statementMisses = 0;
     QLOG_DEBUG() << "SQL drivers available: " << QSqlDatabase::drivers();
     QLOG_TRACE() << "Adding database SQLITE";
     conn = QSqlDatabase::addDatabase("QSQLITE", connection);
     QLOG_TRACE() << "Setting DB name";
     conn.setDatabaseName(global.fileManager.getDbDirPath(NN_NIXNOTE_DATABASE_NAME));
     QLOG_TRACE() << "Opening database";
+    SearchTokenizer::install();
     if (!conn.open()) {
         QLOG_FATAL() << "Error opening database: " << conn.lastError();
         exit(16);
     }
 
+    // The search index needs its tokenizer on every connection that reads
+    // or writes it.  Connections opened by the same SQLite all have it.
+    searchTokenizer = SearchTokenizer::isRegistered(conn);
+    if (!searchTokenizer)
+        QLOG_DEBUG() << "Search tokenizer not available on connection " << connection;
+
     if (connection == NN_DB_CONNECTION_NAME)
         global.db = this;
     QLOG_TRACE() << "Preparing tables";
@@ -67,13 +83,45 @@ DatabaseConnection::DatabaseConnection(QString connection)
         }
 
         int value = global.getDatabaseVersion();
+        DatabaseUpgrade dbu;
         if (value < 2){
             QLOG_DEBUG() << "*****************";
             QLOG_DEBUG() << "Upgrading Database";
-            DatabaseUpgrade dbu;
             dbu.fixSql();
+            global.setDatabaseVersion(2);
         }
-        global.setDatabaseVersion(2);
+
+        dbu.createCoveringIndexes(this);
+
+        // Make sure the typed tables & their triggers exist.  Any data
+        // written before they existed is copied over in the background
+        // by DatabaseUpgrade::startTypedMigration().
+        dbu.createTypedTables(this);
+        DatabaseUpgrade::loadTypedMigrationState(this);
+        dbu.upgradeSearchIndex(this);
+
+        // Matches of the saved searches marked as materialized
+        SearchTable searchTable(this);
+        searchTable.createMatchTable();
+
+        // Tag hierarchy used to include child tags in a selection
+        TagTable tagTable(this);
+        tagTable.createClosureTable();
+
+        // Load the guid/lid lookups all the table classes share
+        global.identityMap.load(this);
+
+        // The search results live in a temp table only this connection
+        // can see, so opening a worker connection doesn't touch them.
+        QLOG_TRACE() << "Creating filter table";
+        tempTable.exec("pragma temp_store=memory");
+        tempTable.exec("drop table if exists main.filter");
+        tempTable.exec("create temp table filter (lid integer, relevance real)");
+        // index could be useful as we do joins on table display
+        // may also slow down search
+        // so maybe reevaluate this
+        tempTable.exec("create index temp.Filter_Lid_Index on filter (lid)");
+        tempTable.exec("insert into filter (lid,relevance) select distinct lid,0 from NoteTable");
 
         // Get username to use for default notes.  This needs to be done after
         // the database is started because we set it by default to the usertable
@@ -81,18 +129,6 @@ DatabaseConnection::DatabaseConnection(QString connection)
         global.full_username = global.getUsername();
 
     }
-
-    QLOG_TRACE() << "Re-creating filter table";
-    tempTable.exec("drop table if exists filter");
-    tempTable.exec("create table filter (lid integer, relevance integer)");
-    // index could be useful as we do joins on table display
-    // may also slow down search
-    // so maybe reevaluate this
-    tempTable.exec("create index Filter_Lid_Index on filter (lid)");
-
-    QLOG_TRACE() << "Adding to filter table";
-    tempTable.exec("insert into filter (lid,relevance) select distinct lid,0 from NoteTable");
-    QLOG_TRACE() << "Addition complete";
     tempTable.finish();
 
 
@@ -101,6 +137,10 @@ DatabaseConnection::DatabaseConnection(QString connection)
 
 // Destructor.  Close the database & delete the memory used by the variables.
 DatabaseConnection::~DatabaseConnection() {
+    QLOG_DEBUG() << "Statement cache for " << connection << ": " << statementHits << " hits, " << statementMisses << " misses";
+    statementMutex.lock();
+    statementCache.clear();
+    statementMutex.unlock();
     conn.close();
     delete configStore;
     delete dataStore;
@@ -143,3 +183,138 @@ QString DatabaseConnection::getConnectionName() {
 }
 
 
+bool DatabaseConnection::hasSearchTokenizer() {
+    return searchTokenizer;
+}
+
+
+
+// Check out a prepared statement for this SQL text.  The statement is
+// removed from the cache while it is in use so two queries can never
+// share it.  Returns false if it has to be prepared from scratch.
+bool DatabaseConnection::takeStatement(const QString &sql, QSqlQuery &query) {
+    statementMutex.lock();
+    QSqlQuery *cached = statementCache.take(sql);
+    if (cached == nullptr) {
+        statementMisses++;
+        statementMutex.unlock();
+        return false;
+    }
+    statementHits++;
+    statementMutex.unlock();
+    query = *cached;
+    delete cached;
+    return true;
+}
+
+
+
+// Return a statement to the cache once the query is done with it.  If
+// the cache is full the least recently used statement is finalized.
+void DatabaseConnection::releaseStatement(const QString &sql, const QSqlQuery &query) {
+    statementMutex.lock();
+    statementCache.insert(sql, new QSqlQuery(query), 1);
+    statementMutex.unlock();
+}
+
+
+
+// Number of times a prepared statement was reused
+qint64 DatabaseConnection::getStatementCacheHits() {
+    return statementHits;
+}
+
+
+
+// Number of times a statement had to be prepared
+qint64 DatabaseConnection::getStatementCacheMisses() {
+    return statementMisses;
+}
+
+
+
+// Start a transaction.  We take the write lock right away so a
+// reader on another connection can't block us from committing.
+bool DatabaseConnection::beginTransaction() {
+    NSqlQuery query(this);
+    bool rc = query.exec("begin immediate transaction");
+    if (!rc)
+        QLOG_ERROR() << "Unable to begin transaction on " << connection << ": " << query.lastError().text();
+    transaction = rc;
+    transactionGeneration = global.searchCache.currentGeneration();
+    return rc;
+}
+
+
+
+// Commit the current transaction.  If the tables changed anything searched
+// for in the meantime, a search run before the commit could have cached
+// the old data, so those results are stale too.
+bool DatabaseConnection::commitTransaction() {
+    NSqlQuery query(this);
+    bool rc = query.exec("commit transaction");
+    if (!rc)
+        QLOG_ERROR() << "Unable to commit transaction on " << connection << ": " << query.lastError().text();
+    else
+        transaction = false;
+    if (global.searchCache.currentGeneration() != transactionGeneration)
+        global.searchCache.dataChanged();
+    return rc;
+}
+
+
+
+// Throw away the current transaction
+bool DatabaseConnection::rollbackTransaction() {
+    NSqlQuery query(this);
+    bool rc = query.exec("rollback transaction");
+    transaction = false;
+    if (global.searchCache.currentGeneration() != transactionGeneration)
+        global.searchCache.dataChanged();
+    return rc;
+}
+
+
+
+bool DatabaseConnection::inTransaction() {
+    return transaction;
+}
+
+
+
+// Mark a point inside the transaction we can roll back to
+bool DatabaseConnection::savepoint(const QString &name) {
+    NSqlQuery query(this);
+    return query.exec("savepoint " +name);
+}
+
+
+
+// Keep everything done since the savepoint
+bool DatabaseConnection::releaseSavepoint(const QString &name) {
+    NSqlQuery query(this);
+    return query.exec("release savepoint " +name);
+}
+
+
+
+// Undo everything done since the savepoint.  The savepoint itself
+// stays open until it is released.
+bool DatabaseConnection::rollbackToSavepoint(const QString &name) {
+    NSqlQuery query(this);
+    return query.exec("rollback to savepoint " +name);
+}
+
+
+
+// Count a failed statement
+void DatabaseConnection::countError() {
+    errorCount.ref();
+}
+
+
+
+// Return the number of failed statements on this connection
+qint32 DatabaseConnection::getErrorCount() {
+    return errorCount.loadAcquire();
+}
@@ -25,6 +25,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "configstore.h"
 
 #include <QtSql>
+#include <QCache>
+#include <QMutex>
+#include <QAtomicInt>
+
+// Number of prepared statements kept per connection
+#define NN_STATEMENT_CACHE_SIZE 64
 
 //***************************************
 //* This class is used to control the
@@ -58,10 +64,36 @@ public:
     void lockForWrite();
     void unlock();
     QString getConnectionName();
+    bool hasSearchTokenizer();      // Was the SearchTokenizer added to this connection?
+
+    // Prepared statement cache used by NSqlQuery
+    bool takeStatement(const QString &sql, QSqlQuery &query);        // Check out a cached statement
+    void releaseStatement(const QString &sql, const QSqlQuery &query);   // Return a statement to the cache
+    qint64 getStatementCacheHits();
+    qint64 getStatementCacheMisses();
+
+    // Transactions & savepoints.  Used to apply a whole sync chunk at once.
+    bool beginTransaction();
+    bool commitTransaction();
+    bool rollbackTransaction();
+    bool inTransaction();                         // Between beginTransaction() & its commit or rollback
+    bool savepoint(const QString &name);
+    bool releaseSavepoint(const QString &name);
+    bool rollbackToSavepoint(const QString &name);
+    void countError();                            // A statement failed on this connection
+    qint32 getErrorCount();                       // Number of failed statements so far
 
 private:
     LockMethod dbLocked;
+    bool transaction;               // beginTransaction() succeeded & hasn't been ended
+    qint32 transactionGeneration;   // Search cache generation when the transaction began
     QString connection;
+    bool searchTokenizer;
+    QCache<QString, QSqlQuery> statementCache;    // Least recently used statements are evicted first
+    QMutex statementMutex;
+    qint64 statementHits;
+    qint64 statementMisses;
+    QAtomicInt errorCount;
 };
 
 #endif // DATABASECONNECTION_H
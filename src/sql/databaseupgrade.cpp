@@ -3,17 +3,169 @@
 #include "src/sql/notetable.h"
 #include "src/sql/notebooktable.h"
 #include "src/sql/searchtable.h"
+#include "src/sql/searchindextable.h"
 #include "src/sql/tagtable.h"
 #include "src/sql/resourcetable.h"
 #include "src/sql/linkednotebooktable.h"
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/configstore.h"
+#include "src/sql/databaseconnection.h"
 #include "src/global.h"
 
+extern Global global;
+
+
+// Mapping of DataStore keys to the columns of the typed tables
+struct TypedColumn {
+    qint32 key;
+    const char *name;
+    const char *type;
+};
+
+static const TypedColumn noteColumns[] = {
+    { NOTE_GUID, "guid", "text" },
+    { NOTE_TITLE, "title", "text" },
+    { NOTE_CONTENT, "content", "blob" },
+    { NOTE_UPDATE_SEQUENCE_NUMBER, "updateSequenceNumber", "integer" },
+    { NOTE_ISDIRTY, "isDirty", "integer" },
+    { NOTE_CONTENT_HASH, "contentHash", "blob" },
+    { NOTE_CONTENT_LENGTH, "contentLength", "integer" },
+    { NOTE_CREATED_DATE, "dateCreated", "integer" },
+    { NOTE_UPDATED_DATE, "dateUpdated", "integer" },
+    { NOTE_DELETED_DATE, "dateDeleted", "integer" },
+    { NOTE_ACTIVE, "active", "integer" },
+    { NOTE_NOTEBOOK_LID, "notebookLid", "integer" },
+    { NOTE_ATTRIBUTE_SUBJECT_DATE, "subjectDate", "integer" },
+    { NOTE_ATTRIBUTE_LATITUDE, "latitude", "real" },
+    { NOTE_ATTRIBUTE_LONGITUDE, "longitude", "real" },
+    { NOTE_ATTRIBUTE_ALTITUDE, "altitude", "real" },
+    { NOTE_ATTRIBUTE_AUTHOR, "author", "text" },
+    { NOTE_ATTRIBUTE_SOURCE, "source", "text" },
+    { NOTE_ATTRIBUTE_SOURCE_URL, "sourceUrl", "text" },
+    { NOTE_ATTRIBUTE_SOURCE_APPLICATION, "sourceApplication", "text" },
+    { NOTE_HAS_ENCRYPT, "hasEncrypt", "integer" },
+    { NOTE_HAS_TODO_COMPLETED, "hasTodoCompleted", "integer" },
+    { NOTE_HAS_TODO_UNCOMPLETED, "hasTodoUncompleted", "integer" },
+    { NOTE_HAS_IMAGE, "hasImage", "integer" },
+    { NOTE_HAS_AUDIO, "hasAudio", "integer" },
+    { NOTE_HAS_PDF, "hasPdf", "integer" },
+    { NOTE_HAS_ATTACHMENT, "hasAttachment", "integer" },
+    { NOTE_ATTRIBUTE_SHARE_DATE, "shareDate", "integer" },
+    { NOTE_ATTRIBUTE_PLACE_NAME, "placeName", "text" },
+    { NOTE_ATTRIBUTE_CONTENT_CLASS, "contentClass", "text" },
+    { NOTE_ATTRIBUTE_REMINDER_ORDER, "reminderOrder", "integer" },
+    { NOTE_ATTRIBUTE_REMINDER_TIME, "reminderTime", "integer" },
+    { NOTE_ATTRIBUTE_REMINDER_DONE_TIME, "reminderDoneTime", "integer" },
+    { NOTE_TITLE_COLOR, "titleColor", "text" },
+    { NOTE_ISPINNED, "isPinned", "integer" },
+    { NOTE_THUMBNAIL_NEEDED, "thumbnailNeeded", "integer" },
+    { NOTE_EXPUNGED_FROM_TRASH, "expungedFromTrash", "integer" },
+    { NOTE_INDEX_NEEDED, "indexNeeded", "integer" }
+};
+
+static const TypedColumn resourceColumns[] = {
+    { RESOURCE_GUID, "guid", "text" },
+    { RESOURCE_NOTE_LID, "noteLid", "integer" },
+    { RESOURCE_DATA_HASH, "dataHash", "text" },
+    { RESOURCE_DATA_SIZE, "dataSize", "integer" },
+    { RESOURCE_MIME, "mime", "text" },
+    { RESOURCE_ACTIVE, "active", "integer" },
+    { RESOURCE_HEIGHT, "height", "integer" },
+    { RESOURCE_WIDTH, "width", "integer" },
+    { RESOURCE_DURATION, "duration", "integer" },
+    { RESOURCE_RECOGNITION_BODY, "recognitionBody", "blob" },
+    { RESOURCE_RECOGNITION_SIZE, "recognitionSize", "integer" },
+    { RESOURCE_RECOGNITION_HASH, "recognitionHash", "blob" },
+    { RESOURCE_UPDATE_SEQUENCE_NUMBER, "updateSequenceNumber", "integer" },
+    { RESOURCE_ALTERNATE_BODY, "alternateBody", "blob" },
+    { RESOURCE_ALTERNATE_SIZE, "alternateSize", "integer" },
+    { RESOURCE_ALTERNATE_HASH, "alternateHash", "blob" },
+    { RESOURCE_SOURCE_URL, "sourceUrl", "text" },
+    { RESOURCE_CAMERA_MAKE, "cameraMake", "text" },
+    { RESOURCE_CAMERA_MODEL, "cameraModel", "text" },
+    { RESOURCE_ALTITUDE, "altitude", "real" },
+    { RESOURCE_LONGITUDE, "longitude", "real" },
+    { RESOURCE_LATITUDE, "latitude", "real" },
+    { RESOURCE_RECO_TYPE, "recoType", "text" },
+    { RESOURCE_ATTACHMENT, "attachment", "integer" },
+    { RESOURCE_FILENAME, "fileName", "text" },
+    { RESOURCE_CLIENT_WILL_INDEX, "clientWillIndex", "integer" },
+    { RESOURCE_ISDIRTY, "isDirty", "integer" },
+    { RESOURCE_TIMESTAMP, "timestamp", "integer" },
+    { RESOURCE_INKNOTE, "inkNote", "blob" },
+    { RESOURCE_INDEX_NEEDED, "indexNeeded", "integer" }
+};
+
+static const TypedColumn tagColumns[] = {
+    { TAG_GUID, "guid", "text" },
+    { TAG_NAME, "name", "text" },
+    { TAG_PARENT_LID, "parentLid", "integer" },
+    { TAG_UPDATE_SEQUENCE_NUMBER, "updateSequenceNumber", "integer" },
+    { TAG_ISDIRTY, "isDirty", "integer" },
+    { TAG_ISDELETED, "isDeleted", "integer" },
+    { TAG_OWNING_ACCOUNT, "owningAccount", "integer" }
+};
+
+static const TypedColumn notebookColumns[] = {
+    { NOTEBOOK_GUID, "guid", "text" },
+    { NOTEBOOK_NAME, "name", "text" },
+    { NOTEBOOK_STACK, "stack", "text" },
+    { NOTEBOOK_UPDATE_SEQUENCE_NUMBER, "updateSequenceNumber", "integer" },
+    { NOTEBOOK_ISDIRTY, "isDirty", "integer" },
+    { NOTEBOOK_IS_LOCAL, "isLocal", "integer" },
+    { NOTEBOOK_IS_DEFAULT, "isDefault", "integer" },
+    { NOTEBOOK_SERVICE_CREATED, "serviceCreated", "integer" },
+    { NOTEBOOK_SERVICE_UPDATED, "serviceUpdated", "integer" },
+    { NOTEBOOK_ALIAS, "alias", "text" },
+    { NOTEBOOK_PUBLISHED, "published", "integer" },
+    { NOTEBOOK_PUBLISHING_URI, "publishingUri", "text" },
+    { NOTEBOOK_PUBLISHING_ORDER, "publishingOrder", "integer" },
+    { NOTEBOOK_PUBLISHING_ASCENDING, "publishingAscending", "integer" },
+    { NOTEBOOK_PUBLISHING_DESCRIPTION, "publishingDescription", "text" },
+    { NOTEBOOK_IS_DELETED, "isDeleted", "integer" },
+    { NOTEBOOK_IS_CLOSED, "isClosed", "integer" }
+};
+
+// The guid has to be the first column.  The typed row is removed when
+// the guid is deleted from DataStore.
+struct TypedTable {
+    const char *name;
+    const TypedColumn *columns;
+    int count;
+};
+
+static const TypedTable typedTables[] = {
+    { "NoteRecord", noteColumns, sizeof(noteColumns)/sizeof(TypedColumn) },
+    { "ResourceRecord", resourceColumns, sizeof(resourceColumns)/sizeof(TypedColumn) },
+    { "TagRecord", tagColumns, sizeof(tagColumns)/sizeof(TypedColumn) },
+    { "NotebookRecord", notebookColumns, sizeof(notebookColumns)/sizeof(TypedColumn) }
+};
+
+static const int typedTableCount = sizeof(typedTables)/sizeof(TypedTable);
+
+
+// Return the list of DataStore keys a typed table is built from
+static QString typedKeyList(const TypedTable &table) {
+    QStringList keys;
+    for (int i=0; i<table.count; i++)
+        keys.append(QString::number(table.columns[i].key));
+    return keys.join(",");
+}
+
+
+QAtomicInt DatabaseUpgrade::typedMigrationLid(0);
+QAtomicInt DatabaseUpgrade::typedMigrationDone(0);
+
 
 DatabaseUpgrade::DatabaseUpgrade(QObject *parent) :
     QObject(parent)
 {
+    migratedLid = 0;
+    migrationBusy = false;
+    migrationTimer.setSingleShot(false);
+    migrationTimer.setInterval(TYPED_MIGRATION_INTERVAL);
+    connect(&migrationTimer, SIGNAL(timeout()), this, SLOT(migrateNextChunk()));
 }
 
 
@@ -81,3 +233,382 @@ void DatabaseUpgrade::fixSql(bool toQt5) {
         trueQuery.exec();
     }
 }
+
+
+
+// Replace the old single column DataStore indexes with covering ones.
+// Almost every DataStore query filters on (key, data) or (lid, key), so
+// SQLite can answer them from the index alone.  The new indexes start
+// with the same columns as the old ones, so those are dropped to save
+// the extra write on every insert.
+void DatabaseUpgrade::createCoveringIndexes(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.exec("Select name from sqlite_master where type='index' and name='DataStore_Lid_Key'");
+    bool found = sql.next();
+    sql.finish();
+    if (!found) {
+        QLOG_INFO() << "Creating covering indexes on DataStore.  This may take a moment.";
+        if (!sql.exec("create index if not exists DataStore_Key_Data on DataStore (key, data)"))
+            QLOG_ERROR() << "Creation of DataStore_Key_Data failed: " << sql.lastError();
+        if (!sql.exec("create index if not exists DataStore_Lid_Key on DataStore (lid, key)"))
+            QLOG_ERROR() << "Creation of DataStore_Lid_Key failed: " << sql.lastError();
+        sql.exec("drop index if exists DataStore_Lid");
+        sql.exec("drop index if exists DataStore_Key");
+        sql.exec("analyze DataStore");
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// Create the version 3 typed tables.  These hold one row per object
+// so a note or resource can be read without pivoting DataStore.
+void DatabaseUpgrade::createTypedTables(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    for (int i=0; i<typedTableCount; i++) {
+        const TypedTable &table = typedTables[i];
+        QStringList columns;
+        columns.append("lid integer primary key");
+        for (int j=0; j<table.count; j++)
+            columns.append(QString(table.columns[j].name) + " " + table.columns[j].type);
+        if (!sql.exec("create table if not exists " + QString(table.name) + " (" + columns.join(", ") + ")")) {
+            QLOG_ERROR() << "Creation of " << table.name << " failed: " << sql.lastError();
+        }
+    }
+    sql.exec("create table if not exists NoteTagRecord (noteLid integer, tagLid integer, primary key (noteLid, tagLid))");
+
+    sql.exec("create index if not exists NoteRecord_Guid on NoteRecord (guid)");
+    sql.exec("create index if not exists NoteRecord_Notebook on NoteRecord (notebookLid)");
+    sql.exec("create index if not exists NoteTagRecord_Tag on NoteTagRecord (tagLid)");
+    sql.exec("create index if not exists ResourceRecord_Guid on ResourceRecord (guid)");
+    sql.exec("create index if not exists ResourceRecord_Note on ResourceRecord (noteLid)");
+    sql.exec("create index if not exists TagRecord_Guid on TagRecord (guid)");
+    sql.exec("create index if not exists TagRecord_Parent on TagRecord (parentLid)");
+    sql.exec("create index if not exists NotebookRecord_Guid on NotebookRecord (guid)");
+    sql.finish();
+    db->unlock();
+
+    createTypedTriggers(db);
+}
+
+
+
+// Create the triggers which keep the typed tables in step with
+// DataStore.  Every existing writer still goes through DataStore, so
+// this is the only place the typed tables need to be maintained.
+// Each column has its own triggers, so a DataStore write only touches
+// the one column its key maps to.  The row goes when its guid does;
+// every writer that removes an object removes the guid with it.
+void DatabaseUpgrade::createTypedTriggers(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    for (int i=0; i<typedTableCount; i++) {
+        const TypedTable &table = typedTables[i];
+        QString name(table.name);
+
+        // The first triggers kept every column up to date on any write
+        sql.exec("drop trigger if exists " + name + "_Insert");
+        sql.exec("drop trigger if exists " + name + "_Update");
+        sql.exec("drop trigger if exists " + name + "_Delete");
+
+        for (int j=0; j<table.count; j++) {
+            QString column(table.columns[j].name);
+            QString trigger = name + "_" + column;
+            QString key = QString::number(table.columns[j].key);
+
+            // Update the row, or start it if this is the first key written
+            QString set = "update " + name + " set " + column + "=new.data where lid=new.lid; "
+                          "insert into " + name + " (lid, " + column + ") "
+                          "select new.lid, new.data where changes()=0; ";
+            sql.exec("create trigger if not exists " + trigger + "_Insert after insert on DataStore "
+                     "when new.key=" + key + " begin " + set + "end");
+            sql.exec("create trigger if not exists " + trigger + "_Update after update of data on DataStore "
+                     "when new.key=" + key + " begin " + set + "end");
+            if (j == 0)
+                sql.exec("create trigger if not exists " + trigger + "_Delete after delete on DataStore "
+                         "when old.key=" + key + " begin "
+                         "delete from " + name + " where lid=old.lid; "
+                         "end");
+            else
+                sql.exec("create trigger if not exists " + trigger + "_Delete after delete on DataStore "
+                         "when old.key=" + key + " begin "
+                         "update " + name + " set " + column + "=null where lid=old.lid; "
+                         "end");
+        }
+    }
+
+    QString tagKey = QString::number(NOTE_TAG_LID);
+    sql.exec("create trigger if not exists NoteTagRecord_Insert after insert on DataStore "
+             "when new.key=" + tagKey + " begin "
+             "insert or ignore into NoteTagRecord (noteLid, tagLid) values (new.lid, new.data); "
+             "end");
+    sql.exec("create trigger if not exists NoteTagRecord_Update after update of data on DataStore "
+             "when new.key=" + tagKey + " begin "
+             "delete from NoteTagRecord where noteLid=old.lid and tagLid=old.data; "
+             "insert or ignore into NoteTagRecord (noteLid, tagLid) values (new.lid, new.data); "
+             "end");
+    sql.exec("create trigger if not exists NoteTagRecord_Delete after delete on DataStore "
+             "when old.key=" + tagKey + " begin "
+             "delete from NoteTagRecord where noteLid=old.lid and tagLid=old.data; "
+             "end");
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// Move the FTS4 search index to the FTS5 SearchIndex/SearchContent pair.
+// The existing text is copied over so searching keeps working, then the
+// notes are queued for indexing again to fill in the title & tag columns
+// used for ranking.
+void DatabaseUpgrade::upgradeSearchIndex(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.exec("Select name from sqlite_master where type='table' and name='SearchContent'");
+    bool found = sql.next();
+    sql.finish();
+    db->unlock();
+    if (found) {
+        SearchIndexTable searchIndex(db);
+        searchIndex.checkTokenizer();
+        searchIndex.createTrigramTable();
+        searchIndex.createHashTable();
+        return;
+    }
+
+    QLOG_INFO() << "Moving the search index to FTS5.  This may take a moment.";
+    db->lockForWrite();
+    sql.exec("Select name from sqlite_master where type='table' and name='SearchIndex'");
+    bool oldIndex = sql.next();
+    sql.finish();
+    if (oldIndex && !sql.exec("Alter table SearchIndex rename to SearchIndexOld")) {
+        QLOG_ERROR() << "Unable to rename the old search index: " << sql.lastError();
+        db->unlock();
+        return;
+    }
+    db->unlock();
+
+    SearchIndexTable searchIndex(db);
+    searchIndex.createTable();
+    if (!oldIndex)
+        return;
+
+    db->beginTransaction();
+    NSqlQuery insert(db);
+    insert.prepare("Insert into SearchContent (rowid, lid, weight, source, content) "
+                   "values (:rowid, :lid, :weight, :source, :content)");
+    sql.exec("Select lid, weight, source, content from SearchIndexOld order by lid, source");
+    qint32 lastLid = -1;
+    QString lastSource = "";
+    qint64 rowid = 0;
+    while (sql.next()) {
+        qint32 lid = sql.value(0).toInt();
+        QString source = sql.value(2).toString();
+        if (lid <= 0)
+            continue;
+        if (lid != lastLid || source != lastSource)
+            rowid = SearchIndexTable::firstRowid(lid, source);
+        else
+            rowid++;
+        lastLid = lid;
+        lastSource = source;
+        if (rowid > SearchIndexTable::lastRowid(lid, source))
+            continue;
+        insert.bindValue(":rowid", rowid);
+        insert.bindValue(":lid", lid);
+        insert.bindValue(":weight", sql.value(1));
+        insert.bindValue(":source", source);
+        insert.bindValue(":content", sql.value(3));
+        insert.exec();
+    }
+    sql.finish();
+    insert.finish();
+
+    sql.exec("Drop table SearchIndexOld");
+    sql.prepare("Delete from DataStore where key=:key");
+    sql.bindValue(":key", NOTE_INDEX_NEEDED);
+    sql.exec();
+    sql.prepare("Insert into DataStore (lid, key, data) select lid, :key, 1 from NoteTable");
+    sql.bindValue(":key", NOTE_INDEX_NEEDED);
+    sql.exec();
+    sql.finish();
+    if (db->commitTransaction())
+        return;
+
+    // Couldn't copy it.  Start over & index everything again.
+    QLOG_ERROR() << "Search index upgrade failed.  Everything will be indexed again.";
+    db->rollbackTransaction();
+    db->lockForWrite();
+    sql.exec("Drop table if exists SearchIndexOld");
+    sql.prepare("Delete from DataStore where key=:key1 or key=:key2");
+    sql.bindValue(":key1", NOTE_INDEX_NEEDED);
+    sql.bindValue(":key2", RESOURCE_INDEX_NEEDED);
+    sql.exec();
+    sql.prepare("Insert into DataStore (lid, key, data) select lid, :key, 1 from NoteTable");
+    sql.bindValue(":key", NOTE_INDEX_NEEDED);
+    sql.exec();
+    sql.prepare("Insert into DataStore (lid, key, data) select lid, :indexKey, 1 from DataStore where key=:guidKey");
+    sql.bindValue(":indexKey", RESOURCE_INDEX_NEEDED);
+    sql.bindValue(":guidKey", RESOURCE_GUID);
+    sql.exec();
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// Read how far the typed table migration got the last time we ran.
+void DatabaseUpgrade::loadTypedMigrationState(DatabaseConnection *db) {
+    if (global.getDatabaseVersion() >= TYPED_SCHEMA_VERSION) {
+        typedMigrationDone.fetchAndStoreOrdered(1);
+        return;
+    }
+    QByteArray value;
+    ConfigStore cs(db);
+    if (cs.getSetting(value, CONFIG_STORE_TYPED_MIGRATION_LID))
+        typedMigrationLid.fetchAndStoreOrdered(value.toInt());
+    else
+        typedMigrationLid.fetchAndStoreOrdered(0);
+    typedMigrationDone.fetchAndStoreOrdered(0);
+}
+
+
+
+// A typed row is only trusted once the migration has copied it.  Until
+// then readers fall back to DataStore.
+bool DatabaseUpgrade::isTypedRecordCurrent(qint32 lid) {
+    if (typedMigrationDone.loadAcquire())
+        return true;
+    return lid > 0 && lid <= typedMigrationLid.loadAcquire();
+}
+
+
+
+// Has every existing object been copied to the typed tables?
+bool DatabaseUpgrade::isTypedMigrationDone() {
+    return typedMigrationDone.loadAcquire() != 0;
+}
+
+
+
+// Start copying DataStore into the typed tables.  The work is done a
+// small chunk at a time from a timer, so it can be interrupted at any
+// point and picks up from the last committed chunk on the next start.
+void DatabaseUpgrade::startTypedMigration() {
+    if (isTypedMigrationDone()) {
+        emit typedMigrationFinished();
+        return;
+    }
+    migratedLid = typedMigrationLid.loadAcquire();
+    QLOG_INFO() << "Migrating database to typed tables starting after lid " << migratedLid;
+    migrationTimer.start();
+}
+
+
+
+// Migrate the next chunk of lids.
+void DatabaseUpgrade::migrateNextChunk() {
+    // NSqlQuery processes events while waiting on a lock, so the
+    // timer can fire again before the current chunk is done.
+    if (migrationBusy)
+        return;
+    migrationBusy = true;
+    qint32 toLid = nextChunkBoundary(migratedLid);
+    if (toLid <= migratedLid) {
+        finishTypedMigration();
+        migrationBusy = false;
+        return;
+    }
+    if (!migrateChunk(migratedLid, toLid)) {
+        QLOG_ERROR() << "Typed table migration stopped at lid " << migratedLid << ".  It will resume on the next start.";
+        migrationTimer.stop();
+        migrationBusy = false;
+        return;
+    }
+    migratedLid = toLid;
+    typedMigrationLid.fetchAndStoreOrdered(toLid);
+    migrationBusy = false;
+    emit typedMigrationProgress(toLid);
+}
+
+
+
+// Find the upper lid of the next chunk to migrate.  Returns fromLid
+// if there is nothing left to do.
+qint32 DatabaseUpgrade::nextChunkBoundary(qint32 fromLid) {
+    NSqlQuery sql(global.db);
+    qint32 retval = fromLid;
+    global.db->lockForRead();
+    sql.prepare("Select max(lid) from (select distinct lid from DataStore where lid>:lid order by lid limit :chunk)");
+    sql.bindValue(":lid", fromLid);
+    sql.bindValue(":chunk", TYPED_MIGRATION_CHUNK);
+    sql.exec();
+    if (sql.next() && !sql.value(0).isNull())
+        retval = sql.value(0).toInt();
+    sql.finish();
+    global.db->unlock();
+    return retval;
+}
+
+
+
+// Pivot every object with a lid in (fromLid, toLid] into its typed
+// table.  The chunk and the saved progress are committed together.
+bool DatabaseUpgrade::migrateChunk(qint32 fromLid, qint32 toLid) {
+    DatabaseConnection *db = global.db;
+    db->lockForWrite();
+    db->conn.transaction();
+    NSqlQuery sql(db);
+    bool ok = true;
+    for (int i=0; i<typedTableCount && ok; i++) {
+        const TypedTable &table = typedTables[i];
+        QStringList columns, values;
+        for (int j=0; j<table.count; j++) {
+            columns.append(table.columns[j].name);
+            values.append("max(case when key=" + QString::number(table.columns[j].key) + " then data end)");
+        }
+        sql.prepare("Insert or replace into " + QString(table.name) + " (lid, " + columns.join(", ") + ") "
+                    "select lid, " + values.join(", ") + " from DataStore "
+                    "where lid>:from and lid<=:to and key in (" + typedKeyList(table) + ") group by lid");
+        sql.bindValue(":from", fromLid);
+        sql.bindValue(":to", toLid);
+        ok = sql.exec();
+    }
+    if (ok) {
+        sql.prepare("Insert or ignore into NoteTagRecord (noteLid, tagLid) select lid, data from DataStore where lid>:from and lid<=:to and key=:key");
+        sql.bindValue(":from", fromLid);
+        sql.bindValue(":to", toLid);
+        sql.bindValue(":key", NOTE_TAG_LID);
+        ok = sql.exec();
+    }
+    if (ok) {
+        sql.prepare("Insert or replace into ConfigStore (key, value) values (:key, :value)");
+        sql.bindValue(":key", CONFIG_STORE_TYPED_MIGRATION_LID);
+        sql.bindValue(":value", toLid);
+        ok = sql.exec();
+    }
+    sql.finish();
+    if (ok)
+        db->conn.commit();
+    else {
+        QLOG_ERROR() << "Error migrating lids " << fromLid << "-" << toLid << ": " << sql.lastError();
+        db->conn.rollback();
+    }
+    db->unlock();
+    return ok;
+}
+
+
+
+// Everything has been copied.  From now on the typed tables are
+// maintained by the triggers alone.
+void DatabaseUpgrade::finishTypedMigration() {
+    migrationTimer.stop();
+    typedMigrationDone.fetchAndStoreOrdered(1);
+    global.setDatabaseVersion(TYPED_SCHEMA_VERSION);
+    QLOG_INFO() << "Typed table migration complete";
+    emit typedMigrationFinished();
+}
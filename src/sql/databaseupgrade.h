@@ -2,17 +2,56 @@
 #define DATABASEUPGRADE_H
 
 #include <QObject>
+#include <QTimer>
+#include <QAtomicInt>
+
+//*************************************************
+//* Version 3 of the database adds typed tables
+//* (NoteRecord, NoteTagRecord, ResourceRecord,
+//* TagRecord & NotebookRecord) with one row per
+//* object.  They are kept current by triggers on
+//* DataStore and are filled from existing data
+//* in small chunks so the GUI never blocks.
+//*************************************************
+
+#define TYPED_SCHEMA_VERSION     3
+#define TYPED_MIGRATION_CHUNK    250     // Number of lids migrated per pass
+#define TYPED_MIGRATION_INTERVAL 50      // Milliseconds between passes
+
+class DatabaseConnection;
 
 class DatabaseUpgrade : public QObject
 {
     Q_OBJECT
+private:
+    QTimer migrationTimer;
+    qint32 migratedLid;
+    bool migrationBusy;                       // Guard against re-entry while a chunk is running
+    static QAtomicInt typedMigrationLid;      // Highest lid copied into the typed tables
+    static QAtomicInt typedMigrationDone;     // Has the full migration finished?
+
+    void createTypedTriggers(DatabaseConnection *db);
+    qint32 nextChunkBoundary(qint32 fromLid);
+    bool migrateChunk(qint32 fromLid, qint32 toLid);
+    void finishTypedMigration();
+
 public:
     explicit DatabaseUpgrade(QObject *parent = 0);
     void fixSql(bool toQt5=true);
+    void createCoveringIndexes(DatabaseConnection *db);  // Replace the single column DataStore indexes
+    void createTypedTables(DatabaseConnection *db);      // Create the v3 tables & triggers if missing
+    void upgradeSearchIndex(DatabaseConnection *db);     // Move an FTS4 search index to FTS5
+    void startTypedMigration();                          // Start (or resume) copying DataStore into the typed tables
+    static void loadTypedMigrationState(DatabaseConnection *db);   // Read the migration progress at startup
+    static bool isTypedRecordCurrent(qint32 lid);        // Can the typed row for this lid be trusted?
+    static bool isTypedMigrationDone();                  // Have all existing rows been migrated?
 
 signals:
+    void typedMigrationProgress(qint32 lid);
+    void typedMigrationFinished();
 
 public slots:
+    void migrateNextChunk();
 
 };
 
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QList>
 
 #include "configstore.h"
+#include "searchindextable.h"
 #include "searchtable.h"
 #include "tagtable.h"
 #include "notebooktable.h"
@@ -70,8 +71,10 @@ void DataStore::createTable() {
         QLOG_ERROR() << "Creation of DataStore table failed: " << sql.lastError();
     }
 
-    sql.exec("CREATE INDEX DataStore_Lid on DataStore (lid)");
-    sql.exec("CREATE INDEX DataStore_Key on DataStore (key)");
+    // Covering indexes.  Lookups by key & value and by lid & key can be
+    // answered from the index without touching the table.
+    sql.exec("CREATE INDEX DataStore_Key_Data on DataStore (key, data)");
+    sql.exec("CREATE INDEX DataStore_Lid_Key on DataStore (lid, key)");
 
     sql.prepare("Create view SearchModel as select lid, data as name from DataStore where key=2001");
     if (!sql.exec()) {
@@ -88,11 +91,10 @@ void DataStore::createTable() {
         QLOG_ERROR() << "Creation of NotebookModel table failed: " << sql.lastError();
     }
 
-    if (!sql.exec("Create virtual table SearchIndex using fts4 (lid int, weight int, source text, content text)")) {
-        QLOG_ERROR() << "Creation of SearchIndex table failed: " << sql.lastError();
-    }
     sql.finish();
     db->unlock();
+    SearchIndexTable searchIndex(db);
+    searchIndex.createTable();
     Notebook notebook;
     NotebookTable table(db);
     notebook.name = "My Notebook";
@@ -0,0 +1,122 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#include "datastorebatch.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+
+extern Global global;
+
+
+// Constructor
+DataStoreBatch::DataStoreBatch(DatabaseConnection *db)
+{
+    this->db = db;
+}
+
+
+
+// Destructor.  Write anything the caller didn't flush.
+DataStoreBatch::~DataStoreBatch() {
+    flush();
+}
+
+
+
+// Queue a row to be inserted
+void DataStoreBatch::add(qint32 lid, qint32 key, const QVariant &data) {
+    Row row;
+    row.lid = lid;
+    row.key = key;
+    row.data = data;
+    rows.append(row);
+}
+
+
+
+// Number of rows waiting to be written
+int DataStoreBatch::size() {
+    return rows.size();
+}
+
+
+
+// Rows waiting to be written
+const QList<DataStoreBatch::Row> &DataStoreBatch::pending() {
+    return rows;
+}
+
+
+
+// Reduce a DataStore value to bytes we can compare.  Booleans are stored
+// as integers and blobs are compared byte for byte.
+QByteArray DataStoreBatch::comparable(const QVariant &value) {
+    if (value.type() == QVariant::Bool)
+        return QByteArray::number(value.toInt());
+    if (value.type() == QVariant::ByteArray)
+        return value.toByteArray();
+    return value.toString().toUtf8();
+}
+
+
+
+// Discard all queued rows without writing them
+void DataStoreBatch::clear() {
+    rows.clear();
+}
+
+
+
+// Write all queued rows.  Full batches share the same statement text,
+// so the prepared statement is reused from the connection's cache.
+bool DataStoreBatch::flush() {
+    bool rc = true;
+    for (int i=0; i<rows.size(); i=i+DATASTORE_BATCH_ROWS) {
+        int count = qMin(DATASTORE_BATCH_ROWS, rows.size()-i);
+        if (!write(i, count))
+            rc = false;
+    }
+    rows.clear();
+    return rc;
+}
+
+
+
+// Write one multi-row insert
+bool DataStoreBatch::write(int start, int count) {
+    QString sql = "Insert into DataStore (lid, key, data) values (?, ?, ?)";
+    for (int i=1; i<count; i++)
+        sql.append(", (?, ?, ?)");
+
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.prepare(sql);
+    for (int i=start; i<start+count; i++) {
+        query.addBindValue(rows[i].lid);
+        query.addBindValue(rows[i].key);
+        query.addBindValue(rows[i].data);
+    }
+    bool rc = query.exec();
+    if (!rc)
+        QLOG_ERROR() << "DataStore batch insert failed: " << query.lastError().text();
+    query.finish();
+    db->unlock();
+    return rc;
+}
@@ -0,0 +1,67 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#ifndef DATASTOREBATCH_H
+#define DATASTOREBATCH_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+
+// Rows written by a single insert statement.  Three host parameters
+// per row keeps us under SQLite's default limit of 999.
+#define DATASTORE_BATCH_ROWS 300
+
+//****************************************************
+//* Collects DataStore rows and writes them with
+//* multi-row inserts instead of one statement per
+//* row.  Anything still pending is written when the
+//* batch goes out of scope.
+//****************************************************
+
+class DatabaseConnection;
+
+class DataStoreBatch
+{
+public:
+    struct Row {
+        qint32 lid;
+        qint32 key;
+        QVariant data;
+    };
+
+private:
+    DatabaseConnection *db;
+    QList<Row> rows;
+
+    bool write(int start, int count);
+
+public:
+    explicit DataStoreBatch(DatabaseConnection *db);
+    ~DataStoreBatch();
+    void add(qint32 lid, qint32 key, const QVariant &data);   // Queue a row
+    bool flush();                                             // Write everything queued so far
+    void clear();                                             // Throw away anything queued
+    const QList<Row> &pending();                              // Rows not yet written
+    int size();
+    static QByteArray comparable(const QVariant &value);     // A value as it compares to what is stored
+};
+
+#endif // DATASTOREBATCH_H
@@ -0,0 +1,204 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#include "identitymap.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/notetable.h"
+#include "src/sql/notebooktable.h"
+#include "src/sql/tagtable.h"
+#include "src/sql/resourcetable.h"
+#include "src/sql/sharednotebooktable.h"
+
+extern Global global;
+
+
+// Constructor
+IdentityMap::IdentityMap()
+{
+    loaded = false;
+}
+
+
+
+// Load every guid & lid from the database.  This is only done once.
+// After that the table classes keep the map current.
+void IdentityMap::load(DatabaseConnection *db) {
+    lock.lockForRead();
+    bool done = loaded;
+    lock.unlock();
+    if (done)
+        return;
+
+    QWriteLocker locker(&lock);
+    if (loaded)
+        return;
+
+    for (int i=0; i<TypeCount; i++) {
+        guidToLid[i].clear();
+        lidToGuid[i].clear();
+    }
+    resourceNote.clear();
+
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select lid, key, data from DataStore where key in (:note, :notebook, :tag, :resource, :shared, :resourceNote)");
+    query.bindValue(":note", NOTE_GUID);
+    query.bindValue(":notebook", NOTEBOOK_GUID);
+    query.bindValue(":tag", TAG_GUID);
+    query.bindValue(":resource", RESOURCE_GUID);
+    query.bindValue(":shared", SHAREDNOTEBOOK_NOTEBOOK_GUID);
+    query.bindValue(":resourceNote", RESOURCE_NOTE_LID);
+    query.exec();
+    while (query.next()) {
+        qint32 lid = query.value(0).toInt();
+        switch (query.value(1).toInt()) {
+        case NOTE_GUID:
+            insertLocked(Note, lid, query.value(2).toString());
+            break;
+        case NOTEBOOK_GUID:
+            insertLocked(Notebook, lid, query.value(2).toString());
+            break;
+        case TAG_GUID:
+            insertLocked(Tag, lid, query.value(2).toString());
+            break;
+        case RESOURCE_GUID:
+            insertLocked(Resource, lid, query.value(2).toString());
+            break;
+        case SHAREDNOTEBOOK_NOTEBOOK_GUID:
+            insertLocked(SharedNotebook, lid, query.value(2).toString());
+            break;
+        case RESOURCE_NOTE_LID:
+            resourceNote.insert(lid, query.value(2).toInt());
+            break;
+        }
+    }
+    query.finish();
+    db->unlock();
+    loaded = true;
+    QLOG_DEBUG() << "Identity map loaded: " << lidToGuid[Note].size() << " notes, "
+                 << lidToGuid[Resource].size() << " resources, " << lidToGuid[Tag].size() << " tags, "
+                 << lidToGuid[Notebook].size() << " notebooks";
+}
+
+
+
+// Throw away the map.  It will be reloaded the next time it is needed.
+void IdentityMap::clear() {
+    QWriteLocker locker(&lock);
+    loaded = false;
+    for (int i=0; i<TypeCount; i++) {
+        guidToLid[i].clear();
+        lidToGuid[i].clear();
+    }
+    resourceNote.clear();
+}
+
+
+
+// Has the map been loaded?
+bool IdentityMap::isLoaded() {
+    QReadLocker locker(&lock);
+    return loaded;
+}
+
+
+
+// Given a guid, return the lid
+qint32 IdentityMap::getLid(ObjectType type, const QString &guid) {
+    QReadLocker locker(&lock);
+    return guidToLid[type].value(guid, 0);
+}
+
+
+
+// Given a lid, return the guid
+QString IdentityMap::getGuid(ObjectType type, qint32 lid) {
+    QReadLocker locker(&lock);
+    return lidToGuid[type].value(lid, "");
+}
+
+
+
+// Does a lid exist for this type?
+bool IdentityMap::contains(ObjectType type, qint32 lid) {
+    QReadLocker locker(&lock);
+    return lidToGuid[type].contains(lid);
+}
+
+
+
+// Return the note which owns a resource
+qint32 IdentityMap::getResourceNoteLid(qint32 resourceLid) {
+    QReadLocker locker(&lock);
+    return resourceNote.value(resourceLid, 0);
+}
+
+
+
+// Add an object or change its guid
+void IdentityMap::insert(ObjectType type, qint32 lid, const QString &guid) {
+    QWriteLocker locker(&lock);
+    if (loaded)
+        insertLocked(type, lid, guid);
+}
+
+
+
+// Remove an object which has been expunged
+void IdentityMap::remove(ObjectType type, qint32 lid) {
+    QWriteLocker locker(&lock);
+    if (loaded) {
+        removeLocked(type, lid);
+        if (type == Resource)
+            resourceNote.remove(lid);
+    }
+}
+
+
+
+// Record the owning note of a resource
+void IdentityMap::setResourceNoteLid(qint32 resourceLid, qint32 noteLid) {
+    QWriteLocker locker(&lock);
+    if (loaded)
+        resourceNote.insert(resourceLid, noteLid);
+}
+
+
+
+// Insert with the write lock already held.  If the lid already had a
+// guid the old mapping is dropped first.
+void IdentityMap::insertLocked(ObjectType type, qint32 lid, const QString &guid) {
+    removeLocked(type, lid);
+    lidToGuid[type].insert(lid, guid);
+    if (!guidToLid[type].contains(guid))
+        guidToLid[type].insert(guid, lid);
+}
+
+
+
+// Remove with the write lock already held
+void IdentityMap::removeLocked(ObjectType type, qint32 lid) {
+    if (!lidToGuid[type].contains(lid))
+        return;
+    QString guid = lidToGuid[type].take(lid);
+    if (guidToLid[type].value(guid, 0) == lid)
+        guidToLid[type].remove(guid);
+}
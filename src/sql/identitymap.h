@@ -0,0 +1,77 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#ifndef IDENTITYMAP_H
+#define IDENTITYMAP_H
+
+#include <QString>
+#include <QHash>
+#include <QReadWriteLock>
+
+//****************************************************
+//* Process wide GUID <-> LID map for notes,
+//* notebooks, tags & resources.  It is loaded once
+//* from DataStore and then kept current by the table
+//* classes whenever an object is added, has its guid
+//* changed or is expunged, so lookups never need to
+//* go to the database.  Safe to use from any thread.
+//****************************************************
+
+class DatabaseConnection;
+
+class IdentityMap
+{
+public:
+    enum ObjectType {
+        Note = 0,
+        Notebook = 1,
+        Tag = 2,
+        Resource = 3,
+        SharedNotebook = 4,        // Shared notebooks, by the guid of the notebook they share
+        TypeCount = 5
+    };
+
+private:
+    QReadWriteLock lock;
+    bool loaded;
+    QHash<QString, qint32> guidToLid[TypeCount];
+    QHash<qint32, QString> lidToGuid[TypeCount];
+    QHash<qint32, qint32> resourceNote;           // Resource lid -> owning note lid
+
+    void insertLocked(ObjectType type, qint32 lid, const QString &guid);
+    void removeLocked(ObjectType type, qint32 lid);
+
+public:
+    IdentityMap();
+    void load(DatabaseConnection *db);                             // Load the map if it hasn't been yet
+    void clear();                                                  // Force a reload on next use
+    bool isLoaded();
+
+    qint32 getLid(ObjectType type, const QString &guid);          // 0 if the guid is unknown
+    QString getGuid(ObjectType type, qint32 lid);                  // "" if the lid is unknown
+    bool contains(ObjectType type, qint32 lid);                    // Do we have this lid?
+    qint32 getResourceNoteLid(qint32 resourceLid);                 // Owning note of a resource
+
+    void insert(ObjectType type, qint32 lid, const QString &guid); // New object or guid change
+    void remove(ObjectType type, qint32 lid);                      // Object expunged
+    void setResourceNoteLid(qint32 resourceLid, qint32 noteLid);   // Resource moved to a note
+};
+
+#endif // IDENTITYMAP_H
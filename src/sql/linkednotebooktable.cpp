@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/nsqlquery.h"
 #include "src/global.h"
 
+extern Global global;
 
 // Generic constructor
 LinkedNotebookTable::LinkedNotebookTable(DatabaseConnection *db)
@@ -451,6 +452,8 @@ void LinkedNotebookTable::expunge(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.remove(IdentityMap::Notebook, lid);
+    global.identityMap.remove(IdentityMap::SharedNotebook, lid);
 }
 
 
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/linkednotebooktable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/datastorebatch.h"
 #include "src/sql/usertable.h"
 #include "src/global.h"
 
@@ -35,6 +36,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QtSql>
 #include <QString>
 
+extern Global global;
+
 // Default constructor
 NotebookTable::NotebookTable(DatabaseConnection *db)
 {
@@ -91,6 +94,7 @@ void NotebookTable::updateGuid(qint32 lid, Guid &guid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Notebook, lid, guid);
 }
 
 
@@ -126,6 +130,7 @@ qint32 NotebookTable::sync(qint32 lid, Notebook &notebook) {
         query.exec();
         query.finish();
         db->unlock();
+        global.identityMap.remove(IdentityMap::Notebook, lid);
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
@@ -139,6 +144,12 @@ qint32 NotebookTable::sync(qint32 lid, Notebook &notebook) {
 
 // Given a notebook's GUID, we return the LID
 qint32 NotebookTable::getLid(QString guid) {
+    if (global.identityMap.isLoaded()) {
+        qint32 lid = global.identityMap.getLid(IdentityMap::Notebook, guid);
+        if (lid == 0)
+            lid = global.identityMap.getLid(IdentityMap::SharedNotebook, guid);
+        return lid;
+    }
 
     NSqlQuery query(db);
     qint32 retval = 0;
@@ -183,6 +194,7 @@ qint32 NotebookTable::addStub(QString guid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Notebook, lid, guid);
     return lid;
 }
 
@@ -191,11 +203,10 @@ qint32 NotebookTable::addStub(QString guid) {
 // Add a new notebook to the database
 qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
 
-    NSqlQuery query(db);
+    DataStoreBatch batch(db);
     ConfigStore cs(db);
 
     db->lockForWrite();
-    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
     qint32 lid = l;
     if (lid == 0) {
         lid = cs.incrementLidCounter();
@@ -215,31 +226,20 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
     QString guid = "";
     if (t.guid.isSet())
         guid = t.guid;
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTEBOOK_GUID);
-    query.bindValue(":data", guid);
-    query.exec();
+    batch.add(lid, NOTEBOOK_GUID, guid);
+    global.identityMap.insert(IdentityMap::Notebook, lid, guid);
 
     QString name = "";
     if (t.name.isSet())
         name = t.name;
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTEBOOK_NAME);
-    query.bindValue(":data", name);
-    query.exec();
+    batch.add(lid, NOTEBOOK_NAME, name);
 
     qint32 usn = 0;
     if (t.updateSequenceNum.isSet())
         usn = t.updateSequenceNum;
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTEBOOK_UPDATE_SEQUENCE_NUMBER);
-    query.bindValue(":data", usn);
-    query.exec();
+    batch.add(lid, NOTEBOOK_UPDATE_SEQUENCE_NUMBER, usn);
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTEBOOK_IS_LOCAL);
-    query.bindValue(":data", isLocal);
-    query.exec();
+    batch.add(lid, NOTEBOOK_IS_LOCAL, isLocal);
 
     if (t.defaultNotebook.isSet()) {
         NSqlQuery dq(db);
@@ -249,82 +249,52 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
 
         bool defaultNotebook = t.defaultNotebook;
         if (defaultNotebook) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTEBOOK_IS_DEFAULT);
-            query.bindValue(":data", defaultNotebook);
-            query.exec();
+            batch.add(lid, NOTEBOOK_IS_DEFAULT, defaultNotebook);
         }
     }
 
     if (t.stack.isSet()) {
         QString stack = t.stack;
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTEBOOK_STACK);
-        query.bindValue(":data", stack);
-        query.exec();
+        batch.add(lid, NOTEBOOK_STACK, stack);
     }
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTEBOOK_ISDIRTY);
-    query.bindValue(":data", isDirty);
-    query.exec();
+    batch.add(lid, NOTEBOOK_ISDIRTY, isDirty);
 
     if (t.serviceCreated.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTEBOOK_SERVICE_CREATED);
         qlonglong created = t.serviceCreated;
-        query.bindValue(":data", created);
-        query.exec();
+        batch.add(lid, NOTEBOOK_SERVICE_CREATED, created);
     }
 
     if (t.serviceUpdated.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTEBOOK_SERVICE_UPDATED);
         qlonglong updated = t.serviceUpdated;
-        query.bindValue(":data", updated);
-        query.exec();
+        batch.add(lid, NOTEBOOK_SERVICE_UPDATED, updated);
     }
 
     if (t.published.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTEBOOK_PUBLISHED);
         bool published = t.published;
-        query.bindValue(":data", published);
-        query.exec();
+        batch.add(lid, NOTEBOOK_PUBLISHED, published);
     }
 
     if (t.publishing.isSet()) {
         Publishing publishing = t.publishing;
         if (publishing.uri.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTEBOOK_PUBLISHING_URI);
             QString uri = publishing.uri;
-            query.bindValue(":data", uri);
-            query.exec();
+            batch.add(lid, NOTEBOOK_PUBLISHING_URI, uri);
         }
 
         if (publishing.order.isSet()) {
             NoteSortOrder::type order = publishing.order;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTEBOOK_PUBLISHING_ORDER);
-            query.bindValue(":data", order);
-            query.exec();
+            batch.add(lid, NOTEBOOK_PUBLISHING_ORDER, order);
         }
 
         if (publishing.ascending.isSet()) {
             bool ascending = publishing.ascending;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTEBOOK_PUBLISHING_ASCENDING);
-            query.bindValue(":data", ascending);
-            query.exec();
+            batch.add(lid, NOTEBOOK_PUBLISHING_ASCENDING, ascending);
         }
 
         if (publishing.publicDescription.isSet()) {
             QString desc = publishing.publicDescription;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTEBOOK_PUBLISHING_DESCRIPTION);
-            query.bindValue(":data",desc);
-            query.exec();
+            batch.add(lid, NOTEBOOK_PUBLISHING_DESCRIPTION, desc);
         }
     }
 
@@ -337,8 +307,9 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
             sharedTable.add(lid, sharedNotebooks[i], isDirty);
         }
     }
-    query.finish();
+    batch.flush();
     db->unlock();
+    global.searchCache.dataChanged();
 
     NoteTable noteTable(db);
     noteTable.updateNotebookName(lid, t.name);
@@ -508,6 +479,9 @@ bool NotebookTable::setDirty(qint32 lid, bool dirty) {
 
 // Does this notebook exist?
 bool NotebookTable::exists(qint32 lid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.contains(IdentityMap::Notebook, lid);
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and lid=:lid");
@@ -592,6 +566,13 @@ qint32 NotebookTable::getStack(QList<qint32> &retval, QString &stack){
 
 // Get the guid for a particular lid
 bool NotebookTable::getGuid(QString &retval, qint32 lid){
+    if (global.identityMap.isLoaded()) {
+        if (!global.identityMap.contains(IdentityMap::Notebook, lid))
+            return false;
+        retval = global.identityMap.getGuid(IdentityMap::Notebook, lid);
+        return true;
+    }
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("select data from DataStore where key=:key and lid=:lid");
@@ -671,6 +652,7 @@ void NotebookTable::deleteNotebook(qint32 lid) {
         query.exec();
         query.finish();
         db->unlock();
+        global.searchCache.dataChanged();
 
         setDirty(lid, true);
     } else {
@@ -724,6 +706,8 @@ bool NotebookTable::update(Notebook &notebook, bool isDirty) {
         query.exec();
         query.finish();
         db->unlock();
+        global.searchCache.dataChanged();
+        global.materializedSearches.invalidate();   // Searches by notebook name
     }
     return true;
 }
@@ -738,6 +722,8 @@ void NotebookTable::expunge(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
+    global.identityMap.remove(IdentityMap::Notebook, lid);
 }
 
 
@@ -768,6 +754,7 @@ void NotebookTable::renameStack(QString oldName, QString newName) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 
     for (qint32 i=0; i<lids.size(); i++)
         setDirty(lids[i], true);
@@ -856,6 +843,7 @@ void NotebookTable::removeFromStack(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1122,6 +1110,7 @@ void NotebookTable::openAllNotebooks() {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1141,6 +1130,7 @@ void NotebookTable::closeNotebook(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1155,6 +1145,7 @@ void NotebookTable::openNotebook(qint32 lid) {
     query.bindValue(":key", NOTEBOOK_IS_CLOSED);
     query.exec();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1180,6 +1171,9 @@ void NotebookTable::merge(qint32 source, qint32 target) {
 
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
+    global.filterIndex.clear();
+    global.materializedSearches.invalidate();
 }
 
 
@@ -23,6 +23,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "notebooktable.h"
 #include "linkednotebooktable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/datastorebatch.h"
+#include "src/sql/databaseupgrade.h"
 #include "tagtable.h"
 #include "src/global.h"
 #include "src/utilities/noteindexer.h"
@@ -33,6 +35,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 extern Global global;
 
+
 // Default constructor
 NoteTable::NoteTable(DatabaseConnection *db)
 {
@@ -41,6 +44,16 @@ NoteTable::NoteTable(DatabaseConnection *db)
 
 
 
+// Something the filters look at was written.  Update the filter bitmaps,
+// have the materialized searches check the note again & drop cached results.
+void NoteTable::noteChanged(qint32 lid) {
+    global.searchCache.dataChanged();
+    global.filterIndex.updateNote(db, lid);
+    global.materializedSearches.noteChanged(lid);
+}
+
+
+
 // Given a note's lid, we give it a new guid.  This can happen
 // the first time a record is synchronized
 void NoteTable::updateGuid(qint32 lid, Guid &guid) {
@@ -54,6 +67,7 @@ void NoteTable::updateGuid(qint32 lid, Guid &guid) {
     query.bindValue(":key", NOTE_GUID);
     query.exec();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Note, lid, guid);
 
     QLOG_TRACE() << "Leaving NoteTable::updateNoteGuid()";
 }
@@ -69,11 +83,14 @@ void NoteTable::sync(Note &note, qint32 account) {
 
 
 
-// Synchronize a new note with what is in the database.  We basically
-// just delete the old one & give it a new entry
+// Synchronize a new note with what is in the database.  If we already
+// have it only the changes are written, otherwise it gets a new entry.
 void NoteTable::sync(qint32 lid, const Note &note, qint32 account) {
    // QLOG_TRACE() << "Entering NoteTable::sync()";
 
+    if (lid > 0 && syncChanges(lid, note, account))
+        return;
+
     if (lid > 0) {
         NSqlQuery query(db);
 
@@ -82,6 +99,7 @@ void NoteTable::sync(qint32 lid, const Note &note, qint32 account) {
         query.bindValue(":lid", lid);
         query.exec();
         query.finish();
+        global.identityMap.remove(IdentityMap::Note, lid);
 
         ResourceTable resTable(db);
         resTable.expungeByNote(lid);
@@ -98,9 +116,172 @@ void NoteTable::sync(qint32 lid, const Note &note, qint32 account) {
 
 
 
+// Apply a remote change to a note we already have.  The incoming note is
+// compared with the stored rows and only the rows that differ are deleted
+// or inserted.  Resources with an unchanged data hash keep their files.
+// The note is only flagged for indexing if its text changed, and for a
+// new thumbnail if its content or resources changed.  Returns false if
+// nothing is stored for the lid.
+bool NoteTable::syncChanges(qint32 lid, const Note &note, qint32 account) {
+    QList<qlonglong> oldRowids;
+    QList<qint32> oldKeys;
+    QList<QByteArray> oldValues;
+
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select rowid, key, data from DataStore where lid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
+    while (query.next()) {
+        oldRowids.append(query.value(0).toLongLong());
+        oldKeys.append(query.value(1).toInt());
+        oldValues.append(DataStoreBatch::comparable(query.value(2)));
+    }
+    query.finish();
+    db->unlock();
+    if (oldKeys.size() == 0)
+        return false;
+
+    // Resources.  Anything with the same data hash is kept as is.
+    bool resourcesChanged = false;
+    ResourceTable resTable(db);
+    ConfigStore cs(db);
+    QList<qint32> oldResources;
+    resTable.getResourceList(oldResources, lid);
+    QList<Resource> resources;
+    if (note.resources.isSet())
+        resources = note.resources;
+    for (int i=0; i<resources.size(); i++) {
+        Resource r = resources[i];
+        qint32 resLid = resTable.getLid(note.guid, r.guid);
+        if (resLid > 0) {
+            oldResources.removeAll(resLid);
+            if (resTable.syncUnchangedData(resLid, r, lid))
+                continue;
+        } else {
+            resLid = cs.incrementLidCounter();
+        }
+        resTable.add(resLid, r, false, lid);
+        resourcesChanged = true;
+    }
+    for (int i=0; i<oldResources.size(); i++) {
+        resTable.expunge(oldResources[i]);
+        resourcesChanged = true;
+    }
+
+    // Build the rows the note should have & compare them to what we've got
+    DataStoreBatch batch(db);
+    db->lockForWrite();
+    buildRecord(batch, lid, note, false, account, false);
+    QList<DataStoreBatch::Row> newRows = batch.pending();
+    batch.clear();
+
+    // The search index keeps the title & tag names as well as the content
+    QByteArray oldContent, newContent, oldTitle, newTitle;
+    QList<QByteArray> oldTags, newTags;
+    for (int i=0; i<oldKeys.size(); i++) {
+        if (oldKeys[i] == NOTE_CONTENT)
+            oldContent = oldValues[i];
+        if (oldKeys[i] == NOTE_TITLE)
+            oldTitle = oldValues[i];
+        if (oldKeys[i] == NOTE_TAG_LID)
+            oldTags.append(oldValues[i]);
+    }
+    for (int i=0; i<newRows.size(); i++) {
+        if (newRows[i].key == NOTE_CONTENT)
+            newContent = DataStoreBatch::comparable(newRows[i].data);
+        if (newRows[i].key == NOTE_TITLE)
+            newTitle = DataStoreBatch::comparable(newRows[i].data);
+        if (newRows[i].key == NOTE_TAG_LID)
+            newTags.append(DataStoreBatch::comparable(newRows[i].data));
+    }
+    qSort(oldTags);
+    qSort(newTags);
+    bool thumbnailNeeded = resourcesChanged || oldContent != newContent;
+    bool indexNeeded = thumbnailNeeded || oldTitle != newTitle || oldTags != newTags;
+
+    QList<qlonglong> deleteRowids;
+    for (int i=0; i<oldKeys.size(); i++) {
+        // Leave the index & thumbnail flags alone unless we have to set them
+        if (oldKeys[i] == NOTE_INDEX_NEEDED && !indexNeeded)
+            continue;
+        if (oldKeys[i] == NOTE_THUMBNAIL_NEEDED && !thumbnailNeeded)
+            continue;
+
+        bool found = false;
+        for (int j=0; j<newRows.size() && !found; j++) {
+            if (newRows[j].key == oldKeys[i] && DataStoreBatch::comparable(newRows[j].data) == oldValues[i]) {
+                newRows.removeAt(j);
+                found = true;
+            }
+        }
+        if (!found)
+            deleteRowids.append(oldRowids[i]);
+    }
+
+    for (int i=0; i<newRows.size(); i++) {
+        if (newRows[i].key == NOTE_INDEX_NEEDED && !indexNeeded)
+            continue;
+        if (newRows[i].key == NOTE_THUMBNAIL_NEEDED && !thumbnailNeeded)
+            continue;
+        batch.add(newRows[i].lid, newRows[i].key, newRows[i].data);
+    }
+    bool changed = deleteRowids.size() > 0 || batch.size() > 0;
+
+    query.prepare("Delete from DataStore where rowid=:rowid");
+    for (int i=0; i<deleteRowids.size(); i++) {
+        query.bindValue(":rowid", deleteRowids[i]);
+        query.exec();
+    }
+    query.finish();
+    batch.flush();
+    db->unlock();
+
+    QLOG_DEBUG() << "Note " << lid << " synchronized: " << deleteRowids.size() << " rows removed, "
+                 << (changed ? "changes written" : "no changes") << (resourcesChanged ? ", resources changed" : "");
+
+    // The note list row is rebuilt from scratch, so hang on to the thumbnail
+    if (changed || resourcesChanged) {
+        QString thumbnail;
+        if (!thumbnailNeeded) {
+            db->lockForRead();
+            query.prepare("Select thumbnail from NoteTable where lid=:lid");
+            query.bindValue(":lid", lid);
+            query.exec();
+            if (query.next())
+                thumbnail = query.value(0).toString();
+            query.finish();
+            db->unlock();
+        }
+        updateNoteList(lid, note, false, account);
+        if (thumbnail != "") {
+            db->lockForWrite();
+            query.prepare("Update NoteTable set thumbnail=:thumbnail where lid=:lid");
+            query.bindValue(":thumbnail", thumbnail);
+            query.bindValue(":lid", lid);
+            query.exec();
+            query.finish();
+            db->unlock();
+        }
+    }
+
+    if (thumbnailNeeded)
+        setThumbnailNeeded(lid, true);
+    if (indexNeeded && !global.enableIndexing) {
+        NoteIndexer indexer(db);
+        indexer.indexNote(lid);
+    }
+    noteChanged(lid);
+    return true;
+}
+
+
+
 
 // Given a note's GUID, we return the LID
 qint32 NoteTable::getLid(QString guid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.getLid(IdentityMap::Note, guid);
 
     NSqlQuery query(db);
     db->lockForRead();
@@ -119,6 +300,8 @@ qint32 NoteTable::getLid(QString guid) {
 
 // Given a note's lid, return the guid
 QString NoteTable::getGuid(qint32 lid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.getGuid(IdentityMap::Note, lid);
 
     NSqlQuery query(db);
     QString retval = "";
@@ -147,46 +330,54 @@ qint32 NoteTable::getLid(string guid) {
 qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
     db->lockForWrite();
 
-    ResourceTable resTable(db);
     ConfigStore cs(db);
-    NSqlQuery query(db);
+    DataStoreBatch batch(db);
     qint32 lid = l;
-    qint32 notebookLid = account;
 
-    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
     if (lid <= 0)
         lid = cs.incrementLidCounter();
 
     QLOG_DEBUG() << "Adding note("<<lid<<") " << (t.title.isSet() ? t.title : "title is empty");
+    buildRecord(batch, lid, t, isDirty, account, true);
+    batch.flush();
+    db->unlock();
+
+    updateNoteList(lid, t, isDirty, account);
+
+    // Experimental index helper.  NOTE_INDEX_NEEDED was already set above.
+    if (!global.enableIndexing) {
+        NoteIndexer indexer(db);
+        indexer.indexNote(lid);
+    }
+    noteChanged(lid);
+    return lid;
+}
+
+
+
+// Queue the DataStore rows for a note.  Any missing notebook or tags are
+// created as stubs.  Resources are only written if addResources is set.
+void NoteTable::buildRecord(DataStoreBatch &batch, qint32 lid, const Note &t, bool isDirty, qint32 account, bool addResources) {
+    ResourceTable resTable(db);
+    ConfigStore cs(db);
+    qint32 notebookLid = account;
+
     if (t.guid.isSet()) {
         QString guid = t.guid;
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_GUID);
-        query.bindValue(":data", guid);
-        query.exec();
+        batch.add(lid, NOTE_GUID, guid);
+        global.identityMap.insert(IdentityMap::Note, lid, guid);
     }
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTE_INDEX_NEEDED);
-    query.bindValue(":data", true);
-    query.exec();
+    batch.add(lid, NOTE_INDEX_NEEDED, true);
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTE_THUMBNAIL_NEEDED);
-    query.bindValue(":data", true);
-    query.exec();
+    batch.add(lid, NOTE_THUMBNAIL_NEEDED, true);
 
     if (t.title.isSet()) {
-        query.bindValue(":lid", lid);
         QString title = t.title;
-        query.bindValue(":key", NOTE_TITLE);
-        query.bindValue(":data", title);
-        query.exec();
+        batch.add(lid, NOTE_TITLE, title);
     }
 
     if (t.content.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_CONTENT);
         QByteArray b;
         QString content = t.content;
 #if QT_VERSION < 0x050000
@@ -194,76 +385,49 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
 #else
         b.append(content);
 #endif
-        query.bindValue(":data", b);
-        query.exec();
+        batch.add(lid, NOTE_CONTENT, b);
     }
 
     if (t.contentHash.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_CONTENT_HASH);
         QByteArray contentHash = t.contentHash;
-        query.bindValue(":data", contentHash);
-        query.exec();
+        batch.add(lid, NOTE_CONTENT_HASH, contentHash);
     }
 
     if (t.contentLength.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_CONTENT_LENGTH);
         qint32 len = t.contentLength;
-        query.bindValue(":data", len);
-        query.exec();
+        batch.add(lid, NOTE_CONTENT_LENGTH, len);
     }
 
     if (t.updateSequenceNum.isSet()) {
-        query.bindValue(":lid", lid);
         qint32 usn = t.updateSequenceNum;
-        query.bindValue(":key", NOTE_UPDATE_SEQUENCE_NUMBER);
-        query.bindValue(":data", usn);
-        query.exec();
+        batch.add(lid, NOTE_UPDATE_SEQUENCE_NUMBER, usn);
     }
 
     if (isDirty) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_ISDIRTY);
-        query.bindValue(":data", isDirty);
-        query.exec();
+        batch.add(lid, NOTE_ISDIRTY, isDirty);
     }
 
     if (t.created.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_CREATED_DATE);
         qlonglong date = t.created;
-        query.bindValue(":data",date);
-        query.exec();
+        batch.add(lid, NOTE_CREATED_DATE, date);
     }
 
     if (t.updated.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_UPDATED_DATE);
         qlonglong date = t.updated;
-        query.bindValue(":data", date);
-        query.exec();
+        batch.add(lid, NOTE_UPDATED_DATE, date);
     }
 
     if (t.deleted.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_DELETED_DATE);
         qlonglong date = t.deleted;
-        query.bindValue(":data", date);
-        query.exec();
+        batch.add(lid, NOTE_DELETED_DATE, date);
     }
 
     if (t.active.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_ACTIVE);
         bool active = t.active;
-        query.bindValue(":data", active);
-        query.exec();
+        batch.add(lid, NOTE_ACTIVE, active);
     }
 
     if (t.notebookGuid.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_NOTEBOOK_LID);
         NotebookTable notebookTable(db);
         LinkedNotebookTable linkedTable(db);
         if (account > 0)
@@ -284,8 +448,7 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
             notebook.name = "<Missing Notebook>";
             notebookTable.add(notebookLid, notebook, false, false);
         }
-        query.bindValue(":data", notebookLid);
-        query.exec();
+        batch.add(lid, NOTE_NOTEBOOK_LID, notebookLid);
     }
 
     QList<QString> tagGuids;
@@ -303,10 +466,7 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
             tagTable.add(tagLid, newTag, false, 0);
         }
 
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_TAG_LID);
-        query.bindValue(":data", tagLid);
-        query.exec();
+        batch.add(lid, NOTE_TAG_LID, tagLid);
     }
 
     QList<Resource> resources;
@@ -317,18 +477,17 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
         resLid = 0;
         Resource r;
         r = resources[i];
-        resLid = resTable.getLid(t.guid,resources[i].guid);
-        if (resLid == 0)
-            resLid = cs.incrementLidCounter();
-        resTable.add(resLid, r, isDirty, lid);
+        if (addResources) {
+            resLid = resTable.getLid(t.guid,resources[i].guid);
+            if (resLid == 0)
+                resLid = cs.incrementLidCounter();
+            resTable.add(resLid, r, isDirty, lid);
+        }
 
         if (r.mime.isSet()) {
             QString mime = r.mime;
             if (!mime.startsWith("image/") && mime != "vnd.evernote.ink") {
-                query.bindValue(":lid", lid);
-                query.bindValue(":key", NOTE_HAS_ATTACHMENT);
-                query.bindValue(":data", true);
-                query.exec();
+                batch.add(lid, NOTE_HAS_ATTACHMENT, true);
             }
         }
     }
@@ -336,102 +495,60 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
     if (t.attributes.isSet()) {
         NoteAttributes na = t.attributes;
         if (na.subjectDate.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_SUBJECT_DATE);
             qlonglong ts = na.subjectDate;
-            query.bindValue(":data",ts);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_SUBJECT_DATE, ts);
         }
         if (na.latitude.isSet()) {
             double lat = na.latitude;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_LATITUDE);
-            query.bindValue(":data", lat);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_LATITUDE, lat);
         }
         if (na.longitude.isSet()) {
             double lon = na.longitude;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_LONGITUDE);
-            query.bindValue(":data", lon);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_LONGITUDE, lon);
         }
         if (na.altitude.isSet()) {
             double alt = na.altitude;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_ALTITUDE);
-            query.bindValue(":data", alt);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_ALTITUDE, alt);
         }
         if (na.author.isSet()) {
             QString author = na.author;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_AUTHOR);
-            query.bindValue(":data", author);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_AUTHOR, author);
         }
         if (na.source.isSet()) {
             QString source = na.source;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
-            query.bindValue(":data", source);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_SOURCE, source);
         }
         if (na.sourceURL.isSet()) {
             QString sourceURL = na.sourceURL;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_SOURCE_URL);
-            query.bindValue(":data", sourceURL);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_SOURCE_URL, sourceURL);
         }
         if (na.sourceApplication.isSet()) {
             QString sourceApplication = na.sourceApplication;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_SOURCE_APPLICATION);
-            query.bindValue(":data", sourceApplication);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_SOURCE_APPLICATION, sourceApplication);
         }
         if (na.shareDate.isSet()) {
             double date = na.shareDate;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_SHARE_DATE);
-            query.bindValue(":data",date);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_SHARE_DATE, date);
         }
         if (na.placeName.isSet()) {
             QString placename = na.placeName;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_PLACE_NAME);
-            query.bindValue(":data", placename);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_PLACE_NAME, placename);
         }
         if (na.contentClass.isSet()) {
             QString cc = na.contentClass;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_CONTENT_CLASS);
-            query.bindValue(":data", cc);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_CONTENT_CLASS, cc);
         }
         if (na.reminderTime.isSet()) {
             double rt = na.reminderTime;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_TIME);
-            query.bindValue(":data",rt);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_REMINDER_TIME, rt);
         }
         if (na.reminderDoneTime.isSet()) {
             double rt = na.reminderDoneTime;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_DONE_TIME);
-            query.bindValue(":data", rt);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_REMINDER_DONE_TIME, rt);
         }
         if (na.reminderOrder.isSet()) {
             bool rt = na.reminderOrder;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_ORDER);
-            query.bindValue(":data", rt);
-            query.exec();
+            batch.add(lid, NOTE_ATTRIBUTE_REMINDER_ORDER, rt);
         }
     }
 
@@ -444,42 +561,17 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
         content = "";
 
     if (content.contains("<en-crypt")) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_HAS_ENCRYPT);
-        query.bindValue(":data", true);
-        query.exec();
+        batch.add(lid, NOTE_HAS_ENCRYPT, true);
     }
 
     if (content.contains("<en-todo")) {
         if (content.contains("<en-todo checked=\"true\"")) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_HAS_TODO_COMPLETED);
-            query.bindValue(":data", true);
-            query.exec();
+            batch.add(lid, NOTE_HAS_TODO_COMPLETED, true);
         }
         if (content.contains("<en-todo checked=\"false\"") || content.contains("<en-todo/>")) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", NOTE_HAS_TODO_UNCOMPLETED);
-            query.bindValue(":data", true);
-            query.exec();
+            batch.add(lid, NOTE_HAS_TODO_UNCOMPLETED, true);
         }
     }
-    query.finish();
-    db->unlock();
-
-    updateNoteList(lid, t, isDirty, account);
-
-    // Experimental index helper
-    if (global.enableIndexing) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", NOTE_INDEX_NEEDED);
-        query.bindValue(":data", true);
-        query.exec();
-    } else {
-        NoteIndexer indexer(db);
-        indexer.indexNote(lid);
-    }
-    return lid;
 }
 
 
@@ -504,6 +596,7 @@ qint32 NoteTable::addStub(QString noteGuid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Note, lid, noteGuid);
     return lid;
 }
 
@@ -736,12 +829,16 @@ bool NoteTable::updateNoteList(qint32 lid, const Note &t, bool isDirty, qint32 n
 bool NoteTable::updateNotebookName(qint32 lid, QString name) {
     NSqlQuery query(db);
     db->lockForWrite();
-    query.prepare("Update NoteTable set notebook=:name where notebooklid=:lid");
+    query.prepare("Update NoteTable set notebook=:name where notebooklid=:lid and notebook is not :oldName");
     query.bindValue(":name", name);
     query.bindValue(":lid", lid);
+    query.bindValue(":oldName", name);
     bool retval = query.exec();
+    bool renamed = retval && query.numRowsAffected() > 0;
     query.finish();
     db->unlock();
+    if (renamed)
+        global.materializedSearches.invalidate();   // Searches by notebook name
     return retval;
 }
 
@@ -749,6 +846,172 @@ bool NoteTable::updateNotebookName(qint32 lid, QString name) {
 // Return a note structure given the LID
 bool NoteTable::get(Note &note, qint32 lid,bool loadResources, bool loadBinary) {
 
+    // Use the typed row if it has been migrated.  Otherwise build the
+    // note up from the DataStore key/value rows.
+    if (!DatabaseUpgrade::isTypedRecordCurrent(lid) || !getRecord(note, lid))
+        getFromDataStore(note, lid);
+
+    db->lockForRead();
+
+    ResourceTable resTable(db);
+    QLOG_TRACE() << "Fetching Resources? " << loadResources << " With binary? " << loadBinary;
+
+    QList<Resource> resources;
+    resTable.getAllResources(resources, lid, loadResources, loadBinary);
+    note.resources = resources;
+        QLOG_TRACE() << "Fetched resources";
+
+    db->unlock();
+    if (note.guid.isSet())
+        return true;
+    else
+        return false;
+}
+
+
+
+// Read a note from its typed NoteRecord row.  Returns false if there
+// is no row, in which case the caller falls back to DataStore.
+bool NoteTable::getRecord(Note &note, qint32 lid) {
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select guid, updateSequenceNumber, title, content, contentHash, contentLength, "
+                  "dateCreated, dateUpdated, dateDeleted, active, notebookLid, "
+                  "subjectDate, latitude, longitude, altitude, author, source, sourceUrl, sourceApplication, "
+                  "shareDate, placeName, contentClass, reminderOrder, reminderTime, reminderDoneTime "
+                  "from NoteRecord where lid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
+    if (!query.next()) {
+        query.finish();
+        db->unlock();
+        return false;
+    }
+
+    if (!query.value(0).isNull())
+        note.guid = query.value(0).toString();
+    if (!query.value(1).isNull())
+        note.updateSequenceNum = query.value(1).toInt();
+    if (!query.value(2).isNull())
+        note.title = query.value(2).toString();
+    if (!query.value(3).isNull()) {
+        note.content = query.value(3).toByteArray().data();
+
+        // Sometimes Evernote doesn't send the XML tag with UTF8 encoding. This forces it.
+        if (global.forceUTF8 && !note.content->startsWith("<?xml"))
+            note.content = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" + note.content;
+    }
+    if (!query.value(4).isNull())
+        note.contentHash = query.value(4).toByteArray();
+    if (!query.value(5).isNull())
+        note.contentLength = query.value(5).toLongLong();
+    if (!query.value(6).isNull())
+        note.created = query.value(6).toLongLong();
+    if (!query.value(7).isNull())
+        note.updated = query.value(7).toLongLong();
+    if (!query.value(8).isNull())
+        note.active = query.value(8).toLongLong();
+    if (!query.value(9).isNull())
+        note.active = query.value(9).toBool();
+    qint32 notebookLid = query.value(10).toInt();
+
+    NoteAttributes na;
+    bool hasAttributes = false;
+    if (note.attributes.isSet()) {
+        na = note.attributes;
+        hasAttributes = true;
+    }
+    if (!query.value(11).isNull()) {
+        na.subjectDate = query.value(11).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(12).isNull()) {
+        na.latitude = query.value(12).toFloat();
+        hasAttributes = true;
+    }
+    if (!query.value(13).isNull()) {
+        na.longitude = query.value(13).toFloat();
+        hasAttributes = true;
+    }
+    if (!query.value(14).isNull()) {
+        na.altitude = query.value(14).toFloat();
+        hasAttributes = true;
+    }
+    if (!query.value(15).isNull()) {
+        na.author = query.value(15).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(16).isNull()) {
+        na.source = query.value(16).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(17).isNull()) {
+        na.sourceURL = query.value(17).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(18).isNull()) {
+        na.sourceApplication = query.value(18).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(19).isNull()) {
+        na.shareDate = query.value(19).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(20).isNull()) {
+        na.placeName = query.value(20).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(21).isNull()) {
+        na.contentClass = query.value(21).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(22).isNull()) {
+        na.reminderOrder = query.value(22).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(23).isNull()) {
+        na.reminderTime = query.value(23).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(24).isNull()) {
+        na.reminderDoneTime = query.value(24).toLongLong();
+        hasAttributes = true;
+    }
+    if (hasAttributes)
+        note.attributes = na;
+    query.finish();
+
+    if (notebookLid > 0) {
+        NotebookTable ntable(db);
+        QString notebookGuid;
+        ntable.getGuid(notebookGuid, notebookLid);
+        note.notebookGuid = notebookGuid;
+    }
+
+    // Pick up the tags from the junction table
+    QList<QString> tagGuids;
+    QList<QString> tagNames;
+    query.prepare("Select guid, name from TagRecord where lid in (select tagLid from NoteTagRecord where noteLid=:lid)");
+    query.bindValue(":lid", lid);
+    query.exec();
+    while (query.next()) {
+        if (!query.value(0).isNull())
+            tagGuids.append(query.value(0).toString());
+        if (!query.value(1).isNull())
+            tagNames.append(query.value(1).toString());
+    }
+    query.finish();
+    if (tagGuids.size() > 0) {
+        note.tagGuids = tagGuids;
+        note.tagNames = tagNames;
+    }
+    db->unlock();
+    return true;
+}
+
+
+// Build a note from its DataStore key/value rows
+void NoteTable::getFromDataStore(Note &note, qint32 lid) {
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select key, data from DataStore where lid=:lid");
@@ -880,20 +1143,7 @@ bool NoteTable::get(Note &note, qint32 lid,bool loadResources, bool loadBinary)
         note.tagGuids = tagGuids;
         note.tagNames = tagNames;
     }
-
-    ResourceTable resTable(db);
-    QLOG_TRACE() << "Fetching Resources? " << loadResources << " With binary? " << loadBinary;
-
-    QList<Resource> resources;
-    resTable.getAllResources(resources, lid, loadResources, loadBinary);
-    note.resources = resources;
-        QLOG_TRACE() << "Fetched resources";
-
     db->unlock();
-    if (note.guid.isSet())
-        return true;
-    else
-        return false;
 }
 
 
@@ -965,6 +1215,9 @@ bool NoteTable::isDirty(string guid) {
 
 // Does this note exist?
 bool NoteTable::exists(qint32 lid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.contains(IdentityMap::Note, lid);
+
     NSqlQuery query(db);
     bool retval = false;
     db->lockForRead();
@@ -1127,8 +1380,18 @@ void NoteTable::setIndexNeeded(qint32 lid, bool indexNeeded) {
 
 // Set if a note needs to be indexed
 qint32 NoteTable::getIndexNeeded(QList<qint32> &lids) {
+    QList<qint32> recent;
+    return getIndexNeeded(lids, recent);
+}
+
+
+
+// Get the notes needing indexing.  Notes updated in the last five minutes
+// go in recent rather than lids, so they aren't part of the backlog.
+qint32 NoteTable::getIndexNeeded(QList<qint32> &lids, QList<qint32> &recent) {
     NSqlQuery query(db);
     lids.clear();
+    recent.clear();
     qlonglong delayTime = QDateTime::currentDateTime().currentMSecsSinceEpoch()-300000;
     db->lockForRead();
     query.prepare("Select lid, data from DataStore where key=:key and lid in (select lid from datastore where key=:key2 and data=1)");
@@ -1139,6 +1402,8 @@ qint32 NoteTable::getIndexNeeded(QList<qint32> &lids) {
         qlonglong dt = query.value(1).toLongLong();
         if (delayTime > dt)
             lids.append(query.value(0).toInt());
+        else
+            recent.append(query.value(0).toInt());
     }
     query.finish();
     db->unlock();
@@ -1147,6 +1412,42 @@ qint32 NoteTable::getIndexNeeded(QList<qint32> &lids) {
 
 
 
+// Get the rowid of the newest index needed flag for a note, or 0 if
+// there is none.  A save adds a new flag, so a flag newer than this
+// means the note changed after it was read.
+qint64 NoteTable::getIndexNeededRowid(qint32 lid) {
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select max(rowid) from DataStore where lid=:lid and key=:key");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", NOTE_INDEX_NEEDED);
+    query.exec();
+    qint64 retval = 0;
+    if (query.next())
+        retval = query.value(0).toLongLong();
+    query.finish();
+    db->unlock();
+    return retval;
+}
+
+
+
+// Clear the index needed flags that were set when the note was read.
+// Any set since then are left for the next pass.
+void NoteTable::clearIndexNeeded(qint32 lid, qint64 rowid) {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.prepare("Delete from DataStore where lid=:lid and key=:key and rowid<=:rowid");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", NOTE_INDEX_NEEDED);
+    query.bindValue(":rowid", rowid);
+    query.exec();
+    query.finish();
+    db->unlock();
+}
+
+
+
 // Update the notebook for a note
 void NoteTable::updateNotebook(qint32 noteLid, qint32 notebookLid, bool setAsDirty) {
     Notebook book;
@@ -1178,6 +1479,7 @@ void NoteTable::updateNotebook(qint32 noteLid, qint32 notebookLid, bool setAsDir
         query.exec();
         query.finish();
         db->unlock();
+        noteChanged(noteLid);
     }
 }
 
@@ -1211,6 +1513,7 @@ void NoteTable::updateUrl(qint32 noteLid, QString url, bool setAsDirty=false) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1236,6 +1539,7 @@ void NoteTable::updateTitle(qint32 noteLid, QString title, bool setAsDirty=false
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1268,6 +1572,7 @@ void NoteTable::updateAuthor(qint32 noteLid, QString author, bool setAsDirty=fal
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -1332,6 +1637,8 @@ void NoteTable::updateDate(qint32 lid, Timestamp ts, qint32 key, bool isDirty =
     query.exec();
     query.finish();
     db->unlock();
+    if (key == NOTE_ATTRIBUTE_REMINDER_TIME)
+        noteChanged(lid);
 }
 
 
@@ -1350,6 +1657,8 @@ void NoteTable::removeTag(qint32 lid, qint32 tag, bool isDirty = false) {
         setDirty(lid, isDirty, false);
     }
     rebuildNoteListTags(lid);
+    setIndexNeeded(lid, true);      // The search index keeps the tag names
+    noteChanged(lid);
 }
 
 
@@ -1377,6 +1686,8 @@ void NoteTable::addTag(qint32 lid, qint32 tag, bool isDirty = false) {
         setDirty(lid, isDirty, false);
     }
     rebuildNoteListTags(lid);
+    setIndexNeeded(lid, true);      // The search index keeps the tag names
+    noteChanged(lid);
 }
 
 
@@ -1575,6 +1886,7 @@ void NoteTable::deleteNote(qint32 lid, bool isDirty=true) {
     }
     query.finish();
     db->unlock();
+    noteChanged(lid);
 }
 
 
@@ -1622,6 +1934,7 @@ void NoteTable::restoreNote(qint32 lid, bool isDirty=true) {
     }
     query.finish();
     db->unlock();
+    noteChanged(lid);
 }
 
 
@@ -1674,6 +1987,10 @@ void NoteTable::expunge(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
+    global.identityMap.remove(IdentityMap::Note, lid);
+    global.filterIndex.removeNote(lid);
+    global.materializedSearches.noteChanged(lid);
 }
 
 
@@ -1907,6 +2224,7 @@ void NoteTable::updateNoteContent(qint32 lid, QString content, bool isDirty) {
 
     db->unlock();
     setDirty(lid, isDirty);
+    noteChanged(lid);
 }
 
 
@@ -1983,6 +2301,7 @@ qint32 NoteTable::duplicateNote(qint32 oldLid, bool keepCreatedDate) {
     query.bindValue(":lid", newLid);
     query.bindValue(":key", NOTE_GUID);
     query.exec();
+    global.identityMap.insert(IdentityMap::Note, newLid, QString::number(newLid));
 
     // experimental: mark copy as "- copy" in title
     query.prepare("update datastore set data=data || ' - copy' where lid=:lid and key=:key");
@@ -2039,6 +2358,8 @@ qint32 NoteTable::duplicateNote(qint32 oldLid, bool keepCreatedDate) {
         query.bindValue(":lid", newResLid);
         query.bindValue(":key", RESOURCE_NOTE_LID);
         query.exec();
+        global.identityMap.insert(IdentityMap::Resource, newResLid, QString::number(newResLid));
+        global.identityMap.setResourceNoteLid(newResLid, newLid);
 
         QStringList filter;
         QDir resDir(global.fileManager.getDbaDirPath());
@@ -2056,6 +2377,7 @@ qint32 NoteTable::duplicateNote(qint32 oldLid, bool keepCreatedDate) {
     }
     query.finish();
     db->unlock();
+    noteChanged(newLid);
     return newLid;
 }
 
@@ -2227,6 +2549,7 @@ void NoteTable::resetGeography(qint32 lid, bool isDirty) {
     query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 
     if (isDirty)
         this->setDirty(lid, isDirty);
@@ -2260,6 +2583,7 @@ void NoteTable::setGeography(qint32 lid, double longitude, double latitude, doub
     }
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 
     if (isDirty)
         this->setDirty(lid, isDirty);
@@ -2389,6 +2713,7 @@ void NoteTable::setReminderCompleted(qint32 lid, bool completed) {
     }
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
 }
 
 
@@ -2423,6 +2748,7 @@ void NoteTable::removeReminder(qint32 lid) {
     query.finish();
 
     db->unlock();
+    noteChanged(lid);
 }
 
 
@@ -2495,6 +2821,8 @@ void NoteTable::pinNote(qint32 lid, bool value) {
         query.exec();
         QLOG_DEBUG() << query.lastError();
         query.finish();
+        db->unlock();
+        noteChanged(lid);
         return;
     }
 
@@ -2509,6 +2837,7 @@ void NoteTable::pinNote(qint32 lid, bool value) {
     query.lastError();
     query.finish();
     db->unlock();
+    noteChanged(lid);
 
     //setDirty(lid, true, false);
 }
@@ -89,11 +89,18 @@ using namespace qevercloud;
 
 using namespace std;
 
+class DataStoreBatch;
+
 class NoteTable
 {
 
 private:
     DatabaseConnection *db;
+    bool getRecord(Note &note, qint32 lid);                  // Read a note from the typed NoteRecord table
+    void getFromDataStore(Note &note, qint32 lid);           // Read a note from the DataStore key/value rows
+    void buildRecord(DataStoreBatch &batch, qint32 lid, const Note &t, bool isDirty, qint32 account, bool addResources);   // Queue a note's DataStore rows
+    bool syncChanges(qint32 lid, const Note &note, qint32 account);     // Rewrite only what changed in an existing note
+    void noteChanged(qint32 lid);                            // Tell the filter indexes a note was written
 
 public:
 
@@ -120,6 +127,8 @@ public:
     qint32 findNotesByTitle(QList<qint32> &lids, QString title);   // Find a note by its title
     qint32 getNotesWithTag(QList<qint32> &retval, QString tag);    // Find all notes for a specific tag;
     qint32 getIndexNeeded(QList<qint32> &lids);              // Get a list of all notes needing indexing
+    qint32 getIndexNeeded(QList<qint32> &lids, QList<qint32> &recent);  // Same, with recently updated notes listed apart
+    qint64 getIndexNeededRowid(qint32 lid);                  // Latest index needed flag for a note
     qint32 findNotesByNotebook(QList<qint32> &notes, QString guid);    // Find all notes for a given notebook
     qint32 findNotesByNotebook(QList<qint32> &notes, string guid);     // Find all notes for a given notebook
     qint32 findNotesByNotebook(QList<qint32> &notes, qint32 lid);      // Find all notes for a given notebook
@@ -186,6 +195,7 @@ public:
     void sync(qint32 lid, const Note &note, qint32 account=0);           // Sync a note with a new record
     qint32 add(qint32 lid, const Note &t, bool isDirty, qint32 account=0); // Add a new note
     void setIndexNeeded(qint32 lid, bool indexNeeded);                   // flag if a note needs reindexing
+    void clearIndexNeeded(qint32 lid, qint64 rowid);                     // Clear index needed flags up to a rowid
     void updateNoteListTags(qint32 noteLid, QString tags);               // Update the tag names in the note list
     void updateNoteListNotebooks(QString guid, QString name);            // Update the notebook name in the note list
     void addToDeleteQueue(qint32 lid, Note n);   // Add to the notes that need to be deleted from Evernote
@@ -23,6 +23,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QSqlError>
 
 #include "src/global.h"
+#include <QMutex>
+#include <QSet>
 
 // Windows Check
 #ifndef _WIN32
@@ -38,6 +40,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 extern Global global;
 
+// Statements whose query plan has already been checked
+static QSet<QString> auditedStatements;
+static QMutex auditMutex;
+
 
 // Constructor
 NSqlQuery::NSqlQuery(DatabaseConnection *db) :
@@ -52,6 +58,7 @@ NSqlQuery::NSqlQuery(DatabaseConnection *db) :
 // Destructor
 NSqlQuery::~NSqlQuery() {
     this->finish();
+    releaseStatement();
 //    if (db->dbLocked) {
 //        QLOG_DEBUG() << "*** Warning: NSqlQuery Terminating with lock active";
 //        global.stackDump();
@@ -59,6 +66,35 @@ NSqlQuery::~NSqlQuery() {
 }
 
 
+// Prepare a statement.  Statements are cached per connection by their
+// SQL text, so the same query run repeatedly is only compiled once.
+bool NSqlQuery::prepare(const QString &query) {
+    releaseStatement();
+    if (db->takeStatement(query, *this)) {
+        cachedSql = query;
+        return true;
+    }
+    bool rc = QSqlQuery::prepare(query);
+    if (rc)
+        cachedSql = query;
+    return rc;
+}
+
+
+
+// Give the current statement back to the connection's cache and
+// detach from it, so this object can be reused for something else.
+void NSqlQuery::releaseStatement() {
+    if (cachedSql == "")
+        return;
+    QSqlQuery::finish();
+    db->releaseStatement(cachedSql, *this);
+    QSqlQuery::operator=(QSqlQuery(db->conn));
+    cachedSql = "";
+}
+
+
+
 QString getLastExecutedQuery(const QSqlQuery& query)
 {
     QString str = query.lastQuery();
@@ -82,10 +118,14 @@ bool NSqlQuery::exec() {
         if (rc) {
             if (indexRestoreNeeded)
                 global.indexRunner->pauseIndexing = indexPauseSave;
+            if (global.auditQueryPlans)
+                auditQueryPlan();
             return true;
         }
-        if (lastError().number() != DATABASE_LOCKED)
+        if (lastError().number() != DATABASE_LOCKED) {
+            db->countError();
             return false;
+        }
         if (i>DEBUG_TRIGGER) {
             QLOG_ERROR() << "DB Locked:  Retry #" << i;
         }
@@ -110,6 +150,7 @@ bool NSqlQuery::exec() {
     }
     if (indexRestoreNeeded)
         global.indexRunner->pauseIndexing = indexPauseSave;
+    db->countError();
     return false;
 }
 
@@ -119,16 +160,21 @@ bool NSqlQuery::exec() {
 bool NSqlQuery::exec(const QString &query) {
     bool indexPauseSave;
     bool indexRestoreNeeded = false;
+    releaseStatement();
     //QLOG_DEBUG() << "Sending SQL:" << query;
     for (int i=1; i<1000; i++) {
         bool rc = QSqlQuery::exec(query);
         if (rc) {
             if (indexRestoreNeeded)
                 global.indexRunner->pauseIndexing = indexPauseSave;
+            if (global.auditQueryPlans)
+                auditQueryPlan();
             return true;
         }
-        if (lastError().number() != DATABASE_LOCKED)
+        if (lastError().number() != DATABASE_LOCKED) {
+            db->countError();
             return false;
+        }
 
         if (i == INDEX_PAUSE_TRIGGER && this->db->getConnectionName() != "indexrunner") {
             QLOG_DEBUG() << "Pausing indexrunner due to db lock";
@@ -152,11 +198,51 @@ bool NSqlQuery::exec(const QString &query) {
     }
     if (indexRestoreNeeded)
         global.indexRunner->pauseIndexing = indexPauseSave;
+    db->countError();
     return false;
 }
 
 
 
+// Run EXPLAIN QUERY PLAN on the statement just executed and report any
+// step that scans a whole table instead of using an index.  Each
+// distinct statement is only checked once per run.
+void NSqlQuery::auditQueryPlan() {
+    QString sql = lastQuery().trimmed();
+    QString verb = sql.section(' ', 0, 0).toLower();
+    if (verb != "select" && verb != "insert" && verb != "update" && verb != "delete")
+        return;
+
+    auditMutex.lock();
+    bool seen = auditedStatements.contains(sql);
+    if (!seen)
+        auditedStatements.insert(sql);
+    auditMutex.unlock();
+    if (seen)
+        return;
+
+    QSqlQuery plan(db->conn);
+    if (!plan.prepare("explain query plan " + sql))
+        return;
+    int count = boundValues().size();
+    for (int i=0; i<count; i++)
+        plan.addBindValue(boundValue(i));
+    if (!plan.exec())
+        return;
+    while (plan.next()) {
+        // The last column is the description, e.g. "SCAN DataStore" or
+        // "SEARCH DataStore USING INDEX DataStore_Lid_Key (lid=? AND key=?)"
+        QString detail = plan.value(plan.record().count()-1).toString();
+        if (detail.startsWith("SCAN") && !detail.contains("USING") && !detail.contains("VIRTUAL TABLE")
+                && !detail.contains("CONSTANT ROW") && !detail.contains("SUBQUERY")) {
+            QLOG_WARN() << "Query plan audit: full table scan (" << detail << ") in: " << sql;
+        }
+    }
+    plan.finish();
+}
+
+
+
 // Execute a SQL statement
 bool NSqlQuery::exec(const string query) {
     QString q;
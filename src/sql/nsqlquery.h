@@ -41,9 +41,13 @@ private:
     DatabaseConnection *db;
     int DEBUG_TRIGGER;
     int INDEX_PAUSE_TRIGGER;
+    QString cachedSql;                     // SQL of the statement checked out of the connection cache
+    void auditQueryPlan();                 // Log any full table scans in the last statement
+    void releaseStatement();               // Hand the current statement back to the connection cache
 public:
     explicit NSqlQuery(DatabaseConnection *db);   // Constructor
     ~NSqlQuery();                          // Destructor
+    bool prepare(const QString &query);    // Prepare a statement, reusing a cached one if possible
     bool exec();                           // Execute SQL statement
     bool exec(const QString &query);       // Execute SQL statement
     bool exec(const string query);         // Execute SQL statement
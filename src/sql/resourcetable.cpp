@@ -23,7 +23,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "notetable.h"
 #include "src/utilities/mimereference.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/datastorebatch.h"
+#include "src/sql/databaseupgrade.h"
 #include "src/utilities/noteindexer.h"
+#include "src/utilities/textcache.h"
 
 #include <QSqlTableModel>
 
@@ -33,6 +36,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 using namespace std;
 extern Global global;
 
+// Columns read from ResourceRecord.  The order must match mapResourceRecord()
+#define RESOURCE_RECORD_COLUMNS "guid, noteLid, dataHash, dataSize, mime, active, height, width, duration, " \
+    "recognitionBody, recognitionSize, recognitionHash, updateSequenceNumber, " \
+    "alternateBody, alternateSize, alternateHash, sourceUrl, cameraMake, cameraModel, " \
+    "altitude, longitude, latitude, recoType, attachment, fileName, clientWillIndex, timestamp, lid"
+
 // Default constructor
 ResourceTable::ResourceTable(DatabaseConnection *db)
 {
@@ -55,6 +64,7 @@ void ResourceTable::updateGuid(qint32 lid, Guid &guid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Resource, lid, guid);
 
     QLOG_TRACE() << "Leaving ResourceTable::updateGuid()";
 }
@@ -104,10 +114,17 @@ void ResourceTable::sync(qint32 lid, Resource &resource) {
 // Given a resource's GUID, we return the LID
 qint32 ResourceTable::getLid(QString noteGuid, QString guid) {
 
-    NSqlQuery query(db);
     NoteTable n(db);
-    db->lockForRead();
     qint32 noteLid = n.getLid(noteGuid);
+    if (global.identityMap.isLoaded()) {
+        qint32 lid = global.identityMap.getLid(IdentityMap::Resource, guid);
+        if (lid > 0 && global.identityMap.getResourceNoteLid(lid) == noteLid)
+            return lid;
+        return 0;
+    }
+
+    NSqlQuery query(db);
+    db->lockForRead();
     query.prepare("Select a.lid from DataStore a where a.data=:data and a.key=:key and a.lid = (select distinct b.lid from DataStore b where b.key=:key2 and b.data=:noteLid)");
     query.bindValue(":data", guid);
     query.bindValue(":key", RESOURCE_GUID);
@@ -139,6 +156,9 @@ qint32 ResourceTable::getLid(string resourceGuid) {
 
 // Get the lid for a given resource's guid
 qint32 ResourceTable::getLid(QString resourceGuid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.getLid(IdentityMap::Resource, resourceGuid);
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and data=:data");
@@ -156,6 +176,9 @@ qint32 ResourceTable::getLid(QString resourceGuid) {
 
 // Get the guid for a given resource lid
 QString ResourceTable::getGuid(int lid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.getGuid(IdentityMap::Resource, lid);
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select data from DataStore where key=:key and lid=:lid");
@@ -175,17 +198,33 @@ bool ResourceTable::get(Resource &resource, qint32 lid, bool withBinary) {
 
     NSqlQuery query(db);
     db->lockForRead();
-    query.prepare("Select key, data from DataStore where lid=:lid");
-    query.bindValue(":lid", lid);
-    query.exec();
-    if (query.size() == 0) {
-        db->unlock();
-        return false;
+
+    // Use the typed row if it has been migrated
+    bool found = false;
+    if (DatabaseUpgrade::isTypedRecordCurrent(lid)) {
+        query.prepare("Select " RESOURCE_RECORD_COLUMNS " from ResourceRecord where lid=:lid");
+        query.bindValue(":lid", lid);
+        query.exec();
+        if (query.next()) {
+            mapResourceRecord(query, resource);
+            found = true;
+        }
+        query.finish();
     }
-    while (query.next()) {
-        mapResource(query, resource);
+
+    if (!found) {
+        query.prepare("Select key, data from DataStore where lid=:lid");
+        query.bindValue(":lid", lid);
+        query.exec();
+        if (query.size() == 0) {
+            db->unlock();
+            return false;
+        }
+        while (query.next()) {
+            mapResource(query, resource);
+        }
+        query.finish();
     }
-    query.finish();
     db->unlock();
 
     // Now read the binary data from the disk
@@ -338,6 +377,129 @@ void ResourceTable::mapResource(NSqlQuery &query, Resource &resource) {
 
 
 
+// Fill in a resource from a ResourceRecord row selected with
+// RESOURCE_RECORD_COLUMNS.  Null columns are left unset.
+void ResourceTable::mapResourceRecord(NSqlQuery &query, Resource &resource) {
+    Data d, rd, ad;
+    ResourceAttributes attributes;
+    bool hasData = false, hasRecognition = false, hasAlternate = false, hasAttributes = false;
+    if (resource.data.isSet())
+        d = resource.data;
+    if (resource.recognition.isSet())
+        rd = resource.recognition;
+    if (resource.alternateData.isSet())
+        ad = resource.alternateData;
+    if (resource.attributes.isSet())
+        attributes = resource.attributes;
+
+    if (!query.value(0).isNull())
+        resource.guid = query.value(0).toString();
+    if (!query.value(1).isNull()) {
+        NoteTable ntable(db);
+        resource.noteGuid = ntable.getGuid(query.value(1).toInt());
+    }
+    if (!query.value(2).isNull()) {
+        d.bodyHash = QByteArray::fromHex(query.value(2).toByteArray());
+        hasData = true;
+    }
+    if (!query.value(3).isNull()) {
+        d.size = query.value(3).toInt();
+        hasData = true;
+    }
+    if (!query.value(4).isNull())
+        resource.mime = query.value(4).toString();
+    if (!query.value(5).isNull())
+        resource.active = query.value(5).toBool();
+    if (!query.value(6).isNull())
+        resource.height = query.value(6).toString().toInt();
+    if (!query.value(7).isNull())
+        resource.width = query.value(7).toString().toInt();
+    if (!query.value(8).isNull())
+        resource.duration = query.value(8).toString().toInt();
+    if (!query.value(9).isNull()) {
+        rd.body = query.value(9).toByteArray();
+        hasRecognition = true;
+    }
+    if (!query.value(10).isNull()) {
+        rd.size = query.value(10).toInt();
+        hasRecognition = true;
+    }
+    if (!query.value(11).isNull()) {
+        rd.bodyHash = query.value(11).toByteArray();
+        hasRecognition = true;
+    }
+    if (!query.value(12).isNull())
+        resource.updateSequenceNum = query.value(12).toInt();
+    if (!query.value(13).isNull()) {
+        ad.body = query.value(13).toByteArray();
+        hasAlternate = true;
+    }
+    if (!query.value(14).isNull()) {
+        ad.size = query.value(14).toInt();
+        hasAlternate = true;
+    }
+    if (!query.value(15).isNull()) {
+        ad.bodyHash = query.value(15).toByteArray();
+        hasAlternate = true;
+    }
+    if (!query.value(16).isNull()) {
+        attributes.sourceURL = query.value(16).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(17).isNull()) {
+        attributes.cameraMake = query.value(17).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(18).isNull()) {
+        attributes.cameraModel = query.value(18).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(19).isNull()) {
+        attributes.altitude = query.value(19).toString().toDouble();
+        hasAttributes = true;
+    }
+    if (!query.value(20).isNull()) {
+        attributes.longitude = query.value(20).toString().toDouble();
+        hasAttributes = true;
+    }
+    if (!query.value(21).isNull()) {
+        attributes.latitude = query.value(21).toString().toDouble();
+        hasAttributes = true;
+    }
+    if (!query.value(22).isNull()) {
+        attributes.recoType = query.value(22).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(23).isNull()) {
+        attributes.attachment = query.value(23).toBool();
+        hasAttributes = true;
+    }
+    if (!query.value(24).isNull()) {
+        attributes.fileName = query.value(24).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(25).isNull()) {
+        attributes.clientWillIndex = query.value(25).toBool();
+        hasAttributes = true;
+    }
+    if (!query.value(26).isNull()) {
+        attributes.timestamp = query.value(26).toDouble();
+        hasAttributes = true;
+    }
+
+    if (hasData)
+        resource.data = d;
+    if (hasRecognition)
+        resource.recognition = rd;
+    if (hasAlternate)
+        resource.alternateData = ad;
+    if (hasAttributes)
+        resource.attributes = attributes;
+}
+
+
+
+
 // Return a resource given the GUID
 bool ResourceTable::get(Resource &resource, QString noteGuid, QString guid, bool withBinary) {
     qint32 lid = getLid(noteGuid, guid);
@@ -388,6 +550,9 @@ bool ResourceTable::isDirty(string noteGuid, string guid) {
 
 // Does this resource exist?
 bool ResourceTable::exists(qint32 lid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.contains(IdentityMap::Resource, lid);
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and lid=:lid");
@@ -426,22 +591,137 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
     else
         expunge(lid);
 
+    writeRecord(lid, t, isDirty, noteLid, true);
+
+    NoteIndexer indexer(db);
+    indexer.indexResource(lid);
+    return lid;
+}
+
+
+
+// Update a resource whose data hasn't changed.  The new rows are compared
+// with the stored ones and only the rows that differ are deleted or
+// inserted, so a resource that didn't change costs no writes.  The file in
+// dba/ is left alone.  The resource is only re-indexed if its recognition
+// data, file name or source URL changed.  Returns false (and does nothing)
+// if the stored data hash doesn't match the new one.
+bool ResourceTable::syncUnchangedData(qint32 lid, Resource &t, qint32 noteLid) {
+    if (lid <= 0 || !t.data.isSet() || !t.data->bodyHash.isSet())
+        return false;
+    QByteArray newHash = t.data->bodyHash;
+    if (newHash != getDataHash(lid))
+        return false;
+
+    QByteArray oldRecognitionHash;     // Stored as hex in the DataStore
+    Resource old;
+    if (getResourceRecognition(old, lid) && old.recognition.isSet() && old.recognition->bodyHash.isSet())
+        oldRecognitionHash = old.recognition->bodyHash;
+    QByteArray newRecognitionHash;
+    if (t.recognition.isSet() && t.recognition->bodyHash.isSet())
+        newRecognitionHash = t.recognition->bodyHash;
+
+    QList<qlonglong> oldRowids;
+    QList<qint32> oldKeys;
+    QList<QByteArray> oldValues;
     NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select rowid, key, data from DataStore where lid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
+    while (query.next()) {
+        oldRowids.append(query.value(0).toLongLong());
+        oldKeys.append(query.value(1).toInt());
+        oldValues.append(DataStoreBatch::comparable(query.value(2)));
+    }
+    query.finish();
+    db->unlock();
+
+    DataStoreBatch batch(db);
     db->lockForWrite();
-    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
+    buildRecord(batch, lid, t, false, noteLid, false);
+    QList<DataStoreBatch::Row> newRows = batch.pending();
+    batch.clear();
+
+    // The file name & source URL are indexed along with the recognition
+    bool indexNeeded = oldRecognitionHash != newRecognitionHash.toHex();
+    QByteArray oldFileName, newFileName, oldUrl, newUrl;
+    for (int i=0; i<oldKeys.size(); i++) {
+        if (oldKeys[i] == RESOURCE_FILENAME)
+            oldFileName = oldValues[i];
+        if (oldKeys[i] == RESOURCE_SOURCE_URL)
+            oldUrl = oldValues[i];
+    }
+    for (int i=0; i<newRows.size(); i++) {
+        if (newRows[i].key == RESOURCE_FILENAME)
+            newFileName = DataStoreBatch::comparable(newRows[i].data);
+        if (newRows[i].key == RESOURCE_SOURCE_URL)
+            newUrl = DataStoreBatch::comparable(newRows[i].data);
+    }
+    indexNeeded = indexNeeded || oldFileName != newFileName || oldUrl != newUrl;
+
+    QList<qlonglong> deleteRowids;
+    for (int i=0; i<oldKeys.size(); i++) {
+        // Leave the index flag alone unless we have to set it
+        if (oldKeys[i] == RESOURCE_INDEX_NEEDED && !indexNeeded)
+            continue;
+
+        bool found = false;
+        for (int j=0; j<newRows.size() && !found; j++) {
+            if (newRows[j].key == oldKeys[i] && DataStoreBatch::comparable(newRows[j].data) == oldValues[i]) {
+                newRows.removeAt(j);
+                found = true;
+            }
+        }
+        if (!found)
+            deleteRowids.append(oldRowids[i]);
+    }
 
+    for (int i=0; i<newRows.size(); i++) {
+        if (newRows[i].key == RESOURCE_INDEX_NEEDED && !indexNeeded)
+            continue;
+        batch.add(newRows[i].lid, newRows[i].key, newRows[i].data);
+    }
+
+    query.prepare("Delete from DataStore where rowid=:rowid");
+    for (int i=0; i<deleteRowids.size(); i++) {
+        query.bindValue(":rowid", deleteRowids[i]);
+        query.exec();
+    }
+    query.finish();
+    batch.flush();
+    db->unlock();
+
+    if (indexNeeded) {
+        NoteIndexer indexer(db);
+        indexer.indexResource(lid);
+    }
+    return true;
+}
+
+
+
+// Write a resource's DataStore rows.  The data itself is only written
+// out to dba/ if writeData is set.
+void ResourceTable::writeRecord(qint32 lid, Resource &t, bool isDirty, int noteLid, bool writeData) {
+    DataStoreBatch batch(db);
+    db->lockForWrite();
+    buildRecord(batch, lid, t, isDirty, noteLid, writeData);
+    batch.flush();
+    db->unlock();
+}
+
+
+
+// Queue the DataStore rows for a resource without writing them
+void ResourceTable::buildRecord(DataStoreBatch &batch, qint32 lid, Resource &t, bool isDirty, int noteLid, bool writeData) {
     if (t.guid.isSet()) {
         QString guid = t.guid;
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", RESOURCE_GUID);
-        query.bindValue(":data", guid);
-        query.exec();
+        batch.add(lid, RESOURCE_GUID, guid);
+        global.identityMap.insert(IdentityMap::Resource, lid, guid);
     }
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", RESOURCE_INDEX_NEEDED);
-    query.bindValue(":data", true);
-    query.exec();
+    batch.add(lid, RESOURCE_INDEX_NEEDED, true);
 
     if (noteLid <=0) {
         NoteTable noteTable(db);
@@ -450,36 +730,25 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
             noteLid = noteTable.addStub(t.noteGuid);
         }
     }
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", RESOURCE_NOTE_LID);
-    query.bindValue(":data", noteLid);
-    query.exec();
+    batch.add(lid, RESOURCE_NOTE_LID, noteLid);
+    global.identityMap.setResourceNoteLid(lid, noteLid);
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", RESOURCE_ISDIRTY);
-    query.bindValue(":data", isDirty);
-    query.exec();
+    batch.add(lid, RESOURCE_ISDIRTY, isDirty);
 
     if (t.data.isSet()) {
         Data d = t.data;
         if (d.size.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_DATA_SIZE);
             qint32 size = d.size;
-            query.bindValue(":data", size);
-            query.exec();
+            batch.add(lid, RESOURCE_DATA_SIZE, size);
         }
 
         if (d.bodyHash.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_DATA_HASH);
             QByteArray b;
             b.append(d.bodyHash);
-            query.bindValue(":data", b.toHex());
-            query.exec();
+            batch.add(lid, RESOURCE_DATA_HASH, b.toHex());
         }
 
-        if (d.body.isSet()) {
+        if (writeData && d.body.isSet()) {
             QString mimetype = t.mime;
             QString filename;
             MimeReference ref;
@@ -498,78 +767,52 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
     }
 
     if (t.mime.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", RESOURCE_MIME);
         QString mime = t.mime;
-        query.bindValue(":data", mime);
-        query.exec();
+        batch.add(lid, RESOURCE_MIME, mime);
     }
 
     if (t.width.isSet()) {
         qint16 width = t.width;
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", RESOURCE_WIDTH);
-        query.bindValue(":data", width);
-        query.exec();
+        batch.add(lid, RESOURCE_WIDTH, width);
     }
 
     if (t.height.isSet()) {
         qint16 height = t.height;
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", RESOURCE_HEIGHT);
-        query.bindValue(":data", height);
-        query.exec();
+        batch.add(lid, RESOURCE_HEIGHT, height);
     }
 
     if (t.duration.isSet()) {
         qint16 duration = t.duration;
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", RESOURCE_DURATION);
-        query.bindValue(":data", duration);
-        query.exec();
+        batch.add(lid, RESOURCE_DURATION, duration);
     }
 
     if (t.active.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", RESOURCE_ACTIVE);
         bool active = t.active;
-        query.bindValue(":data", active);
-        query.exec();
+        batch.add(lid, RESOURCE_ACTIVE, active);
     }
 
     if (t.recognition.isSet()) {
         Data r = t.recognition;
         if (r.size.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_RECOGNITION_SIZE);
             qint32 size = r.size;
-            query.bindValue(":data", size);
-            query.exec();
+            batch.add(lid, RESOURCE_RECOGNITION_SIZE, size);
         }
 
         if (r.bodyHash.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_RECOGNITION_HASH);
             QByteArray b;
             b.append(r.bodyHash);
-            query.bindValue(":data", b.toHex());
-            query.exec();
+            batch.add(lid, RESOURCE_RECOGNITION_HASH, b.toHex());
         }
 
         if (r.body.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_RECOGNITION_BODY);
             QByteArray body = r.body;
-            query.bindValue(":data", body);
-            query.exec();
+            batch.add(lid, RESOURCE_RECOGNITION_BODY, body);
         }
     }
 
     if (t.updateSequenceNum.isSet()) {
         qint32 usn =t.updateSequenceNum;
-        query.bindValue(":key", RESOURCE_UPDATE_SEQUENCE_NUMBER);
-        query.bindValue(":data", usn);
-        query.exec();
+        batch.add(lid, RESOURCE_UPDATE_SEQUENCE_NUMBER, usn);
     }
 
 
@@ -577,27 +820,18 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
         Data ad = t.alternateData;
         if (ad.size.isSet()) {
             qint32 size = ad.size;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_ALTERNATE_SIZE);
-            query.bindValue(":data", size);
-            query.exec();
+            batch.add(lid, RESOURCE_ALTERNATE_SIZE, size);
         }
 
         if (ad.bodyHash.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_ALTERNATE_HASH);
             QByteArray b;
             b.append(ad.bodyHash);
-            query.bindValue(":data", b.toHex());
-            query.exec();
+            batch.add(lid, RESOURCE_ALTERNATE_HASH, b.toHex());
         }
 
         if (ad.body.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_ALTERNATE_BODY);
             QByteArray body = ad.body;
-            query.bindValue(":data", body);
-            query.exec();
+            batch.add(lid, RESOURCE_ALTERNATE_BODY, body);
         }
     }
 
@@ -605,99 +839,60 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
     if (t.attributes.isSet()) {
         ResourceAttributes ra = t.attributes;
         if (ra.sourceURL.isSet()) {
-            query.bindValue(":lid", lid);
             QString url = ra.sourceURL;
-            query.bindValue(":key", RESOURCE_SOURCE_URL);
-            query.bindValue(":data", url);
-            query.exec();
+            batch.add(lid, RESOURCE_SOURCE_URL, url);
         }
 
         if (ra.timestamp.isSet()) {
             qlonglong ts = ra.timestamp;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_TIMESTAMP);
-            query.bindValue(":data", ts);
-            query.exec();
+            batch.add(lid, RESOURCE_TIMESTAMP, ts);
         }
 
         if (ra.latitude.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_LATITUDE);
             double lat = ra.latitude;
-            query.bindValue(":data", lat);
-            query.exec();
+            batch.add(lid, RESOURCE_LATITUDE, lat);
         }
 
         if (ra.longitude.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_LONGITUDE);
             double lon = ra.longitude;
-            query.bindValue(":data", lon);
-            query.exec();
+            batch.add(lid, RESOURCE_LONGITUDE, lon);
         }
 
         if (ra.altitude.isSet()) {
             double alt = ra.altitude;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_ALTITUDE);
-            query.bindValue(":data", alt);
-            query.exec();
+            batch.add(lid, RESOURCE_ALTITUDE, alt);
         }
 
         if (ra.cameraMake.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_CAMERA_MAKE);
             QString cameramake = ra.cameraMake;
-            query.bindValue(":data", cameramake);
-            query.exec();
+            batch.add(lid, RESOURCE_CAMERA_MAKE, cameramake);
         }
 
         if (ra.cameraModel.isSet()) {
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_CAMERA_MODEL);
             QString model = ra.cameraModel;
-            query.bindValue(":data", model);
-            query.exec();
+            batch.add(lid, RESOURCE_CAMERA_MODEL, model);
         }
 
         if (ra.clientWillIndex.isSet()) {
             bool cwi = ra.clientWillIndex;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_CLIENT_WILL_INDEX);
-            query.bindValue(":data", cwi);
-            query.exec();
+            batch.add(lid, RESOURCE_CLIENT_WILL_INDEX, cwi);
         }
 
         if (ra.recoType.isSet()) {
             QString reco = ra.recoType;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_RECO_TYPE);
-            query.bindValue(":data", reco);
-            query.exec();
+            batch.add(lid, RESOURCE_RECO_TYPE, reco);
         }
 
         if (ra.fileName.isSet()) {
             QString filename = ra.fileName;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_FILENAME);
-            query.bindValue(":data", filename);
-            query.exec();
+            batch.add(lid, RESOURCE_FILENAME, filename);
         }
 
         if (ra.attachment.isSet()) {
             bool attachment = ra.attachment;
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", RESOURCE_ATTACHMENT);
-            query.bindValue(":data", attachment);
-            query.exec();
+            batch.add(lid, RESOURCE_ATTACHMENT, attachment);
         }
     }
-    query.finish();
-    db->unlock();
-
-    NoteIndexer indexer(db);
-    indexer.indexResource(lid);
-    return lid;
 }
 
 
@@ -827,6 +1022,41 @@ qint32 ResourceTable::getIndexNeeded(QList<qint32> &lids) {
 
 
 
+// Get the rowid of the newest index needed flag for a resource, or 0
+// if there is none
+qint64 ResourceTable::getIndexNeededRowid(qint32 lid) {
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select max(rowid) from DataStore where lid=:lid and key=:key");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", RESOURCE_INDEX_NEEDED);
+    query.exec();
+    qint64 retval = 0;
+    if (query.next())
+        retval = query.value(0).toLongLong();
+    query.finish();
+    db->unlock();
+    return retval;
+}
+
+
+
+// Clear the index needed flags that were set when the resource was read.
+// Unlike setIndexNeeded() this doesn't index the resource again.
+void ResourceTable::clearIndexNeeded(qint32 lid, qint64 rowid) {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.prepare("Delete from DataStore where lid=:lid and key=:key and rowid<=:rowid");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", RESOURCE_INDEX_NEEDED);
+    query.bindValue(":rowid", rowid);
+    query.exec();
+    query.finish();
+    db->unlock();
+}
+
+
+
 // Get a list of all resource LIDs for a given note
 bool ResourceTable::getResourceList(QList<qint32> &resourceList, qint32 noteLid) {
 
@@ -859,11 +1089,31 @@ void ResourceTable::expunge(qint32 lid) {
     }
     NSqlQuery query(db);
     db->lockForWrite();
+    query.prepare("select data from DataStore where lid=:lid and key=:key");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", RESOURCE_DATA_HASH);
+    query.exec();
+    QVariant hash;
+    if (query.next())
+        hash = query.value(0);
     query.prepare("delete from DataStore where lid=:lid");
     query.bindValue(":lid", lid);
     query.exec();
+
+    // The cached text is shared by every attachment with the same body
+    bool shared = true;
+    if (!hash.isNull()) {
+        query.prepare("select lid from DataStore where key=:key and data=:hash limit 1");
+        query.bindValue(":key", RESOURCE_DATA_HASH);
+        query.bindValue(":hash", hash);
+        query.exec();
+        shared = query.next();
+    }
     query.finish();
     db->unlock();
+    global.identityMap.remove(IdentityMap::Resource, lid);
+    if (!shared)
+        TextCache::remove(QByteArray::fromHex(hash.toByteArray()));
 
     // Delete the physical files (resource)
     QDir myDir(global.fileManager.getDbaDirPath());
@@ -982,6 +1232,8 @@ qint32 ResourceTable::addStub(qint32 resLid, qint32 noteLid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Resource, resLid, QString::number(resLid));
+    global.identityMap.setResourceNoteLid(resLid, noteLid);
     return resLid;
 }
 
@@ -1049,6 +1301,7 @@ void ResourceTable::updateNoteLid(qint32 resourceLid, qint32 newNoteLid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.setResourceNoteLid(resourceLid, newNoteLid);
 }
 
 
@@ -1137,29 +1390,52 @@ void ResourceTable::getAllResources(QList<Resource> &list, qint32 noteLid, bool
     NSqlQuery query(db);
     db->lockForRead();
     QHash<qint32, Resource*> lidMap;
-    if (fullLoad){
-        query.prepare("Select key, data, lid from datastore where lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
-        query.bindValue(":key2", RESOURCE_NOTE_LID);
-        query.bindValue(":noteLid", noteLid);
-    } else {
-        query.prepare("Select key, data, lid from datastore where key=:key and lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
-        query.bindValue(":key", RESOURCE_GUID);
-        query.bindValue(":key2", RESOURCE_NOTE_LID);
-        query.bindValue(":noteLid", noteLid);
-    }
     Resource *r = nullptr;
-    query.exec();
-    while (query.next()) {
-        qint32 lid = query.value(2).toInt();
-        if (!lidMap.contains(lid)) {
+
+    // Once every resource has a typed row we can read them directly.
+    // Until then a resource may only exist in DataStore.
+    if (DatabaseUpgrade::isTypedMigrationDone()) {
+        if (fullLoad)
+            query.prepare("Select " RESOURCE_RECORD_COLUMNS " from ResourceRecord where noteLid=:noteLid order by lid");
+        else
+            query.prepare("Select guid, lid from ResourceRecord where noteLid=:noteLid and guid is not null order by lid");
+        query.bindValue(":noteLid", noteLid);
+        query.exec();
+        while (query.next()) {
             r = new Resource();
-            lidMap.insert(lid, r);
+            if (fullLoad) {
+                lidMap.insert(query.value(27).toInt(), r);
+                mapResourceRecord(query, *r);
+            } else {
+                lidMap.insert(query.value(1).toInt(), r);
+                r->guid = query.value(0).toString();
+            }
+        }
+        query.finish();
+    } else {
+        if (fullLoad){
+            query.prepare("Select key, data, lid from datastore where lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
+            query.bindValue(":key2", RESOURCE_NOTE_LID);
+            query.bindValue(":noteLid", noteLid);
         } else {
-            r = lidMap[lid];
+            query.prepare("Select key, data, lid from datastore where key=:key and lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
+            query.bindValue(":key", RESOURCE_GUID);
+            query.bindValue(":key2", RESOURCE_NOTE_LID);
+            query.bindValue(":noteLid", noteLid);
         }
-        mapResource(query, *r);
+        query.exec();
+        while (query.next()) {
+            qint32 lid = query.value(2).toInt();
+            if (!lidMap.contains(lid)) {
+                r = new Resource();
+                lidMap.insert(lid, r);
+            } else {
+                r = lidMap[lid];
+            }
+            mapResource(query, *r);
+        }
+        query.finish();
     }
-    query.finish();
     db->unlock();
 
     // if we need binary data, read it in.  Then add to the list
@@ -66,12 +66,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 using namespace std;
 
+class DataStoreBatch;
 
 class ResourceTable
 {
 
 private:
     DatabaseConnection *db;
+    void writeRecord(qint32 lid, Resource &t, bool isDirty, int noteLid, bool writeData);   // Write a resource's DataStore rows
+    void buildRecord(DataStoreBatch &batch, qint32 lid, Resource &t, bool isDirty, int noteLid, bool writeData);   // Queue them
 public:
     ResourceTable(DatabaseConnection *db);                             // Constructor
 
@@ -94,6 +97,7 @@ public:
     qint32 getLidByHashHex(QString noteGuid, QString hash);      // Get a lid by the resource's hash value
     bool getInkNote(QByteArray &value, qint32 lid);              // Get an inknote
     qint32 getIndexNeeded(QList<qint32> &lids);                  // Get a list of all resources needing indexing
+    qint64 getIndexNeededRowid(qint32 lid);                      // Latest index needed flag for a resource
     bool getResourceList(QList<qint32> &resourceList, qint32 noteLid);  // Get resources for a note
     qint32 getCount();                                           // count of all resources
     qint32 getUnindexedCount();                                  // count of unindexed resources
@@ -109,7 +113,9 @@ public:
     void sync(Resource &resource);                               // Sync a resource with a new record
     void sync(qint32 lid, Resource &resource);                   // Sync a resource with a new record
     qint32 add(qint32 lid, Resource &t, bool isDirty, int noteLid=0);    // Add a new resource
+    bool syncUnchangedData(qint32 lid, Resource &t, qint32 noteLid);     // Update a resource, keeping its data file
     void setIndexNeeded(qint32 lid, bool indexNeeded);           // flag if a resource needs reindexing
+    void clearIndexNeeded(qint32 lid, qint64 rowid);             // Clear index needed flags up to a rowid
     void expunge(int lid);                                       // erase a resource
     void expunge(QString guid);                                  // erase a resource
     void updateResourceHash(qint32 lid, QByteArray newhash);     // Update a resource's hash value
@@ -118,6 +124,7 @@ public:
     void updateNoteLid(qint32 resourceLid, qint32 newNoteLid);   // Update the owning note
     void expungeByNote(qint32 notebookLid);                      // Given a note's LID, erase the resource
     void mapResource(NSqlQuery &query, Resource &resource);      // Save a resource map data
+    void mapResourceRecord(NSqlQuery &query, Resource &resource);   // Fill a resource from a typed ResourceRecord row
 };
 
 
@@ -0,0 +1,409 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "searchindextable.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/searchtokenizer.h"
+
+extern Global global;
+
+QAtomicInt SearchIndexTable::trigramsReady(0);
+
+// Constructor
+SearchIndexTable::SearchIndexTable(DatabaseConnection *conn)
+{
+    db = conn;
+}
+
+
+
+qint64 SearchIndexTable::firstRowid(qint32 lid) {
+    return static_cast<qint64>(lid) << SEARCHINDEX_LID_SHIFT;
+}
+
+
+qint64 SearchIndexTable::lastRowid(qint32 lid) {
+    return firstRowid(lid+1) - 1;
+}
+
+
+qint64 SearchIndexTable::firstRowid(qint32 lid, QString source) {
+    qint64 code = (source == "text" ? SEARCHINDEX_SOURCE_TEXT : SEARCHINDEX_SOURCE_RECOGNITION);
+    return firstRowid(lid) | (code << SEARCHINDEX_SOURCE_SHIFT);
+}
+
+
+qint64 SearchIndexTable::lastRowid(qint32 lid, QString source) {
+    return firstRowid(lid, source) + (Q_INT64_C(1) << SEARCHINDEX_SOURCE_SHIFT) - 1;
+}
+
+
+
+// Turn a search term into an FTS5 prefix query.  The term is quoted so
+// punctuation the tokenizer drops (c++, e-mail) isn't read as an operator.
+QString SearchIndexTable::toMatch(QString word) {
+    word = word.trimmed();
+    while (word.endsWith("*"))
+        word.chop(1);
+    word.replace("\"", "\"\"");
+    return "\"" + word + "\"*";
+}
+
+
+
+// Turn a search term into a GLOB pattern matching it anywhere in the text.
+// '*' stays a wildcard as in the rest of the search syntax; '?' and '['
+// are matched as they are.  '_' and '%' are ordinary characters in a GLOB,
+// which is why the underscore search needs one.
+QString SearchIndexTable::toGlob(QString word) {
+    word.replace("[", "[[]");
+    word.replace("?", "[?]");
+    if (!word.startsWith("*"))
+        word = "*" + word;
+    if (!word.endsWith("*"))
+        word = word + "*";
+    return word;
+}
+
+
+
+// The trigram index is only used once it has every row.  Until then
+// substring searches read SearchContent directly.
+bool SearchIndexTable::hasTrigrams() {
+    return trigramsReady.loadAcquire() != 0;
+}
+
+
+// SearchTrigram has the same lid, weight & content columns as
+// SearchContent, so a "content like" query can run on either one.
+QString SearchIndexTable::likeTable() {
+    return hasTrigrams() ? "SearchTrigram" : "SearchContent";
+}
+
+
+
+// The tokenize= option SearchIndex should have.  Whether diacritics are
+// folded follows the search settings, so changing them rebuilds the index.
+// Case is always folded, as unicode61 always did; forceSearchLowerCase only
+// lowercases the text kept for substring searches.  Without the
+// SearchTokenizer on this connection it is FTS5's unicode61.
+QString SearchIndexTable::tokenizeOption() {
+    QString diacritics = global.isForceSearchWithoutDiacritics() ? "1" : "0";
+    if (!db->hasSearchTokenizer())
+        return "tokenize='unicode61 remove_diacritics " + diacritics + "', ";
+    return QString("tokenize='") + SEARCHTOKENIZER_NAME + " remove_diacritics " + diacritics +
+           " case_sensitive 0', ";
+}
+
+
+
+// Create the content table, the FTS5 index over it & the triggers
+// that keep the two in step.  lid, weight & source are stored in the
+// index unindexed so the existing queries can keep selecting them.
+void SearchIndexTable::createTable() {
+    QLOG_DEBUG() << "Creating table SearchIndex";
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec("Create table if not exists SearchContent (rowid integer primary key, lid integer, "
+                  "weight integer, source text, title text, tags text, content text)")) {
+        QLOG_ERROR() << "Creation of SearchContent table failed: " << sql.lastError();
+    }
+    if (!sql.exec("Create virtual table if not exists SearchIndex using fts5 (title, tags, content, "
+                  "lid unindexed, weight unindexed, source unindexed, " + tokenizeOption() +
+                  "content='SearchContent', content_rowid='rowid')")) {
+        QLOG_ERROR() << "Creation of SearchIndex table failed: " << sql.lastError();
+    }
+    sql.exec("Create trigger if not exists SearchContent_Insert after insert on SearchContent begin "
+             "insert into SearchIndex (rowid, title, tags, content, lid, weight, source) "
+             "values (new.rowid, new.title, new.tags, new.content, new.lid, new.weight, new.source); "
+             "end");
+    sql.exec("Create trigger if not exists SearchContent_Delete after delete on SearchContent begin "
+             "insert into SearchIndex (SearchIndex, rowid, title, tags, content, lid, weight, source) "
+             "values ('delete', old.rowid, old.title, old.tags, old.content, old.lid, old.weight, old.source); "
+             "end");
+    sql.finish();
+    db->unlock();
+    createTrigramTable();
+    createHashTable();
+}
+
+
+
+// Create the trigram index.  It needs SQLite 3.34, so if it can't be
+// created substring searches just keep scanning SearchContent.  The
+// triggers only index rows up to the watermark in SearchTrigramState;
+// buildTrigrams() moves it up as it adds the rows that already exist.
+void SearchIndexTable::createTrigramTable() {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec("Create virtual table if not exists SearchTrigram using fts5 (content, "
+                  "lid unindexed, weight unindexed, tokenize='trigram', "
+                  "content='SearchContent', content_rowid='rowid')")) {
+        QLOG_WARN() << "Trigram search index is not available: " << sql.lastError();
+        trigramsReady.fetchAndStoreOrdered(0);
+        sql.finish();
+        db->unlock();
+        return;
+    }
+    sql.exec("Create table if not exists SearchTrigramState (rowid integer primary key, built integer)");
+    sql.exec("Insert or ignore into SearchTrigramState (rowid, built) values (1, 0)");
+    sql.exec("Create trigger if not exists SearchTrigram_Insert after insert on SearchContent "
+             "when new.rowid <= (select built from SearchTrigramState where rowid=1) begin "
+             "insert into SearchTrigram (rowid, content, lid, weight) "
+             "values (new.rowid, new.content, new.lid, new.weight); "
+             "end");
+    sql.exec("Create trigger if not exists SearchTrigram_Delete after delete on SearchContent "
+             "when old.rowid <= (select built from SearchTrigramState where rowid=1) begin "
+             "insert into SearchTrigram (SearchTrigram, rowid, content, lid, weight) "
+             "values ('delete', old.rowid, old.content, old.lid, old.weight); "
+             "end");
+
+    sql.exec("Select built from SearchTrigramState where rowid=1");
+    bool done = sql.next() && sql.value(0).toLongLong() == SEARCHINDEX_TRIGRAMS_DONE;
+    trigramsReady.fetchAndStoreOrdered(done ? 1 : 0);
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// The hash of what is indexed for each lid & source.  The IndexRunner
+// compares it with the text it extracted & leaves the rows alone if
+// they match.  Anything that removes rows removes their hash too.
+void SearchIndexTable::createHashTable() {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec("Create table if not exists SearchHash (lid integer, source text, hash blob, "
+                  "primary key (lid, source)) without rowid")) {
+        QLOG_ERROR() << "Creation of SearchHash table failed: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// Make sure SearchIndex uses the tokenizer wanted now.  The text is all in
+// SearchContent, so changing it only takes a rebuild of the index.  The
+// rebuild runs before anything else uses the database.
+void SearchIndexTable::checkTokenizer() {
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.exec("Select sql from sqlite_master where type='table' and name='SearchIndex'");
+    QString definition = "";
+    if (sql.next())
+        definition = sql.value(0).toString();
+    sql.finish();
+    db->unlock();
+
+    if (definition == "" || definition.contains(tokenizeOption()))
+        return;
+
+    QLOG_INFO() << "Rebuilding the search index for a new tokenizer.  This may take a moment.";
+    db->lockForWrite();
+    sql.exec("Drop trigger if exists SearchContent_Insert");
+    sql.exec("Drop trigger if exists SearchContent_Delete");
+    if (!sql.exec("Drop table SearchIndex")) {
+        // FTS5 can't drop a table whose tokenizer isn't registered, so
+        // take it out of the schema & drop its shadow tables directly.
+        QLOG_WARN() << "Removing the search index from the schema: " << sql.lastError();
+        sql.exec("Pragma schema_version");
+        qint64 version = sql.next() ? sql.value(0).toLongLong() : 0;
+        sql.exec("Pragma writable_schema=1");
+        sql.exec("Delete from sqlite_master where type='table' and name='SearchIndex'");
+        sql.exec("Pragma writable_schema=0");
+        sql.exec("Pragma schema_version=" + QString::number(version+1));
+        sql.exec("Drop table if exists SearchIndex_data");
+        sql.exec("Drop table if exists SearchIndex_idx");
+        sql.exec("Drop table if exists SearchIndex_docsize");
+        sql.exec("Drop table if exists SearchIndex_config");
+    }
+    sql.finish();
+    db->unlock();
+
+    createTable();
+    db->lockForWrite();
+    if (!sql.exec("Insert into SearchIndex (SearchIndex) values ('rebuild')")) {
+        QLOG_ERROR() << "Unable to rebuild the search index: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// Add the next chunk of existing rows to the trigram index & move the
+// watermark past them, in one transaction.  Returns true once there is
+// nothing left to add.
+bool SearchIndexTable::buildTrigrams() {
+    if (hasTrigrams())
+        return true;
+
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.exec("Select built from SearchTrigramState where rowid=1");
+    if (!sql.next()) {
+        // No trigram index in this database
+        sql.finish();
+        db->unlock();
+        return true;
+    }
+    qint64 built = sql.value(0).toLongLong();
+
+    sql.prepare("Select max(rowid) from (select rowid from SearchContent where rowid>:built "
+                "order by rowid limit :chunk)");
+    sql.bindValue(":built", built);
+    sql.bindValue(":chunk", SEARCHINDEX_TRIGRAM_CHUNK);
+    sql.exec();
+    qint64 upTo = SEARCHINDEX_TRIGRAMS_DONE;
+    if (sql.next() && !sql.value(0).isNull())
+        upTo = sql.value(0).toLongLong();
+
+    db->beginTransaction();
+    sql.prepare("Insert into SearchTrigram (rowid, content, lid, weight) select rowid, content, lid, weight "
+                "from SearchContent where rowid>:built and rowid<=:upTo");
+    sql.bindValue(":built", built);
+    sql.bindValue(":upTo", upTo);
+    bool ok = sql.exec();
+    sql.prepare("Update SearchTrigramState set built=:upTo where rowid=1");
+    sql.bindValue(":upTo", upTo);
+    ok = ok && sql.exec();
+    sql.finish();
+    if (!ok || !db->commitTransaction()) {
+        QLOG_ERROR() << "Unable to build the trigram index past rowid " << built;
+        db->rollbackTransaction();
+        db->unlock();
+        return true;
+    }
+    db->unlock();
+
+    if (upTo != SEARCHINDEX_TRIGRAMS_DONE)
+        return false;
+    QLOG_INFO() << "Trigram search index complete";
+    trigramsReady.fetchAndStoreOrdered(1);
+    return true;
+}
+
+
+
+// Add a row.  It gets the next free sequence number for the lid & source.
+void SearchIndexTable::add(qint32 lid, qint32 weight, QString source, QString content, QString title, QString tags) {
+    if (lid <= 0)
+        return;
+
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Select max(rowid) from SearchContent where rowid between :first and :last");
+    sql.bindValue(":first", firstRowid(lid, source));
+    sql.bindValue(":last", lastRowid(lid, source));
+    sql.exec();
+    qint64 rowid = firstRowid(lid, source);
+    if (sql.next() && !sql.value(0).isNull())
+        rowid = sql.value(0).toLongLong() + 1;
+    if (rowid > lastRowid(lid, source)) {
+        QLOG_ERROR() << "Too many index entries for " << lid << " " << source;
+        sql.finish();
+        db->unlock();
+        return;
+    }
+
+    sql.prepare("Insert into SearchContent (rowid, lid, weight, source, title, tags, content) "
+                "values (:rowid, :lid, :weight, :source, :title, :tags, :content)");
+    sql.bindValue(":rowid", rowid);
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":weight", weight);
+    sql.bindValue(":source", source);
+    sql.bindValue(":title", title);
+    sql.bindValue(":tags", tags);
+    sql.bindValue(":content", content);
+    sql.exec();
+    sql.finish();
+    db->unlock();
+    global.searchCache.dataChanged();
+    global.materializedSearches.noteChanged(lid);
+}
+
+
+
+void SearchIndexTable::expunge(qint32 lid) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Delete from SearchContent where rowid between :first and :last");
+    sql.bindValue(":first", firstRowid(lid));
+    sql.bindValue(":last", lastRowid(lid));
+    sql.exec();
+    sql.prepare("Delete from SearchHash where lid=:lid");
+    sql.bindValue(":lid", lid);
+    sql.exec();
+    sql.finish();
+    db->unlock();
+    global.searchCache.dataChanged();
+    global.materializedSearches.noteChanged(lid);
+}
+
+
+
+void SearchIndexTable::expunge(qint32 lid, QString source) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Delete from SearchContent where rowid between :first and :last");
+    sql.bindValue(":first", firstRowid(lid, source));
+    sql.bindValue(":last", lastRowid(lid, source));
+    sql.exec();
+    sql.prepare("Delete from SearchHash where lid=:lid and source=:source");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":source", source);
+    sql.exec();
+    sql.finish();
+    db->unlock();
+    global.searchCache.dataChanged();
+    global.materializedSearches.noteChanged(lid);
+}
+
+
+
+QByteArray SearchIndexTable::getHash(qint32 lid, QString source) {
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.prepare("Select hash from SearchHash where lid=:lid and source=:source");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":source", source);
+    sql.exec();
+    QByteArray hash;
+    if (sql.next())
+        hash = sql.value(0).toByteArray();
+    sql.finish();
+    db->unlock();
+    return hash;
+}
+
+
+
+void SearchIndexTable::setHash(qint32 lid, QString source, QByteArray hash) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Insert or replace into SearchHash (lid, source, hash) values (:lid, :source, :hash)");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":source", source);
+    sql.bindValue(":hash", hash);
+    sql.exec();
+    sql.finish();
+    db->unlock();
+}
@@ -0,0 +1,97 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef SEARCHINDEXTABLE_H
+#define SEARCHINDEXTABLE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QAtomicInt>
+#include "src/sql/databaseconnection.h"
+
+//*************************************************
+//* The full text index.  The text lives in
+//* SearchContent and SearchIndex is an FTS5
+//* index over it (external content) which is
+//* kept current by triggers.  The rowid of a
+//* row is built from the lid, the source and a
+//* sequence number, so every row for a lid or
+//* for one of its sources is a single rowid
+//* range and can be found without a scan.
+//*
+//* SearchTrigram is a second index over the
+//* same text for the substring searches the
+//* word index can't answer (*suffix, hyphens &
+//* underscores).  Existing rows are added to it
+//* a chunk at a time by the IndexRunner.
+//*
+//* SearchIndex uses the SearchTokenizer when it
+//* can be registered, with the diacritic setting
+//* from the search preferences.  If the tokenizer
+//* the index was built with isn't the one wanted,
+//* it is rebuilt from SearchContent at startup.
+//*************************************************
+
+#define SEARCHINDEX_LID_SHIFT       24      // Bits below the lid in a rowid
+#define SEARCHINDEX_SOURCE_SHIFT    20      // Bits below the source in a rowid
+#define SEARCHINDEX_SOURCE_TEXT         0   // Note text
+#define SEARCHINDEX_SOURCE_RECOGNITION  1   // Resource recognition, attachments & PDFs
+
+#define SEARCHINDEX_TRIGRAM_CHUNK   2000    // Rows added to the trigram index per step
+#define SEARCHINDEX_TRIGRAMS_DONE   Q_INT64_C(0x7FFFFFFFFFFFFFFF)   // Watermark once every row is in it
+#define SEARCHINDEX_HASH_VERSION    1       // Part of every hash.  Change it if the index needs rebuilding.
+
+// Ranking used for the relevance column.  The weights are for the title, tags
+// & content columns.  bm25() is negative, better matches are more negative.
+#define SEARCHINDEX_RANK "-bm25(SearchIndex, 10.0, 5.0, 1.0)"
+
+class DatabaseConnection;
+
+class SearchIndexTable
+{
+private:
+    DatabaseConnection *db;
+    static QAtomicInt trigramsReady;       // Has every row been added to SearchTrigram?
+
+public:
+    SearchIndexTable(DatabaseConnection *conn);
+    static qint64 firstRowid(qint32 lid);                     // Rowid range for every row of a lid
+    static qint64 lastRowid(qint32 lid);
+    static qint64 firstRowid(qint32 lid, QString source);     // Rowid range for one source of a lid
+    static qint64 lastRowid(qint32 lid, QString source);
+    static QString toMatch(QString word);                     // Quote a search term for MATCH
+    static QString toGlob(QString word);                      // Substring GLOB pattern, * is the only wildcard
+    static bool hasTrigrams();                                // Can substring searches use SearchTrigram?
+    static QString likeTable();                               // Table to run "content like" searches on
+
+    QString tokenizeOption();                                 // tokenize= clause for SearchIndex
+    void createTable();                                       // Create the tables & triggers
+    void createTrigramTable();                                // Create the trigram index if missing
+    void createHashTable();                                   // Create the hash table if missing
+    void checkTokenizer();                                    // Rebuild SearchIndex if its tokenizer changed
+    bool buildTrigrams();                                     // Index the next chunk.  True when done.
+    void add(qint32 lid, qint32 weight, QString source, QString content,
+             QString title="", QString tags="");              // Add a row of text
+    void expunge(qint32 lid);                                 // Remove everything for a lid
+    void expunge(qint32 lid, QString source);                 // Remove one source for a lid
+    QByteArray getHash(qint32 lid, QString source);           // Hash of the indexed text, empty if unknown
+    void setHash(qint32 lid, QString source, QByteArray hash);
+};
+
+#endif // SEARCHINDEXTABLE_H
@@ -111,8 +111,9 @@ void SearchTable::sync(qint32 lid, SavedSearch &search) {
 
     if (lid > 0) {
         db->lockForWrite();
-        query.prepare("Delete from DataStore where lid=:lid");
+        query.prepare("Delete from DataStore where lid=:lid and key<>:materialized");
         query.bindValue(":lid", lid);
+        query.bindValue(":materialized", SEARCH_IS_MATERIALIZED);
         query.exec();
         db->unlock();
     } else {
@@ -359,6 +360,8 @@ void SearchTable::deleteSearch(qint32 lid) {
         query.finish();
         db->unlock();
         setDirty(lid,true);
+        if (isMaterialized(lid))
+            setMaterialized(lid, false);
     } else {
         expunge(lid);
     }
@@ -371,8 +374,12 @@ void SearchTable::expunge(qint32 lid) {
     query.prepare("delete from DataStore where lid=:lid");
     query.bindValue(":lid", lid);
     query.exec();
+    query.prepare("delete from SearchMatches where searchLid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
     query.finish();
     db->unlock();
+    global.materializedSearches.remove(lid);
 }
 
 
@@ -482,3 +489,173 @@ QString SearchTable::getGuid(qint32 lid) {
     db->unlock();
     return retval;
 }
+
+
+
+// Create the table the matches of materialized searches are kept in
+void SearchTable::createMatchTable() {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    if (!query.exec("create table if not exists SearchMatches (searchLid integer, noteLid integer, "
+                    "relevance real, primary key (searchLid, noteLid)) without rowid"))
+        QLOG_ERROR() << "Creation of SearchMatches failed: " << query.lastError();
+    query.finish();
+    db->unlock();
+}
+
+
+
+// Are the matches of this search kept?
+bool SearchTable::isMaterialized(qint32 lid) {
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select lid from DataStore where key=:key and lid=:lid and data=1");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", SEARCH_IS_MATERIALIZED);
+    query.exec();
+    bool retval = query.next();
+    query.finish();
+    db->unlock();
+    return retval;
+}
+
+
+
+// Get every search whose matches are kept
+void SearchTable::getMaterialized(QList<qint32> &lids) {
+    NSqlQuery query(db);
+    lids.clear();
+    db->lockForRead();
+    query.prepare("Select lid from DataStore where key=:key and data=1");
+    query.bindValue(":key", SEARCH_IS_MATERIALIZED);
+    query.exec();
+    while (query.next())
+        lids.append(query.value(0).toInt());
+    query.finish();
+    db->unlock();
+}
+
+
+
+// Start or stop keeping the matches of a search.  The matches themselves
+// are found by MaterializedSearches the next time the counts are updated.
+void SearchTable::setMaterialized(qint32 lid, bool value) {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.prepare("Delete from DataStore where key in (:key, :signature) and lid=:lid");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", SEARCH_IS_MATERIALIZED);
+    query.bindValue(":signature", SEARCH_MATCH_SIGNATURE);
+    query.exec();
+    query.prepare("Delete from SearchMatches where searchLid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
+    if (value) {
+        query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, 1)");
+        query.bindValue(":lid", lid);
+        query.bindValue(":key", SEARCH_IS_MATERIALIZED);
+        query.exec();
+    }
+    query.finish();
+    db->unlock();
+    global.materializedSearches.setMaterialized(db, lid, value);
+}
+
+
+
+// Get the kept matches of a search & their relevance
+void SearchTable::getMatches(qint32 lid, QHash<qint32, double> &matches) {
+    NSqlQuery query(db);
+    matches.clear();
+    db->lockForRead();
+    query.prepare("Select noteLid, relevance from SearchMatches where searchLid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
+    while (query.next())
+        matches.insert(query.value(0).toInt(), query.value(1).toDouble());
+    query.finish();
+    db->unlock();
+}
+
+
+
+// Get the statement the kept matches were found with
+QString SearchTable::getMatchSignature(qint32 lid) {
+    NSqlQuery query(db);
+    QString retval = "";
+    db->lockForRead();
+    query.prepare("Select data from DataStore where key=:key and lid=:lid");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", SEARCH_MATCH_SIGNATURE);
+    query.exec();
+    if (query.next())
+        retval = query.value(0).toString();
+    query.finish();
+    db->unlock();
+    return retval;
+}
+
+
+
+// Replace every kept match of a search
+bool SearchTable::setMatches(qint32 lid, QString signature, const QHash<qint32, double> &matches) {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    if (!db->beginTransaction()) {
+        db->unlock();
+        return false;
+    }
+    query.prepare("Delete from DataStore where key=:key and lid=:lid");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", SEARCH_MATCH_SIGNATURE);
+    query.exec();
+    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
+    query.bindValue(":lid", lid);
+    query.bindValue(":key", SEARCH_MATCH_SIGNATURE);
+    query.bindValue(":data", signature);
+    query.exec();
+    query.prepare("Delete from SearchMatches where searchLid=:lid");
+    query.bindValue(":lid", lid);
+    query.exec();
+    query.prepare("Insert into SearchMatches (searchLid, noteLid, relevance) values (:lid, :noteLid, :relevance)");
+    for (QHash<qint32, double>::const_iterator i = matches.constBegin(); i != matches.constEnd(); ++i) {
+        query.bindValue(":lid", lid);
+        query.bindValue(":noteLid", i.key());
+        query.bindValue(":relevance", i.value());
+        query.exec();
+    }
+    query.finish();
+    bool rc = db->commitTransaction();
+    db->unlock();
+    return rc;
+}
+
+
+
+// Some notes were checked against the search again.  Any of them that
+// were kept are replaced by the ones that still match.
+bool SearchTable::updateMatches(qint32 lid, const QList<qint32> &checked, const QHash<qint32, double> &matches) {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    if (!db->beginTransaction()) {
+        db->unlock();
+        return false;
+    }
+    query.prepare("Delete from SearchMatches where searchLid=:lid and noteLid=:noteLid");
+    for (int i=0; i<checked.size(); i++) {
+        query.bindValue(":lid", lid);
+        query.bindValue(":noteLid", checked[i]);
+        query.exec();
+    }
+    query.prepare("Insert into SearchMatches (searchLid, noteLid, relevance) values (:lid, :noteLid, :relevance)");
+    for (QHash<qint32, double>::const_iterator i = matches.constBegin(); i != matches.constEnd(); ++i) {
+        query.bindValue(":lid", lid);
+        query.bindValue(":noteLid", i.key());
+        query.bindValue(":relevance", i.value());
+        query.exec();
+    }
+    query.finish();
+    bool rc = db->commitTransaction();
+    db->unlock();
+    return rc;
+}
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QSqlTableModel>
 #include <QtSql>
 #include <QString>
+#include <QHash>
 #include "src/sql/databaseconnection.h"
 
 using namespace std;
@@ -40,6 +41,8 @@ using namespace std;
 #define SEARCH_FORMAT                  2005
 #define SEARCH_QUERY                   2006
 #define SEARCH_ISDELETED               2007
+#define SEARCH_IS_MATERIALIZED         2008     // Local only.  The matches are kept in SearchMatches
+#define SEARCH_MATCH_SIGNATURE         2009     // Local only.  The statement the kept matches were found with
 
 #define SEARCH_LID_POSITION            0
 #define SEARCH_NAME_POSITION           1
@@ -69,6 +72,10 @@ public:
     bool isDeleted(qint32 lid);                // Is this search marked for deletion?
     QString getGuid(qint32 lid);               // Get the GUID for a searcht
     void getAll(QList<qint32> &lids);          // Get a list of all search LIDs.
+    bool isMaterialized(qint32 lid);           // Are the matches of this search kept?
+    void getMaterialized(QList<qint32> &lids); // Get every search whose matches are kept
+    void getMatches(qint32 lid, QHash<qint32, double> &matches);  // Get the kept matches & their relevance
+    QString getMatchSignature(qint32 lid);     // Get the statement the kept matches were found with
 
     // DB Write Functions
     void updateGuid(qint32 lid, Guid &guid);   // Update a record's guid
@@ -82,6 +89,12 @@ public:
     void expunge(string guid);                 // Erase a search
     void setDirty(qint32 lid, bool dirty);     // Set a search as needing to be synchronized
     void setUpdateSequenceNumber(qint32 lid, qint32 usn);     // Set the update sequence number for a search
+    void createMatchTable();                   // Create SearchMatches if it doesn't exist
+    void setMaterialized(qint32 lid, bool value);             // Start or stop keeping the matches of a search
+    bool setMatches(qint32 lid, QString signature,
+                    const QHash<qint32, double> &matches);     // Replace the kept matches
+    bool updateMatches(qint32 lid, const QList<qint32> &checked,
+                       const QHash<qint32, double> &matches);  // Replace the matches among the checked notes
 };
 
 #endif // SEARCHTABLE_H
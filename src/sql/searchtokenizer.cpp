@@ -0,0 +1,483 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "searchtokenizer.h"
+#include "src/logger/qslog.h"
+
+#include <QByteArray>
+#include <QChar>
+#include <QMutex>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <sqlite3.h>
+#include <string.h>
+
+// What a character is to the tokenizer
+#define TOKEN_SEPARATOR     0       // Ends a word
+#define TOKEN_LETTER        1       // Letters, digits & private use characters
+#define TOKEN_EXPAND        2       // A letter that loses its diacritics as several (æ, ß ...)
+#define TOKEN_MARK          3       // Combining marks.  Dropped with the diacritics.
+#define TOKEN_CJK           4       // Indexed in pairs
+
+
+// Letters without a decomposition that still have a plain form
+static const char *const specialLetters[] = {
+    "ßss", "æae", "Æae", "œoe", "Œoe", "øo", "Øo", "ðd", "Ðd", "đd", "Đd",
+    "łl", "Łl", "ħh", "Ħh", "ŧt", "Ŧt", "þth", "Þth", "ıi"
+};
+
+
+//****************************************************
+//* Kind & plain form of every character in the BMP,
+//* worked out once from Qt's Unicode tables.  Other
+//* characters are looked up as they are met.
+//****************************************************
+class FoldTable
+{
+public:
+    quint8 kind[0x10000];
+    ushort base[0x10000];           // Without diacritics.  For TOKEN_EXPAND an index into expansions.
+    QStringList expansions;
+    FoldTable();
+    static quint8 kindOf(uint c);
+};
+
+
+static bool isCjk(uint c, QChar::Script script) {
+    return script == QChar::Script_Han || script == QChar::Script_Hiragana ||
+           script == QChar::Script_Katakana || script == QChar::Script_Hangul ||
+           (c >= 0x3040 && c <= 0x30FF) || (c >= 0x20000 && c <= 0x3FFFF);
+}
+
+
+quint8 FoldTable::kindOf(uint c) {
+    QChar::Category category = QChar::category(c);
+    if (category == QChar::Mark_NonSpacing || category == QChar::Mark_SpacingCombining ||
+        category == QChar::Mark_Enclosing)
+        return TOKEN_MARK;
+    if (!QChar::isLetterOrNumber(c) && category != QChar::Other_PrivateUse)
+        return TOKEN_SEPARATOR;
+    if (isCjk(c, QChar::script(c)))
+        return TOKEN_CJK;
+    return TOKEN_LETTER;
+}
+
+
+// The plain form is what is left of the compatibility decomposition once
+// the marks are gone, as long as that is only letters & digits.  So é is
+// e, ﬁ is fi and Ａ is A, but ½ stays as it is.
+FoldTable::FoldTable() {
+    for (uint c=0; c<0x10000; c++) {
+        base[c] = static_cast<ushort>(c);
+        kind[c] = QChar::isSurrogate(c) ? TOKEN_SEPARATOR : kindOf(c);
+        if (kind[c] != TOKEN_LETTER || QChar::decompositionTag(c) == QChar::NoDecomposition)
+            continue;
+        QString plain = "";
+        QString decomposed = QString(QChar(static_cast<ushort>(c))).normalized(QString::NormalizationForm_KD);
+        for (int i=0; i<decomposed.size(); i++) {
+            QChar part = decomposed[i];
+            if (part.isMark())
+                continue;
+            if (!part.isLetterOrNumber()) {
+                plain = "";
+                break;
+            }
+            plain.append(part);
+        }
+        if (plain.size() == 1) {
+            base[c] = plain[0].unicode();
+        } else if (plain.size() > 1) {
+            kind[c] = TOKEN_EXPAND;
+            base[c] = static_cast<ushort>(expansions.size());
+            expansions.append(plain);
+        }
+    }
+
+    for (size_t i=0; i<sizeof(specialLetters)/sizeof(specialLetters[0]); i++) {
+        QString special = QString::fromUtf8(specialLetters[i]);
+        ushort c = special[0].unicode();
+        QString plain = special.mid(1);
+        if (plain.size() == 1) {
+            kind[c] = TOKEN_LETTER;
+            base[c] = plain[0].unicode();
+        } else {
+            kind[c] = TOKEN_EXPAND;
+            base[c] = static_cast<ushort>(expansions.size());
+            expansions.append(plain);
+        }
+    }
+}
+
+
+static const FoldTable &foldTable() {
+    static const FoldTable table;
+    return table;
+}
+
+
+
+//****************************************************
+//* One call to the tokenizer.  Words are built up
+//* in folded UTF-8 as the text is read.  For CJK
+//* the previous character is kept so each one can
+//* be paired with the next.
+//****************************************************
+
+class TokenizerOptions
+{
+public:
+    bool removeDiacritics;
+    bool foldCase;
+};
+
+
+class TokenStream
+{
+private:
+    const TokenizerOptions *options;
+    const FoldTable &table;
+    void *context;
+    int (*output)(void *context, int flags, const char *token, int length, int start, int end);
+    bool query;
+    int rc;
+
+    QByteArray word;
+    int wordStart;
+    int wordEnd;
+
+    char previous[4];               // Last CJK character, as UTF-8
+    int previousLength;
+    int previousStart;
+    int previousEnd;
+    int run;                        // CJK characters in a row
+
+    void emitToken(const char *token, int length, int start, int end, int flags);
+    void append(uint c);
+    void letter(uint c, quint8 kind, int start, int end);
+    void cjk(uint c, int start, int end);
+    void endWord();
+    void endRun();
+
+public:
+    TokenStream(const TokenizerOptions *options, void *context, int flags,
+                int (*output)(void*, int, const char*, int, int, int));
+    int tokenize(const char *text, int length);
+};
+
+
+TokenStream::TokenStream(const TokenizerOptions *options, void *context, int flags,
+                         int (*output)(void*, int, const char*, int, int, int)) : table(foldTable())
+{
+    this->options = options;
+    this->context = context;
+    this->output = output;
+    query = (flags & FTS5_TOKENIZE_QUERY) != 0;
+    rc = SQLITE_OK;
+    wordStart = 0;
+    wordEnd = 0;
+    previousLength = 0;
+    previousStart = 0;
+    previousEnd = 0;
+    run = 0;
+    word.reserve(64);
+}
+
+
+static int putUtf8(char *out, uint c) {
+    if (c < 0x80) {
+        out[0] = static_cast<char>(c);
+        return 1;
+    }
+    if (c < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (c >> 6));
+        out[1] = static_cast<char>(0x80 | (c & 0x3F));
+        return 2;
+    }
+    if (c < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (c >> 12));
+        out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (c & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (c >> 18));
+    out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (c & 0x3F));
+    return 4;
+}
+
+
+// Read the character at pos & move past it.  Bad UTF-8 reads as U+FFFD,
+// which is a separator.
+static uint nextChar(const unsigned char *text, int length, int &pos) {
+    uint c = text[pos++];
+    if (c < 0x80)
+        return c;
+    int extra;
+    if ((c & 0xE0) == 0xC0) {
+        extra = 1;
+        c &= 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        extra = 2;
+        c &= 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        extra = 3;
+        c &= 0x07;
+    } else {
+        return 0xFFFD;
+    }
+    while (extra-- > 0) {
+        if (pos >= length || (text[pos] & 0xC0) != 0x80)
+            return 0xFFFD;
+        c = (c << 6) | (text[pos++] & 0x3F);
+    }
+    return c;
+}
+
+
+void TokenStream::emitToken(const char *token, int length, int start, int end, int flags) {
+    if (rc == SQLITE_OK)
+        rc = output(context, flags, token, length, start, end);
+}
+
+
+void TokenStream::append(uint c) {
+    if (options->foldCase)
+        c = QChar::toCaseFolded(c);
+    char buffer[4];
+    word.append(buffer, putUtf8(buffer, c));
+}
+
+
+void TokenStream::letter(uint c, quint8 kind, int start, int end) {
+    endRun();
+    if (word.isEmpty())
+        wordStart = start;
+    wordEnd = end;
+    if (!options->removeDiacritics || c >= 0x10000) {
+        append(c);
+    } else if (kind == TOKEN_EXPAND) {
+        const QString &plain = table.expansions[table.base[c]];
+        for (int i=0; i<plain.size(); i++)
+            append(plain[i].unicode());
+    } else {
+        append(table.base[c]);
+    }
+}
+
+
+// Pair each CJK character with the one before it.  A character on its own
+// is a word by itself.  In a document the last character of a run is also
+// indexed on its own, at the same position as the last pair, so a search
+// for it finds it even though no pair starts with it.
+void TokenStream::cjk(uint c, int start, int end) {
+    endWord();
+    char current[4];
+    int length = putUtf8(current, c);
+    if (run > 0) {
+        char pair[8];
+        memcpy(pair, previous, previousLength);
+        memcpy(pair + previousLength, current, length);
+        emitToken(pair, previousLength + length, previousStart, end, 0);
+    }
+    memcpy(previous, current, length);
+    previousLength = length;
+    previousStart = start;
+    previousEnd = end;
+    run++;
+}
+
+
+void TokenStream::endWord() {
+    if (word.isEmpty())
+        return;
+    emitToken(word.constData(), word.size(), wordStart, wordEnd, 0);
+    word.clear();
+}
+
+
+void TokenStream::endRun() {
+    if (run == 1)
+        emitToken(previous, previousLength, previousStart, previousEnd, 0);
+    else if (run > 1 && !query)
+        emitToken(previous, previousLength, previousStart, previousEnd, FTS5_TOKEN_COLOCATED);
+    run = 0;
+}
+
+
+int TokenStream::tokenize(const char *text, int length) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(text);
+    int pos = 0;
+    while (pos < length && rc == SQLITE_OK) {
+        int start = pos;
+        uint c = nextChar(bytes, length, pos);
+        quint8 kind = c < 0x10000 ? table.kind[c] : FoldTable::kindOf(c);
+        switch (kind) {
+        case TOKEN_LETTER:
+        case TOKEN_EXPAND:
+            letter(c, kind, start, pos);
+            break;
+        case TOKEN_CJK:
+            cjk(c, start, pos);
+            break;
+        case TOKEN_MARK:
+            // Part of the word it follows.  On its own it is ignored.
+            if (!word.isEmpty()) {
+                wordEnd = pos;
+                if (!options->removeDiacritics)
+                    append(c);
+            }
+            break;
+        default:
+            endWord();
+            endRun();
+            break;
+        }
+    }
+    endWord();
+    endRun();
+    return rc;
+}
+
+
+
+//****************************************************
+//* The fts5_tokenizer callbacks
+//****************************************************
+
+// Options are "remove_diacritics 0|1" & "case_sensitive 0|1"
+static int tokenizerCreate(void *, const char **args, int count, Fts5Tokenizer **tokenizer) {
+    if (count % 2 != 0)
+        return SQLITE_ERROR;
+    TokenizerOptions *options = new TokenizerOptions();
+    options->removeDiacritics = true;
+    options->foldCase = true;
+    for (int i=0; i<count; i+=2) {
+        bool on = strcmp(args[i+1], "0") != 0;
+        if (strcmp(args[i], "remove_diacritics") == 0) {
+            options->removeDiacritics = on;
+        } else if (strcmp(args[i], "case_sensitive") == 0) {
+            options->foldCase = !on;
+        } else {
+            delete options;
+            return SQLITE_ERROR;
+        }
+    }
+    *tokenizer = reinterpret_cast<Fts5Tokenizer*>(options);
+    return SQLITE_OK;
+}
+
+
+static void tokenizerDelete(Fts5Tokenizer *tokenizer) {
+    delete reinterpret_cast<TokenizerOptions*>(tokenizer);
+}
+
+
+static int tokenizerTokenize(Fts5Tokenizer *tokenizer, void *context, int flags, const char *text, int length,
+                             int (*output)(void*, int, const char*, int, int, int)) {
+    TokenStream stream(reinterpret_cast<TokenizerOptions*>(tokenizer), context, flags, output);
+    return stream.tokenize(text, length);
+}
+
+
+
+// Get the FTS5 API of a connection
+static fts5_api *fts5Api(sqlite3 *connection) {
+    fts5_api *api = nullptr;
+    sqlite3_stmt *statement = nullptr;
+    if (sqlite3_prepare_v2(connection, "select fts5(?1)", -1, &statement, nullptr) != SQLITE_OK)
+        return nullptr;
+    sqlite3_bind_pointer(statement, 1, reinterpret_cast<void*>(&api), "fts5_api_ptr", nullptr);
+    sqlite3_step(statement);
+    sqlite3_finalize(statement);
+    return api;
+}
+
+
+
+// Called by SQLite for every connection it opens, once the built in
+// extensions (FTS5 among them) are loaded.  A connection without the
+// tokenizer still opens, isRegistered() tells the difference.
+static int autoRegister(sqlite3 *connection, char **, const sqlite3_api_routines *) {
+    fts5_api *api = fts5Api(connection);
+    if (api == nullptr)
+        return SQLITE_OK;
+    static fts5_tokenizer callbacks = { tokenizerCreate, tokenizerDelete, tokenizerTokenize };
+    api->xCreateTokenizer(api, SEARCHTOKENIZER_NAME, nullptr, &callbacks, nullptr);
+    return SQLITE_OK;
+}
+
+
+
+// Install the tokenizer in the SQLite library we link with.  The Qt
+// driver's handle is never used with it: if the driver has its own copy
+// of SQLite, this copy never opens its connections & nothing happens.
+void SearchTokenizer::install() {
+    static QMutex mutex;
+    static bool installed = false;
+    QMutexLocker locker(&mutex);
+    if (installed)
+        return;
+    installed = true;
+    foldTable();
+    if (sqlite3_auto_extension(reinterpret_cast<void(*)(void)>(autoRegister)) != SQLITE_OK)
+        QLOG_WARN() << "Unable to install the search tokenizer";
+}
+
+
+
+// Try the tokenizer through the connection itself, so the answer comes
+// from whichever copy of SQLite the driver uses.
+bool SearchTokenizer::isRegistered(QSqlDatabase &db) {
+    QSqlQuery query(db);
+    bool registered = query.exec("Create virtual table temp.SearchTokenizerCheck using fts5 "
+                                 "(content, tokenize='" SEARCHTOKENIZER_NAME "')");
+    if (registered)
+        query.exec("Drop table temp.SearchTokenizerCheck");
+    query.finish();
+    return registered;
+}
+
+
+
+// Fold text the way the index does with every option on, for comparing
+// words outside of SQLite.  Characters outside the BMP are kept as they are.
+QString SearchTokenizer::fold(const QString &text) {
+    const FoldTable &table = foldTable();
+    QString folded;
+    folded.reserve(text.size());
+    for (int i=0; i<text.size(); i++) {
+        ushort c = text[i].unicode();
+        switch (table.kind[c]) {
+        case TOKEN_MARK:
+            break;
+        case TOKEN_EXPAND:
+            folded.append(table.expansions[table.base[c]].toCaseFolded());
+            break;
+        case TOKEN_LETTER:
+            folded.append(QChar(static_cast<ushort>(QChar::toCaseFolded(static_cast<uint>(table.base[c])))));
+            break;
+        default:
+            folded.append(QChar(c).toCaseFolded());
+            break;
+        }
+    }
+    return folded;
+}
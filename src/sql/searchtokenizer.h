@@ -0,0 +1,54 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef SEARCHTOKENIZER_H
+#define SEARCHTOKENIZER_H
+
+#include <QSqlDatabase>
+#include <QString>
+
+//****************************************************
+//* The FTS5 tokenizer for the search index.  In one
+//* pass over the text it splits the words, folds
+//* their case & strips their diacritics.  Chinese,
+//* Japanese & Korean don't put spaces between
+//* words, so runs of those characters are indexed
+//* as overlapping pairs instead, which a query
+//* tokenized the same way matches as a phrase.
+//*
+//* It is installed as an SQLite auto extension, so
+//* the library we link with adds it to every
+//* connection it opens itself.  Only if the Qt
+//* driver uses that same library do its connections
+//* get it; a driver with its own copy of SQLite
+//* never sees it & the index keeps FTS5's unicode61
+//* tokenizer.  Each connection is checked on its own.
+//****************************************************
+
+#define SEARCHTOKENIZER_NAME    "nixnote"
+
+class SearchTokenizer
+{
+public:
+    static void install();                          // Before the first connection is opened
+    static bool isRegistered(QSqlDatabase &db);     // Does this connection have it?
+    static QString fold(const QString &text);       // Case & diacritics folded as the index folds them
+};
+
+#endif // SEARCHTOKENIZER_H
@@ -72,6 +72,7 @@ qint32 SharedNotebookTable::sync(qint32 l, SharedNotebook sharedNotebook){
         query.exec();
         query.finish();
         db->unlock();
+        global.identityMap.remove(IdentityMap::SharedNotebook, lid);
     } else {
        ConfigStore cs(db);
        lid = cs.incrementLidCounter();
@@ -119,6 +120,7 @@ qint32 SharedNotebookTable::add(qint32 l, const SharedNotebook &t, bool isDirty)
         QString notebookGuid = t.notebookGuid;
         query.bindValue(":data", notebookGuid);
         query.exec();
+        global.identityMap.insert(IdentityMap::SharedNotebook, lid, notebookGuid);
     }
 
     if (t.notebookModifiable.isSet()) {
@@ -477,4 +479,5 @@ void SharedNotebookTable::expunge(qint32 lid) {
     query.bindValue(":lid", lid);
     query.exec();
     db->unlock();
+    global.identityMap.remove(IdentityMap::SharedNotebook, lid);
 }
@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "configstore.h"
 #include "notetable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/datastorebatch.h"
 
 #include <QSqlTableModel>
 #include <QList>
@@ -184,6 +185,7 @@ void TagTable::updateGuid(qint32 lid, Guid &guid) {
     query.exec();
     query.finish();
     db->unlock();
+    global.identityMap.insert(IdentityMap::Tag, lid, guid);
     QLOG_TRACE_OUT();
 }
 
@@ -212,6 +214,7 @@ void TagTable::update(Tag &tag, bool dirty=true) {
         query.exec();
         query.finish();
         db->unlock();
+        global.identityMap.remove(IdentityMap::Tag, lid);
         qint32 account = owningAccount(lid);
         add(lid, tag, dirty,account);
 
@@ -222,6 +225,7 @@ void TagTable::update(Tag &tag, bool dirty=true) {
         for (qint32 i=0; i<noteList.size(); i++) {
             noteTable.rebuildNoteListTags(noteList[i]);
         }
+        global.materializedSearches.invalidate();   // Searches by tag name
     }
 }
 
@@ -234,6 +238,10 @@ qint32 TagTable::sync(qint32 l, Tag &tag, qint32 account) {
         lid= getLid(tag.name);
 
     if (lid > 0) {
+        Tag oldTag;
+        if (get(oldTag, lid) && (!oldTag.name.isSet() || !tag.name.isSet() || QString(oldTag.name) != QString(tag.name)))
+            global.materializedSearches.invalidate();   // Searches by tag name
+
         NSqlQuery query(db);
         // Delete the old record
         db->lockForWrite();
@@ -242,6 +250,7 @@ qint32 TagTable::sync(qint32 l, Tag &tag, qint32 account) {
         query.exec();
         query.finish();
         db->unlock();
+        global.identityMap.remove(IdentityMap::Tag, lid);
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
@@ -257,6 +266,10 @@ qint32 TagTable::sync(qint32 l, Tag &tag, qint32 account) {
 // Given a tag's GUID, we return the LID
 qint32 TagTable::getLid(QString guid) {
     QLOG_TRACE_IN();
+    if (global.identityMap.isLoaded()) {
+        QLOG_TRACE_OUT();
+        return global.identityMap.getLid(IdentityMap::Tag, guid);
+    }
     qint32 retval = 0;
     NSqlQuery query(db);
     db->lockForRead();
@@ -290,39 +303,31 @@ qint32 TagTable::add(qint32 l, Tag &t, bool isDirty, qint32 account) {
     if (lid == 0)
         lid = cs.incrementLidCounter();
 
-    NSqlQuery query(db);
+    DataStoreBatch batch(db);
     db->lockForWrite();
-    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
 
     if (t.guid.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", TAG_GUID);
         QString guid = t.guid;
-        query.bindValue(":data", guid);
-        query.exec();
+        batch.add(lid, TAG_GUID, guid);
+        global.identityMap.insert(IdentityMap::Tag, lid, guid);
     }
 
     if (t.name.isSet()) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", TAG_NAME);
         QString name  = t.name;
-        query.bindValue(":data", name);
-        query.exec();
+        batch.add(lid, TAG_NAME, name);
     }
 
     qint32 usn = 0;
     if (t.updateSequenceNum.isSet())
         usn = t.updateSequenceNum;
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", TAG_UPDATE_SEQUENCE_NUMBER);
-    query.bindValue(":data", usn);
-    query.exec();
+    batch.add(lid, TAG_UPDATE_SEQUENCE_NUMBER, usn);
 
+    qint32 parentLid = 0;
     if (t.parentGuid.isSet()) {
         QString parentGuid = t.parentGuid;
         if (parentGuid != "") {
             db->unlock();
-            qint32 parentLid = getLid(t.parentGuid);
+            parentLid = getLid(t.parentGuid);
             if (parentLid == 0) {
                 Tag tempTag;
                 parentLid = cs.incrementLidCounter();
@@ -332,26 +337,19 @@ qint32 TagTable::add(qint32 l, Tag &t, bool isDirty, qint32 account) {
                 add(parentLid, tempTag, false, account);
             }
             db->lockForWrite();
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", TAG_PARENT_LID);
-            query.bindValue(":data", parentLid);
-            query.exec();
+            batch.add(lid, TAG_PARENT_LID, parentLid);
         }
     }
 
-    query.bindValue(":lid", lid);
-    query.bindValue(":key", TAG_ISDIRTY);
-    query.bindValue(":data", isDirty);
-    query.exec();
+    batch.add(lid, TAG_ISDIRTY, isDirty);
 
     if (account >0) {
-        query.bindValue(":lid", lid);
-        query.bindValue(":key", TAG_OWNING_ACCOUNT);
-        query.bindValue(":data", account);
-        query.exec();
+        batch.add(lid, TAG_OWNING_ACCOUNT, account);
     }
-    query.finish();
+    batch.flush();
     db->unlock();
+    global.searchCache.dataChanged();
+    updateClosure(lid, parentLid);
     return lid;
 }
 
@@ -492,6 +490,9 @@ void TagTable::setDirty(qint32 lid, bool dirty) {
 
 // Does this tag exist?
 bool TagTable::exists(qint32 lid) {
+    if (global.identityMap.isLoaded())
+        return global.identityMap.contains(IdentityMap::Tag, lid);
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and lid=:lid");
@@ -526,6 +527,13 @@ bool TagTable::exists(string guid) {
 // Return a tag guid given the LID
 bool TagTable::getGuid(QString &guid, qint32 lid) {
     QLOG_TRACE_IN();
+    if (global.identityMap.isLoaded()) {
+        QLOG_TRACE_OUT();
+        if (!global.identityMap.contains(IdentityMap::Tag, lid))
+            return false;
+        guid = global.identityMap.getGuid(IdentityMap::Tag, lid);
+        return true;
+    }
 
     NSqlQuery query(db);
     db->lockForRead();
@@ -592,6 +600,7 @@ void TagTable::deleteTag(qint32 lid) {
         query.bindValue(":data", true);
         query.exec();
         db->unlock();
+        global.searchCache.dataChanged();
         setDirty(lid, true);
     } else {
         expunge(lid);
@@ -617,8 +626,18 @@ void TagTable::expunge(qint32 lid) {
     query.prepare("delete from DataStore where lid=:lid");
     query.bindValue(":lid", lid);
     query.exec();
+
+    // Its children become top level tags
+    query.prepare("delete from TagClosure where descendant in (select descendant from TagClosure where ancestor=:lid) "
+                  "and ancestor in (select ancestor from TagClosure where descendant=:lid2)");
+    query.bindValue(":lid", lid);
+    query.bindValue(":lid2", lid);
+    query.exec();
     query.finish();
     db->unlock();
+    global.searchCache.dataChanged();
+    global.identityMap.remove(IdentityMap::Tag, lid);
+    global.materializedSearches.invalidate();
 
     NoteTable noteTable(db);
     QList<int> notes;
@@ -780,6 +799,11 @@ void TagTable::cleanupLinkedTags() {
     query.exec();
     query.finish();
     db->unlock();
+
+    // Too many tags may have gone to track one by one, so reload the identity map
+    global.identityMap.clear();
+    global.identityMap.load(db);
+    rebuildClosure();
 }
 
 
@@ -848,4 +872,136 @@ void TagTable::cleanupMissingParents() {
     query.exec();
     query.finish();
     db->unlock();
+    rebuildClosure();
+}
+
+
+
+// The hierarchy is kept as a closure table: one row for every tag and each
+// of its ancestors (and itself at depth 0), so "this tag and everything
+// below it" is a single indexed lookup.
+void TagTable::createClosureTable() {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.exec("Select name from sqlite_master where type='table' and name='TagClosure'");
+    bool exists = query.next();
+    if (!exists) {
+        if (!query.exec("create table TagClosure (ancestor integer, descendant integer, depth integer, "
+                        "primary key (ancestor, descendant)) without rowid"))
+            QLOG_ERROR() << "Creation of TagClosure failed: " << query.lastError();
+        if (!query.exec("create index TagClosure_Descendant on TagClosure (descendant, depth)"))
+            QLOG_ERROR() << "TagClosure_Descendant index creation failed: " << query.lastError();
+    }
+    query.finish();
+    db->unlock();
+    if (!exists)
+        rebuildClosure();
+}
+
+
+
+// Rebuild the hierarchy from the parent records.  The depth limit stops a
+// bad parent loop from recursing forever.
+void TagTable::rebuildClosure() {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.exec("delete from TagClosure");
+    query.prepare("insert into TagClosure (ancestor, descendant, depth) "
+                  "with recursive closure(ancestor, descendant, depth) as ("
+                  "select lid, lid, 0 from DataStore where key=:guidKey "
+                  "union select p.data, c.descendant, c.depth+1 from closure c "
+                  "join DataStore p on p.lid=c.ancestor and p.key=:parentKey where c.depth<100) "
+                  "select ancestor, descendant, min(depth) from closure group by ancestor, descendant");
+    query.bindValue(":guidKey", TAG_GUID);
+    query.bindValue(":parentKey", TAG_PARENT_LID);
+    if (!query.exec())
+        QLOG_ERROR() << "TagClosure rebuild failed: " << query.lastError();
+    query.finish();
+    db->unlock();
+    global.searchCache.dataChanged();
+    global.materializedSearches.invalidate();
+}
+
+
+
+// A tag was added or saved.  If its parent changed, the tag & everything
+// below it are unlinked from the old ancestors and linked to the new ones.
+void TagTable::updateClosure(qint32 lid, qint32 parentLid) {
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.prepare("Select ancestor, depth from TagClosure where descendant=:lid and depth<=1");
+    query.bindValue(":lid", lid);
+    query.exec();
+    bool found = false;
+    qint32 oldParent = 0;
+    while (query.next()) {
+        if (query.value(1).toInt() == 0)
+            found = true;
+        else
+            oldParent = query.value(0).toInt();
+    }
+    if (found && oldParent == parentLid) {
+        query.finish();
+        db->unlock();
+        return;
+    }
+
+    query.prepare("Insert or ignore into TagClosure (ancestor, descendant, depth) values (:lid, :lid2, 0)");
+    query.bindValue(":lid", lid);
+    query.bindValue(":lid2", lid);
+    query.exec();
+
+    query.prepare("Delete from TagClosure where descendant in (select descendant from TagClosure where ancestor=:lid) "
+                  "and ancestor not in (select descendant from TagClosure where ancestor=:lid2)");
+    query.bindValue(":lid", lid);
+    query.bindValue(":lid2", lid);
+    query.exec();
+
+    // A parent inside its own subtree would be a loop, so the tag is left at the top
+    bool loop = false;
+    if (parentLid > 0) {
+        query.prepare("Select descendant from TagClosure where ancestor=:lid and descendant=:parent");
+        query.bindValue(":lid", lid);
+        query.bindValue(":parent", parentLid);
+        query.exec();
+        loop = query.next();
+        if (loop)
+            QLOG_WARN() << "Tag " << lid << " can't be a child of its own child " << parentLid;
+    }
+    if (parentLid > 0 && !loop) {
+        query.prepare("Insert or ignore into TagClosure (ancestor, descendant, depth) values (:parent, :parent2, 0)");
+        query.bindValue(":parent", parentLid);
+        query.bindValue(":parent2", parentLid);
+        query.exec();
+        query.prepare("Insert or replace into TagClosure (ancestor, descendant, depth) "
+                      "select a.ancestor, d.descendant, a.depth+d.depth+1 from TagClosure a, TagClosure d "
+                      "where a.descendant=:parent and d.ancestor=:lid");
+        query.bindValue(":parent", parentLid);
+        query.bindValue(":lid", lid);
+        query.exec();
+    }
+    query.finish();
+    db->unlock();
+    global.searchCache.dataChanged();
+    if (found)
+        global.materializedSearches.invalidate();   // Searches that include child tags
+}
+
+
+
+// A tag and every tag below it, nearest first
+qint32 TagTable::getDescendants(QList<qint32> &list, qint32 lid) {
+    qint32 start = list.size();
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select descendant from TagClosure where ancestor=:lid order by depth");
+    query.bindValue(":lid", lid);
+    query.exec();
+    while (query.next())
+        list.append(query.value(0).toInt());
+    query.finish();
+    db->unlock();
+    if (list.size() == start)
+        list.append(lid);      // Not in the hierarchy yet
+    return list.size();
 }
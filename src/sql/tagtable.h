@@ -48,6 +48,8 @@ class TagTable
 
 private:
     DatabaseConnection *db;
+    void updateClosure(qint32 lid, qint32 parentLid);    // Move a tag & its children under a new parent
+
 public:
     TagTable(DatabaseConnection *db);                // Constructor
 
@@ -78,6 +80,7 @@ public:
     void findMissingParents(QList<qint32> &lids);        // Find any tags with invalid parent records
     qint32 getAllInAccount(QList<qint32> &tags, qint32 account);   // Find all tags for a specific account
     void getAllNames(QHash<qint32, QString> *list);    // Get a hastable of all tag names by lid
+    qint32 getDescendants(QList<qint32> &list, qint32 lid);   // A tag and every tag below it
 
 
     // DB Write Functions
@@ -97,6 +100,8 @@ public:
     void resetLinkedTagsDirty();                 // mark all linked tags as not-dirty
     void cleanupMissingParents();
     void cleanupLinkedTags();
+    void createClosureTable();                   // Create the tag hierarchy table at startup
+    void rebuildClosure();                       // Rebuild the tag hierarchy from the parent records
 };
 
 #endif // TAGTABLE_H
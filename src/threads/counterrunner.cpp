@@ -32,9 +32,9 @@ CounterRunner::CounterRunner(QObject *parent) :
 }
 
 
+// The materialized searches are kept current even if nothing is counted,
+// so the connection is opened either way.
 void CounterRunner::initialize() {
-    if (global.countBehavior == Global::CountNone)
-        return;
     init = true;
     QLOG_DEBUG() << "Starting CounterRunner";
     db = new DatabaseConnection("counterrunner");
@@ -155,3 +155,28 @@ void CounterRunner::countTags() {
     emit(tagCountComplete());
     QLOG_TRACE_OUT();
 }
+
+
+
+// Bring the matches of a materialized saved search up to date & count
+// them.  The search was compiled on the GUI thread.  A search that is
+// only notebooks & tags is answered by the indexed bitmap alone.
+void CounterRunner::countSearch(qint32 searchLid, QString statement, QList<QVariant> values, LidBitmap indexed) {
+    QLOG_TRACE_IN();
+    if (!init)
+        initialize();
+    global.materializedSearches.refresh(db, searchLid, statement, values);
+    if (global.countBehavior == Global::CountNone) {
+        QLOG_TRACE_OUT();
+        return;
+    }
+
+    qint32 total = indexed.size();
+    if (statement != "")
+        total = global.materializedSearches.count(searchLid, indexed);
+    if (total >= 0) {
+        global.materializedSearches.setTotal(searchLid, total);
+        emit searchTotals(searchLid, total);
+    }
+    QLOG_TRACE_OUT();
+}
@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QPair>
 #include <QList>
 #include "src/sql/databaseconnection.h"
+#include "src/filters/lidbitmap.h"
 
 extern Global global;
 
@@ -48,12 +49,14 @@ signals:
     void notebookTotals(qint32, qint32, qint32);
     void tagTotals(qint32, qint32, qint32);
     void tagCountComplete();
+    void searchTotals(qint32, qint32);
     
 public slots:
     void countAll();
     void countTrash();
     void countNotebooks();
     void countTags();
+    void countSearch(qint32 searchLid, QString statement, QList<QVariant> values, LidBitmap indexed);
     
 };
 
@@ -0,0 +1,341 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "indexpipeline.h"
+#include "src/global.h"
+#include "src/sql/databaseconnection.h"
+#include "src/sql/notetable.h"
+#include "src/sql/resourcetable.h"
+#include "src/sql/searchindextable.h"
+#include "src/utilities/enmltext.h"
+#include "src/utilities/officetext.h"
+#include "src/utilities/pdftext.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QProcess>
+#include <QThread>
+#include <QThreadStorage>
+#include <QXmlStreamReader>
+
+extern Global global;
+
+// Each pool thread opens its own connection the first time it is used.  The
+// pool never expires its threads, so these live as long as the IndexRunner.
+static QThreadStorage<DatabaseConnection*> connections;
+
+
+IndexResult::IndexResult(qint32 lid, bool resource)
+{
+    this->lid = lid;
+    this->resource = resource;
+    noteLid = 0;
+    loaded = false;
+    officeMissing = false;
+    flagRowid = 0;
+}
+
+
+// Hash the text exactly as it will be written.  The version is part of
+// it so a change to how text is indexed invalidates every hash.
+void IndexResult::hashRecords() {
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    md5.addData(QByteArray::number(SEARCHINDEX_HASH_VERSION));
+    for (int i=0; i<records.size(); i++) {
+        const IndexRecord &rec = records[i];
+        QString fields[3] = { rec.title, rec.tags, rec.content };
+        md5.addData(QByteArray::number(rec.weight));
+        for (int j=0; j<3; j++) {
+            md5.addData(QByteArray::number(fields[j].size()));
+            md5.addData(reinterpret_cast<const char*>(fields[j].constData()), fields[j].size()*sizeof(QChar));
+        }
+    }
+    hash = md5.result();
+}
+
+
+
+IndexQueue::IndexQueue()
+{
+    capacity = INDEX_QUEUE_PER_THREAD;
+}
+
+
+void IndexQueue::setCapacity(int capacity) {
+    QMutexLocker locker(&mutex);
+    this->capacity = qMax(1, capacity);
+    notFull.wakeAll();
+}
+
+
+void IndexQueue::put(IndexResult *result) {
+    QMutexLocker locker(&mutex);
+    while (items.size() >= capacity)
+        notFull.wait(&mutex);
+    items.append(result);
+    notEmpty.wakeOne();
+}
+
+
+IndexResult *IndexQueue::take() {
+    QMutexLocker locker(&mutex);
+    while (items.isEmpty())
+        notEmpty.wait(&mutex);
+    IndexResult *result = items.takeFirst();
+    notFull.wakeOne();
+    return result;
+}
+
+
+bool IndexQueue::isEmpty() {
+    QMutexLocker locker(&mutex);
+    return items.isEmpty();
+}
+
+
+
+IndexTask::IndexTask(qint32 lid, bool resource, bool officeFound, IndexQueue *queue, const QAtomicInt *cancelled)
+{
+    this->lid = lid;
+    this->resource = resource;
+    this->officeFound = officeFound;
+    this->queue = queue;
+    this->cancelled = cancelled;
+    setAutoDelete(true);
+}
+
+
+
+DatabaseConnection *IndexTask::connection() {
+    if (!connections.hasLocalData()) {
+        QString name = "indexworker" + QString::number(reinterpret_cast<quintptr>(QThread::currentThread()));
+        connections.setLocalData(new DatabaseConnection(name));
+    }
+    return connections.localData();
+}
+
+
+
+// Extract one note or resource.  A result is always queued, even when
+// cancelled, because the writer counts them.  The flag is read before the
+// record so a save made while it is being indexed flags it again.
+void IndexTask::run() {
+    IndexResult *result = new IndexResult(lid, resource);
+    if (cancelled->loadAcquire() == 0) {
+        DatabaseConnection *db = connection();
+        if (resource) {
+            ResourceTable resourceTable(db);
+            result->flagRowid = resourceTable.getIndexNeededRowid(lid);
+            extractResource(db, result);
+        } else {
+            NoteTable noteTable(db);
+            result->flagRowid = noteTable.getIndexNeededRowid(lid);
+            extractNote(db, result);
+        }
+        if (result->loaded)
+            result->hashRecords();
+    }
+    queue->put(result);
+}
+
+
+
+void IndexTask::extractNote(DatabaseConnection *db, IndexResult *result) {
+    Note n;
+    NoteTable noteTable(db);
+    if (!noteTable.get(n, lid, false, false))
+        return;
+
+    QString title = "";
+    if (n.title.isSet())
+        title = n.title;
+    QString content = "";
+    if (n.content.isSet())
+        content = n.content;
+
+    IndexRecord rec;
+    rec.lid = lid;
+    rec.weight = 100;
+    rec.source = "text";
+    rec.content = global.normalizeTermForSearchAndIndex(EnmlText::toPlainText(content) + " " + title);
+    rec.title = title;          // Only searched through the tokenizer, which folds it
+    if (n.tagNames.isSet())
+        rec.tags = QStringList(n.tagNames).join(" ");
+    result->records.append(rec);
+    result->loaded = true;
+}
+
+
+
+// The text of a resource is indexed under the resource's own lid.  Searches
+// find the note through RESOURCE_NOTE_LID, the same as NoteIndexer's rows.
+void IndexTask::extractResource(DatabaseConnection *db, IndexResult *result) {
+    Resource r;
+    ResourceTable resourceTable(db);
+    if (!resourceTable.get(r, lid, false))
+        return;
+    result->loaded = true;
+    if (r.noteGuid.isSet()) {
+        NoteTable noteTable(db);
+        result->noteLid = noteTable.getLid(r.noteGuid);
+    }
+
+    if (r.attributes.isSet()) {
+        ResourceAttributes a = r.attributes;
+        QStringList names;
+        if (a.fileName.isSet())
+            names.append(a.fileName);
+        if (a.sourceURL.isSet())
+            names.append(a.sourceURL);
+        if (!names.isEmpty()) {
+            IndexRecord rec;
+            rec.lid = lid;
+            rec.weight = 100;
+            rec.source = "recognition";
+            rec.content = global.normalizeTermForSearchAndIndex(names.join(" "));
+            result->records.append(rec);
+        }
+    }
+
+    if (r.recognition.isSet()) {
+        Data recognition = r.recognition;
+        if (recognition.body.isSet())
+            addRecognition(result, recognition.body);
+    }
+
+    QString mime = "";
+    if (r.mime.isSet())
+        mime = r.mime;
+    QString fileName = "";
+    if (r.attributes.isSet() && r.attributes->fileName.isSet())
+        fileName = r.attributes->fileName;
+    QByteArray bodyHash;
+    if (r.data.isSet() && r.data->bodyHash.isSet())
+        bodyHash = r.data->bodyHash;
+    QString text = "";
+    if (mime == "application/pdf")
+        text = PdfText::text(lid, bodyHash);
+    else if (OfficeText::handles(mime, fileName))
+        text = OfficeText::text(lid, fileName, bodyHash);
+    else if (officeFound && mime.startsWith("application", Qt::CaseInsensitive))
+        text = attachmentText(lid, r, result->officeMissing);
+    if (text.trimmed() != "") {
+        IndexRecord rec;
+        rec.lid = lid;
+        rec.weight = 100;
+        rec.source = "recognition";
+        rec.content = global.normalizeTermForSearchAndIndex(text);
+        result->records.append(rec);
+    }
+}
+
+
+
+// Recognition candidates are grouped by weight, one row per weight, so the
+// minimum weight filter still applies to each word.
+void IndexTask::addRecognition(IndexResult *result, QByteArray xml) {
+    QMap<qint32, QStringList> words;
+    QXmlStreamReader reader(xml);
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (!reader.isStartElement() || reader.name() != "t")
+            continue;
+        qint32 weight = reader.attributes().value("w").toString().toInt();
+        QString text = reader.readElementText();
+        if (text != "")
+            words[weight].append(text);
+    }
+
+    QMap<qint32, QStringList>::iterator i;
+    for (i=words.begin(); i!=words.end(); ++i) {
+        IndexRecord rec;
+        rec.lid = result->lid;
+        rec.weight = i.key();
+        rec.source = "recognition";
+        rec.content = global.normalizeTermForSearchAndIndex(i.value().join(" "));
+        result->records.append(rec);
+    }
+}
+
+
+
+// Convert any other office file (.doc, .xls, .ppt ...) to text with soffice.
+// Each resource has its own output file, so several can be converted at once.
+QString IndexTask::attachmentText(qint32 reslid, Resource &r, bool &officeMissing) {
+    QString extension = "";
+    ResourceAttributes attributes;
+    if (r.attributes.isSet())
+        attributes = r.attributes;
+    if (attributes.fileName.isSet()) {
+        extension = attributes.fileName;
+        int i = extension.indexOf(".");
+        if (i != -1)
+            extension = extension.mid(i);
+    }
+    if (extension != ".doc"  && extension != ".xls"  && extension != ".ppt" &&
+        extension != ".docx" && extension != ".xlsx" && extension != ".pptx" &&
+        extension != ".pps"  && extension != ".pdf"  && extension != ".odt"  &&
+        extension != ".odf"  && extension != ".ott"  && extension != ".odm"  &&
+        extension != ".html" && extension != ".txt"  && extension != ".oth"  &&
+        extension != ".ods"  && extension != ".ots"  && extension != ".odg"  &&
+        extension != ".otg"  && extension != ".odp"  && extension != ".otp"  &&
+        extension != ".odb"  && extension != ".oxt"  && extension != ".htm"  &&
+        extension != ".docm")
+        return "";
+
+    QString file = global.fileManager.getDbaDirPath() + QString::number(reslid) +extension;
+    QFile dataFile(file);
+    if (!dataFile.exists()) {
+        QDir dir(global.fileManager.getDbaDirPath());
+        QStringList filterList;
+        filterList.append(QString::number(reslid)+".*");
+        QStringList list= dir.entryList(filterList, QDir::Files);
+        if (list.size() > 0) {
+            file = global.fileManager.getDbaDirPath()+list[0];
+        }
+    }
+
+    QString outDir = global.fileManager.getTmpDirPath();
+    QProcess sofficeProcess;
+    QString cmd = "soffice --headless --convert-to txt:\"Text\" --outdir "
+                    +outDir + " "
+                    +file;
+    sofficeProcess.start(cmd, QIODevice::ReadWrite|QIODevice::Unbuffered);
+    sofficeProcess.waitForStarted();
+    sofficeProcess.waitForFinished();
+    int rc = sofficeProcess.exitCode();
+    QLOG_DEBUG() << "soffice return code for " << reslid << ": " << rc;
+    if (rc == 255) {
+        QLOG_ERROR() << "soffice not found.  Disabling attachment indexing.";
+        officeMissing = true;
+        return "";
+    }
+
+    QString text = "";
+    QFile txtFile(outDir+QString::number(reslid) +".txt");
+    if (txtFile.open(QIODevice::ReadOnly)) {
+        text = txtFile.readAll();
+        txtFile.close();
+    }
+    QDir dir;
+    dir.remove(outDir+QString::number(reslid) +".txt");
+    return text;
+}
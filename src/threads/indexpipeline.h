@@ -0,0 +1,124 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef INDEXPIPELINE_H
+#define INDEXPIPELINE_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QRunnable>
+#include <QString>
+#include <QWaitCondition>
+
+#include "src/qevercloud/include/QEverCloud.h"
+using namespace qevercloud;
+
+//****************************************************
+//* The stages of the background indexer.  Each note
+//* or resource is an IndexTask that runs on the
+//* IndexRunner's thread pool: it loads the record
+//* with its thread's own connection, extracts the
+//* text (ENML, recognition XML, PDF or office file)
+//* and normalizes it.  The result goes on a bounded
+//* IndexQueue that the IndexRunner, the only writer,
+//* empties a batch per transaction.
+//****************************************************
+
+class DatabaseConnection;
+
+#define INDEX_QUEUE_PER_THREAD  8       // Results waiting for the writer, per extracting thread
+#define INDEX_WRITE_BATCH       200     // Notes or resources written per transaction
+
+
+// One row of text for the search index
+class IndexRecord
+{
+public:
+    qint32 lid;
+    qint32 weight;
+    QString source;
+    QString content;
+    QString title;          // Only for note text.  Ranked above the content.
+    QString tags;
+};
+
+
+
+// Everything extracted for one note or resource
+class IndexResult
+{
+public:
+    qint32 lid;
+    bool resource;
+    qint32 noteLid;         // Note owning a resource
+    bool loaded;            // False if it was cancelled or couldn't be read
+    bool officeMissing;     // soffice couldn't be run
+    qint64 flagRowid;       // Newest index needed flag when it was read.  Later ones are kept.
+    QList<IndexRecord> records;
+    QByteArray hash;        // Of the records.  The writer leaves the index alone if it hasn't changed.
+    IndexResult(qint32 lid, bool resource);
+    void hashRecords();
+};
+
+
+
+// Bounded hand off from the extracting threads to the writer.  put()
+// blocks while the queue is full.
+class IndexQueue
+{
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QList<IndexResult*> items;
+    int capacity;
+
+public:
+    IndexQueue();
+    void setCapacity(int capacity);
+    void put(IndexResult *result);
+    IndexResult *take();                        // Waits for a result
+    bool isEmpty();
+};
+
+
+
+class IndexTask : public QRunnable
+{
+private:
+    qint32 lid;
+    bool resource;
+    bool officeFound;
+    IndexQueue *queue;
+    const QAtomicInt *cancelled;
+
+    static DatabaseConnection *connection();    // This thread's connection
+    void extractNote(DatabaseConnection *db, IndexResult *result);
+    void extractResource(DatabaseConnection *db, IndexResult *result);
+    static void addRecognition(IndexResult *result, QByteArray xml);
+    static QString attachmentText(qint32 reslid, Resource &r, bool &officeMissing);
+
+public:
+    IndexTask(qint32 lid, bool resource, bool officeFound, IndexQueue *queue, const QAtomicInt *cancelled);
+    void run();
+};
+
+#endif // INDEXPIPELINE_H
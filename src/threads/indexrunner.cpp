@@ -22,16 +22,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/notetable.h"
 #include "src/sql/nsqlquery.h"
 #include "src/sql/resourcetable.h"
-#include <QTextDocument>
-#include <QtXml>
-#if QT_VERSION < 0x050000
-#include <poppler-qt4.h>
-#else
-#include <poppler-qt5.h>
-#endif
+#include "src/sql/searchindextable.h"
+#include <QElapsedTimer>
 
 extern Global global;
-using namespace Poppler;
 
 
 
@@ -42,19 +36,22 @@ IndexRunner::IndexRunner()
     init = false;
     officeFound = false;  // temporarily disabled to test performance impact
     this->pauseIndexing = false;
-    this->textDocument = nullptr;
     this->enableIndexing = true;
-    this->indexHash = nullptr;
     this->keepRunning = true;
     this->db = nullptr;
     //this->indexTimer = nullptr;
     this->iAmBusy = false;
+    threads = 1;
+    active = 1;
+    notesPerSecond = 0;
+    resourcesPerSecond = 0;
 }
 
 
-// Destructor
+// Destructor.  Any task still running finishes before the pool goes away.
 IndexRunner::~IndexRunner() {
-    delete indexHash;
+    cancelled.storeRelease(1);
+    pool.waitForDone();
 }
 
 
@@ -70,23 +67,28 @@ void IndexRunner::initialize() {
     iAmBusy = false;
     QLOG_DEBUG() << "Starting IndexRunner";
     db = new DatabaseConnection("indexrunner");
-    //indexTimer = new QTimer();
-    //indexTimer->setInterval(global.minIndexInterval);
-    //connect(indexTimer, SIGNAL(timeout()), this, SLOT(index()));
-    //indexTimer->start();
-    textDocument = new QTextDocument();
-    indexHash = new QHash<qint32, IndexRecord*>();
-    QLOG_DEBUG() << "Indexrunner initialized.";
-}
 
+    // Every thread keeps its connection, so they are never expired
+    threads = global.getIndexThreads();
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qMax(1, threads);
+    pool.setExpiryTimeout(-1);
+    setActiveThreads(threads);
+    QLOG_DEBUG() << "Indexrunner initialized with " << threads << " threads.";
+}
 
 
-// The index timer has expired.  Look for any unindexed notes or resources
-void IndexRunner::index() {
-    if (!enableIndexing)
-        return;
 
-    if (!keepRunning || pauseIndexing) {
+// Index what needs it.  The open note and notes updated in the last few
+// minutes, with their resources, go first on every thread.  The rest is the
+// backlog, which gets backlogThreads threads (INDEX_ALL_THREADS for all of
+// them or 0 to leave it for later).  A backlog pass does at most
+// indexNoteCountPause notes and indexResourceCountPause resources per thread
+// so the rest of the program gets a turn.
+void IndexRunner::index(qint32 openNote, qint32 backlogThreads) {
+    if (!enableIndexing || !keepRunning || pauseIndexing) {
+        emit(this->indexDone(false));
         return;
     }
 
@@ -94,435 +96,212 @@ void IndexRunner::index() {
         initialize();
     if (iAmBusy)
         return;
+    iAmBusy = true;
 
-    //indexTimer->stop();   // Stop the timer because we are already working
-    //indexTimer->setInterval(global.minIndexInterval);
-
-    busy(true,false);
-    QList<qint32> lids;
-
+    QElapsedTimer timer;
+    timer.start();
     NoteTable noteTable(db);
     ResourceTable resourceTable(db);
-    bool endMsgNeeded = false;
-
-    int countPause = global.indexNoteCountPause;
-
-    QList<qint32> finishedLids;
-    // Get any unindexed notes
-    if (keepRunning && !pauseIndexing && noteTable.getIndexNeeded(lids) > 0) {
-        QApplication::processEvents();
-        endMsgNeeded = true;
-        QLOG_DEBUG() << "Unindexed notes found: " << lids.size();
-
-        // Index any unindexed note content.
-        for (int i=0; keepRunning && !pauseIndexing && i<lids.size(); i++) {
-            QApplication::processEvents();
-            Note n;
-            noteTable.get(n, lids[i], false, false);
-            indexNote(lids[i],n);
-            finishedLids.append(lids[i]);
-            if (countPause <=0) {
-                flushCache();
-                for (int j=0; j<finishedLids.size(); j++)
-                    noteTable.setIndexNeeded(finishedLids[j], false);
-                //indexTimer->start();
-                busy(false,false);
-                return;
-            }
-            countPause--;
+    QList<qint32> notes;
+    QList<qint32> recent;
+    QList<qint32> resources;
+    QList<qint32> recentResources;
+    noteTable.getIndexNeeded(notes, recent);
+    resourceTable.getIndexNeeded(resources);
+    if (openNote > 0 && (recent.removeAll(openNote) > 0 || notes.removeAll(openNote) > 0))
+        recent.prepend(openNote);
+    for (int i=0; i<recent.size(); i++) {
+        QList<qint32> noteResources;
+        resourceTable.getResourceList(noteResources, recent[i]);
+        for (int j=0; j<noteResources.size(); j++) {
+            if (resources.removeOne(noteResources[j]))
+                recentResources.append(noteResources[j]);
         }
     }
-    if (keepRunning && !pauseIndexing)
-       flushCache();
-    for (int j=0; !pauseIndexing && keepRunning && j<finishedLids.size(); j++)
-        noteTable.setIndexNeeded(finishedLids[j], false);
-
-
-    lids.clear();  // Clear out the list so we can start on resources
-
-    if (!keepRunning || pauseIndexing) {
-        //indexTimer->start();
-        busy(false,false);
-        return;
+    qint32 pendingNotes = notes.size() + recent.size();
+    qint32 pendingResources = resources.size() + recentResources.size();
+    qint32 written = 0;
+    qint32 count = 0;
+
+    // What the user is working on
+    if (!recent.isEmpty() || !recentResources.isEmpty())
+        QLOG_DEBUG() << "Recent notes to index: " << recent.size() << ", resources: " << recentResources.size();
+    bool complete = runPipeline(recent, false, count);
+    pendingNotes -= count;
+    written += count;
+    if (complete) {
+        complete = runPipeline(recentResources, true, count);
+        pendingResources -= count;
+        written += count;
     }
 
-    countPause = global.indexResourceCountPause;
-    finishedLids.clear();
-    // Start indexing resources
-    if (keepRunning && !pauseIndexing && resourceTable.getIndexNeeded(lids) > 0) {
-        endMsgNeeded = true;
-
-        // Index each resource that is needed.
-        for (int i=0; keepRunning && !pauseIndexing && i<lids.size(); i++) {
-            QApplication::processEvents();
-            Resource r;
-            resourceTable.get(r, lids.at(i), false);
-            qint32 noteLid = noteTable.getLid(r.noteGuid);
-            indexRecognition(noteLid, r);
-            QString mime = "";
-            if (r.mime.isSet())
-                mime = r.mime;
-            if (mime == "application/pdf")
-                indexPdf(noteLid, r);
-            else {
-                if (mime.startsWith("application", Qt::CaseInsensitive))
-                    indexAttachment(noteLid, r);
-            }
-            finishedLids.append(lids[i]);
-            if (countPause <=0) {
-                flushCache();
-                for (int j=0; keepRunning && !pauseIndexing && j<finishedLids.size(); j++) {
-                    resourceTable.setIndexNeeded(finishedLids[j], false);
-                }
-                busy(false,false);
-                //indexTimer->start();
-                return;
-            }
-            countPause--;
+    // The backlog
+    qint32 backlog = backlogThreads < 0 ? threads : qMin(backlogThreads, threads);
+    bool trigramsDone = false;
+    if (complete && backlog > 0) {
+        setActiveThreads(backlog);
+        if (!notes.isEmpty()) {
+            QLOG_DEBUG() << "Unindexed notes found: " << notes.size();
+            qint32 limit = qMax(1, global.indexNoteCountPause) * backlog;
+            complete = runPipeline(notes.mid(0, limit), false, count) && notes.size() <= limit;
+            pendingNotes -= count;
+            written += count;
         }
-    }
-    if (!keepRunning || pauseIndexing) {
-        busy(false,false);
-        //indexTimer->start();
-        return;
-    }
-    if (keepRunning && !pauseIndexing)
-        flushCache();
-    for (int j=0; keepRunning && !pauseIndexing && j<finishedLids.size(); j++) {
-        resourceTable.setIndexNeeded(finishedLids[j], false);
+        if (complete && !resources.isEmpty()) {
+            QLOG_DEBUG() << "Unindexed resources found: " << resources.size();
+            qint32 limit = qMax(1, global.indexResourceCountPause) * backlog;
+            complete = runPipeline(resources.mid(0, limit), true, count) && resources.size() <= limit;
+            pendingResources -= count;
+            written += count;
+        }
+
+        // Once everything else is indexed, add any text that is older than
+        // the trigram index to it.  This is done a chunk at a time.
+        if (complete && keepRunning && !pauseIndexing) {
+            SearchIndexTable searchIndex(db);
+            trigramsDone = searchIndex.buildTrigrams();
+        }
+        setActiveThreads(threads);
     }
 
-    if (endMsgNeeded) {
+    double rate = 0;
+    if (written > 0)
+        rate = written / (qMax(timer.elapsed(), Q_INT64_C(1)) / 1000.0);
+    bool finished = complete && (backlog > 0 ? trigramsDone : notes.isEmpty() && resources.isEmpty());
+    if (finished && written > 0) {
         QLOG_DEBUG() << "Indexing completed";
     }
-    busy(false,true);
-    //indexTimer->setInterval(global.maxIndexInterval);
-    //indexTimer->start();
+    done(finished, qMax(0, pendingNotes), qMax(0, pendingResources), rate);
 }
 
 
 
-// This indexes the actual note.
-void IndexRunner::indexNote(qint32 lid, Note &n) {
-    if (n.title.isSet()) {
-        QLOG_DEBUG() << "Indexing note: " << n.title;
-    }
-
-    QString content = "";
-    if (n.content.isSet())
-        content = n.content; //.replace(QString("\n"), QString(" "));
-
-
-    // Start looking through the note
-    qint32 startPos = content.indexOf(QChar('<'));
-    qint32 endPos = content.indexOf(QChar('>'),startPos)+1;
-    content.remove(startPos,endPos-startPos);
-
-    // Remove encrypted text
-    while (keepRunning && !pauseIndexing && content.contains("<en-crypt")) {
-        startPos = content.indexOf("<en-crypt");
-        endPos = content.indexOf("</en-crypt>") + 11;
-        content = content.mid(0,startPos)+content.mid(endPos);
-    }
-
-    // Remove any XML tags
-    while (keepRunning && !pauseIndexing && content.contains(QChar('<'))) {
-        startPos = content.indexOf(QChar('<'));
-        endPos = content.indexOf(QChar('>'),startPos)+1;
-        content.remove(startPos,endPos-startPos);
-    };
-
-    if (!keepRunning || pauseIndexing) {
-        //indexTimer->start();
-        return;
-    }
-
-    // Get the content as an HTML doc.
-    textDocument->setHtml(content);
-    QString title  = "";
-    if (n.title.isSet())
-        title = n.title;
-    content = textDocument->toPlainText() + " " + title;
-
-    IndexRecord *rec = new IndexRecord();
-    rec->content = content;
-    rec->source = "text";
-    rec->weight = 100;
-    rec->lid = lid;
-    if (indexHash->contains(lid)) {
-        delete indexHash->value(lid);
-        indexHash->remove(lid);
-    }
-    indexHash->insert(lid, rec);
+// Set how many threads extract text, and size the queue to match
+void IndexRunner::setActiveThreads(qint32 count) {
+    active = qMax(1, count);
+    pool.setMaxThreadCount(active);
+    queue.setCapacity(active * INDEX_QUEUE_PER_THREAD);
 }
 
 
 
-
-
-// Index any resources
-void IndexRunner::indexRecognition(qint32 lid, Resource &r) {
-
-    if (!keepRunning || pauseIndexing) {
-        //indexTimer->start();
-        return;
-    }
-
-    // Add filename or source url to search index
-    if (r.attributes.isSet()) {
-        NSqlQuery sql(db);
-        ResourceAttributes a = r.attributes;
-        if (a.fileName.isSet()) {
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", lid);
-            sql.bindValue(":weight", 100);
-            sql.bindValue(":source", "recognition");
-            sql.bindValue(":content", QString(a.fileName));
-            sql.exec();
-        }
-        if (a.sourceURL.isSet()) {
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", lid);
-            sql.bindValue(":weight", 100);
-            sql.bindValue(":source", "recognition");
-            sql.bindValue(":content", QString(a.sourceURL));
-            sql.exec();
-        }
-    }
-
-
-    // Make sure we have something to look through.
-    Data recognition;
-    if (r.recognition.isSet())
-        recognition = r.recognition;
-    if (!recognition.body.isSet())
-        return;
-
-    QDomDocument doc;
-    QString emsg;
-    doc.setContent(recognition.body, &emsg);
-
-    // look for text tags
-    QDomNodeList anchors = doc.documentElement().elementsByTagName("t");
-#if QT_VERSION < 0x050000
-    for (unsigned int i=0; keepRunning && !pauseIndexing && i<anchors.length(); i++) {
-#else
-    for (int i=0; keepRunning && !pauseIndexing && i<anchors.length(); i++) {
-#endif
-        QApplication::processEvents();
-        QDomElement enmedia = anchors.at(i).toElement();
-        QString weight = enmedia.attribute("w");
-        QString text = enmedia.text();
-        if (text != "") {
-            IndexRecord *rec = new IndexRecord();
-            rec->weight = weight.toInt();
-            rec->lid = lid;
-            rec->content = text;
-            rec->source = "recognition";
-            if (indexHash->contains(lid)) {
-                delete indexHash->value(lid);
-                indexHash->remove(lid);
-            }
-            indexHash->insert(lid, rec);
+// Hand the lids to the pool and write what comes back.  At most the queue's
+// capacity is outstanding at a time, so a slow writer holds the extraction
+// back instead of piling up text in memory.  Returns false if indexing was
+// stopped or paused before every lid was done.
+bool IndexRunner::runPipeline(QList<qint32> lids, bool resources, qint32 &written) {
+    written = 0;
+    if (lids.isEmpty())
+        return keepRunning && !pauseIndexing;
+    QElapsedTimer timer;
+    timer.start();
+    cancelled.storeRelease(0);
+
+    qint32 capacity = active * INDEX_QUEUE_PER_THREAD;
+    qint32 next = 0;
+    qint32 outstanding = 0;
+    qint32 unchanged = 0;
+    QList<IndexResult*> batch;
+    while (next < lids.size() || outstanding > 0) {
+        bool stopping = !keepRunning || pauseIndexing;
+        if (stopping)
+            cancelled.storeRelease(1);
+        while (!stopping && next < lids.size() && outstanding < capacity) {
+            pool.start(new IndexTask(lids[next++], resources, officeFound, &queue, &cancelled));
+            outstanding++;
         }
+        if (outstanding == 0)
+            break;
+
+        IndexResult *result = queue.take();
+        outstanding--;
+        if (result->loaded)
+            written++;
+        batch.append(result);
+        if (batch.size() >= INDEX_WRITE_BATCH || outstanding == 0)
+            unchanged += writeBatch(batch);
     }
+    unchanged += writeBatch(batch);
+
+    double seconds = qMax(timer.elapsed(), Q_INT64_C(1)) / 1000.0;
+    double rate = written / seconds;
+    if (resources)
+        resourcesPerSecond = rate;
+    else
+        notesPerSecond = rate;
+    QLOG_INFO() << "Indexed " << written << (resources ? " resources in " : " notes in ")
+                << timer.elapsed() << "ms, " << rate << "/s with " << active << " threads, "
+                << unchanged << " unchanged";
+    return next >= lids.size() && cancelled.loadAcquire() == 0;
 }
 
 
-// Index any PDFs that are attached.  Basically it turns the PDF into text and adds it the same
-// way as a note's body
-void IndexRunner::indexPdf(qint32 lid, Resource &r) {
-    if (!global.indexPDFLocally)
-        return;
-    if (!keepRunning || pauseIndexing) {
-        //indexTimer->start();
-        return;
-    }
-    ResourceTable rtable(db);
-    qint32 reslid = rtable.getLid(r.guid);
-    if (lid <= 0) {
-        //indexTimer->start();
-        return;
-    }
-    QString file = global.fileManager.getDbaDirPath() + QString::number(reslid) +".pdf";
-
-    QString text = "";
-    Poppler::Document *doc = Poppler::Document::load(file);
-    if (doc == nullptr || doc->isEncrypted() || doc->isLocked()) {
-        //indexTimer->start();
-        return;
-    }
-    for (int i=0; keepRunning && !pauseIndexing && i<doc->numPages(); i++) {
-        QRectF rect;
-        text = text + doc->page(i)->text(rect) + QString(" ");
-    }
-    IndexRecord *rec = new IndexRecord();
-    rec->content = text;
-    rec->source = "recognition";
-    rec->weight = 100;
-    rec->lid = lid;
-    if (indexHash->contains(lid)) {
-        delete indexHash->value(lid);
-        indexHash->remove(lid);
-    }
-    indexHash->insert(lid, rec);
-}
-
-
-
 
-// Index any files that are attached.
-void IndexRunner::indexAttachment(qint32 lid, Resource &r) {
-    if (!officeFound)
-        return;
-    QLOG_DEBUG() << "indexing attachment to note " << lid;
-    if (!keepRunning || pauseIndexing) {
-        //indexTimer->start();
-        return;
-    }
-    ResourceTable rtable(db);
-    qint32 reslid = rtable.getLid(r.guid);
-    if (lid <= 0) {
-        //indexTimer->start();
-        return;
-    }
-    QLOG_DEBUG() << "Resource " << reslid;
-    QString extension = "";
-    ResourceAttributes attributes;
-    if (r.attributes.isSet())
-        attributes = r.attributes;
-    if (attributes.fileName.isSet()) {
-        extension = attributes.fileName;
-        int i = extension.indexOf(".");
-	if (i != -1)
-	  extension = extension.mid(i);
-    }
-    if (extension != ".doc"  && extension != ".xls"  && extension != ".ppt" &&
-        extension != ".docx" && extension != ".xlsx" && extension != ".pptx" &&
-        extension != ".pps"  && extension != ".pdf"  && extension != ".odt"  &&
-        extension != ".odf"  && extension != ".ott"  && extension != ".odm"  &&
-        extension != ".html" && extension != ".txt"  && extension != ".oth"  &&
-        extension != ".ods"  && extension != ".ots"  && extension != ".odg"  &&
-        extension != ".otg"  && extension != ".odp"  && extension != ".otp"  &&
-        extension != ".odb"  && extension != ".oxt"  && extension != ".htm"  &&
-        extension != ".docm")
-                return;
-
-    QString file = global.fileManager.getDbaDirPath() + QString::number(reslid) +extension;
-    QFile dataFile(file);
-    if (!dataFile.exists()) {
-        QDir dir(global.fileManager.getDbaDirPath());
-        QStringList filterList;
-        filterList.append(QString::number(lid)+".*");
-        QStringList list= dir.entryList(filterList, QDir::Files);
-        if (list.size() > 0) {
-            file = global.fileManager.getDbaDirPath()+list[0];
-        }
-    }
+// Write a batch of extracted text in one transaction.  Whatever a note or
+// resource had in the index for these sources is replaced, unless the
+// text hashes the same as what is there already.  If the transaction can't
+// be started nothing is written and the index flags are left set, so the
+// next pass picks the batch up again.
+qint32 IndexRunner::writeBatch(QList<IndexResult*> &batch) {
+    if (batch.isEmpty())
+        return 0;
+    QElapsedTimer timer;
+    timer.start();
 
-    QString outDir = global.fileManager.getTmpDirPath();
-
-    QProcess sofficeProcess;
-    QString cmd = "soffice --headless --convert-to txt:\"Text\" --outdir "
-                    +outDir + " "
-                    +file;
-
-    sofficeProcess.start(cmd,
-                         QIODevice::ReadWrite|QIODevice::Unbuffered);
-
-    QLOG_DEBUG() << "Starting soffice ";
-    sofficeProcess.waitForStarted();
-    QLOG_DEBUG() << "Waiting for completion";
-    sofficeProcess.waitForFinished();
-    int rc = sofficeProcess.exitCode();
-    QLOG_DEBUG() << "soffice Errors:" << sofficeProcess.readAllStandardError();
-    QLOG_DEBUG() << "soffice Output:" << sofficeProcess.readAllStandardOutput();
-    QLOG_DEBUG() << "return code:" << rc;
-    if (rc == 255) {
-        QLOG_ERROR() << "soffice not found.  Disabling attachment indexing.";
-        this->officeFound = false;
-        return;
-    }
-    QFile txtFile(outDir+QString::number(reslid) +".txt");
-    if (txtFile.open(QIODevice::ReadOnly)) {
-        QString text;
-        text = txtFile.readAll();
-        NSqlQuery sql(db);
-        db->lockForWrite();
-        sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, 'recognition', :content)");
-        sql.bindValue(":lid", lid);
-        sql.bindValue(":weight", 100);
-
-        text = global.normalizeTermForSearchAndIndex(text);
-        sql.bindValue(":content", text);
-
-        QLOG_DEBUG() << "Adding note resource to index DB";
-        sql.exec();
+    SearchIndexTable searchIndex(db);
+    NoteTable noteTable(db);
+    ResourceTable resourceTable(db);
+    qint32 unchanged = 0;
+    db->lockForWrite();
+    if (!db->beginTransaction()) {
+        QLOG_ERROR() << "Unable to start a search index transaction.  The batch will be indexed again.";
         db->unlock();
-        txtFile.close();
+        qDeleteAll(batch);
+        batch.clear();
+        return 0;
     }
-    QDir dir;
-    dir.remove(outDir+QString::number(reslid) +".txt");
-}
-
-
-void IndexRunner::flushCache() {
-    if (indexHash->size() <= 0)
-        return;
-    QDateTime start = QDateTime::currentDateTimeUtc();
-    NSqlQuery sql(db);
-    db->lockForWrite();
-    sql.exec("begin");
-    QHash<qint32, IndexRecord*>::iterator i;
-
-    // Start adding words to the index.  Every 200 sql insertions we do a commit
-    int commitCount = 200;
-
-    for (i=indexHash->begin(); keepRunning && !pauseIndexing && i!=indexHash->end(); ++i) {
-        qint32 lid = i.key();
-        IndexRecord *rec = i.value();
-        qint32 weight = rec->weight;
-        QString source = rec->source;
-        QString content = rec->content;
-        delete rec;
-
-        // Delete any old content
-        sql.prepare("Delete from SearchIndex where lid=:lid and source=:source");
-        sql.bindValue(":lid", lid);
-        sql.bindValue(":source", source);
-        sql.exec();
-
-        // Add the new content.  it is basically a text version of the note with a weight of 100.
-        sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-        sql.bindValue(":lid", lid);
-        sql.bindValue(":weight", weight);
-        sql.bindValue(":source", source);
-
-        content = global.normalizeTermForSearchAndIndex(content);
-        sql.bindValue(":content", content);
-
-        sql.exec();
-        commitCount--;
-        if (commitCount <= 0) {
-            sql.exec("commit");
-            commitCount = 200;
+    for (int i=0; i<batch.size(); i++) {
+        IndexResult *result = batch[i];
+        if (result->officeMissing)
+            officeFound = false;
+        if (!result->loaded)
+            continue;
+        QString source = result->resource ? "recognition" : "text";
+        if (result->hash == searchIndex.getHash(result->lid, source)) {
+            unchanged++;
+        } else {
+            searchIndex.expunge(result->lid, source);
+
+            // Older versions filed resource text under the note
+            if (result->resource && result->noteLid > 0)
+                searchIndex.expunge(result->noteLid, "recognition");
+            for (int j=0; j<result->records.size(); j++) {
+                const IndexRecord &rec = result->records[j];
+                searchIndex.add(rec.lid, rec.weight, rec.source, rec.content, rec.title, rec.tags);
+            }
+            searchIndex.setHash(result->lid, source, result->hash);
         }
+        if (result->resource)
+            resourceTable.clearIndexNeeded(result->lid, result->flagRowid);
+        else
+            noteTable.clearIndexNeeded(result->lid, result->flagRowid);
+    }
+    if (!db->commitTransaction()) {
+        QLOG_ERROR() << "Unable to write the search index.  The batch will be indexed again.";
+        db->rollbackTransaction();
     }
-    indexHash->clear();
-    sql.exec("commit");
-
-    sql.finish();
     db->unlock();
-    QDateTime finish = QDateTime::currentDateTimeUtc();
 
-    QLOG_DEBUG() << "Index Cache Flush Complete: " <<
-                    finish.toMSecsSinceEpoch() - start.toMSecsSinceEpoch()
-                    << " milliseconds.";
+    QLOG_DEBUG() << "Index batch of " << batch.size() << " written in " << timer.elapsed() << "ms";
+    qDeleteAll(batch);
+    batch.clear();
+    return unchanged;
 }
 
 
 
-void IndexRunner::busy(bool value, bool finished) {
-    iAmBusy=value;
+void IndexRunner::done(bool finished, qint32 notes, qint32 resources, double rate) {
+    iAmBusy = false;
+    emit(this->indexProgress(notes, resources, rate));
     emit(this->indexDone(finished));
 }
@@ -22,18 +22,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
 #include <QString>
-#include <QMap>
-#include <QHash>
-#include <QVector>
+#include <QList>
 #include "src/sql/databaseconnection.h"
+#include "indexpipeline.h"
 
 #include <iostream>
 #include <string>
 #include <stdio.h>
 #include <QFileInfo>
 #include <QTimer>
-#include <QTextDocument>
 
 #include "src/qevercloud/include/QEverCloud.h"
 using namespace qevercloud;
@@ -43,34 +43,33 @@ using namespace std;
 // Forward declare classes used later
 class DatabaseConnection;
 
-class IndexRecord : public QObject
-{
-    Q_OBJECT
-public:
-    qint32 lid;
-    qint32 weight;
-    QString source;
-    QString content;
-};
+#define INDEX_ALL_THREADS   -1      // The backlog may use every extracting thread
 
 
 
+//****************************************************
+//* Background indexer.  Text is extracted by a pool
+//* of IndexTasks and this thread writes it to the
+//* search index a batch at a time.  The
+//* IndexScheduler decides when it runs and how many
+//* threads the backlog gets.
+//****************************************************
 
 class IndexRunner : public QObject
 {
     Q_OBJECT
 private:
     QTimer *indexTimer;
-    QHash<qint32, IndexRecord*> *indexHash;
     bool init;
-    void indexRecognition(qint32 lid, Resource &r);
-    void indexNote(qint32 lid, Note &n);
-    void indexPdf(qint32 lid, Resource &r);
-    void indexAttachment(qint32 lid, Resource &r);
-    QTextDocument *textDocument;
     DatabaseConnection *db;
-    void flushCache();
-    void busy(bool value, bool finished);
+    QThreadPool pool;                   // Extracts the text
+    IndexQueue queue;                   // Extracted text waiting to be written
+    QAtomicInt cancelled;               // Set to make queued tasks skip their work
+    qint32 active;                      // Threads the current pass may use
+    void setActiveThreads(qint32 count);
+    bool runPipeline(QList<qint32> lids, bool resources, qint32 &written);
+    qint32 writeBatch(QList<IndexResult*> &batch);    // Returns how many were unchanged
+    void done(bool finished, qint32 notes, qint32 resources, double rate);
     bool iAmBusy;
 
 public:
@@ -79,15 +78,19 @@ public:
     bool pauseIndexing;
     void initialize();
     bool officeFound;
+    qint32 threads;                     // Extracting threads
+    double notesPerSecond;              // Rate of the last pass that indexed notes
+    double resourcesPerSecond;          // Rate of the last pass that indexed resources
     IndexRunner();
     ~IndexRunner();
 
 signals:
     void thumbnailNeeded(qint32);
     void indexDone(bool finished);
+    void indexProgress(qint32 notes, qint32 resources, double rate);   // Backlog left & items/s
 
  public slots:
-    void index();
+    void index(qint32 openNote, qint32 backlogThreads);
 
 };
 
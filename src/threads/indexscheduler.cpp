@@ -0,0 +1,161 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "indexscheduler.h"
+#include "indexrunner.h"
+#include "src/global.h"
+#include "src/gui/nbrowserwindow.h"
+#include "src/gui/ntabwidget.h"
+
+#include <QEvent>
+#include <QFile>
+
+extern Global global;
+
+
+IndexScheduler::IndexScheduler(NTabWidget *tabWindow, QObject *parent) : QObject(parent)
+{
+    this->tabWindow = tabWindow;
+    inputSinceRun = false;
+    started = false;
+    running = false;
+    finished = false;
+    cpuTotal = 0;
+    cpuBusy = 0;
+    cpuSelf = 0;
+    timer.setInterval(INDEX_SCHEDULER_TICK);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+
+
+// Start watching the user's input & checking for work.  The first run
+// waits as long as the thumbnailer does so startup isn't slowed down.
+void IndexScheduler::start() {
+    global.application->installEventFilter(this);
+    lastInput.start();
+    lastRun.start();
+    cpuLoad();
+    timer.start();
+}
+
+
+
+// Note when the user last did something.  Nothing is filtered out.
+bool IndexScheduler::eventFilter(QObject *watched, QEvent *event) {
+    switch (event->type()) {
+    case QEvent::KeyPress:
+    case QEvent::MouseButtonPress:
+    case QEvent::Wheel:
+        lastInput.restart();
+        inputSinceRun = true;
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+
+
+// The runner is done.  Either the backlog is empty or it stopped
+// to give the rest of the program a turn.
+void IndexScheduler::indexFinished(bool finished) {
+    running = false;
+    this->finished = finished;
+}
+
+
+
+// See if the runner should be started & how many threads the backlog gets.
+// With a backlog it runs again right away if the user is away & the CPU is
+// free, otherwise every minIndexInterval.  Without one it only looks again
+// after maxIndexInterval, or minIndexInterval if the user did something.
+void IndexScheduler::tick() {
+    qint32 load = cpuLoad();
+    if (running)
+        return;
+
+    bool idle = lastInput.elapsed() >= INDEX_IDLE_TIME;
+    qint32 backlogThreads = INDEX_ALL_THREADS;
+    if (load >= INDEX_CPU_BUSY)
+        backlogThreads = 0;
+    else if (!idle)
+        backlogThreads = 1;
+
+    qint64 interval = global.minIndexInterval;
+    if (!started)
+        interval = global.minimumThumbnailInterval;
+    else if (finished && !inputSinceRun)
+        interval = global.maxIndexInterval;
+    else if (!finished && backlogThreads == INDEX_ALL_THREADS)
+        interval = 0;
+    if (lastRun.elapsed() < interval)
+        return;
+
+    qint32 openNote = 0;
+    NBrowserWindow *browser = tabWindow->currentBrowser();
+    if (browser != nullptr)
+        openNote = browser->lid;
+
+    started = true;
+    running = true;
+    inputSinceRun = false;
+    lastRun.restart();
+    emit indexRequested(openNote, backlogThreads);
+}
+
+
+
+// How busy other programs kept the CPU since the last call, as a percent
+// of every core.  Indexing's own threads are left out so it doesn't hold
+// itself back.  Returns -1 if it can't be read.
+qint32 IndexScheduler::cpuLoad() {
+    QFile stat("/proc/stat");
+    QFile self("/proc/self/stat");
+    if (!stat.open(QIODevice::ReadOnly) || !self.open(QIODevice::ReadOnly))
+        return -1;
+
+    // cpu user nice system idle iowait irq softirq steal ...
+    QList<QByteArray> cpu = stat.readLine().simplified().split(' ');
+    if (cpu.size() < 9 || cpu[0] != "cpu")
+        return -1;
+    quint64 total = 0;
+    for (int i=1; i<9; i++)
+        total += cpu[i].toULongLong();
+    quint64 busy = total - cpu[4].toULongLong() - cpu[5].toULongLong();
+
+    // The program name can hold spaces, so count from the ')' after it.
+    // utime & stime are the 12th & 13th fields after that.
+    QByteArray line = self.readAll();
+    QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13)
+        return -1;
+    quint64 own = fields[11].toULongLong() + fields[12].toULongLong();
+
+    qint32 retval = -1;
+    if (cpuTotal > 0 && total > cpuTotal) {
+        qint64 others = static_cast<qint64>(busy - cpuBusy) - static_cast<qint64>(own - cpuSelf);
+        retval = static_cast<qint32>(qMax(Q_INT64_C(0), others) * 100 / static_cast<qint64>(total - cpuTotal));
+    }
+    cpuTotal = total;
+    cpuBusy = busy;
+    cpuSelf = own;
+    return retval;
+}
@@ -0,0 +1,77 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef INDEXSCHEDULER_H
+#define INDEXSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+//****************************************************
+//* Decides when the IndexRunner runs.  The note that
+//* is open and notes edited in the last few minutes
+//* are indexed whenever it runs.  The backlog is held
+//* while other programs keep the CPU busy, gets one
+//* thread while the user is typing or clicking, and
+//* every thread once they stop.  CPU load is read
+//* from /proc.  Where there is no /proc only user
+//* activity counts.
+//****************************************************
+
+class NTabWidget;
+
+#define INDEX_SCHEDULER_TICK    1000    // How often the scheduler checks, in ms
+#define INDEX_IDLE_TIME         30000   // No input for this long (ms) means the user is away
+#define INDEX_CPU_BUSY          75      // Load (%) from other programs that holds the backlog
+
+
+class IndexScheduler : public QObject
+{
+    Q_OBJECT
+private:
+    QTimer timer;
+    NTabWidget *tabWindow;
+    QElapsedTimer lastInput;            // Since the last key press, click or scroll
+    QElapsedTimer lastRun;              // Since the runner was last started
+    bool inputSinceRun;                 // The user did something since the last run
+    bool started;                       // The runner has run at least once
+    bool running;                       // Waiting for the runner to finish
+    bool finished;                      // The last run found no backlog
+    quint64 cpuTotal;                   // Last /proc/stat sample, in clock ticks
+    quint64 cpuBusy;
+    quint64 cpuSelf;
+    qint32 cpuLoad();                   // % used by other programs since the last call, or -1
+
+public:
+    IndexScheduler(NTabWidget *tabWindow, QObject *parent = nullptr);
+    void start();
+    bool eventFilter(QObject *watched, QEvent *event);
+
+signals:
+    void indexRequested(qint32 openNote, qint32 backlogThreads);
+
+public slots:
+    void indexFinished(bool finished);
+
+private slots:
+    void tick();
+};
+
+#endif // INDEXSCHEDULER_H
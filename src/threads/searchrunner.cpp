@@ -0,0 +1,102 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#include "searchrunner.h"
+#include "src/global.h"
+#include "src/filters/filterengine.h"
+#include "src/sql/databaseconnection.h"
+#include "src/sql/nsqlquery.h"
+
+extern Global global;
+
+SearchRunner::SearchRunner(QObject *parent) :
+    QObject(parent)
+{
+    init = false;
+    db = nullptr;
+    keepRunning = true;
+    currentSearch = 0;
+    qRegisterMetaType<LidBitmap>("LidBitmap");
+    qRegisterMetaType< QList<QVariant> >("QList<QVariant>");
+    qRegisterMetaType< QList<qint32> >("QList<qint32>");
+    qRegisterMetaType< QList<double> >("QList<double>");
+}
+
+
+// Open our own connection the first time we are used, so it belongs to
+// the search thread.
+void SearchRunner::initialize() {
+    QLOG_DEBUG() << "Starting SearchRunner";
+    db = new DatabaseConnection("searchrunner");
+    NSqlQuery sql(db);
+    sql.exec("pragma query_only=1");
+    sql.finish();
+    init = true;
+}
+
+
+
+// Called from the GUI thread.  Bumping the id is what cancels a running search.
+qint32 SearchRunner::nextSearch() {
+    return latestSearch.fetchAndAddOrdered(1) + 1;
+}
+
+
+bool SearchRunner::isCurrent(qint32 id) {
+    return latestSearch.loadAcquire() == id;
+}
+
+
+
+// Run a search compiled by FilterEngine::compileSearch().  Searches that
+// were replaced while they were waiting in the queue are skipped.
+void SearchRunner::search(qint32 id, QString statement, QList<QVariant> values, LidBitmap indexed) {
+    if (!keepRunning || !isCurrent(id))
+        return;
+    if (!init)
+        initialize();
+
+    currentSearch = id;
+    FilterEngine engine;
+    engine.setCancelCheck(&latestSearch, id);
+    engine.setBatchSize(SEARCH_FIRST_BATCH);
+    connect(&engine, SIGNAL(partialResults(QList<qint32>,QList<double>)),
+            this, SLOT(sendBatch(QList<qint32>,QList<double>)), Qt::DirectConnection);
+
+    QList<qint32> lids;
+    QList<double> relevance;
+    bool found = engine.runSearch(db, statement, values, indexed, lids, relevance);
+    if (engine.isCancelled()) {
+        QLOG_DEBUG() << "Search " << id << " cancelled";
+        return;
+    }
+    if (!found) {
+        emit searchFailed(id);
+        return;
+    }
+    emit searchResults(id, lids, relevance, true);
+}
+
+
+
+// Pass on the hits found so far by the running search
+void SearchRunner::sendBatch(QList<qint32> lids, QList<double> relevance) {
+    emit searchResults(currentSearch, lids, relevance, false);
+}
@@ -0,0 +1,74 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef SEARCHRUNNER_H
+#define SEARCHRUNNER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QList>
+#include <QVariant>
+#include "src/filters/lidbitmap.h"
+
+//*************************************************
+//* Runs note searches on their own thread & read
+//* only connection so typing in the search box
+//* doesn't hold up the GUI.  The criteria are
+//* compiled on the GUI thread (they point at tree
+//* items) and only the statement is run here.  Only
+//* the newest search matters: starting one cancels
+//* any that are still running.  Hits are sent back
+//* in batches and the GUI writes them to its filter
+//* table, so the first page shows up before the
+//* search is finished.
+//*************************************************
+
+#define SEARCH_FIRST_BATCH 200      // Hits in the first batch sent back
+
+class DatabaseConnection;
+
+class SearchRunner : public QObject
+{
+    Q_OBJECT
+private:
+    DatabaseConnection *db;
+    bool init;
+    QAtomicInt latestSearch;        // Id of the newest search requested
+    qint32 currentSearch;           // Id of the search running now
+    void initialize();
+
+public:
+    explicit SearchRunner(QObject *parent = 0);
+    bool keepRunning;
+    qint32 nextSearch();            // Get an id for a new search.  Older searches stop.
+    bool isCurrent(qint32 id);      // Is this still the newest search?
+
+signals:
+    // Batches have the hits found since the last one.  The finished one has all of them.
+    void searchResults(qint32 id, QList<qint32> lids, QList<double> relevance, bool finished);
+    void searchFailed(qint32 id);   // The statement failed.  Use the legacy filter.
+
+public slots:
+    void search(qint32 id, QString statement, QList<QVariant> values, LidBitmap indexed);
+
+private slots:
+    void sendBatch(QList<qint32> lids, QList<double> relevance);
+};
+
+#endif // SEARCHRUNNER_H
@@ -18,6 +18,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 ***********************************************************************************/
 
 #include <QTimer>
+#include <QTime>
 
 #include "syncrunner.h"
 #include "src/global.h"
@@ -42,6 +43,7 @@ SyncRunner::SyncRunner() {
     finalSync = false;
     apiRateLimitExceeded = false;
     minutesToNextSync = 0;
+    syncItemErrors = 0;
 }
 
 SyncRunner::~SyncRunner() {
@@ -88,7 +90,11 @@ void SyncRunner::synchronize() {
 
     global.connected = true;
     keepRunning = true;
+    qint64 startHits = db->getStatementCacheHits();
+    qint64 startMisses = db->getStatementCacheMisses();
     evernoteSync();
+    QLOG_INFO() << "Sync statement cache: " << db->getStatementCacheHits()-startHits << " hits, "
+                << db->getStatementCacheMisses()-startMisses << " misses";
     emit syncComplete();
     comm->enDisconnect();
     global.connected = false;
@@ -288,8 +294,19 @@ bool SyncRunner::syncRemoteToLocal(qint32 updateCount) {
 }
 
 
-// Deal with the sync chunk returned
+// Deal with the sync chunk returned.  The whole chunk is written in one
+// transaction with a savepoint around each object, so one bad object
+// only loses itself and we don't pay for a commit on every statement.
+// Attachment text isn't read while the transaction is open; the resources
+// stay flagged for the index pipeline (see NoteIndexer::indexResource()).
 void SyncRunner::processSyncChunk(SyncChunk &chunk, qint32 linkedNotebook) {
+    QTime applyTimer;
+    applyTimer.start();
+    qint32 noteCount = chunk.notes.isSet() ? chunk.notes.ref().size() : 0;
+    qint32 resourceCount = chunk.resources.isSet() ? chunk.resources.ref().size() : 0;
+    qint32 startErrors = db->getErrorCount();
+    clearUpdates();
+    bool inTransaction = db->beginTransaction();
 
     // Now start processing the chunk
     if (chunk.expungedNotes.isSet())
@@ -326,6 +343,20 @@ void SyncRunner::processSyncChunk(SyncChunk &chunk, qint32 linkedNotebook) {
     if (chunk.resources.isSet())
         syncRemoteResources(chunk.resources);
 
+    if (inTransaction && !db->commitTransaction()) {
+        db->rollbackTransaction();
+        global.identityMap.clear();
+        global.filterIndex.clear();
+        global.identityMap.load(db);
+        clearUpdates();
+    }
+    QLOG_INFO() << "Sync chunk applied in " << applyTimer.elapsed() << " ms (" << noteCount << " notes, "
+                << resourceCount << " resources, " << db->getErrorCount()-startErrors << " errors)";
+
+    // Tell everyone about the changes now that other connections can see them
+    if (!finalSync)
+        announceUpdates();
+    clearUpdates();
 
     chunk.expungedLinkedNotebooks.clear();;
     chunk.expungedNotebooks.clear();
@@ -367,12 +398,95 @@ void SyncRunner::processSyncChunk(SyncChunk &chunk, qint32 linkedNotebook) {
 }
 
 
+void SyncRunner::queueTagUpdate(qint32 lid, QString name, QString parentGuid, qint32 account) {
+    TagUpdate update;
+    update.lid = lid;
+    update.name = name;
+    update.parentGuid = parentGuid;
+    update.account = account;
+    updatedTags.append(update);
+}
+
+
+void SyncRunner::queueNotebookUpdate(qint32 lid, QString name, QString stack, bool linked, bool shared) {
+    NotebookUpdate update;
+    update.lid = lid;
+    update.name = name;
+    update.stack = stack;
+    update.linked = linked;
+    update.shared = shared;
+    updatedNotebooks.append(update);
+}
+
+
+void SyncRunner::queueSearchUpdate(qint32 lid, QString name) {
+    SearchUpdate update;
+    update.lid = lid;
+    update.name = name;
+    updatedSearches.append(update);
+}
+
+
+// Emit the updates queued while the chunk was applied, in the order the
+// chunk applies them: notebooks, tags & searches before their notes.
+void SyncRunner::announceUpdates() {
+    for (int i=0; i<updatedNotebooks.size(); i++) {
+        NotebookUpdate &u = updatedNotebooks[i];
+        emit notebookUpdated(u.lid, u.name, u.stack, u.linked, u.shared);
+    }
+    for (int i=0; i<updatedTags.size(); i++) {
+        TagUpdate &u = updatedTags[i];
+        emit tagUpdated(u.lid, u.name, u.parentGuid, u.account);
+    }
+    for (int i=0; i<updatedSearches.size(); i++)
+        emit searchUpdated(updatedSearches[i].lid, updatedSearches[i].name);
+    for (int i=0; i<updatedNotes.size(); i++)
+        emit noteUpdated(updatedNotes[i]);
+}
+
+
+void SyncRunner::clearUpdates() {
+    updatedNotebooks.clear();
+    updatedTags.clear();
+    updatedSearches.clear();
+    updatedNotes.clear();
+}
+
+
+// Start applying a single object from a sync chunk
+void SyncRunner::beginSyncItem() {
+    syncItemErrors = db->getErrorCount();
+    db->savepoint("syncitem");
+}
+
+
+// Finish applying a single object.  If any statement failed we undo
+// everything written for it and leave the rest of the chunk alone.
+bool SyncRunner::endSyncItem(QString type, QString guid) {
+    if (db->getErrorCount() == syncItemErrors) {
+        db->releaseSavepoint("syncitem");
+        return true;
+    }
+    QLOG_ERROR() << "Error applying " << type << " " << guid << " from sync chunk.  Changes rolled back.";
+    db->rollbackToSavepoint("syncitem");
+    db->releaseSavepoint("syncitem");
+
+    // The identity map may hold guids that were just rolled back
+    global.identityMap.clear();
+    global.filterIndex.clear();
+    global.identityMap.load(db);
+    return false;
+}
+
+
 // Expunge deleted notes from the local database
 void SyncRunner::syncRemoteExpungedNotes(QList<Guid> guids) {
     QLOG_TRACE() << "Entering SyncRunner::syncRemoteExpungedNotes";
     NoteTable noteTable(db);
     for (int i = 0; i < guids.size(); i++) {
+        beginSyncItem();
         noteTable.expunge(guids[i]);
+        endSyncItem("expunged note", guids[i]);
     }
     QLOG_TRACE() << "Leaving SyncRunner::syncRemoteExpungedNotes";
 }
@@ -384,7 +498,10 @@ void SyncRunner::syncRemoteExpungedNotebooks(QList<Guid> guids) {
     NotebookTable notebookTable(db);
     for (int i = 0; i < guids.size(); i++) {
         int lid = notebookTable.getLid(guids[i]);
+        beginSyncItem();
         notebookTable.expunge(guids[i]);
+        if (!endSyncItem("expunged notebook", guids[i]))
+            continue;
         if (!finalSync)
             emit notebookExpunged(lid);
     }
@@ -398,7 +515,10 @@ void SyncRunner::syncRemoteExpungedTags(QList<Guid> guids) {
     TagTable tagTable(db);
     for (int i = 0; i < guids.size(); i++) {
         int lid = tagTable.getLid(guids[i]);
+        beginSyncItem();
         tagTable.expunge(guids[i]);
+        if (!endSyncItem("expunged tag", guids[i]))
+            continue;
         if (!finalSync)
             emit tagExpunged(lid);
     }
@@ -427,6 +547,7 @@ void SyncRunner::syncRemoteTags(QList<Tag> tags, qint32 account) {
 
     for (int i = 0; i < tags.size() && keepRunning; i++) {
         Tag t = tags.at(i);
+        beginSyncItem();
 
         // There are two ways to get the tag.  We can get
         // it by name or by guid.  We check both.  We'll find it by
@@ -456,14 +577,16 @@ void SyncRunner::syncRemoteTags(QList<Tag> tags, qint32 account) {
             lid = tagTable.getLid(t.guid);
             changedTags.insert(t.guid, t.name);
         }
+        if (!endSyncItem("tag", t.guid))
+            continue;
         QString parentGuid = "";
         if (t.parentGuid.isSet())
             parentGuid = t.parentGuid;
         if (!finalSync) {
             if (t.name.isSet())
-                emit tagUpdated(lid, t.name, parentGuid, account);
+                queueTagUpdate(lid, t.name, parentGuid, account);
             else
-                emit(tagUpdated(lid, "", parentGuid, account));
+                queueTagUpdate(lid, "", parentGuid, account);
         }
     }
 
@@ -488,9 +611,9 @@ void SyncRunner::syncRemoteSearches(QList<SavedSearch> searches) {
         }
         if (!finalSync) {
             if (t.name.isSet())
-                emit searchUpdated(lid, t.name);
+                queueSearchUpdate(lid, t.name);
             else
-                emit searchUpdated(lid, "");
+                queueSearchUpdate(lid, "");
         }
     }
 
@@ -531,11 +654,14 @@ void SyncRunner::syncRemoteNotebooks(QList<Notebook> books, qint32 account) {
             lid = notebookTable.findByName(t.name);
 
 
+        beginSyncItem();
         if (lid > 0) {
             notebookTable.sync(lid, t);
         } else {
             lid = notebookTable.sync(t);
         }
+        if (!endSyncItem("notebook", t.guid))
+            continue;
         changedNotebooks.insert(t.guid, t.name);
         QString stack = "";
         if (t.stack.isSet())
@@ -552,9 +678,9 @@ void SyncRunner::syncRemoteNotebooks(QList<Notebook> books, qint32 account) {
         }
         if (!finalSync) {
             if (t.name.isSet())
-                emit notebookUpdated(lid, t.name, stack, false, shared);
+                queueNotebookUpdate(lid, t.name, stack, false, shared);
             else
-                emit notebookUpdated(lid, "", stack, false, shared);
+                queueNotebookUpdate(lid, "", stack, false, shared);
         }
     }
     QLOG_TRACE() << "Leaving SyncRunner::syncRemoteNotebooks";
@@ -570,27 +696,31 @@ void SyncRunner::syncRemoteNotes(QList<Note> notes, qint32 account) {
     for (int i = 0; i < notes.size() && keepRunning; i++) {
         Note t = notes[i];
         qint32 lid = noteTable.getLid(t.guid);
+        qint32 newLid = 0;
+        beginSyncItem();
         if (lid > 0) {
             // Find out if it is a conflicting change
             if (noteTable.isDirty(lid)) {
-                qint32 newLid = noteTable.duplicateNote(lid);
+                newLid = noteTable.duplicateNote(lid);
                 qint32 conflictNotebook = bookTable.getConflictNotebook();
                 noteTable.updateNotebook(newLid, conflictNotebook, true);
-                if (!finalSync)
-                    emit noteUpdated(newLid);
             }
             noteTable.sync(lid, notes.at(i), account);
         } else {
             noteTable.sync(t, account);
             lid = noteTable.getLid(t.guid);
         }
+        if (!endSyncItem("note", t.guid))
+            continue;
+
         // Remove it from the cache (if it exists)
         if (global.cache.contains(lid)) {
             delete global.cache[lid];
             global.cache.remove(lid);
         }
-        if (!finalSync)
-            emit noteUpdated(lid);
+        if (newLid > 0)
+            updatedNotes.append(newLid);
+        updatedNotes.append(lid);
     }
 
     QLOG_TRACE() << "Leaving SyncRunner::syncRemoteNotes";
@@ -605,10 +735,12 @@ void SyncRunner::syncRemoteResources(QList<Resource> resources) {
     for (int i = 0; i < resources.size(); i++) {
         Resource r = resources[i];
         qint32 lid = resTable.getLid(r.noteGuid, r.guid);
+        beginSyncItem();
         if (lid > 0)
             resTable.sync(lid, r);
         else
             resTable.sync(r);
+        endSyncItem("resource", r.guid);
     }
     QLOG_TRACE() << "Leaving SyncRunner::syncRemoteResources";
 }
@@ -628,7 +760,7 @@ void SyncRunner::syncRemoteLinkedNotebooksChunk(QList<LinkedNotebook> books) {
         if (lbk.username.isSet())
             username = lbk.username;
         if (!finalSync)
-            emit notebookUpdated(lid, sharename, username, true, false);
+            queueNotebookUpdate(lid, sharename, username, true, false);
     }
     QLOG_TRACE_OUT();
 }
@@ -70,12 +70,44 @@ private:
     bool fullSync;
     QHash<QString, QString> changedNotebooks;
     QHash<QString, QString> changedTags;
+    qint32 syncItemErrors;                       // Connection error count when the current item started
+    QList<qint32> updatedNotes;                  // Notes to announce once the chunk is committed
+
+    // Tags, notebooks & searches to announce once the chunk is committed.
+    // The GUI reads them back through its own connection.
+    struct TagUpdate {
+        qint32 lid;
+        QString name;
+        QString parentGuid;
+        qint32 account;
+    };
+    struct NotebookUpdate {
+        qint32 lid;
+        QString name;
+        QString stack;
+        bool linked;
+        bool shared;
+    };
+    struct SearchUpdate {
+        qint32 lid;
+        QString name;
+    };
+    QList<TagUpdate> updatedTags;
+    QList<NotebookUpdate> updatedNotebooks;
+    QList<SearchUpdate> updatedSearches;
 
     void evernoteSync();
     bool syncRemoteToLocal(qint32 highSequence);
     void syncRemoteExpungedNotes(QList<Guid> guids);
     void syncRemoteExpungedNotebooks(QList<Guid> guids);
     void processSyncChunk(SyncChunk &chunk, qint32 linkedNotebook=0);
+    void queueTagUpdate(qint32 lid, QString name, QString parentGuid, qint32 account);
+    void queueNotebookUpdate(qint32 lid, QString name, QString stack, bool linked, bool shared);
+    void queueSearchUpdate(qint32 lid, QString name);
+    void announceUpdates();                              // Emit everything queued for the chunk
+    void clearUpdates();
+    void beginSyncItem();                                 // Start a savepoint for one object in a chunk
+    bool endSyncItem(QString type, QString guid);         // Keep the object, or roll it back if a statement failed
     void syncRemoteExpungedTags(QList<Guid> guids);
     void syncRemoteExpungedSavedSearches(QList<Guid> guid);
 
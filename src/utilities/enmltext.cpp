@@ -0,0 +1,372 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "enmltext.h"
+
+#include <QByteArray>
+#include <stdlib.h>
+#include <string.h>
+
+// Elements that start a new line.  All of these lists are sorted for bsearch().
+static const char *blockElements[] = {
+    "address", "blockquote", "center", "dd", "div", "dl", "dt", "en-note",
+    "h1", "h2", "h3", "h4", "h5", "h6", "hr", "li", "ol", "p", "pre", "table",
+    "tr", "ul"
+};
+
+// Table cells only need to keep their words apart
+static const char *cellElements[] = {
+    "td", "th"
+};
+
+// Elements whose content is never shown as text
+static const char *skippedElements[] = {
+    "en-crypt", "script", "style"
+};
+
+class EnmlEntity
+{
+public:
+    const char *name;
+    ushort code;
+};
+
+// The HTML 4 entities the ENML DTD allows, plus &apos;
+static const EnmlEntity entities[] = {
+    {"AElig",198}, {"Aacute",193}, {"Acirc",194}, {"Agrave",192}, {"Alpha",913},
+    {"Aring",197}, {"Atilde",195}, {"Auml",196}, {"Beta",914}, {"Ccedil",199}, {"Chi",935},
+    {"Dagger",8225}, {"Delta",916}, {"ETH",208}, {"Eacute",201}, {"Ecirc",202},
+    {"Egrave",200}, {"Epsilon",917}, {"Eta",919}, {"Euml",203}, {"Gamma",915},
+    {"Iacute",205}, {"Icirc",206}, {"Igrave",204}, {"Iota",921}, {"Iuml",207},
+    {"Kappa",922}, {"Lambda",923}, {"Mu",924}, {"Ntilde",209}, {"Nu",925}, {"OElig",338},
+    {"Oacute",211}, {"Ocirc",212}, {"Ograve",210}, {"Omega",937}, {"Omicron",927},
+    {"Oslash",216}, {"Otilde",213}, {"Ouml",214}, {"Phi",934}, {"Pi",928}, {"Prime",8243},
+    {"Psi",936}, {"Rho",929}, {"Scaron",352}, {"Sigma",931}, {"THORN",222}, {"Tau",932},
+    {"Theta",920}, {"Uacute",218}, {"Ucirc",219}, {"Ugrave",217}, {"Upsilon",933},
+    {"Uuml",220}, {"Xi",926}, {"Yacute",221}, {"Yuml",376}, {"Zeta",918}, {"aacute",225},
+    {"acirc",226}, {"acute",180}, {"aelig",230}, {"agrave",224}, {"alefsym",8501},
+    {"alpha",945}, {"amp",38}, {"and",8743}, {"ang",8736}, {"apos",39}, {"aring",229},
+    {"asymp",8776}, {"atilde",227}, {"auml",228}, {"bdquo",8222}, {"beta",946},
+    {"brvbar",166}, {"bull",8226}, {"cap",8745}, {"ccedil",231}, {"cedil",184},
+    {"cent",162}, {"chi",967}, {"circ",710}, {"clubs",9827}, {"cong",8773}, {"copy",169},
+    {"crarr",8629}, {"cup",8746}, {"curren",164}, {"dArr",8659}, {"dagger",8224},
+    {"darr",8595}, {"deg",176}, {"delta",948}, {"diams",9830}, {"divide",247},
+    {"eacute",233}, {"ecirc",234}, {"egrave",232}, {"empty",8709}, {"emsp",8195},
+    {"ensp",8194}, {"epsilon",949}, {"equiv",8801}, {"eta",951}, {"eth",240}, {"euml",235},
+    {"euro",8364}, {"exist",8707}, {"fnof",402}, {"forall",8704}, {"frac12",189},
+    {"frac14",188}, {"frac34",190}, {"frasl",8260}, {"gamma",947}, {"ge",8805}, {"gt",62},
+    {"hArr",8660}, {"harr",8596}, {"hearts",9829}, {"hellip",8230}, {"iacute",237},
+    {"icirc",238}, {"iexcl",161}, {"igrave",236}, {"image",8465}, {"infin",8734},
+    {"int",8747}, {"iota",953}, {"iquest",191}, {"isin",8712}, {"iuml",239}, {"kappa",954},
+    {"lArr",8656}, {"lambda",955}, {"lang",9001}, {"laquo",171}, {"larr",8592},
+    {"lceil",8968}, {"ldquo",8220}, {"le",8804}, {"lfloor",8970}, {"lowast",8727},
+    {"loz",9674}, {"lrm",8206}, {"lsaquo",8249}, {"lsquo",8216}, {"lt",60}, {"macr",175},
+    {"mdash",8212}, {"micro",181}, {"middot",183}, {"minus",8722}, {"mu",956},
+    {"nabla",8711}, {"nbsp",160}, {"ndash",8211}, {"ne",8800}, {"ni",8715}, {"not",172},
+    {"notin",8713}, {"nsub",8836}, {"ntilde",241}, {"nu",957}, {"oacute",243},
+    {"ocirc",244}, {"oelig",339}, {"ograve",242}, {"oline",8254}, {"omega",969},
+    {"omicron",959}, {"oplus",8853}, {"or",8744}, {"ordf",170}, {"ordm",186},
+    {"oslash",248}, {"otilde",245}, {"otimes",8855}, {"ouml",246}, {"para",182},
+    {"part",8706}, {"permil",8240}, {"perp",8869}, {"phi",966}, {"pi",960}, {"piv",982},
+    {"plusmn",177}, {"pound",163}, {"prime",8242}, {"prod",8719}, {"prop",8733},
+    {"psi",968}, {"quot",34}, {"rArr",8658}, {"radic",8730}, {"rang",9002}, {"raquo",187},
+    {"rarr",8594}, {"rceil",8969}, {"rdquo",8221}, {"real",8476}, {"reg",174},
+    {"rfloor",8971}, {"rho",961}, {"rlm",8207}, {"rsaquo",8250}, {"rsquo",8217},
+    {"sbquo",8218}, {"scaron",353}, {"sdot",8901}, {"sect",167}, {"shy",173},
+    {"sigma",963}, {"sigmaf",962}, {"sim",8764}, {"spades",9824}, {"sub",8834},
+    {"sube",8838}, {"sum",8721}, {"sup",8835}, {"sup1",185}, {"sup2",178}, {"sup3",179},
+    {"supe",8839}, {"szlig",223}, {"tau",964}, {"there4",8756}, {"theta",952},
+    {"thetasym",977}, {"thinsp",8201}, {"thorn",254}, {"tilde",732}, {"times",215},
+    {"trade",8482}, {"uArr",8657}, {"uacute",250}, {"uarr",8593}, {"ucirc",251},
+    {"ugrave",249}, {"uml",168}, {"upsih",978}, {"upsilon",965}, {"uuml",252},
+    {"weierp",8472}, {"xi",958}, {"yacute",253}, {"yen",165}, {"yuml",255}, {"zeta",950},
+    {"zwj",8205}, {"zwnj",8204}
+};
+
+#define ENML_ENTITY_MAX     10      // Longest entity between the & and the ;, "#x10FFFF" & "thetasym" included
+
+
+static int compareName(const void *key, const void *element) {
+    return strcmp(static_cast<const char*>(key), *static_cast<const char * const *>(element));
+}
+
+
+static int compareEntity(const void *key, const void *element) {
+    return strcmp(static_cast<const char*>(key), static_cast<const EnmlEntity*>(element)->name);
+}
+
+
+template <size_t count>
+static bool listed(const char *name, const char *(&list)[count]) {
+    return bsearch(name, list, count, sizeof(const char*), compareName) != nullptr;
+}
+
+
+
+EnmlText::EnmlText(const QString &enml) :
+    enml(enml)
+{
+    data = enml.constData();
+    length = enml.length();
+    pos = 0;
+    preDepth = 0;
+    pendingSpace = false;
+    pendingBreak = false;
+    text.reserve(length/2);
+}
+
+
+
+// Return the text of a note's ENML
+QString EnmlText::toPlainText(const QString &enml) {
+    EnmlText parser(enml);
+    parser.parse();
+    return parser.text;
+}
+
+
+
+void EnmlText::parse() {
+    while (pos < length) {
+        QChar c = data[pos];
+        if (c == QLatin1Char('<')) {
+            tag();
+        } else if (c == QLatin1Char('&')) {
+            entity();
+        } else {
+            character(c);
+            pos++;
+        }
+    }
+}
+
+
+
+// Handle the markup starting at pos & move past it.  An unterminated
+// tag ends the text.
+void EnmlText::tag() {
+    qint32 start = pos+1;
+    if (start < length && (data[start] == QLatin1Char('!') || data[start] == QLatin1Char('?'))) {
+        if (enml.midRef(start, 8) == QLatin1String("![CDATA[")) {
+            qint32 close = enml.indexOf(QLatin1String("]]>"), start+8);
+            if (close < 0)
+                close = length;
+            for (qint32 i=start+8; i<close; i++)
+                character(data[i]);
+            pos = qMin(close+3, length);
+        } else if (enml.midRef(start, 3) == QLatin1String("!--")) {
+            pos = start+3;
+            skipPast(QLatin1String("-->"));
+        } else {
+            skipPast(QLatin1String(">"));
+        }
+        return;
+    }
+
+    bool closing = start < length && data[start] == QLatin1Char('/');
+    if (closing)
+        start++;
+    char name[16];
+    qint32 nameLength = tagName(data+start, length-start, name, sizeof(name));
+
+    // A '>' inside a quoted attribute doesn't end the tag
+    qint32 end = start+nameLength;
+    QChar quote;
+    for (; end<length; end++) {
+        QChar c = data[end];
+        if (!quote.isNull()) {
+            if (c == quote)
+                quote = QChar();
+        } else if (c == QLatin1Char('"') || c == QLatin1Char('\'')) {
+            quote = c;
+        } else if (c == QLatin1Char('>')) {
+            break;
+        }
+    }
+    if (end >= length) {
+        pos = length;
+        return;
+    }
+    bool empty = data[end-1] == QLatin1Char('/');
+    pos = end+1;
+    if (name[0] == '\0')
+        return;
+
+    if (!closing && !empty && listed(name, skippedElements)) {
+        QByteArray terminator = QByteArray("</") + name;
+        if (skipPast(QLatin1String(terminator)))
+            skipPast(QLatin1String(">"));
+        return;
+    }
+
+    if (listed(name, blockElements))
+        pendingBreak = true;
+    else if (listed(name, cellElements))
+        pendingSpace = true;
+    else if (strcmp(name, "br") == 0)
+        lineBreak();
+
+    if (!empty && strcmp(name, "pre") == 0)
+        preDepth = qMax(0, preDepth + (closing ? -1 : 1));
+}
+
+
+
+// Decode the entity at pos.  Anything that isn't a known entity is
+// kept as it is.
+void EnmlText::entity() {
+    qint32 semicolon = -1;
+    for (qint32 i=pos+1; i<length && i<=pos+ENML_ENTITY_MAX+1; i++) {
+        if (data[i] == QLatin1Char(';')) {
+            semicolon = i;
+            break;
+        }
+        if (data[i].unicode() > 127 || !(data[i].isLetterOrNumber() || data[i] == QLatin1Char('#')))
+            break;
+    }
+
+    uint code = 0;
+    if (semicolon > pos+1 && data[pos+1] == QLatin1Char('#')) {
+        qint32 i = pos+2;
+        int base = 10;
+        if (i < semicolon && (data[i] == QLatin1Char('x') || data[i] == QLatin1Char('X'))) {
+            base = 16;
+            i++;
+        }
+        for (; i<semicolon && code <= 0x10FFFF; i++) {
+            ushort c = data[i].unicode();
+            int digit = -1;
+            if (c >= '0' && c <= '9')
+                digit = c-'0';
+            else if (base == 16 && ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+                digit = (c | 0x20)-'a'+10;
+            if (digit < 0) {
+                code = 0;
+                break;
+            }
+            code = code*base + digit;
+        }
+    } else if (semicolon > pos+1) {
+        char name[ENML_ENTITY_MAX+1];
+        qint32 nameLength = semicolon-pos-1;
+        for (qint32 i=0; i<nameLength; i++)
+            name[i] = static_cast<char>(data[pos+1+i].unicode());
+        name[nameLength] = '\0';
+        const EnmlEntity *found = static_cast<const EnmlEntity*>(
+                    bsearch(name, entities, sizeof(entities)/sizeof(entities[0]), sizeof(EnmlEntity), compareEntity));
+        if (found != nullptr)
+            code = found->code;
+    }
+
+    if (code == 0 || code > 0x10FFFF) {
+        character(QLatin1Char('&'));
+        pos++;
+        return;
+    }
+    pos = semicolon+1;
+    if (QChar::requiresSurrogates(code)) {
+        flush();
+        text.append(QChar(QChar::highSurrogate(code)));
+        text.append(QChar(QChar::lowSurrogate(code)));
+    } else {
+        character(QChar(static_cast<ushort>(code)));
+    }
+}
+
+
+
+// Add one character of text.  Runs of whitespace become one space, like
+// they do in HTML.  A non breaking space is kept as a plain one.
+void EnmlText::character(QChar c) {
+    if (c == QChar::Nbsp) {
+        flush();
+        text.append(QLatin1Char(' '));
+        return;
+    }
+    if (c.isSpace()) {
+        if (preDepth == 0) {
+            pendingSpace = true;
+        } else if (c != QLatin1Char('\r')) {
+            flush();
+            text.append(c);
+        }
+        return;
+    }
+    flush();
+    text.append(c);
+}
+
+
+
+// Write out the space or line break waiting in front of the next character
+void EnmlText::flush() {
+    if (!text.isEmpty() && text.at(text.length()-1) != QLatin1Char('\n')) {
+        if (pendingBreak)
+            text.append(QLatin1Char('\n'));
+        else if (pendingSpace)
+            text.append(QLatin1Char(' '));
+    }
+    pendingBreak = false;
+    pendingSpace = false;
+}
+
+
+
+// A <br>.  Unlike block elements, several of these in a row each count.
+void EnmlText::lineBreak() {
+    pendingSpace = false;
+    pendingBreak = false;
+    if (!text.isEmpty())
+        text.append(QLatin1Char('\n'));
+}
+
+
+
+// Move pos past the next occurrence of the terminator, or to the end of
+// the text if there isn't one.
+bool EnmlText::skipPast(const QLatin1String &terminator) {
+    qint32 i = enml.indexOf(terminator, pos, Qt::CaseInsensitive);
+    if (i < 0) {
+        pos = length;
+        return false;
+    }
+    pos = i+terminator.size();
+    return true;
+}
+
+
+
+// Copy the lower case element name into name.  Names too long for it
+// come back empty.  Returns the characters the name takes up.
+qint32 EnmlText::tagName(const QChar *start, qint32 max, char *name, qint32 size) {
+    qint32 i = 0;
+    for (; i<max; i++) {
+        ushort c = start[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            c += 'a'-'A';
+        else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == ':' || c == '_'))
+            break;
+        if (i < size-1)
+            name[i] = static_cast<char>(c);
+    }
+    name[qMin(i, size-1)] = '\0';
+    if (i >= size)
+        name[0] = '\0';
+    return i;
+}
@@ -0,0 +1,61 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef ENMLTEXT_H
+#define ENMLTEXT_H
+
+#include <QString>
+
+//****************************************************
+//* Converts note ENML to plain text in one pass,
+//* without building a document.  Tags are dropped,
+//* entities are decoded, encrypted text is skipped and
+//* block elements become line breaks, so words in
+//* neighbouring paragraphs or cells stay apart.
+//* Whitespace collapses the way it does in HTML,
+//* except inside <pre>.
+//****************************************************
+
+class EnmlText
+{
+private:
+    const QString &enml;
+    const QChar *data;
+    qint32 length;
+    qint32 pos;
+    qint32 preDepth;            // Inside <pre>, whitespace is kept
+    bool pendingSpace;
+    bool pendingBreak;
+    QString text;
+
+    EnmlText(const QString &enml);
+    void parse();
+    void tag();
+    void entity();
+    void character(QChar c);
+    void flush();
+    void lineBreak();
+    bool skipPast(const QLatin1String &terminator);
+    static qint32 tagName(const QChar *start, qint32 max, char *name, qint32 size);
+
+public:
+    static QString toPlainText(const QString &enml);
+};
+
+#endif // ENMLTEXT_H
@@ -24,16 +24,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/notetable.h"
 #include "src/sql/nsqlquery.h"
 #include "src/sql/resourcetable.h"
-#include <QTextDocument>
+#include "src/sql/searchindextable.h"
+#include "src/utilities/enmltext.h"
+#include "src/utilities/officetext.h"
+#include "src/utilities/pdftext.h"
 #include <QtXml>
-#if QT_VERSION < 0x050000
-#include <poppler-qt4.h>
-#else
-#include <poppler-qt5.h>
-#endif
 
 extern Global global;
-using namespace Poppler;
 
 
 NoteIndexer::NoteIndexer(DatabaseConnection *db)
@@ -55,56 +52,29 @@ void NoteIndexer::indexNote(qint32 lid) {
     if (n.content.isSet())
         content = n.content;
 
-
-    // Start looking through the note
-    qint32 startPos =content.indexOf(QChar('<'));
-    qint32 endPos = content.indexOf(QChar('>'),startPos)+1;
-    content.remove(startPos,endPos-startPos);
-
-    // Remove encrypted text
-    while (content.contains("<en-crypt")) {
-        startPos = content.indexOf("<en-crypt");
-        endPos = content.indexOf("</en-crypt>") + 11;
-        content = content.mid(0,startPos)+content.mid(endPos);
-    }
-
-    // Remove any XML tags
-    while (content.contains(QChar('<'))) {
-        startPos = content.indexOf(QChar('<'));
-        endPos = content.indexOf(QChar('>'),startPos)+1;
-        content.remove(startPos,endPos-startPos);
-    };
-
-    // Get the content as an HTML doc.
-    QTextDocument textDocument;
-    textDocument.setHtml(content);
     QString title  = "";
     if (n.title.isSet())
         title = n.title;
-    content = textDocument.toPlainText() + " " + title;
-    this->addTextIndex(lid, content);
+    content = EnmlText::toPlainText(content) + " " + title;
+    QStringList tagNames;
+    if (n.tagNames.isSet())
+        tagNames = n.tagNames;
+    this->addTextIndex(lid, content, title, tagNames.join(" "));
 }
 
 
-void NoteIndexer::addTextIndex(int lid, QString content) {
+// The title & tags are kept in their own columns so they can be ranked
+// higher.  The title is also part of content so filtering is unchanged.
+void NoteIndexer::addTextIndex(qint32 lid, QString content, QString title, QString tags) {
     // Delete any old content
-    NSqlQuery sql(db);
-    sql.prepare("Delete from SearchIndex where lid=:lid and source=:source");
-    sql.bindValue(":lid", lid);
-    sql.bindValue(":source", "text");
-    sql.exec();
+    SearchIndexTable searchIndex(db);
+    searchIndex.expunge(lid, "text");
 
     // Add the new content.  it is basically a text version of the note with a weight of 100.
-    sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-    sql.bindValue(":lid", lid);
-    sql.bindValue(":weight", 100);
-    sql.bindValue(":source", "text");
-
-    content = global.normalizeTermForSearchAndIndex(content);
-    sql.bindValue(":content", content);
-
-    sql.exec();
+    // Only content is searched with LIKE, so only it needs normalizing.
+    searchIndex.add(lid, 100, "text", global.normalizeTermForSearchAndIndex(content), title, tags);
 
+    NSqlQuery sql(db);
     sql.prepare("Delete from DataStore where lid=:lid and key=:key");
     sql.bindValue(":lid", lid);
     sql.bindValue(":key", NOTE_INDEX_NEEDED);
@@ -123,32 +93,19 @@ void NoteIndexer::indexResource(qint32 lid) {
     resourceTable.get(r, lid, false);
 
     NSqlQuery sql(db);
+    SearchIndexTable searchIndex(db);
 
     // Delete the old index
     QLOG_DEBUG() << "Deleting old resource from index";
-    sql.prepare("Delete from SearchIndex where lid=:lid");
-    sql.bindValue(":lid", lid);
-    sql.exec();
+    searchIndex.expunge(lid);
 
     QLOG_DEBUG() << "Adding attributes to index.";
     if (r.attributes.isSet()) {
         ResourceAttributes a = r.attributes;
-        if (a.fileName.isSet()) {
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", lid);
-            sql.bindValue(":weight", 100);
-            sql.bindValue(":source", "recognition");
-            sql.bindValue(":content", QString(a.fileName));
-            sql.exec();
-        }
-        if (a.sourceURL.isSet()) {
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", lid);
-            sql.bindValue(":weight", 100);
-            sql.bindValue(":source", "recognition");
-            sql.bindValue(":content", QString(a.sourceURL));
-            sql.exec();
-        }
+        if (a.fileName.isSet())
+            searchIndex.add(lid, 100, "recognition", QString(a.fileName));
+        if (a.sourceURL.isSet())
+            searchIndex.add(lid, 100, "recognition", QString(a.sourceURL));
     }
 
     QLOG_TRACE() << "Indexing recognition";
@@ -156,12 +113,30 @@ void NoteIndexer::indexResource(qint32 lid) {
     QString mime = "";
     if (r.mime.isSet())
         mime = r.mime;
+    QString fileName = "";
+    if (r.attributes.isSet() && r.attributes->fileName.isSet())
+        fileName = r.attributes->fileName;
+    bool attachment = mime.toLower() == "application/pdf" || OfficeText::handles(mime, fileName);
+
+    // Reading an attachment can take up to its time limit.  Inside a
+    // transaction (a sync chunk) that would hold the write lock the whole
+    // time, so the resource stays flagged & the index pipeline reads it
+    // once the transaction is committed.
+    if (attachment && db->inTransaction()) {
+        QLOG_DEBUG() << "Leaving the attachment text to the index pipeline.";
+        sql.prepare("insert into DataStore (lid, key, data) select :lid, :key, 1 where not exists "
+                    "(select 1 from DataStore where lid=:lid2 and key=:key2)");
+        sql.bindValue(":lid", lid);
+        sql.bindValue(":key", RESOURCE_INDEX_NEEDED);
+        sql.bindValue(":lid2", lid);
+        sql.bindValue(":key2", RESOURCE_INDEX_NEEDED);
+        sql.exec();
+        return;
+    }
     if (mime.toLower() == "application/pdf")
-        this->indexPdf(lid);
-//    else {
-//        if (mime.startsWith("application", Qt::CaseInsensitive))
-//            indexAttachment(noteLid, r);
-//   }
+        this->indexPdf(lid, r);
+    else if (attachment)
+        this->indexOffice(lid, r);
 
     QLOG_DEBUG() << "Resetting index needed.";
     sql.prepare("delete from DataStore where lid=:lid and key=:key");
@@ -181,7 +156,7 @@ void NoteIndexer::indexRecognition(qint32 reslid, Resource &r) {
     if (reslid <= 0)
         return;
 
-    NSqlQuery sql(db);
+    SearchIndexTable searchIndex(db);
 
     // Make sure we have something to look through.
     Data recognition;
@@ -199,7 +174,9 @@ void NoteIndexer::indexRecognition(qint32 reslid, Resource &r) {
 
     QLOG_TRACE() << "Beginning insertion of recognition:";
     QLOG_TRACE() << "Anchors found: " << anchors.length();
-    sql.exec("begin;");
+    // A savepoint rather than a transaction, since a sync chunk may already
+    // have one open on this connection.
+    db->savepoint("recognition");
 #if QT_VERSION < 0x050000
     for (unsigned int i=0;  i<anchors.length(); i++) {
 #else
@@ -212,20 +189,11 @@ void NoteIndexer::indexRecognition(qint32 reslid, Resource &r) {
         QString text = enmedia.text();
         if (text != "") {
             // Add the new content.  it is basically a text version of the note with a weight of 100.
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", reslid);
-            sql.bindValue(":weight", weight);
-            sql.bindValue(":source", "recognition");
-
-
-            text = global.normalizeTermForSearchAndIndex(text);
-            sql.bindValue(":content", text);
-
-            sql.exec();
+            searchIndex.add(reslid, weight.toInt(), "recognition", global.normalizeTermForSearchAndIndex(text));
         }
     }
     QLOG_TRACE() << "Committing";
-    sql.exec("commit");
+    db->releaseSavepoint("recognition");
     QLOG_TRACE_OUT();
 }
 
@@ -233,38 +201,48 @@ void NoteIndexer::indexRecognition(qint32 reslid, Resource &r) {
 
 // Index any PDFs that are attached.  Basically it turns the PDF into text and adds it the same
 // way as a note's body
-void NoteIndexer::indexPdf(qint32 reslid) {
+void NoteIndexer::indexPdf(qint32 reslid, Resource &r) {
 
     QLOG_TRACE_IN();
-    if (!global.indexPDFLocally)
-        return;
-
-    NSqlQuery sql(db);
     if (reslid <= 0)
         return;
 
-    QString file = global.fileManager.getDbaDirPath() + QString::number(reslid) +".pdf";
-
-    QString text = "";
-    Poppler::Document *doc = Poppler::Document::load(file);
-    if (doc == nullptr || doc->isEncrypted() || doc->isLocked())
+    QByteArray bodyHash;
+    if (r.data.isSet() && r.data->bodyHash.isSet())
+        bodyHash = r.data->bodyHash;
+    QString text = PdfText::text(reslid, bodyHash);
+    if (text.trimmed() == "")
         return;
 
-    for (int i=0; i<doc->numPages(); i++) {
-        QRectF rect;
-        text = text + doc->page(i)->text(rect) + QString(" ");
-    }
-
     QLOG_TRACE() << "Adding PDF";
     // Add the new content.  it is basically a text version of the note with a weight of 100.
-    sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-    sql.bindValue(":lid", reslid);
-    sql.bindValue(":weight", 100);
-    sql.bindValue(":source", "recognition");
+    SearchIndexTable searchIndex(db);
+    searchIndex.add(reslid, 100, "recognition", global.normalizeTermForSearchAndIndex(text));
+    QLOG_TRACE_OUT();
+}
 
-    text = global.normalizeTermForSearchAndIndex(text);
-    sql.bindValue(":content", text);
 
-    sql.exec();
+
+// Index the text of an office attachment (docx, xlsx, odt ...) the same
+// way as a PDF.  OfficeText has the same time limit & cache rules.
+void NoteIndexer::indexOffice(qint32 reslid, Resource &r) {
+
+    QLOG_TRACE_IN();
+    if (reslid <= 0)
+        return;
+
+    QString fileName = "";
+    if (r.attributes.isSet() && r.attributes->fileName.isSet())
+        fileName = r.attributes->fileName;
+    QByteArray bodyHash;
+    if (r.data.isSet() && r.data->bodyHash.isSet())
+        bodyHash = r.data->bodyHash;
+    QString text = OfficeText::text(reslid, fileName, bodyHash);
+    if (text.trimmed() == "")
+        return;
+
+    QLOG_TRACE() << "Adding office text";
+    SearchIndexTable searchIndex(db);
+    searchIndex.add(reslid, 100, "recognition", global.normalizeTermForSearchAndIndex(text));
     QLOG_TRACE_OUT();
 }
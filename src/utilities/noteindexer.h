@@ -44,10 +44,11 @@ private:
 public:
     NoteIndexer(DatabaseConnection *db);
     void indexNote(qint32 lid);
-    void addTextIndex(qint32 lid, QString content);
+    void addTextIndex(qint32 lid, QString content, QString title="", QString tags="");
     void indexResource(qint32 lid);
     void indexRecognition(qint32 reslid, Resource &r);
-    void indexPdf(qint32 reslid);
+    void indexPdf(qint32 reslid, Resource &r);
+    void indexOffice(qint32 reslid, Resource &r);
 };
 
 #endif // NOTEINDEXER_H
@@ -0,0 +1,168 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "officetext.h"
+#include "src/global.h"
+#include "textcache.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QXmlStreamReader>
+
+extern Global global;
+
+
+// Is it a format this can read?  The file name is checked as well as the
+// mime type, since attachments often come as application/octet-stream.
+bool OfficeText::handles(QString mime, QString fileName) {
+    mime = mime.toLower();
+    if (mime.startsWith("application/vnd.openxmlformats-officedocument.") ||
+            mime.startsWith("application/vnd.oasis.opendocument."))
+        return true;
+
+    static const QStringList extensions = QStringList()
+            << "docx" << "docm" << "dotx" << "dotm" << "xlsx" << "xlsm" << "xltx" << "xltm"
+            << "pptx" << "pptm" << "ppsx" << "potx" << "odt" << "ott" << "ods" << "ots"
+            << "odp" << "otp" << "odg" << "otg" << "odm";
+    return extensions.contains(QFileInfo(fileName).suffix().toLower());
+}
+
+
+
+// Return the text of an office attachment, from the cache if it has been
+// read before.  A file that can't be read is cached as empty so it isn't
+// tried again.  Text cut short by the time limit isn't cached, as a less
+// busy machine may get further.
+QString OfficeText::text(qint32 reslid, QString fileName, QByteArray bodyHash) {
+    QString text = "";
+    if (reslid <= 0 || TextCache::get(bodyHash, text))
+        return text;
+
+    QString file = global.fileManager.getDbaDirPath() + QString::number(reslid) + "." + QFileInfo(fileName).suffix();
+    if (!QFile::exists(file)) {
+        QDir dir(global.fileManager.getDbaDirPath());
+        QStringList list = dir.entryList(QStringList(QString::number(reslid)+".*"), QDir::Files);
+        if (list.isEmpty())
+            return "";
+        file = global.fileManager.getDbaDirPath() + list[0];
+    }
+    QFileInfo info(file);
+    if (info.size() > OFFICETEXT_MAX_FILE) {
+        QLOG_WARN() << "Not indexing " << file << ", it is " << info.size() << " bytes";
+        return "";
+    }
+
+    ZipReader zip(file);
+    if (!zip.open()) {
+        QLOG_DEBUG() << file << " isn't a ZIP file, it has no text to index";
+        TextCache::put(bodyHash, "");
+        return "";
+    }
+
+    bool odf = zip.contains("content.xml");
+    QElapsedTimer timer;
+    timer.start();
+    bool complete = true;
+    const QList<ZipEntry> &entries = zip.entries();
+    for (int i=0; i<entries.size(); i++) {
+        if (!isTextPart(entries[i].name, odf))
+            continue;
+        if (timer.hasExpired(OFFICETEXT_TIME_LIMIT) || text.length() >= OFFICETEXT_MAX_CHARS) {
+            complete = false;
+            break;
+        }
+        if (!readPart(zip, entries[i], odf, text, timer)) {
+            QLOG_DEBUG() << "Only part of " << entries[i].name << " in " << file << " was read";
+            complete = false;
+        }
+    }
+    if (!complete)
+        QLOG_WARN() << "Only part of " << file << " was indexed, it took " << timer.elapsed() << "ms";
+
+    text.truncate(OFFICETEXT_MAX_CHARS);
+    if (!timer.hasExpired(OFFICETEXT_TIME_LIMIT))
+        TextCache::put(bodyHash, text);
+    return text;
+}
+
+
+
+// The parts that hold a document's text.  Styles, settings & relationships
+// are skipped.
+bool OfficeText::isTextPart(QString name, bool odf) {
+    if (odf)
+        return name == "content.xml";
+    if (!name.endsWith(".xml"))
+        return false;
+    return name == "word/document.xml" || name == "word/footnotes.xml" ||
+           name == "word/endnotes.xml" || name == "word/comments.xml" ||
+           name.startsWith("word/header") || name.startsWith("word/footer") ||
+           name == "xl/sharedStrings.xml" || name.startsWith("xl/worksheets/sheet") ||
+           name.startsWith("ppt/slides/slide") || name.startsWith("ppt/notesSlides/notesSlide");
+}
+
+
+
+// Parse one part as it is inflated.  OOXML keeps its text in <t> elements
+// (w:t, a:t or a spreadsheet's t); everything in an ODF body is text.
+// Paragraphs end with a line break, cells with a tab.  Returns false if
+// the part couldn't all be read.
+bool OfficeText::readPart(ZipReader &zip, const ZipEntry &entry, bool odf, QString &text, QElapsedTimer &timer) {
+    ZipStream stream(zip.device(), entry, OFFICETEXT_MAX_PART);
+    QXmlStreamReader reader;
+    bool inText = false;
+    forever {
+        QByteArray chunk = stream.read();
+        if (chunk.isEmpty())
+            break;
+        reader.addData(chunk);
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement()) {
+                QStringRef name = reader.name();
+                if (name == (odf ? "body" : "t"))
+                    inText = true;
+                else if (odf && !inText)
+                    continue;
+                else if (name == "s")
+                    text.append(QChar(' '));
+                else if (name == "tab")
+                    text.append(QChar('\t'));
+                else if (name == "line-break" || name == "br" || name == "cr")
+                    text.append(QChar('\n'));
+            } else if (reader.isEndElement()) {
+                QStringRef name = reader.name();
+                if ((odf && name == "body") || (!odf && name == "t"))
+                    inText = false;
+                else if (name == "p" || name == "h" || name == "si")
+                    text.append(QChar('\n'));
+                else if (name == "table-cell" || name == "c")
+                    text.append(QChar('\t'));
+            } else if (reader.isCharacters() && inText) {
+                text.append(reader.text());
+            }
+        }
+        if (reader.hasError() && reader.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+            return false;
+        if (timer.hasExpired(OFFICETEXT_TIME_LIMIT) || text.length() >= OFFICETEXT_MAX_CHARS)
+            return false;
+    }
+    return !stream.failed();
+}
@@ -0,0 +1,54 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef OFFICETEXT_H
+#define OFFICETEXT_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+#include "zipreader.h"
+
+//****************************************************
+//* Text of Office Open XML (docx, xlsx, pptx) &
+//* OpenDocument (odt, ods, odp) attachments for the
+//* search index, read in process.  Both are ZIP
+//* files of XML parts; the parts with text in them
+//* are inflated & parsed a chunk at a time.  The
+//* result goes in the TextCache.
+//****************************************************
+
+#define OFFICETEXT_MAX_FILE     (Q_INT64_C(64)*1024*1024)   // Larger files aren't opened
+#define OFFICETEXT_MAX_PART     (Q_INT64_C(128)*1024*1024)  // XML read from one part before giving up on it
+#define OFFICETEXT_MAX_CHARS    (8*1024*1024)               // Text kept from one file
+#define OFFICETEXT_TIME_LIMIT   30000                       // ms a file may take before its remaining parts are skipped
+
+class OfficeText
+{
+private:
+    static bool isTextPart(QString name, bool odf);
+    static bool readPart(ZipReader &zip, const ZipEntry &entry, bool odf, QString &text, QElapsedTimer &timer);
+
+public:
+    static bool handles(QString mime, QString fileName);       // Can the file be read?
+    static QString text(qint32 reslid, QString fileName, QByteArray bodyHash);
+};
+
+#endif // OFFICETEXT_H
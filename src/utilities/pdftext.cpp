@@ -0,0 +1,177 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "pdftext.h"
+#include "src/global.h"
+#include "textcache.h"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#if QT_VERSION < 0x050000
+#include <poppler-qt4.h>
+#else
+#include <poppler-qt5.h>
+#endif
+
+extern Global global;
+
+
+// Reads one range of pages.  The first range is read on the calling
+// thread with the document it already has open; the others open their own.
+class PdfPageTask : public QRunnable
+{
+public:
+    QString file;
+    Poppler::Document *doc;
+    qint32 first;
+    qint32 last;
+    const QElapsedTimer *timer;
+    QAtomicInt *budget;             // Characters still allowed
+    QSemaphore *done;
+    QStringList pages;
+    bool complete;
+    bool timedOut;                  // Stopped by PDFTEXT_TIME_LIMIT
+
+    PdfPageTask(QString file, qint32 first, qint32 last, const QElapsedTimer *timer,
+                QAtomicInt *budget, QSemaphore *done) {
+        this->file = file;
+        this->doc = nullptr;
+        this->first = first;
+        this->last = last;
+        this->timer = timer;
+        this->budget = budget;
+        this->done = done;
+        complete = false;
+        timedOut = false;
+        setAutoDelete(false);
+    }
+
+    void run() {
+        Poppler::Document *document = doc;
+        if (document == nullptr)
+            document = Poppler::Document::load(file);
+        if (document != nullptr) {
+            complete = true;
+            for (qint32 i=first; i<last && complete; i++) {
+                if (timer->hasExpired(PDFTEXT_TIME_LIMIT))
+                    timedOut = true;
+                if (timedOut || budget->loadAcquire() <= 0) {
+                    complete = false;
+                    break;
+                }
+                Poppler::Page *page = document->page(i);
+                if (page == nullptr)
+                    continue;
+                QRectF rect;
+                QString text = page->text(rect);
+                delete page;
+                budget->fetchAndAddOrdered(-text.length());
+                pages.append(text);
+            }
+            if (document != doc)
+                delete document;
+        }
+        done->release();
+    }
+};
+
+
+
+// Return the text of a PDF resource, from the cache if it has been read
+// before.  Text is only cached once the document could be opened, so a
+// file that isn't there yet is tried again next time.  Text cut short by
+// PDFTEXT_MAX_CHARS is cached, since reading it again would stop there
+// too.  Text cut short by the time limit isn't, as a less busy machine
+// may get further.
+QString PdfText::text(qint32 reslid, QByteArray bodyHash) {
+    if (!global.indexPDFLocally || reslid <= 0)
+        return "";
+    QString text = "";
+    if (TextCache::get(bodyHash, text))
+        return text;
+
+    QString file = global.fileManager.getDbaDirPath() + QString::number(reslid) +".pdf";
+    QFileInfo info(file);
+    if (!info.exists())
+        return "";
+    if (info.size() > PDFTEXT_MAX_FILE) {
+        QLOG_WARN() << "Not indexing " << file << ", it is " << info.size() << " bytes";
+        return "";
+    }
+
+    bool opened = false;
+    bool timedOut = false;
+    text = extract(file, opened, timedOut);
+    if (opened && !timedOut)
+        TextCache::put(bodyHash, text);
+    return text;
+}
+
+
+
+// Read the pages, in parallel if there are enough of them.  The page
+// tasks go to the global pool; the indexer's threads wait on them but
+// never run them, so they can't starve each other.
+QString PdfText::extract(QString file, bool &opened, bool &timedOut) {
+    Poppler::Document *doc = Poppler::Document::load(file);
+    if (doc == nullptr)
+        return "";
+    opened = true;
+    if (doc->isEncrypted() || doc->isLocked()) {
+        delete doc;
+        return "";
+    }
+
+    qint32 pages = doc->numPages();
+    qint32 count = qBound(1, pages/PDFTEXT_PAGES_PER_TASK, qMin(PDFTEXT_MAX_TASKS, QThread::idealThreadCount()));
+    QElapsedTimer timer;
+    timer.start();
+    QAtomicInt budget(PDFTEXT_MAX_CHARS);
+    QSemaphore done;
+    QList<PdfPageTask*> tasks;
+    for (qint32 i=0; i<count; i++)
+        tasks.append(new PdfPageTask(file, pages*i/count, pages*(i+1)/count, &timer, &budget, &done));
+    for (qint32 i=1; i<count; i++)
+        QThreadPool::globalInstance()->start(tasks[i]);
+    tasks[0]->doc = doc;
+    tasks[0]->run();
+    done.acquire(count);
+
+    QString text = "";
+    bool complete = true;
+    for (qint32 i=0; i<count; i++) {
+        text = text + tasks[i]->pages.join(" ") + QString(" ");
+        complete = complete && tasks[i]->complete;
+        timedOut = timedOut || tasks[i]->timedOut;
+    }
+    qDeleteAll(tasks);
+    delete doc;
+
+    if (!complete)
+        QLOG_WARN() << "Only part of " << file << " was indexed, it took " << timer.elapsed()
+                    << "ms for " << pages << " pages";
+    text.truncate(PDFTEXT_MAX_CHARS);
+    return text;
+}
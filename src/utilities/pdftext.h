@@ -0,0 +1,50 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef PDFTEXT_H
+#define PDFTEXT_H
+
+#include <QString>
+#include <QByteArray>
+
+//****************************************************
+//* Text of a PDF attachment for the search index.
+//* It is kept in the TextCache, so a PDF is only
+//* read once.  Long documents are split into page
+//* ranges that are read on separate threads, each
+//* with its own Poppler document since they can't
+//* be shared.
+//****************************************************
+
+#define PDFTEXT_TIME_LIMIT      60000                   // ms a document may take before its remaining pages are skipped
+#define PDFTEXT_MAX_CHARS       (8*1024*1024)           // Text kept from one document
+#define PDFTEXT_MAX_FILE        (Q_INT64_C(256)*1024*1024)  // Larger files aren't opened
+#define PDFTEXT_PAGES_PER_TASK  16                      // Pages a thread gets at least
+#define PDFTEXT_MAX_TASKS       4                       // Threads one document may use
+
+class PdfText
+{
+private:
+    static QString extract(QString file, bool &opened, bool &timedOut);
+
+public:
+    static QString text(qint32 reslid, QByteArray bodyHash);    // Empty if indexPDFLocally is off
+};
+
+#endif // PDFTEXT_H
@@ -0,0 +1,94 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "textcache.h"
+#include "src/global.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+extern Global global;
+
+
+static QString cacheFile(QByteArray bodyHash) {
+    return global.fileManager.getTextCacheDirPath(QString(bodyHash.toHex()) + ".txt");
+}
+
+
+
+bool TextCache::get(QByteArray bodyHash, QString &text) {
+    if (bodyHash.isEmpty())
+        return false;
+    QFile cached(cacheFile(bodyHash));
+    if (!cached.open(QIODevice::ReadOnly))
+        return false;
+    text = QString::fromUtf8(cached.readAll());
+    cached.close();
+    return true;
+}
+
+
+
+// The file is written under another name & renamed, so a crash can't
+// leave half of it behind.
+void TextCache::put(QByteArray bodyHash, QString text) {
+    if (bodyHash.isEmpty())
+        return;
+    QSaveFile cached(cacheFile(bodyHash));
+    if (!cached.open(QIODevice::WriteOnly)) {
+        QLOG_WARN() << "Unable to cache the text of " << bodyHash.toHex();
+        return;
+    }
+    cached.write(text.toUtf8());
+    if (!cached.commit()) {
+        QLOG_WARN() << "Unable to cache the text of " << bodyHash.toHex();
+        return;
+    }
+    trim();
+}
+
+
+
+void TextCache::remove(QByteArray bodyHash) {
+    if (bodyHash.isEmpty())
+        return;
+    QFile::remove(cacheFile(bodyHash));
+}
+
+
+
+// Delete the oldest files until the cache fits in TEXTCACHE_MAX_SIZE.
+// Only a put can make it grow, and it follows reading a whole attachment,
+// so listing the directory each time costs little next to that.
+void TextCache::trim() {
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+    QDir dir(global.fileManager.getTextCacheDirPath(""));
+    QFileInfoList files = dir.entryInfoList(QStringList("*.txt"), QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for (int i=0; i<files.size(); i++) {
+        total = total + files[i].size();
+        if (total > TEXTCACHE_MAX_SIZE)
+            QFile::remove(files[i].absoluteFilePath());
+    }
+}
@@ -0,0 +1,48 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+//****************************************************
+//* Text extracted from attachments (PDFs & office
+//* files) for the search index, kept on disk under
+//* the attachment's body hash.  The same file is
+//* only read once however often it is indexed and
+//* however many notes it is attached to.  Once it
+//* passes TEXTCACHE_MAX_SIZE the oldest files go.
+//****************************************************
+
+#define TEXTCACHE_MAX_SIZE      (Q_INT64_C(256)*1024*1024)  // Bytes kept on disk
+
+class TextCache
+{
+private:
+    static void trim();
+
+public:
+    static bool get(QByteArray bodyHash, QString &text);   // False if it isn't cached
+    static void put(QByteArray bodyHash, QString text);
+    static void remove(QByteArray bodyHash);               // The last attachment with this body is gone
+};
+
+#endif // TEXTCACHE_H
@@ -0,0 +1,245 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "zipreader.h"
+
+#include <string.h>
+
+#define ZIP_END_SIGNATURE       0x06054b50
+#define ZIP_CENTRAL_SIGNATURE   0x02014b50
+#define ZIP_LOCAL_SIGNATURE     0x04034b50
+#define ZIP_END_SIZE            22
+#define ZIP_CENTRAL_SIZE        46
+#define ZIP_LOCAL_SIZE          30
+
+// Little endian fields
+static quint16 read16(const char *p) {
+    const uchar *u = reinterpret_cast<const uchar*>(p);
+    return static_cast<quint16>(u[0] | (u[1] << 8));
+}
+
+static quint32 read32(const char *p) {
+    const uchar *u = reinterpret_cast<const uchar*>(p);
+    return static_cast<quint32>(u[0]) | (static_cast<quint32>(u[1]) << 8) |
+           (static_cast<quint32>(u[2]) << 16) | (static_cast<quint32>(u[3]) << 24);
+}
+
+
+
+ZipReader::ZipReader(QString fileName) :
+    file(fileName)
+{
+}
+
+
+
+// Find the end of central directory record (it is followed by a comment
+// of up to 64k) & read the entries it points to.
+bool ZipReader::open() {
+    list.clear();
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 size = file.size();
+    if (size < ZIP_END_SIZE)
+        return false;
+
+    qint64 tailSize = qMin(size, static_cast<qint64>(ZIP_END_SIZE + 65535));
+    file.seek(size - tailSize);
+    QByteArray tail = file.read(tailSize);
+    qint32 end = -1;
+    for (qint32 i=tail.size()-ZIP_END_SIZE; i>=0; i--) {
+        if (read32(tail.constData()+i) == ZIP_END_SIGNATURE) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0)
+        return false;
+
+    quint16 count = read16(tail.constData()+end+10);
+    quint32 directorySize = read32(tail.constData()+end+12);
+    quint32 directoryOffset = read32(tail.constData()+end+16);
+    if (static_cast<qint64>(directoryOffset) + directorySize > size)
+        return false;
+    file.seek(directoryOffset);
+    QByteArray directory = file.read(directorySize);
+    if (static_cast<quint32>(directory.size()) != directorySize)
+        return false;
+
+    qint32 pos = 0;
+    for (quint16 i=0; i<count; i++) {
+        if (pos + ZIP_CENTRAL_SIZE > directory.size())
+            return false;
+        const char *p = directory.constData()+pos;
+        if (read32(p) != ZIP_CENTRAL_SIGNATURE)
+            return false;
+        quint16 flags = read16(p+8);
+        quint16 nameLength = read16(p+28);
+        quint16 extraLength = read16(p+30);
+        quint16 commentLength = read16(p+32);
+        if (pos + ZIP_CENTRAL_SIZE + nameLength > directory.size())
+            return false;
+
+        ZipEntry entry;
+        entry.method = read16(p+10);
+        entry.compressedSize = read32(p+20);
+        entry.size = read32(p+24);
+        entry.offset = read32(p+42);
+        if (flags & 0x0800)
+            entry.name = QString::fromUtf8(p+ZIP_CENTRAL_SIZE, nameLength);
+        else
+            entry.name = QString::fromLatin1(p+ZIP_CENTRAL_SIZE, nameLength);
+        if ((flags & 0x0001) == 0 && (entry.method == 0 || entry.method == 8))
+            list.append(entry);
+        pos += ZIP_CENTRAL_SIZE + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+
+
+const QList<ZipEntry> &ZipReader::entries() {
+    return list;
+}
+
+
+
+bool ZipReader::contains(QString name) {
+    for (int i=0; i<list.size(); i++) {
+        if (list[i].name == name)
+            return true;
+    }
+    return false;
+}
+
+
+
+QFile *ZipReader::device() {
+    return &file;
+}
+
+
+
+ZipStream::ZipStream(QFile *file, const ZipEntry &entry, qint64 limit) {
+    this->file = file;
+    this->entry = entry;
+    this->limit = limit;
+    position = 0;
+    remaining = entry.compressedSize;
+    produced = 0;
+    started = false;
+    finished = false;
+    error = false;
+    memset(&stream, 0, sizeof(stream));
+}
+
+
+
+ZipStream::~ZipStream() {
+    if (started && entry.method == 8)
+        inflateEnd(&stream);
+}
+
+
+
+// Skip the local header, whose name & extra field lengths can differ
+// from the central directory's.
+bool ZipStream::start() {
+    started = true;
+    if (!file->seek(entry.offset))
+        return false;
+    QByteArray header = file->read(ZIP_LOCAL_SIZE);
+    if (header.size() != ZIP_LOCAL_SIZE || read32(header.constData()) != ZIP_LOCAL_SIGNATURE)
+        return false;
+    position = static_cast<qint64>(entry.offset) + ZIP_LOCAL_SIZE
+            + read16(header.constData()+26) + read16(header.constData()+28);
+    if (entry.method == 8 && inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        entry.method = 0;       // Nothing for the destructor to end
+        return false;
+    }
+    return true;
+}
+
+
+
+QByteArray ZipStream::read() {
+    if (finished || error)
+        return QByteArray();
+    if (!started && !start()) {
+        error = true;
+        return QByteArray();
+    }
+
+    QByteArray output;
+    if (entry.method == 0) {
+        if (remaining == 0) {
+            finished = true;
+            return output;
+        }
+        file->seek(position);
+        output = file->read(qMin(remaining, static_cast<qint64>(ZIP_CHUNK)));
+        if (output.isEmpty()) {
+            error = true;
+            return output;
+        }
+        position += output.size();
+        remaining -= output.size();
+    } else {
+        output.resize(ZIP_CHUNK);
+        stream.next_out = reinterpret_cast<Bytef*>(output.data());
+        stream.avail_out = ZIP_CHUNK;
+        while (stream.avail_out == ZIP_CHUNK) {
+            if (stream.avail_in == 0 && remaining > 0) {
+                file->seek(position);
+                input = file->read(qMin(remaining, static_cast<qint64>(ZIP_CHUNK)));
+                if (input.isEmpty()) {
+                    error = true;
+                    return QByteArray();
+                }
+                position += input.size();
+                remaining -= input.size();
+                stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                stream.avail_in = input.size();
+            }
+            int rc = inflate(&stream, Z_NO_FLUSH);
+            if (rc == Z_STREAM_END) {
+                finished = true;
+                break;
+            }
+            if (rc != Z_OK && !(rc == Z_BUF_ERROR && stream.avail_in == 0 && remaining > 0)) {
+                error = true;
+                return QByteArray();
+            }
+        }
+        output.resize(ZIP_CHUNK - stream.avail_out);
+    }
+
+    produced += output.size();
+    if (produced > limit) {
+        error = true;
+        return QByteArray();
+    }
+    return output;
+}
+
+
+
+bool ZipStream::failed() {
+    return error;
+}
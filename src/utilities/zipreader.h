@@ -0,0 +1,95 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef ZIPREADER_H
+#define ZIPREADER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <zlib.h>
+
+//****************************************************
+//* Just enough of a ZIP reader to get the XML out
+//* of office documents: the central directory is
+//* read once and an entry is inflated a chunk at a
+//* time, so a part never has to fit in memory.
+//* Only stored & deflated entries are supported and
+//* encrypted ones are skipped.
+//****************************************************
+
+#define ZIP_CHUNK   65536       // Bytes read from the file at a time
+
+class ZipEntry
+{
+public:
+    QString name;
+    quint16 method;             // 0 stored, 8 deflated
+    quint32 compressedSize;
+    quint32 size;
+    quint32 offset;             // Of the local header
+};
+
+
+
+class ZipReader
+{
+private:
+    QFile file;
+    QList<ZipEntry> list;
+
+public:
+    ZipReader(QString fileName);
+    bool open();                                    // Read the central directory
+    const QList<ZipEntry> &entries();
+    bool contains(QString name);
+    QFile *device();
+};
+
+
+
+// One entry, read a chunk at a time.  limit is the most uncompressed data
+// it will hand out before giving up, so a tiny entry can't expand into
+// gigabytes.
+class ZipStream
+{
+private:
+    QFile *file;
+    ZipEntry entry;
+    qint64 limit;
+    qint64 position;            // Next compressed byte in the file
+    qint64 remaining;           // Compressed bytes not read yet
+    qint64 produced;
+    bool started;
+    bool finished;
+    bool error;
+    z_stream stream;
+    QByteArray input;
+
+    bool start();
+
+public:
+    ZipStream(QFile *file, const ZipEntry &entry, qint64 limit);
+    ~ZipStream();
+    QByteArray read();                              // Empty at the end or on an error
+    bool failed();
+};
+
+#endif // ZIPREADER_H